@@ -18,6 +18,8 @@ class DCTDSTFieldBackend
     dim = Traits::dim
   };
 
+  using Copy = StridedCopy<Index, Indices, dim>;
+
   static_assert(dim != 1, "DCTDSTMatrixBackend requires dim > 1");
 
   const std::shared_ptr<Traits> traits;
@@ -42,11 +44,12 @@ class DCTDSTFieldBackend
   Indices localDCTDSTCells;
 
   mutable RF* fieldData;
+  RF* sumData;
   mutable Indices indices;
 
   Index sliceSize;
   bool odd[dim];
-  typename FFTW<RF>::r2r_kind k[dim];
+  typename FFTEngine<RF>::r2r_kind k[dim];
   bool transposed;
 
   enum
@@ -61,44 +64,38 @@ public:
   /**
    * @brief Constructor
    *
-   * Imports FFTW wisdom if configured to do so.
-   *
    * @param traits_ traits object with parameters and communication
    */
   DCTDSTFieldBackend(const std::shared_ptr<Traits>& traits_)
     : traits(traits_)
     , fieldData(nullptr)
+    , sumData(nullptr)
   {
     if ((*traits).verbose && (*traits).rank == 0)
       std::cout << "using DCTDSTFieldBackend" << std::endl;
-
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      if ((*traits).rank == 0)
-        FFTW<RF>::import_wisdom_from_filename("wisdom-DCTDSTField.ini");
-
-      FFTW<RF>::mpi_broadcast_wisdom((*traits).comm);
-    }
   }
 
   /**
    * @brief Destructor
    *
-   * Cleans up allocated arrays and FFTW plans. Exports FFTW
+   * Cleans up allocated arrays and FFTW plans. Stores new FFTW
    * wisdom if configured to do so.
    */
   ~DCTDSTFieldBackend()
   {
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      FFTW<RF>::mpi_gather_wisdom((*traits).comm);
-
-      if ((*traits).rank == 0)
-        FFTW<RF>::export_wisdom_to_filename("wisdom-DCTDSTField.ini");
-    }
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::store(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
 
     if (fieldData != nullptr) {
-      FFTW<RF>::free(fieldData);
+      FFTEngine<RF>::free(fieldData);
       fieldData = nullptr;
     }
+
+    if (sumData != nullptr) {
+      FFTEngine<RF>::free(sumData);
+      sumData = nullptr;
+    }
   }
 
   /*
@@ -106,13 +103,18 @@ public:
    *
    * This function is has to be called after the creation of
    * the random field object or its refinement. It updates
-   * parameters like the number of cells per dimension.
+   * parameters like the number of cells per dimension, and
+   * imports FFTW wisdom for the new geometry if configured to do so.
    */
   void update()
   {
     rank = (*traits).rank;
     commSize = (*traits).commSize;
 
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::load(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
+
     localCells = (*traits).localCells;
     localOffset = (*traits).localOffset;
     localDomainSize = (*traits).localDomainSize;
@@ -129,9 +131,14 @@ public:
     setType(0);
 
     if (fieldData != nullptr) {
-      FFTW<RF>::free(fieldData);
+      FFTEngine<RF>::free(fieldData);
       fieldData = nullptr;
     }
+
+    if (sumData != nullptr) {
+      FFTEngine<RF>::free(sumData);
+      sumData = nullptr;
+    }
   }
 
   /**
@@ -205,7 +212,7 @@ public:
   void allocate()
   {
     if (fieldData == nullptr)
-      fieldData = FFTW<RF>::alloc_real(allocLocal);
+      fieldData = FFTEngine<RF>::alloc_real(allocLocal);
   }
 
   /**
@@ -232,16 +239,14 @@ public:
    * Perform a forward Fourier transform, mapping from the original
    * domain to the frequency domain. Uses a single FFTW real-to-real
    * DFT transform corresponding to the configured type of symmetry.
+   *
+   * @param normalize divide result by extended domain size if true
    */
-  void forwardTransform()
+  void forwardTransform(bool normalize = true)
   {
     toFFTWCompatible();
 
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
+    unsigned int flags = plannerFlags(*traits);
     if (transposed)
       flags |= FFTW_MPI_TRANSPOSED_OUT;
 
@@ -279,26 +284,29 @@ public:
     else
       blockSizeOut = (extendedCells[dim - 1] / 2 + 1) / commSize + 1;
 
-    typename FFTW<RF>::plan plan_forward =
-      FFTW<RF>::mpi_plan_many_r2r(dim,
-                                  n,
-                                  1,
-                                  blockSizeIn,
-                                  blockSizeOut,
-                                  fieldData + shiftIn,
-                                  fieldData + shiftIn,
-                                  (*traits).comm,
-                                  k,
-                                  flags);
+    typename FFTEngine<RF>::plan plan_forward =
+      createPlan(fieldData, allocLocal, flags, [&] {
+        return FFTEngine<RF>::mpi_plan_many_r2r(dim,
+                                                n,
+                                                1,
+                                                blockSizeIn,
+                                                blockSizeOut,
+                                                fieldData + shiftIn,
+                                                fieldData + shiftIn,
+                                                (*traits).comm,
+                                                k,
+                                                flags);
+      });
 
     if (plan_forward == nullptr)
       throw std::runtime_error{ "parafields failed to create forward plan" };
 
-    FFTW<RF>::execute(plan_forward);
-    FFTW<RF>::destroy_plan(plan_forward);
+    FFTEngine<RF>::execute(plan_forward);
+    destroyPlan<RF>(plan_forward);
 
-    for (Index i = 0; i < allocLocal; i++)
-      fieldData[i] /= extendedDomainSize;
+    if (normalize)
+      for (Index i = 0; i < allocLocal; i++)
+        fieldData[i] /= extendedDomainSize;
 
     if (shiftIn > shiftOut) {
       const Index diff = shiftIn - shiftOut;
@@ -313,7 +321,7 @@ public:
 
     transposeIfNeeded(localN0Trans, local0StartTrans);
 
-    fromFFTWCompatible();
+    fromFFTWCompatible(false);
   }
 
   /**
@@ -322,18 +330,18 @@ public:
    * Perform a backward Fourier transform, mapping from the frequency
    * domain back to the original domain. Uses a single FFTW real-to-real
    * DFT transform corresponding to the configured type of symmetry.
+   * If requested, the result is not expanded in place, but added to the
+   * sum of components instead, see clearSum.
+   *
+   * @param addToSum add result to sum of components if true
    */
-  void backwardTransform()
+  void backwardTransform(bool addToSum = false)
   {
     toFFTWCompatible();
 
     transposeIfNeeded(localN0, local0Start);
 
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
+    unsigned int flags = plannerFlags(*traits);
     if (transposed)
       flags |= FFTW_MPI_TRANSPOSED_IN;
 
@@ -371,23 +379,25 @@ public:
     else
       blockSizeIn = (extendedCells[dim - 1] / 2 + 1) / commSize + 1;
 
-    typename FFTW<RF>::plan plan_backward =
-      FFTW<RF>::mpi_plan_many_r2r(dim,
-                                  n,
-                                  1,
-                                  blockSizeIn,
-                                  blockSizeOut,
-                                  fieldData + shiftIn,
-                                  fieldData + shiftIn,
-                                  (*traits).comm,
-                                  k,
-                                  flags);
+    typename FFTEngine<RF>::plan plan_backward =
+      createPlan(fieldData, allocLocal, flags, [&] {
+        return FFTEngine<RF>::mpi_plan_many_r2r(dim,
+                                                n,
+                                                1,
+                                                blockSizeIn,
+                                                blockSizeOut,
+                                                fieldData + shiftIn,
+                                                fieldData + shiftIn,
+                                                (*traits).comm,
+                                                k,
+                                                flags);
+      });
 
     if (plan_backward == nullptr)
       throw std::runtime_error{ "parafields failed to create backward plan" };
 
-    FFTW<RF>::execute(plan_backward);
-    FFTW<RF>::destroy_plan(plan_backward);
+    FFTEngine<RF>::execute(plan_backward);
+    destroyPlan<RF>(plan_backward);
 
     if (shiftIn > shiftOut) {
       const Index diff = shiftIn - shiftOut;
@@ -400,7 +410,38 @@ public:
         fieldData[index + diff] = fieldData[index];
     }
 
-    fromFFTWCompatible();
+    fromFFTWCompatible(addToSum);
+  }
+
+  /**
+   * @brief Reset the sum of even/odd components
+   *
+   * The extended field is the superposition of one component per
+   * combination of even and odd symmetry. Instead of restricting each
+   * of these to the original domain and adding the results there, which
+   * means one redistribution per component in the parallel case, the
+   * components are added in extended space as part of the backward
+   * transform, and the sum is restricted only once, see
+   * extendedSumToField.
+   */
+  void clearSum()
+  {
+    if (sumData == nullptr)
+      sumData = FFTEngine<RF>::alloc_real(allocLocal);
+
+    std::fill_n(sumData, localDCTDomainSize, RF(0.));
+  }
+
+  /**
+   * @brief Restrict sum of even/odd components to the original domain
+   *
+   * @param[out] field random field to fill with restriction
+   */
+  void extendedSumToField(std::vector<RF>& field)
+  {
+    std::swap(fieldData, sumData);
+    extendedFieldToField(field);
+    std::swap(fieldData, sumData);
   }
 
   /**
@@ -489,22 +530,32 @@ public:
   void fieldToExtendedField(std::vector<RF>& field)
   {
     if (fieldData == nullptr)
-      fieldData = FFTW<RF>::alloc_real(allocLocal);
+      fieldData = FFTEngine<RF>::alloc_real(allocLocal);
 
     for (Index index = 0; index < localDCTDomainSize; index++)
       fieldData[index] = 0.;
 
     if (commSize == 1) {
-      Index index, dctIndex;
-      metaForLoopToExtended(index, dctIndex, &(field[0]), fieldData);
+      Copy::copy(localCells,
+                 field.data(),
+                 localCells,
+                 0,
+                 fieldData,
+                 localDCTCells,
+                 0);
     } else {
       Index fieldSize = localCells[dim - 1];
       for (unsigned int i = 0; i < dim - 1; i++)
         fieldSize *= localDCTCells[i];
       std::vector<RF> localCopy(fieldSize, 0.);
 
-      Index index, dctIndex;
-      metaForLoopToExtended(index, dctIndex, &(field[0]), &(localCopy[0]));
+      Copy::copy(localCells,
+                 field.data(),
+                 localCells,
+                 0,
+                 localCopy.data(),
+                 localDCTCells,
+                 0);
 
       std::vector<MPI_Request> request(2);
       for (unsigned int i = 0; i < 2; i++)
@@ -640,12 +691,7 @@ public:
     field.resize(localDomainSize);
 
     if (commSize == 1) {
-      Index index, dctIndex;
-      if (additive)
-        metaForLoopFromExtendedAdditive(
-          index, dctIndex, &(field[0]), fieldData);
-      else
-        metaForLoopFromExtended(index, dctIndex, &(field[0]), fieldData);
+      restrictToField(fieldData, field, additive);
     } else {
       Index fieldSize = localCells[dim - 1];
       for (unsigned int i = 0; i < dim - 1; i++)
@@ -761,12 +807,7 @@ public:
 
       MPI_Waitall(request.size(), &(request[0]), MPI_STATUSES_IGNORE);
 
-      Index index, dctIndex;
-      if (additive)
-        metaForLoopFromExtendedAdditive(
-          index, dctIndex, &(field[0]), &(localCopy[0]));
-      else
-        metaForLoopFromExtended(index, dctIndex, &(field[0]), &(localCopy[0]));
+      restrictToField(localCopy.data(), field, additive);
     }
   }
 
@@ -796,16 +837,16 @@ private:
       }
 
       ptrdiff_t allocLocalComb =
-        FFTW<RF>::mpi_local_size_many_transposed(dim,
-                                                 n,
-                                                 1,
-                                                 blockSize,
-                                                 blockSizeTrans,
-                                                 (*traits).comm,
-                                                 &localN0,
-                                                 &local0Start,
-                                                 &localN0Trans,
-                                                 &local0StartTrans);
+        FFTEngine<RF>::mpi_local_size_many_transposed(dim,
+                                                      n,
+                                                      1,
+                                                      blockSize,
+                                                      blockSizeTrans,
+                                                      (*traits).comm,
+                                                      &localN0,
+                                                      &local0Start,
+                                                      &localN0Trans,
+                                                      &local0StartTrans);
 
       allocLocal = std::max(allocLocal, allocLocalComb);
     }
@@ -872,86 +913,40 @@ private:
   }
 
   /**
-   * @brief Recursive helper function for fieldToExtendedField
+   * @brief Copy or add local extended field to local part of original domain
+   *
+   * @param      dctData  local extended field, possibly received from others
+   * @param[out] field    local part of random field
+   * @param      additive add to field if true, else replace it
    */
-  template<unsigned int currentDim = dim - 1>
-  void metaForLoopToExtended(Index& index,
-                             Index& dctIndex,
-                             RF* data,
-                             RF* dctData)
+  void restrictToField(const RF* dctData,
+                       std::vector<RF>& field,
+                       bool additive) const
   {
-    if constexpr (currentDim > 0) {
-      if constexpr (currentDim == dim - 1) {
-        index = 0;
-        dctIndex = 0;
-      }
-
-      for (Index i = 0; i < localCells[currentDim]; i++)
-        metaForLoopToExtended<currentDim - 1>(index, dctIndex, data, dctData);
-
-      metaSkip<currentDim>(dctIndex);
-    } else {
-      for (Index i = 0; i < localCells[currentDim]; i++, index++, dctIndex++)
-        dctData[dctIndex] = data[index];
-
-      metaSkip<currentDim>(dctIndex);
-    }
+    if (additive)
+      Copy::add(
+        localCells, dctData, localDCTCells, 0, field.data(), localCells, 0);
+    else
+      Copy::copy(
+        localCells, dctData, localDCTCells, 0, field.data(), localCells, 0);
   }
 
   /**
-   * @brief Recursive helper function for extendedFieldToField, non-additive
-   * version
+   * @brief Offset of first entry that is stored in FFTW-compatible format
+   *
+   * Dimensions other than the last one skip their first entry if they are
+   * odd, since it is an explicit zero.
    */
-  template<unsigned int currentDim = dim - 1>
-  void metaForLoopFromExtended(Index& index,
-                               Index& dctIndex,
-                               RF* data,
-                               RF* dctData) const
+  Index compatibleOffset() const
   {
-    if constexpr (currentDim > 0) {
-      if constexpr (currentDim == dim - 1) {
-        index = 0;
-        dctIndex = 0;
-      }
-
-      for (Index i = 0; i < localCells[currentDim]; i++)
-        metaForLoopFromExtended<currentDim - 1>(index, dctIndex, data, dctData);
-
-      metaSkip<currentDim>(dctIndex);
-    } else {
-      for (Index i = 0; i < localCells[currentDim]; i++, index++, dctIndex++)
-        data[index] += dctData[dctIndex];
-
-      metaSkip<currentDim>(dctIndex);
+    Index offset = 0, stride = 1;
+    for (unsigned int i = 0; i < dim - 1; i++) {
+      if (odd[i])
+        offset += stride;
+      stride *= localDCTCells[i];
     }
-  }
-
-  /**
-   * @brief Recursive helper function for extendedFieldToField, additive version
-   */
-  template<unsigned int currentDim = dim - 1>
-  void metaForLoopFromExtendedAdditive(Index& index,
-                                       Index& dctIndex,
-                                       RF* data,
-                                       RF* dctData) const
-  {
-    if constexpr (currentDim > 0) {
-      if constexpr (currentDim == dim - 1) {
-        index = 0;
-        dctIndex = 0;
-      }
-
-      for (Index i = 0; i < localCells[currentDim]; i++)
-        metaForLoopFromExtendedAdditive<currentDim - 1>(
-          index, dctIndex, data, dctData);
-
-      metaSkip<currentDim>(dctIndex);
-    } else {
-      for (Index i = 0; i < localCells[currentDim]; i++, index++, dctIndex++)
-        data[index] += dctData[dctIndex];
 
-      metaSkip<currentDim>(dctIndex);
-    }
+    return offset;
   }
 
   /**
@@ -967,8 +962,13 @@ private:
     }
 
     // remove zeros in all dimensions but last one
-    Index index, smallIndex;
-    metaForLoopToFFTWCompatible(index, smallIndex);
+    Copy::copy(localDCTDSTCells,
+               fieldData,
+               localDCTCells,
+               compatibleOffset(),
+               fieldData,
+               localDCTDSTCells,
+               0);
 
     // shift last dimension by one cell in parallel case
     if (odd[dim - 1] && commSize > 1) {
@@ -1000,45 +1000,12 @@ private:
     }
   }
 
-  /**
-   * @brief Helper function for toFFTWCompatible, iterating over variable number
-   * of dimensions
-   */
-  template<unsigned int currentDim = dim - 1>
-  void metaForLoopToFFTWCompatible(Index& index, Index& smallIndex)
-  {
-    if constexpr (currentDim == dim - 1) {
-      index = 0;
-      smallIndex = 0;
-
-      for (Index i = 0; i < localDCTDSTCells[currentDim]; i++)
-        metaForLoopToFFTWCompatible<currentDim - 1>(index, smallIndex);
-    } else if constexpr (currentDim > 0) {
-      if (odd[currentDim])
-        metaSkip<currentDim>(index);
-
-      for (Index i = 0; i < localDCTDSTCells[currentDim]; i++)
-        metaForLoopToFFTWCompatible<currentDim - 1>(index, smallIndex);
-
-      if (odd[currentDim])
-        metaSkip<currentDim>(index);
-    } else {
-      if (odd[currentDim])
-        metaSkip<currentDim>(index);
-
-      for (Index i = 0; i < localDCTDSTCells[currentDim];
-           i++, index++, smallIndex++)
-        fieldData[smallIndex] = fieldData[index];
-
-      if (odd[currentDim])
-        metaSkip<currentDim>(index);
-    }
-  }
-
   /**
    * @brief Reinsert explicit zeros of DST dimensions
+   *
+   * @param addToSum add to sum of components instead of expanding in place
    */
-  void fromFFTWCompatible()
+  void fromFFTWCompatible(bool addToSum)
   {
     Index shift = 0;
     if (odd[dim - 1] && commSize > 1) {
@@ -1076,9 +1043,60 @@ private:
       MPI_Wait(&request, MPI_STATUS_IGNORE);
     }
 
+    if (addToSum) {
+      Index localDCTDSTDomainSize = 1;
+      for (unsigned int i = 0; i < dim; i++)
+        localDCTDSTDomainSize *= localDCTDSTCells[i];
+
+      // boundary slices are zero in last dimension if odd
+      if (odd[dim - 1]) {
+        Index smallSliceSize = 1;
+        for (unsigned int i = 0; i < dim - 1; i++)
+          smallSliceSize *= localDCTDSTCells[i];
+        if (rank == 0)
+          std::fill_n(fieldData, smallSliceSize, RF(0.));
+        if (rank == commSize - 1 && localDCTDSTDomainSize > 0)
+          std::fill_n(fieldData + localDCTDSTDomainSize - smallSliceSize,
+                      smallSliceSize,
+                      RF(0.));
+      }
+
+      // skip zeros in all dimensions but last one while adding
+      Copy::add(localDCTDSTCells,
+                fieldData,
+                localDCTDSTCells,
+                0,
+                sumData,
+                localDCTCells,
+                compatibleOffset());
+      return;
+    }
+
     // reinsert zeros in all dimensions but last one
-    Index index, smallIndex;
-    metaForLoopFromFFTWCompatible(index, smallIndex);
+    Copy::template copy<true>(localDCTDSTCells,
+                              fieldData,
+                              localDCTDSTCells,
+                              0,
+                              fieldData,
+                              localDCTCells,
+                              compatibleOffset());
+
+    Indices stride, planeCount;
+    stride[0] = 1;
+    for (unsigned int i = 1; i < dim; i++)
+      stride[i] = stride[i - 1] * localDCTCells[i - 1];
+
+    for (unsigned int i = 0; i < dim - 1; i++)
+      if (odd[i]) {
+        planeCount = localDCTCells;
+        planeCount[i] = 1;
+        Copy::fill(planeCount, fieldData, localDCTCells, 0, RF(0.));
+        Copy::fill(planeCount,
+                   fieldData,
+                   localDCTCells,
+                   (localDCTCells[i] - 1) * stride[i],
+                   RF(0.));
+      }
 
     Index sliceSize = 1;
     for (unsigned int i = 0; i < dim - 1; i++)
@@ -1097,78 +1115,6 @@ private:
     }
   }
 
-  /**
-   * @brief Helper function for fromFFTWCompatible, iterating over variable
-   * number of dimensions
-   */
-  template<unsigned int currentDim = dim - 1>
-  void metaForLoopFromFFTWCompatible(Index& index, Index& smallIndex)
-  {
-    if constexpr (currentDim == dim - 1) {
-      Index localDCTDSTDomainSize = 1;
-      for (unsigned int i = 0; i < dim; i++)
-        localDCTDSTDomainSize *= localDCTDSTCells[i];
-
-      index = localDCTDomainSize - 1;
-      smallIndex = localDCTDSTDomainSize - 1;
-
-      for (Index i = localDCTDSTCells[currentDim] - 1;
-           i < localDCTDSTCells[currentDim];
-           i--)
-        metaForLoopFromFFTWCompatible<currentDim - 1>(index, smallIndex);
-    } else if constexpr (currentDim > 0) {
-      if (odd[currentDim])
-        metaFill<currentDim>(index);
-
-      for (Index i = localDCTDSTCells[currentDim] - 1;
-           i < localDCTDSTCells[currentDim];
-           i--)
-        metaForLoopFromFFTWCompatible<currentDim - 1>(index, smallIndex);
-
-      if (odd[currentDim])
-        metaFill<currentDim>(index);
-    } else {
-      if (odd[currentDim])
-        metaFill<currentDim>(index);
-
-      for (Index i = localDCTDSTCells[currentDim] - 1;
-           i < localDCTDSTCells[currentDim];
-           i--, index--, smallIndex--)
-        fieldData[index] = fieldData[smallIndex];
-
-      if (odd[currentDim])
-        metaFill<currentDim>(index);
-    }
-  }
-
-  /**
-   * @brief Helper function, skip consecutive indices with irrelevant entries
-   */
-  template<unsigned int currentDim>
-  void metaSkip(Index& index) const
-  {
-    Index skip = 1;
-    for (unsigned int i = 0; i < currentDim; i++)
-      skip *= localDCTCells[i];
-
-    index += skip;
-  }
-
-  /**
-   * @brief Helper function, insert consecutive explicit zero entries
-   */
-  template<unsigned int currentDim>
-  void metaFill(Index& index)
-  {
-    Index skip = 1;
-    for (unsigned int i = 0; i < currentDim; i++)
-      skip *= localDCTCells[i];
-
-    for (Index i = 0; i < skip; i++) {
-      fieldData[index] = 0.;
-      index--;
-    }
-  }
 };
 
 } // namespace parafields
@@ -17,6 +17,14 @@ namespace parafields {
  * domain can be represented on the original domain with one row
  * of cells per dimension as padding.
  *
+ * FFTW-MPI doesn't provide distributed onedimensional real-to-real
+ * transforms. In 1D, the entries are therefore distributed in equal
+ * blocks, and gathered on each processor for a sequential DCT-I, of
+ * which each processor keeps its own block. This is still a quarter
+ * of the memory and a real instead of a complex transform compared
+ * to the DFT matrix backend, apart from a transient buffer of half
+ * the extended domain.
+ *
  * @tparam Traits traits class with data types and definitions
  */
 template<typename Traits>
@@ -31,8 +39,6 @@ class DCTMatrixBackend
     dim = Traits::dim
   };
 
-  static_assert(dim != 1, "DCTMatrixBackend requires dim > 1");
-
   const std::shared_ptr<Traits> traits;
 
   int rank, commSize;
@@ -56,6 +62,8 @@ class DCTMatrixBackend
   mutable RF* matrixData;
   mutable Indices indices;
 
+  std::size_t peakMemory;
+
   bool transposed, finalized;
 
   enum
@@ -68,43 +76,32 @@ public:
   /**
    * @brief Constructor
    *
-   * Imports FFTW wisdom if configured to do so.
-   *
    * @param traits_ traits object with parameters and communication
    */
   DCTMatrixBackend(const std::shared_ptr<Traits>& traits_)
     : traits(traits_)
     , matrixData(nullptr)
+    , peakMemory(0)
     , finalized(false)
   {
     if ((*traits).verbose && (*traits).rank == 0)
       std::cout << "using DCTMatrixBackend" << std::endl;
-
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      if ((*traits).rank == 0)
-        FFTW<RF>::import_wisdom_from_filename("wisdom-DCTMatrix.ini");
-
-      FFTW<RF>::mpi_broadcast_wisdom((*traits).comm);
-    }
   }
 
   /**
    * @brief Destructor
    *
-   * Cleans up allocated arrays and FFTW plans. Exports FFTW
+   * Cleans up allocated arrays and FFTW plans. Stores new FFTW
    * wisdom if configured to do so.
    */
   ~DCTMatrixBackend()
   {
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      FFTW<RF>::mpi_gather_wisdom((*traits).comm);
-
-      if ((*traits).rank == 0)
-        FFTW<RF>::export_wisdom_to_filename("wisdom-DCTMatrix.ini");
-    }
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::store(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
 
     if (matrixData != nullptr) {
-      FFTW<RF>::free(matrixData);
+      FFTEngine<RF>::free(matrixData);
       matrixData = nullptr;
     }
   }
@@ -114,7 +111,8 @@ public:
    *
    * This function has to be called after the creation of
    * the random field object or its refinement. It updates
-   * parameters like the number of cells per dimension.
+   * parameters like the number of cells per dimension, and
+   * imports FFTW wisdom for the new geometry if configured to do so.
    */
   void update()
   {
@@ -123,6 +121,10 @@ public:
     rank = (*traits).rank;
     commSize = (*traits).commSize;
 
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::load(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
+
     extendedCells = (*traits).extendedCells;
     extendedDomainSize = (*traits).extendedDomainSize;
     localExtendedCells = (*traits).localExtendedCells;
@@ -133,8 +135,10 @@ public:
 
     getDCTCells(localN0, local0Start);
 
+    peakMemory = 0;
+
     if (matrixData != nullptr) {
-      FFTW<RF>::free(matrixData);
+      FFTEngine<RF>::free(matrixData);
       matrixData = nullptr;
     }
   }
@@ -201,10 +205,43 @@ public:
    */
   void allocate()
   {
-    if (matrixData == nullptr)
-      matrixData = FFTW<RF>::alloc_real(allocLocal);
+    if (matrixData == nullptr) {
+      matrixData = FFTEngine<RF>::alloc_real(allocLocal);
+      peakMemory = std::max(peakMemory, allocLocal * sizeof(RF));
+    }
   }
 
+  /**
+   * @brief Largest amount of memory used for matrix data
+   *
+   * This is the largest amount of memory the backend has held at any
+   * point in time since the last update, including transient buffers
+   * used during finalization.
+   *
+   * @return memory in bytes on this processor
+   */
+  std::size_t peakMemoryUsage() const { return peakMemory; }
+
+  /**
+   * @brief Number of values in the local array, including padding
+   *
+   * This is the size of the array returned by rawData, which contains
+   * the transformed matrix between the transform and finalization.
+   *
+   * @return number of local values of type RF
+   */
+  Index localStorageSize() const { return allocLocal; }
+
+  /**
+   * @brief Raw access to the local array
+   *
+   * Used for storing the transformed matrix before finalization, and
+   * for restoring it, e.g., when it is cached on disk.
+   *
+   * @return pointer to the local array
+   */
+  RF* rawData() const { return (RF*)matrixData; }
+
   /**
    * @brief Switch last two dimensions (for transposed transforms)
    *
@@ -230,6 +267,60 @@ public:
     }
   }
 
+  /**
+   * @brief Switch to frequency space without transforming the data
+   *
+   * This performs the same changes to the data layout as the forward
+   * transform, but leaves the stored data untouched. It is used when
+   * the transformed matrix is restored instead of being computed.
+   */
+  void markTransformed()
+  {
+    checkFinalized();
+    transposeIfNeeded(localN0Trans, local0StartTrans);
+  }
+
+  /**
+   * @brief Switch back to original domain without transforming the data
+   *
+   * This restores the data layout of the untransformed matrix, so that
+   * it can be filled anew, e.g., after the correlation length has been
+   * changed. The local array is kept, except for the mirrored array of
+   * a finalized parallel matrix, which has a different size and is
+   * replaced during the next fill.
+   */
+  void reset()
+  {
+    if (finalized) {
+      FFTEngine<RF>::free(matrixData);
+      matrixData = nullptr;
+      finalized = false;
+    }
+
+    extendedCells = (*traits).extendedCells;
+    localExtendedCells = (*traits).localExtendedCells;
+    localExtendedOffset = (*traits).localExtendedOffset;
+    getDCTCells(localN0, local0Start);
+  }
+
+  /**
+   * @brief Multiply all stored entries with given factor
+   *
+   * @param factor scale factor, e.g., ratio of new and old variance
+   */
+  void scale(RF factor)
+  {
+    Index size = allocLocal;
+    if (finalized) {
+      size = 1;
+      for (unsigned int i = 0; i < dim; i++)
+        size *= localEvalCells[i];
+    }
+
+    for (Index i = 0; i < size; i++)
+      matrixData[i] *= factor;
+  }
+
   /**
    * @brief Transform into Fourier (i.e., frequency) space
    *
@@ -241,34 +332,117 @@ public:
   {
     checkFinalized();
 
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
-    if (transposed)
+    if constexpr (dim == 1)
+      transformLine();
+    else {
+      unsigned int flags = plannerFlags(*traits);
+      if (transposed)
+        flags |= FFTW_MPI_TRANSPOSED_OUT;
+
+      ptrdiff_t n[dim];
+      typename FFTEngine<RF>::r2r_kind k[dim];
+      for (unsigned int i = 0; i < dim; i++) {
+        n[i] = extendedCells[dim - 1 - i] / 2 + 1;
+        k[i] = FFTW_REDFT00;
+      }
+
+      typename FFTEngine<RF>::plan plan_forward =
+        createPlan(matrixData, allocLocal, flags, [&] {
+          return FFTEngine<RF>::mpi_plan_r2r(
+            dim, n, matrixData, matrixData, (*traits).comm, k, flags);
+        });
+
+      if (plan_forward == nullptr)
+        throw std::runtime_error{ "parafields failed to create forward plan" };
+
+      FFTEngine<RF>::execute(plan_forward);
+      destroyPlan<RF>(plan_forward);
+    }
+
+    for (Index i = 0; i < allocLocal; i++)
+      matrixData[i] /= extendedDomainSize;
+
+    transposeIfNeeded(localN0Trans, local0StartTrans);
+  }
+
+  /**
+   * @brief Transform several matrices into Fourier space at once
+   *
+   * Equivalent to calling forwardTransform on each of the backends, which
+   * have to share the extended domain and communicator. The local arrays
+   * are interleaved in a temporary buffer, so that a single FFTW plan
+   * with the number of matrices as howmany parameter transforms all of
+   * them, amortizing planning and communication. In 1D, the matrices
+   * are transformed one after the other.
+   *
+   * @param backends backends containing the untransformed matrices
+   */
+  static void forwardTransform(const std::vector<DCTMatrixBackend*>& backends)
+  {
+    if constexpr (dim == 1) {
+      for (DCTMatrixBackend* backend : backends)
+        backend->forwardTransform();
+      return;
+    }
+
+    const DCTMatrixBackend& first = *backends.front();
+    const ptrdiff_t howmany = backends.size();
+    const ptrdiff_t allocLocal = first.allocLocal;
+
+    for (const DCTMatrixBackend* backend : backends)
+      backend->checkFinalized();
+
+    unsigned int flags = plannerFlags(*first.traits);
+    if (first.transposed)
       flags |= FFTW_MPI_TRANSPOSED_OUT;
 
     ptrdiff_t n[dim];
-    typename FFTW<RF>::r2r_kind k[dim];
+    typename FFTEngine<RF>::r2r_kind k[dim];
     for (unsigned int i = 0; i < dim; i++) {
-      n[i] = extendedCells[dim - 1 - i] / 2 + 1;
+      n[i] = first.extendedCells[dim - 1 - i] / 2 + 1;
       k[i] = FFTW_REDFT00;
     }
 
-    typename FFTW<RF>::plan plan_forward = FFTW<RF>::mpi_plan_r2r(
-      dim, n, matrixData, matrixData, (*traits).comm, k, flags);
-
-    if (plan_forward == nullptr)
+    // plan before filling the buffer, since planning may overwrite it
+    RF* batch = FFTEngine<RF>::alloc_real(howmany * allocLocal);
+    typename FFTEngine<RF>::plan plan_forward =
+      createPlan(batch, 0, flags, [&] {
+        return FFTEngine<RF>::mpi_plan_many_r2r(dim,
+                                                n,
+                                                howmany,
+                                                FFTW_MPI_DEFAULT_BLOCK,
+                                                FFTW_MPI_DEFAULT_BLOCK,
+                                                batch,
+                                                batch,
+                                                (*first.traits).comm,
+                                                k,
+                                                flags);
+      });
+
+    if (plan_forward == nullptr) {
+      FFTEngine<RF>::free(batch);
       throw std::runtime_error{ "parafields failed to create forward plan" };
+    }
 
-    FFTW<RF>::execute(plan_forward);
-    FFTW<RF>::destroy_plan(plan_forward);
+    for (ptrdiff_t j = 0; j < howmany; j++)
+      for (ptrdiff_t i = 0; i < allocLocal; i++)
+        batch[i * howmany + j] = backends[j]->matrixData[i];
 
-    for (Index i = 0; i < allocLocal; i++)
-      matrixData[i] /= extendedDomainSize;
+    FFTEngine<RF>::execute(plan_forward);
+    destroyPlan<RF>(plan_forward);
 
-    transposeIfNeeded(localN0Trans, local0StartTrans);
+    for (ptrdiff_t j = 0; j < howmany; j++) {
+      DCTMatrixBackend& backend = *backends[j];
+      for (ptrdiff_t i = 0; i < allocLocal; i++)
+        backend.matrixData[i] =
+          batch[i * howmany + j] / backend.extendedDomainSize;
+
+      backend.peakMemory =
+        std::max(backend.peakMemory, 2 * allocLocal * sizeof(RF));
+      backend.transposeIfNeeded(backend.localN0Trans, backend.local0StartTrans);
+    }
+
+    FFTEngine<RF>::free(batch);
   }
 
   /**
@@ -283,29 +457,32 @@ public:
     checkFinalized();
     transposeIfNeeded(localN0, local0Start);
 
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
-    if (transposed)
-      flags |= FFTW_MPI_TRANSPOSED_IN;
-
-    ptrdiff_t n[dim];
-    typename FFTW<RF>::r2r_kind k[dim];
-    for (unsigned int i = 0; i < dim; i++) {
-      n[i] = extendedCells[dim - 1 - i] / 2 + 1;
-      k[i] = FFTW_REDFT00;
-    }
+    if constexpr (dim == 1)
+      transformLine();
+    else {
+      unsigned int flags = plannerFlags(*traits);
+      if (transposed)
+        flags |= FFTW_MPI_TRANSPOSED_IN;
+
+      ptrdiff_t n[dim];
+      typename FFTEngine<RF>::r2r_kind k[dim];
+      for (unsigned int i = 0; i < dim; i++) {
+        n[i] = extendedCells[dim - 1 - i] / 2 + 1;
+        k[i] = FFTW_REDFT00;
+      }
 
-    typename FFTW<RF>::plan plan_backward = FFTW<RF>::mpi_plan_r2r(
-      dim, n, matrixData, matrixData, (*traits).comm, k, flags);
+      typename FFTEngine<RF>::plan plan_backward =
+        createPlan(matrixData, allocLocal, flags, [&] {
+          return FFTEngine<RF>::mpi_plan_r2r(
+            dim, n, matrixData, matrixData, (*traits).comm, k, flags);
+        });
 
-    if (plan_backward == nullptr)
-      throw std::runtime_error{ "parafields failed to create backward plan" };
+      if (plan_backward == nullptr)
+        throw std::runtime_error{ "parafields failed to create backward plan" };
 
-    FFTW<RF>::execute(plan_backward);
-    FFTW<RF>::destroy_plan(plan_backward);
+      FFTEngine<RF>::execute(plan_backward);
+      destroyPlan<RF>(plan_backward);
+    }
   }
 
   /**
@@ -354,6 +531,44 @@ public:
     return matrixData[smallIndex];
   }
 
+  /**
+   * @brief Per-dimension contributions to storage index of matrix entries
+   *
+   * The index remapping performed by eval(Indices) acts on each dimension
+   * separately. This function tabulates it for the given number of local
+   * cells per dimension, so that the storage index of an entry is the sum
+   * of the table entries for its indices, see evalStored.
+   *
+   * @param cells local cells per dimension that should be tabulated
+   *
+   * @return table of index contributions, one per dimension
+   */
+  std::array<std::vector<Index>, dim> evalOffsets(const Indices& cells) const
+  {
+    std::array<std::vector<Index>, dim> offsets;
+    Index stride = 1;
+    for (unsigned int i = 0; i < dim; i++) {
+      offsets[i].resize(cells[i]);
+      for (Index j = 0; j < cells[i]; j++)
+        if (j + localEvalOffset[i] >= evalCells[i])
+          offsets[i][j] = (extendedCells[i] - j - localEvalOffset[i]) * stride;
+        else
+          offsets[i][j] = j * stride;
+      stride *= localEvalCells[i];
+    }
+
+    return offsets;
+  }
+
+  /**
+   * @brief Evaluate matrix entry (using the storage index)
+   *
+   * @param index storage index, as assembled from evalOffsets
+   *
+   * @return value associated with index
+   */
+  RF evalStored(Index index) const { return matrixData[index]; }
+
   /**
    * @brief Get matrix entry (using the actual index)
    *
@@ -402,11 +617,18 @@ public:
    * the array grows by roughly a factor of two. This is needed
    * for parallel field generation, because otherwise the data
    * for some of the cells would lie on another processor and
-   * couldn't be accessed. After this function has been called,
-   * the backend can no longer be modified.
+   * couldn't be accessed. In 1D, the matrix is mirrored on a single
+   * processor as well, so that there is only one layout for the field
+   * backend. After this function has been called, the backend can no
+   * longer be modified.
    */
   void finalize()
   {
+    if constexpr (dim == 1) {
+      finalizeLine();
+      return;
+    }
+
     // nothing to do in sequential case
     if (commSize == 1)
       return;
@@ -417,7 +639,9 @@ public:
     unsigned int mirrorAllocLocal = localExtendedCells[dim - 1];
     for (unsigned int i = 0; i < dim - 1; i++)
       mirrorAllocLocal *= localDCTCells[i];
-    matrixData = FFTW<RF>::alloc_real(mirrorAllocLocal);
+    matrixData = FFTEngine<RF>::alloc_real(mirrorAllocLocal);
+    peakMemory =
+      std::max(peakMemory, (allocLocal + mirrorAllocLocal) * sizeof(RF));
 
     Index strideWidth = localExtendedCells[dim - 1];
     Index sliceSize = 1;
@@ -733,7 +957,7 @@ public:
     localEvalCells[dim - 1] = localExtendedCells[dim - 1];
     localEvalOffset[dim - 1] = localExtendedOffset[dim - 1];
 
-    FFTW<RF>::free(unmirrored);
+    FFTEngine<RF>::free(unmirrored);
     unmirrored = nullptr;
 
     finalized = true;
@@ -752,13 +976,117 @@ private:
     for (unsigned int i = 0; i < dim; i++)
       n[i] = extendedCells[dim - 1 - i] / 2 + 1;
 
-    allocLocal = FFTW<RF>::mpi_local_size_transposed(dim,
-                                                     n,
-                                                     (*traits).comm,
-                                                     &localN0,
-                                                     &local0Start,
-                                                     &localN0Trans,
-                                                     &local0StartTrans);
+    if constexpr (dim == 1) {
+      // equal blocks, since the transform itself isn't distributed
+      localN0 = n[0] / commSize + (rank < n[0] % commSize ? 1 : 0);
+      local0Start =
+        rank * (n[0] / commSize) + std::min<ptrdiff_t>(rank, n[0] % commSize);
+      localN0Trans = localN0;
+      local0StartTrans = local0Start;
+      allocLocal = std::max<ptrdiff_t>(localN0, 1);
+    } else
+      allocLocal = FFTEngine<RF>::mpi_local_size_transposed(dim,
+                                                            n,
+                                                            (*traits).comm,
+                                                            &localN0,
+                                                            &local0Start,
+                                                            &localN0Trans,
+                                                            &local0StartTrans);
+  }
+
+  /**
+   * @brief Collect the local blocks of the 1D matrix on each processor
+   *
+   * @param[out] line array of size dctCells[0] receiving all entries
+   */
+  void gatherLine(RF* line) const
+  {
+    if (commSize == 1) {
+      std::copy_n(matrixData, localN0, line);
+      return;
+    }
+
+    const int count = localN0;
+    std::vector<int> counts(commSize), displs(commSize, 0);
+    MPI_Allgather(
+      &count, 1, MPI_INT, counts.data(), 1, MPI_INT, (*traits).comm);
+    for (int i = 1; i < commSize; i++)
+      displs[i] = displs[i - 1] + counts[i - 1];
+
+    MPI_Allgatherv(matrixData,
+                   count,
+                   mpiType<RF>,
+                   line,
+                   counts.data(),
+                   displs.data(),
+                   mpiType<RF>,
+                   (*traits).comm);
+  }
+
+  /**
+   * @brief Sequential DCT-I of the 1D matrix, keeping the local block
+   *
+   * The plan is created before the entries are gathered, since planning
+   * may overwrite the array. The DCT-I is its own inverse up to scaling,
+   * and is therefore used for both directions.
+   */
+  void transformLine()
+  {
+    RF* line = FFTEngine<RF>::alloc_real(dctCells[0]);
+    peakMemory = std::max(peakMemory, (allocLocal + dctCells[0]) * sizeof(RF));
+
+    const unsigned int flags = plannerFlags(*traits);
+    typename FFTEngine<RF>::plan plan = createPlan(line, 0, flags, [&] {
+      return FFTEngine<RF>::plan_r2r_1d(
+        dctCells[0], line, line, FFTW_REDFT00, flags);
+    });
+
+    if (plan == nullptr) {
+      FFTEngine<RF>::free(line);
+      throw std::runtime_error{ "parafields failed to create plan" };
+    }
+
+    gatherLine(line);
+    FFTEngine<RF>::execute(plan);
+    destroyPlan<RF>(plan);
+
+    std::copy_n(line + local0Start, localN0, matrixData);
+    FFTEngine<RF>::free(line);
+  }
+
+  /**
+   * @brief Mirror the 1D matrix onto the local part of the extended domain
+   *
+   * Counterpart of finalize for 1D: each processor collects the
+   * transformed entries and keeps those belonging to its part of the
+   * extended domain, mirroring the indices beyond the midpoint. On a
+   * single processor, this doubles the size of the array, which is
+   * still half that of the DFT matrix backend.
+   */
+  void finalizeLine()
+  {
+    RF* line = FFTEngine<RF>::alloc_real(dctCells[0]);
+    gatherLine(line);
+
+    RF* unmirrored = matrixData;
+    matrixData = FFTEngine<RF>::alloc_real(localExtendedCells[0]);
+    peakMemory = std::max(
+      peakMemory,
+      (allocLocal + dctCells[0] + localExtendedCells[0]) * sizeof(RF));
+
+    for (Index i = 0; i < localExtendedCells[0]; i++) {
+      const Index k = localExtendedOffset[0] + i;
+      matrixData[i] = line[std::min(k, extendedCells[0] - k)];
+    }
+
+    evalCells[0] = extendedCells[0];
+    localEvalCells[0] = localExtendedCells[0];
+    localEvalOffset[0] = localExtendedOffset[0];
+
+    FFTEngine<RF>::free(line);
+    FFTEngine<RF>::free(unmirrored);
+
+    finalized = true;
   }
 
   /**
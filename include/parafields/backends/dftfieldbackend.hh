@@ -41,22 +41,17 @@ class DFTFieldBackend
   Indices localExtendedCells;
   Index localExtendedDomainSize;
 
-  mutable typename FFTW<RF>::complex* fieldData;
+  mutable typename FFTEngine<RF>::complex* fieldData;
 
-  bool transposed;
+  bool transposed, pruned;
 
-  enum
-  {
-    toExtended,
-    fromExtended
-  };
+  SlabExchange<Traits> slabExchange;
+  PrunedTransform<Traits> prunedTransform;
 
 public:
   /**
    * @brief Constructor
    *
-   * Imports FFTW wisdom if configured to do so.
-   *
    * @param traits_ traits object with parameters and communication
    */
   DFTFieldBackend(const std::shared_ptr<Traits>& traits_)
@@ -65,32 +60,22 @@ public:
   {
     if ((*traits).verbose && (*traits).rank == 0)
       std::cout << "using DFTFieldBackend" << std::endl;
-
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      if ((*traits).rank == 0)
-        FFTW<RF>::import_wisdom_from_filename("wisdom-DFTField.ini");
-
-      FFTW<RF>::mpi_broadcast_wisdom((*traits).comm);
-    }
   }
 
   /**
    * @brief Destructor
    *
-   * Cleans up allocated arrays and FFTW plans. Exports FFTW
+   * Cleans up allocated arrays and FFTW plans. Stores new FFTW
    * wisdom if configured to do so.
    */
   ~DFTFieldBackend()
   {
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      FFTW<RF>::mpi_gather_wisdom((*traits).comm);
-
-      if ((*traits).rank == 0)
-        FFTW<RF>::export_wisdom_to_filename("wisdom-DFTField.ini");
-    }
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::store(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
 
     if (fieldData != nullptr) {
-      FFTW<RF>::free(fieldData);
+      FFTEngine<RF>::free(fieldData);
       fieldData = nullptr;
     }
   }
@@ -100,13 +85,18 @@ public:
    *
    * This function is has to be called after the creation of
    * the random field object or its refinement. It updates
-   * parameters like the number of cells per dimension.
+   * parameters like the number of cells per dimension, and
+   * imports FFTW wisdom for the new geometry if configured to do so.
    */
   void update()
   {
     rank = (*traits).rank;
     commSize = (*traits).commSize;
 
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::load(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
+
     localCells = (*traits).localCells;
     localDomainSize = (*traits).localDomainSize;
     extendedCells = (*traits).extendedCells;
@@ -114,11 +104,37 @@ public:
     localExtendedCells = (*traits).localExtendedCells;
     localExtendedDomainSize = (*traits).localExtendedDomainSize;
     transposed = (*traits).transposed;
+    pruned = dim > 1 &&
+             (*traits).config.template get<bool>("fftw.pruned", true);
 
     getDFTData();
 
+    if (commSize > 1) {
+      Index sliceSize = 1;
+      for (unsigned int i = 0; i < dim - 1; i++)
+        sliceSize *= localCells[i];
+      slabExchange.update((*traits).comm,
+                          sliceSize,
+                          localCells[dim - 1],
+                          (*traits).localExtendedCells[dim - 1],
+                          (*traits).localExtendedOffset[dim - 1]);
+    }
+
+    if constexpr (dim > 1)
+      if (pruned) {
+        Indices boxCells = localCells;
+        if (commSize > 1)
+          boxCells[dim - 1] = slabExchange.embeddedRows();
+        prunedTransform.update((*traits).comm,
+                               extendedCells,
+                               localExtendedCells[dim - 1],
+                               boxCells,
+                               false,
+                               transposed);
+      }
+
     if (fieldData != nullptr) {
-      FFTW<RF>::free(fieldData);
+      FFTEngine<RF>::free(fieldData);
       fieldData = nullptr;
     }
   }
@@ -145,6 +161,30 @@ public:
    */
   const Indices& localFieldCells() const { return localExtendedCells; }
 
+  /**
+   * @brief Global frequency of a field entry
+   *
+   * Only meaningful in the frequency layout, i.e., after a forward
+   * transform or a call to transposeIfNeeded on a new field. The
+   * frequencies are given in the original order of dimensions, even if
+   * the last two dimensions are stored transposed.
+   *
+   * @param index flat index of local field entry
+   *
+   * @return frequency of the entry, one per dimension
+   */
+  Indices frequency(Index index) const
+  {
+    Indices output;
+    Traits::indexToIndices(index, output, localExtendedCells);
+    if (transposed) {
+      output[dim - 1] += rank * localExtendedCells[dim - 1];
+      std::swap(output[dim - 1], output[dim - 2]);
+    } else
+      output[dim - 1] += local0Start;
+    return output;
+  }
+
   /**
    * @brief Reserve memory before storing any field entries
    *
@@ -155,7 +195,7 @@ public:
   void allocate()
   {
     if (fieldData == nullptr)
-      fieldData = FFTW<RF>::alloc_complex(allocLocal);
+      fieldData = FFTEngine<RF>::alloc_complex(allocLocal);
   }
 
   /**
@@ -181,36 +221,46 @@ public:
    * @brief Transform into Fourier (i.e., frequency) space
    *
    * Perform a forward Fourier transform, mapping from the original
-   * domain to the frequency domain. Uses a single FFTW DFT transform.
+   * domain to the frequency domain. Uses a single FFTW DFT transform,
+   * or skips lines of the array that are known to be zero if pruned
+   * transforms are enabled.
+   *
+   * @param normalize divide result by extended domain size if true
    */
-  void forwardTransform()
+  void forwardTransform(bool normalize = true)
   {
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
-    if (transposed)
-      flags |= FFTW_MPI_TRANSPOSED_OUT;
+    unsigned int flags = plannerFlags(*traits);
 
-    ptrdiff_t n[dim];
-    for (unsigned int i = 0; i < dim; i++)
-      n[i] = extendedCells[dim - 1 - i];
+    if (pruned) {
+      if constexpr (dim > 1)
+        prunedTransform.forward(fieldData, flags);
+    } else {
+      if (transposed)
+        flags |= FFTW_MPI_TRANSPOSED_OUT;
 
-    typename FFTW<RF>::plan plan_forward = FFTW<RF>::mpi_plan_dft(
-      dim, n, fieldData, fieldData, (*traits).comm, FFTW_FORWARD, flags);
+      ptrdiff_t n[dim];
+      for (unsigned int i = 0; i < dim; i++)
+        n[i] = extendedCells[dim - 1 - i];
 
-    if (plan_forward == nullptr)
-      throw std::runtime_error{ "parafields failed to create forward plan" };
+      typename FFTEngine<RF>::plan plan_forward =
+        createPlan((RF*)fieldData, 2 * allocLocal, flags, [&] {
+          return FFTEngine<RF>::mpi_plan_dft(
+            dim, n, fieldData, fieldData, (*traits).comm, FFTW_FORWARD, flags);
+        });
 
-    FFTW<RF>::execute(plan_forward);
-    FFTW<RF>::destroy_plan(plan_forward);
+      if (plan_forward == nullptr)
+        throw std::runtime_error{ "parafields failed to create forward plan" };
 
-    for (Index i = 0; i < allocLocal; i++) {
-      fieldData[i][0] /= extendedDomainSize;
-      fieldData[i][1] /= extendedDomainSize;
+      FFTEngine<RF>::execute(plan_forward);
+      destroyPlan<RF>(plan_forward);
     }
 
+    if (normalize)
+      for (Index i = 0; i < allocLocal; i++) {
+        fieldData[i][0] /= extendedDomainSize;
+        fieldData[i][1] /= extendedDomainSize;
+      }
+
     transposeIfNeeded();
   }
 
@@ -219,31 +269,43 @@ public:
    *
    * Perform a backward Fourier transform, mapping from the frequency
    * domain back to the original domain. Uses a single FFTW DFT transform.
+   * If pruned transforms are enabled, only the part of the output on the
+   * original domain is valid, and lines outside of the band of nonzero
+   * frequencies are skipped for spectrally truncated input.
+   *
+   * @param bandLimited whether the input is spectrally truncated
    */
-  void backwardTransform()
+  void backwardTransform(bool bandLimited = false)
   {
     transposeIfNeeded();
 
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
-    if (transposed)
-      flags |= FFTW_MPI_TRANSPOSED_IN;
+    unsigned int flags = plannerFlags(*traits);
 
-    ptrdiff_t n[dim];
-    for (unsigned int i = 0; i < dim; i++)
-      n[i] = extendedCells[dim - 1 - i];
-
-    typename FFTW<RF>::plan plan_backward = FFTW<RF>::mpi_plan_dft(
-      dim, n, fieldData, fieldData, (*traits).comm, FFTW_BACKWARD, flags);
-
-    if (plan_backward == nullptr)
-      throw std::runtime_error{ "parafields failed to create backward plan" };
-
-    FFTW<RF>::execute(plan_backward);
-    FFTW<RF>::destroy_plan(plan_backward);
+    if (pruned) {
+      if constexpr (dim > 1)
+        prunedTransform.backward(fieldData, flags, bandLimited);
+    } else {
+      if (transposed)
+        flags |= FFTW_MPI_TRANSPOSED_IN;
+
+      ptrdiff_t n[dim];
+      for (unsigned int i = 0; i < dim; i++)
+        n[i] = extendedCells[dim - 1 - i];
+
+      typename FFTEngine<RF>::plan plan_backward =
+        createPlan((RF*)fieldData, 2 * allocLocal, flags, [&] {
+          return FFTEngine<RF>::mpi_plan_dft(
+            dim, n, fieldData, fieldData, (*traits).comm, FFTW_BACKWARD, flags);
+        });
+
+      if (plan_backward == nullptr)
+        throw std::runtime_error{
+          "parafields failed to create backward plan"
+        };
+
+      FFTEngine<RF>::execute(plan_backward);
+      destroyPlan<RF>(plan_backward);
+    }
   }
 
   /**
@@ -307,7 +369,7 @@ public:
   void fieldToExtendedField(std::vector<RF>& field)
   {
     if (fieldData == nullptr)
-      fieldData = FFTW<RF>::alloc_complex(allocLocal);
+      fieldData = FFTEngine<RF>::alloc_complex(allocLocal);
 
     for (Index i = 0; i < localExtendedDomainSize; i++) {
       fieldData[i][0] = 0.;
@@ -324,44 +386,19 @@ public:
         fieldData[extIndex][0] = field[index];
       }
     } else {
-      const int embeddingFactor = (*traits).embeddingFactor;
-      MPI_Request request;
-
-      MPI_Isend(&(field[0]),
-                localDomainSize,
-                mpiType<RF>,
-                rank / embeddingFactor,
-                toExtended,
-                (*traits).comm,
-                &request);
-
-      if (rank * embeddingFactor < commSize) {
-        std::vector<RF> localCopy(localDomainSize);
-        Indices indices;
-
-        Index receiveSize =
-          std::min(embeddingFactor, commSize - rank * embeddingFactor);
-        for (Index i = 0; i < receiveSize; i++) {
-          MPI_Recv(&(localCopy[0]),
-                   localDomainSize,
-                   mpiType<RF>,
-                   rank * embeddingFactor + i,
-                   toExtended,
-                   (*traits).comm,
-                   MPI_STATUS_IGNORE);
-
-          for (Index index = 0; index < localDomainSize; index++) {
-            Traits::indexToIndices(index, indices, localCells);
-            const Index offset = i * localExtendedDomainSize / embeddingFactor;
-            const Index extIndex =
-              Traits::indicesToIndex(indices, localExtendedCells) + offset;
-
-            fieldData[extIndex][0] = localCopy[index];
-          }
-        }
-      }
+      std::vector<RF> slab;
+      slabExchange.toExtended(field, slab);
 
-      MPI_Wait(&request, MPI_STATUS_IGNORE);
+      Indices slabCells = localCells;
+      slabCells[dim - 1] = slabExchange.embeddedRows();
+      Indices indices;
+      for (Index index = 0; index < slab.size(); index++) {
+        Traits::indexToIndices(index, indices, slabCells);
+        const Index extIndex =
+          Traits::indicesToIndex(indices, localExtendedCells);
+
+        fieldData[extIndex][0] = slab[index];
+      }
     }
   }
 
@@ -392,56 +429,23 @@ public:
         field[index] = fieldData[extIndex][component];
       }
     } else {
-      const int embeddingFactor = (*traits).embeddingFactor;
-
-      if (rank * embeddingFactor < commSize) {
-        std::vector<std::vector<RF>> localCopy;
-        std::vector<MPI_Request> request;
-
-        unsigned int sendSize =
-          std::min(embeddingFactor, commSize - rank * embeddingFactor);
-        localCopy.resize(sendSize);
-        request.resize(sendSize);
-        Indices indices;
-
-        for (unsigned int i = 0; i < sendSize; i++) {
-          localCopy[i].resize(localDomainSize);
-          for (Index index = 0; index < localDomainSize; index++) {
-            Traits::indexToIndices(index, indices, localCells);
-            const Index offset = i * localExtendedDomainSize / embeddingFactor;
-            const Index extIndex =
-              Traits::indicesToIndex(indices, localExtendedCells);
-
-            localCopy[i][index] = fieldData[extIndex + offset][component];
-          }
-
-          MPI_Isend(&(localCopy[i][0]),
-                    localDomainSize,
-                    mpiType<RF>,
-                    rank * embeddingFactor + i,
-                    fromExtended,
-                    (*traits).comm,
-                    &(request[i]));
-        }
-
-        MPI_Recv(&(field[0]),
-                 localDomainSize,
-                 mpiType<RF>,
-                 rank / embeddingFactor,
-                 fromExtended,
-                 (*traits).comm,
-                 MPI_STATUS_IGNORE);
-
-        MPI_Waitall(request.size(), &(request[0]), MPI_STATUSES_IGNORE);
-      } else {
-        MPI_Recv(&(field[0]),
-                 localDomainSize,
-                 mpiType<RF>,
-                 rank / embeddingFactor,
-                 fromExtended,
-                 (*traits).comm,
-                 MPI_STATUS_IGNORE);
+      Indices slabCells = localCells;
+      slabCells[dim - 1] = slabExchange.embeddedRows();
+      Index slabSize = 1;
+      for (unsigned int i = 0; i < dim; i++)
+        slabSize *= slabCells[i];
+
+      std::vector<RF> slab(slabSize);
+      Indices indices;
+      for (Index index = 0; index < slabSize; index++) {
+        Traits::indexToIndices(index, indices, slabCells);
+        const Index extIndex =
+          Traits::indicesToIndex(indices, localExtendedCells);
+
+        slab[index] = fieldData[extIndex][component];
       }
+
+      slabExchange.fromExtended(slab, field);
     }
   }
 
@@ -460,18 +464,28 @@ private:
 
     if (dim == 1) {
       ptrdiff_t localN02, local0Start2;
-      allocLocal = FFTW<RF>::mpi_local_size_1d(n[0],
-                                               (*traits).comm,
-                                               FFTW_FORWARD,
-                                               FFTW_ESTIMATE,
-                                               &localN0,
-                                               &local0Start,
-                                               &localN02,
-                                               &local0Start2);
+      allocLocal = FFTEngine<RF>::mpi_local_size_1d(n[0],
+                                                    (*traits).comm,
+                                                    FFTW_FORWARD,
+                                                    FFTW_ESTIMATE,
+                                                    &localN0,
+                                                    &local0Start,
+                                                    &localN02,
+                                                    &local0Start2);
       if (localN0 != localN02 || local0Start != local0Start2)
         throw std::runtime_error{ "1d size / offset results don't match" };
+    } else if (pruned) {
+      // pruned transforms switch to transposed layout in between
+      ptrdiff_t localN0Trans, local0StartTrans;
+      allocLocal = FFTEngine<RF>::mpi_local_size_transposed(dim,
+                                                            n,
+                                                            (*traits).comm,
+                                                            &localN0,
+                                                            &local0Start,
+                                                            &localN0Trans,
+                                                            &local0StartTrans);
     } else
-      allocLocal = FFTW<RF>::mpi_local_size(
+      allocLocal = FFTEngine<RF>::mpi_local_size(
         dim, n, (*traits).comm, &localN0, &local0Start);
   }
 };
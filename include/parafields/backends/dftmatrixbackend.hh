@@ -40,7 +40,9 @@ class DFTMatrixBackend
   Indices localExtendedOffset;
   Index localExtendedDomainSize;
 
-  mutable typename FFTW<RF>::complex* matrixData;
+  mutable typename FFTEngine<RF>::complex* matrixData;
+
+  std::size_t peakMemory;
 
   bool transposed;
 
@@ -48,42 +50,31 @@ public:
   /**
    * @brief Constructor
    *
-   * Imports FFTW wisdom if configured to do so.
-   *
    * @param traits_ traits object with parameters and communication
    */
   DFTMatrixBackend(const std::shared_ptr<Traits>& traits_)
     : traits(traits_)
     , matrixData(nullptr)
+    , peakMemory(0)
   {
     if ((*traits).verbose && (*traits).rank == 0)
       std::cout << "using DFTMatrixBackend" << std::endl;
-
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      if ((*traits).rank == 0)
-        FFTW<RF>::import_wisdom_from_filename("wisdom-DFTMatrix.ini");
-
-      FFTW<RF>::mpi_broadcast_wisdom((*traits).comm);
-    }
   }
 
   /**
    * @brief Destructor
    *
-   * Cleans up allocated arrays and FFTW plans. Exports FFTW
+   * Cleans up allocated arrays and FFTW plans. Stores new FFTW
    * wisdom if configured to do so.
    */
   ~DFTMatrixBackend()
   {
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      FFTW<RF>::mpi_gather_wisdom((*traits).comm);
-
-      if ((*traits).rank == 0)
-        FFTW<RF>::export_wisdom_to_filename("wisdom-DFTMatrix.ini");
-    }
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::store(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
 
     if (matrixData != nullptr) {
-      FFTW<RF>::free(matrixData);
+      FFTEngine<RF>::free(matrixData);
       matrixData = nullptr;
     }
   }
@@ -93,13 +84,18 @@ public:
    *
    * This function is has to be called after the creation of
    * the random field object or its refinement. It updates
-   * parameters like the number of cells per dimension.
+   * parameters like the number of cells per dimension, and
+   * imports FFTW wisdom for the new geometry if configured to do so.
    */
   void update()
   {
     rank = (*traits).rank;
     commSize = (*traits).commSize;
 
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::load(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
+
     extendedCells = (*traits).extendedCells;
     extendedDomainSize = (*traits).extendedDomainSize;
     localExtendedCells = (*traits).localExtendedCells;
@@ -109,8 +105,10 @@ public:
 
     getDFTData();
 
+    peakMemory = 0;
+
     if (matrixData != nullptr) {
-      FFTW<RF>::free(matrixData);
+      FFTEngine<RF>::free(matrixData);
       matrixData = nullptr;
     }
   }
@@ -176,10 +174,44 @@ public:
    */
   void allocate()
   {
-    if (matrixData == nullptr)
-      matrixData = FFTW<RF>::alloc_complex(allocLocal);
+    if (matrixData == nullptr) {
+      matrixData = FFTEngine<RF>::alloc_complex(allocLocal);
+      peakMemory = std::max(
+        peakMemory, allocLocal * sizeof(typename FFTEngine<RF>::complex));
+    }
   }
 
+  /**
+   * @brief Largest amount of memory used for matrix data
+   *
+   * This is the largest amount of memory the backend has held at any
+   * point in time since the last update, including transient buffers
+   * used during finalization.
+   *
+   * @return memory in bytes on this processor
+   */
+  std::size_t peakMemoryUsage() const { return peakMemory; }
+
+  /**
+   * @brief Number of values in the local array, including padding
+   *
+   * This is the size of the array returned by rawData, which contains
+   * the transformed matrix between the transform and finalization.
+   *
+   * @return number of local values of type RF
+   */
+  Index localStorageSize() const { return 2 * allocLocal; }
+
+  /**
+   * @brief Raw access to the local array
+   *
+   * Used for storing the transformed matrix before finalization, and
+   * for restoring it, e.g., when it is cached on disk.
+   *
+   * @return pointer to the local array
+   */
+  RF* rawData() const { return (RF*)matrixData; }
+
   /**
    * @brief Switch last two dimensions (for transposed transforms)
    *
@@ -200,6 +232,42 @@ public:
     }
   }
 
+  /**
+   * @brief Switch to frequency space without transforming the data
+   *
+   * This performs the same changes to the data layout as the forward
+   * transform, but leaves the stored data untouched. It is used when
+   * the transformed matrix is restored instead of being computed.
+   */
+  void markTransformed() { transposeIfNeeded(); }
+
+  /**
+   * @brief Switch back to original domain without transforming the data
+   *
+   * This restores the data layout of the untransformed matrix, so that
+   * it can be filled anew, e.g., after the correlation length has been
+   * changed. The local array is kept and will be overwritten.
+   */
+  void reset()
+  {
+    extendedCells = (*traits).extendedCells;
+    localExtendedCells = (*traits).localExtendedCells;
+    localExtendedOffset = (*traits).localExtendedOffset;
+  }
+
+  /**
+   * @brief Multiply all stored entries with given factor
+   *
+   * @param factor scale factor, e.g., ratio of new and old variance
+   */
+  void scale(RF factor)
+  {
+    for (Index i = 0; i < allocLocal; i++) {
+      matrixData[i][0] *= factor;
+      matrixData[i][1] *= factor;
+    }
+  }
+
   /**
    * @brief Transform into Fourier (i.e., frequency) space
    *
@@ -208,11 +276,7 @@ public:
    */
   void forwardTransform()
   {
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
+    unsigned int flags = plannerFlags(*traits);
     if (transposed)
       flags |= FFTW_MPI_TRANSPOSED_OUT;
 
@@ -220,14 +284,22 @@ public:
     for (unsigned int i = 0; i < dim; i++)
       n[i] = extendedCells[dim - 1 - i];
 
-    typename FFTW<RF>::plan plan_forward = FFTW<RF>::mpi_plan_dft(
-      dim, n, matrixData, matrixData, (*traits).comm, FFTW_FORWARD, flags);
+    typename FFTEngine<RF>::plan plan_forward =
+      createPlan((RF*)matrixData, 2 * allocLocal, flags, [&] {
+        return FFTEngine<RF>::mpi_plan_dft(dim,
+                                           n,
+                                           matrixData,
+                                           matrixData,
+                                           (*traits).comm,
+                                           FFTW_FORWARD,
+                                           flags);
+      });
 
     if (plan_forward == nullptr)
       throw std::runtime_error{ "parafields failed to create forward plan" };
 
-    FFTW<RF>::execute(plan_forward);
-    FFTW<RF>::destroy_plan(plan_forward);
+    FFTEngine<RF>::execute(plan_forward);
+    destroyPlan<RF>(plan_forward);
 
     for (Index i = 0; i < allocLocal; i++) {
       matrixData[i][0] /= extendedDomainSize;
@@ -237,6 +309,80 @@ public:
     transposeIfNeeded();
   }
 
+  /**
+   * @brief Transform several matrices into Fourier space at once
+   *
+   * Equivalent to calling forwardTransform on each of the backends, which
+   * have to share the extended domain and communicator. The local arrays
+   * are interleaved in a temporary buffer, so that a single FFTW plan
+   * with the number of matrices as howmany parameter transforms all of
+   * them, amortizing planning and communication.
+   *
+   * @param backends backends containing the untransformed matrices
+   */
+  static void forwardTransform(const std::vector<DFTMatrixBackend*>& backends)
+  {
+    const DFTMatrixBackend& first = *backends.front();
+    const ptrdiff_t howmany = backends.size();
+    const ptrdiff_t allocLocal = first.allocLocal;
+
+    unsigned int flags = plannerFlags(*first.traits);
+    if (first.transposed)
+      flags |= FFTW_MPI_TRANSPOSED_OUT;
+
+    ptrdiff_t n[dim];
+    for (unsigned int i = 0; i < dim; i++)
+      n[i] = first.extendedCells[dim - 1 - i];
+
+    // plan before filling the buffer, since planning may overwrite it
+    typename FFTEngine<RF>::complex* batch =
+      FFTEngine<RF>::alloc_complex(howmany * allocLocal);
+    typename FFTEngine<RF>::plan plan_forward =
+      createPlan((RF*)batch, 0, flags, [&] {
+        return FFTEngine<RF>::mpi_plan_many_dft(dim,
+                                                n,
+                                                howmany,
+                                                FFTW_MPI_DEFAULT_BLOCK,
+                                                FFTW_MPI_DEFAULT_BLOCK,
+                                                batch,
+                                                batch,
+                                                (*first.traits).comm,
+                                                FFTW_FORWARD,
+                                                flags);
+      });
+
+    if (plan_forward == nullptr) {
+      FFTEngine<RF>::free(batch);
+      throw std::runtime_error{ "parafields failed to create forward plan" };
+    }
+
+    for (ptrdiff_t j = 0; j < howmany; j++)
+      for (ptrdiff_t i = 0; i < allocLocal; i++) {
+        batch[i * howmany + j][0] = backends[j]->matrixData[i][0];
+        batch[i * howmany + j][1] = backends[j]->matrixData[i][1];
+      }
+
+    FFTEngine<RF>::execute(plan_forward);
+    destroyPlan<RF>(plan_forward);
+
+    for (ptrdiff_t j = 0; j < howmany; j++) {
+      DFTMatrixBackend& backend = *backends[j];
+      for (ptrdiff_t i = 0; i < allocLocal; i++) {
+        backend.matrixData[i][0] =
+          batch[i * howmany + j][0] / backend.extendedDomainSize;
+        backend.matrixData[i][1] =
+          batch[i * howmany + j][1] / backend.extendedDomainSize;
+      }
+
+      backend.peakMemory =
+        std::max(backend.peakMemory,
+                 2 * allocLocal * sizeof(typename FFTEngine<RF>::complex));
+      backend.transposeIfNeeded();
+    }
+
+    FFTEngine<RF>::free(batch);
+  }
+
   /**
    * @brief Transform from Fourier (i.e., frequency) space
    *
@@ -247,11 +393,7 @@ public:
   {
     transposeIfNeeded();
 
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
+    unsigned int flags = plannerFlags(*traits);
     if (transposed)
       flags |= FFTW_MPI_TRANSPOSED_IN;
 
@@ -259,14 +401,22 @@ public:
     for (unsigned int i = 0; i < dim; i++)
       n[i] = extendedCells[dim - 1 - i];
 
-    typename FFTW<RF>::plan plan_backward = FFTW<RF>::mpi_plan_dft(
-      dim, n, matrixData, matrixData, (*traits).comm, FFTW_BACKWARD, flags);
+    typename FFTEngine<RF>::plan plan_backward =
+      createPlan((RF*)matrixData, 2 * allocLocal, flags, [&] {
+        return FFTEngine<RF>::mpi_plan_dft(dim,
+                                           n,
+                                           matrixData,
+                                           matrixData,
+                                           (*traits).comm,
+                                           FFTW_BACKWARD,
+                                           flags);
+      });
 
     if (plan_backward == nullptr)
       throw std::runtime_error{ "parafields failed to create backward plan" };
 
-    FFTW<RF>::execute(plan_backward);
-    FFTW<RF>::destroy_plan(plan_backward);
+    FFTEngine<RF>::execute(plan_backward);
+    destroyPlan<RF>(plan_backward);
   }
 
   /**
@@ -306,6 +456,41 @@ public:
     return eval(index);
   }
 
+  /**
+   * @brief Per-dimension contributions to storage index of matrix entries
+   *
+   * The index remapping performed by eval(Indices) acts on each dimension
+   * separately. This function tabulates it for the given number of local
+   * cells per dimension, so that the storage index of an entry is the sum
+   * of the table entries for its indices, see evalStored.
+   *
+   * @param cells local cells per dimension that should be tabulated
+   *
+   * @return table of index contributions, one per dimension
+   */
+  std::array<std::vector<Index>, dim> evalOffsets(const Indices& cells) const
+  {
+    std::array<std::vector<Index>, dim> offsets;
+    Index stride = 1;
+    for (unsigned int i = 0; i < dim; i++) {
+      offsets[i].resize(cells[i]);
+      for (Index j = 0; j < cells[i]; j++)
+        offsets[i][j] = j * stride;
+      stride *= localExtendedCells[i];
+    }
+
+    return offsets;
+  }
+
+  /**
+   * @brief Evaluate matrix entry (using the storage index)
+   *
+   * @param index storage index, as assembled from evalOffsets
+   *
+   * @return value associated with index
+   */
+  RF evalStored(Index index) const { return matrixData[index][0]; }
+
   /**
    * @brief Get matrix entry (using the actual index)
    *
@@ -367,18 +552,18 @@ private:
 
     if (dim == 1) {
       ptrdiff_t localN02, local0Start2;
-      allocLocal = FFTW<RF>::mpi_local_size_1d(n[0],
-                                               (*traits).comm,
-                                               FFTW_FORWARD,
-                                               FFTW_ESTIMATE,
-                                               &localN0,
-                                               &local0Start,
-                                               &localN02,
-                                               &local0Start2);
+      allocLocal = FFTEngine<RF>::mpi_local_size_1d(n[0],
+                                                    (*traits).comm,
+                                                    FFTW_FORWARD,
+                                                    FFTW_ESTIMATE,
+                                                    &localN0,
+                                                    &local0Start,
+                                                    &localN02,
+                                                    &local0Start2);
       if (localN0 != localN02 || local0Start != local0Start2)
         throw std::runtime_error{ "1d size / offset results don't match" };
     } else
-      allocLocal = FFTW<RF>::mpi_local_size(
+      allocLocal = FFTEngine<RF>::mpi_local_size(
         dim, n, (*traits).comm, &localN0, &local0Start);
   }
 };
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <parafields/mpi.hh>
+
+#if HAVE_FFTW3_FLOAT || HAVE_FFTW3_DOUBLE || HAVE_FFTW3_LONGDOUBLE
+#include <fftw3.h>
+#else
+// constants of the FFTW interface, which all engines share
+#define FFTW_FORWARD (-1)
+#define FFTW_BACKWARD (+1)
+#define FFTW_MEASURE (0U)
+#define FFTW_PATIENT (1U << 5)
+#define FFTW_ESTIMATE (1U << 6)
+enum
+{
+  FFTW_REDFT00 = 3,
+  FFTW_RODFT00 = 7
+};
+#endif
+
+#include <parafields/backends/fftwwrapper.hh>
+#include <parafields/backends/nativefft.hh>
+
+namespace parafields {
+
+/**
+ * @brief FFT engine used by the matrix and field backends
+ *
+ * An engine is a class template with the data type as argument, which
+ * provides static functions for buffer allocation, data layout queries,
+ * plan creation, execution and destruction, and wisdom handling, with
+ * the names and signatures of FFTW3-MPI (as in the FFTW wrapper), and the
+ * types complex, plan, r2r_kind and iodim. Constants like FFTW_FORWARD or
+ * FFTW_ESTIMATE are shared between engines. The backends only refer to
+ * the engine through this alias, so that engines can be exchanged without
+ * touching them.
+ *
+ * The default engine is FFTW3-MPI. Defining PARAFIELDS_NATIVE_FFT (CMake
+ * option PARAFIELDS_FFT_ENGINE=native) selects the header-only engine in
+ * nativefft.hh instead, which is restricted to a single processor.
+ *
+ * @tparam RF data type of transformed values
+ */
+#if PARAFIELDS_NATIVE_FFT
+template<typename RF>
+using FFTEngine = NativeFFT<RF>;
+#else
+template<typename RF>
+using FFTEngine = FFTW<RF>;
+#endif
+
+/**
+ * @brief Number of threads used by subsequently created plans
+ *
+ * Only has an effect for the native engine, and for FFTW in serial builds
+ * if the threaded FFTW libraries have been found.
+ *
+ * @param threads number of threads per plan
+ */
+inline void
+plannerThreads(int threads)
+{
+#if PARAFIELDS_NATIVE_FFT
+  nativeFFTThreads() = threads;
+#elif PARAFIELDS_NO_MPI && HAVE_FFTW3_THREADS
+#if HAVE_FFTW3_FLOAT
+  static const bool floatThreads = fftwf_init_threads();
+  if (floatThreads)
+    fftwf_plan_with_nthreads(threads);
+#endif
+#if HAVE_FFTW3_DOUBLE
+  static const bool doubleThreads = fftw_init_threads();
+  if (doubleThreads)
+    fftw_plan_with_nthreads(threads);
+#endif
+#else
+  (void)threads;
+#endif
+}
+
+} // namespace parafields
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdlib>
+#include <string>
+
 namespace parafields {
 
 /**
@@ -35,6 +38,12 @@ public:
   using complex = fftwf_complex;
   using plan = fftwf_plan;
   using r2r_kind = fftwf_r2r_kind;
+  using iodim = fftwf_iodim64;
+
+  // setup
+
+  //! @brief Initialize FFTW-MPI
+  static void mpi_init() { fftwf_mpi_init(); }
 
   // allocation and deallocation
 
@@ -183,6 +192,107 @@ public:
       dim, n, howmany, block0, block1, data1, data2, comm, kinds, flags);
   }
 
+  //! @brief Generate sequential one-dimensional discrete cosine / sine
+  //! transform plan
+  static fftwf_plan plan_r2r_1d(int n,
+                                float* data1,
+                                float* data2,
+                                r2r_kind kind,
+                                unsigned int flags)
+  {
+    return fftwf_plan_r2r_1d(n, data1, data2, kind, flags);
+  }
+
+  //! @brief Generate discrete Fourier transform plan, second version
+  static fftwf_plan mpi_plan_many_dft(unsigned int dim,
+                                      const ptrdiff_t* n,
+                                      ptrdiff_t howmany,
+                                      ptrdiff_t block0,
+                                      ptrdiff_t block1,
+                                      fftwf_complex* data1,
+                                      fftwf_complex* data2,
+                                      MPI_Comm comm,
+                                      int direction,
+                                      unsigned int flags)
+  {
+    return fftwf_mpi_plan_many_dft(
+      dim, n, howmany, block0, block1, data1, data2, comm, direction, flags);
+  }
+
+  //! @brief Generate real-to-complex discrete Fourier transform plan, second
+  //! version
+  static fftwf_plan mpi_plan_many_dft_r2c(unsigned int dim,
+                                          const ptrdiff_t* n,
+                                          ptrdiff_t howmany,
+                                          ptrdiff_t block0,
+                                          ptrdiff_t block1,
+                                          float* data1,
+                                          fftwf_complex* data2,
+                                          MPI_Comm comm,
+                                          unsigned int flags)
+  {
+    return fftwf_mpi_plan_many_dft_r2c(
+      dim, n, howmany, block0, block1, data1, data2, comm, flags);
+  }
+
+  //! @brief Generate one-dimensional discrete Fourier transform plan for
+  //! strided lines
+  static fftwf_plan plan_guru64_dft(int rank,
+                                    const iodim* dims,
+                                    int howmanyRank,
+                                    const iodim* howmanyDims,
+                                    fftwf_complex* data1,
+                                    fftwf_complex* data2,
+                                    int direction,
+                                    unsigned int flags)
+  {
+    return fftwf_plan_guru64_dft(
+      rank, dims, howmanyRank, howmanyDims, data1, data2, direction, flags);
+  }
+
+  //! @brief Generate one-dimensional real-to-complex discrete Fourier
+  //! transform plan for strided lines
+  static fftwf_plan plan_guru64_dft_r2c(int rank,
+                                        const iodim* dims,
+                                        int howmanyRank,
+                                        const iodim* howmanyDims,
+                                        float* data1,
+                                        fftwf_complex* data2,
+                                        unsigned int flags)
+  {
+    return fftwf_plan_guru64_dft_r2c(
+      rank, dims, howmanyRank, howmanyDims, data1, data2, flags);
+  }
+
+  //! @brief Generate one-dimensional complex-to-real discrete Fourier
+  //! transform plan for strided lines
+  static fftwf_plan plan_guru64_dft_c2r(int rank,
+                                        const iodim* dims,
+                                        int howmanyRank,
+                                        const iodim* howmanyDims,
+                                        fftwf_complex* data1,
+                                        float* data2,
+                                        unsigned int flags)
+  {
+    return fftwf_plan_guru64_dft_c2r(
+      rank, dims, howmanyRank, howmanyDims, data1, data2, flags);
+  }
+
+  //! @brief Generate plan for transpose of distributed matrix
+  static fftwf_plan mpi_plan_many_transpose(ptrdiff_t n0,
+                                            ptrdiff_t n1,
+                                            ptrdiff_t howmany,
+                                            ptrdiff_t block0,
+                                            ptrdiff_t block1,
+                                            float* data1,
+                                            float* data2,
+                                            MPI_Comm comm,
+                                            unsigned int flags)
+  {
+    return fftwf_mpi_plan_many_transpose(
+      n0, n1, howmany, block0, block1, data1, data2, comm, flags);
+  }
+
   // plan execution and destruction
 
   //! @brief Perform discrete transform
@@ -211,11 +321,29 @@ public:
     fftwf_mpi_gather_wisdom(comm);
   }
 
+  //! @brief Read in optimized DFT configuration from string
+  static void import_wisdom_from_string(const std::string& wisdom)
+  {
+    fftwf_import_wisdom_from_string(wisdom.c_str());
+  }
+
+  //! @brief Discard all accumulated DFT configurations
+  static void forget_wisdom() { fftwf_forget_wisdom(); }
+
   //! @brief Write out optimized DFT configuration
   static void export_wisdom_to_filename(const char* filename)
   {
     fftwf_export_wisdom_to_filename(filename);
   }
+
+  //! @brief Write out optimized DFT configuration to string
+  static std::string export_wisdom_to_string()
+  {
+    char* buffer = fftwf_export_wisdom_to_string();
+    std::string wisdom(buffer);
+    std::free(buffer);
+    return wisdom;
+  }
 };
 #endif // HAVE_FFTW3_FLOAT
 
@@ -234,6 +362,12 @@ public:
   using complex = fftw_complex;
   using plan = fftw_plan;
   using r2r_kind = fftw_r2r_kind;
+  using iodim = fftw_iodim64;
+
+  // setup
+
+  //! @brief Initialize FFTW-MPI
+  static void mpi_init() { fftw_mpi_init(); }
 
   // allocation and deallocation
 
@@ -382,6 +516,107 @@ public:
       dim, n, howmany, block0, block1, data1, data2, comm, kinds, flags);
   }
 
+  //! @brief Generate sequential one-dimensional discrete cosine / sine
+  //! transform plan
+  static fftw_plan plan_r2r_1d(int n,
+                               double* data1,
+                               double* data2,
+                               r2r_kind kind,
+                               unsigned int flags)
+  {
+    return fftw_plan_r2r_1d(n, data1, data2, kind, flags);
+  }
+
+  //! @brief Generate discrete Fourier transform plan, second version
+  static fftw_plan mpi_plan_many_dft(unsigned int dim,
+                                     const ptrdiff_t* n,
+                                     ptrdiff_t howmany,
+                                     ptrdiff_t block0,
+                                     ptrdiff_t block1,
+                                     fftw_complex* data1,
+                                     fftw_complex* data2,
+                                     MPI_Comm comm,
+                                     int direction,
+                                     unsigned int flags)
+  {
+    return fftw_mpi_plan_many_dft(
+      dim, n, howmany, block0, block1, data1, data2, comm, direction, flags);
+  }
+
+  //! @brief Generate real-to-complex discrete Fourier transform plan, second
+  //! version
+  static fftw_plan mpi_plan_many_dft_r2c(unsigned int dim,
+                                         const ptrdiff_t* n,
+                                         ptrdiff_t howmany,
+                                         ptrdiff_t block0,
+                                         ptrdiff_t block1,
+                                         double* data1,
+                                         fftw_complex* data2,
+                                         MPI_Comm comm,
+                                         unsigned int flags)
+  {
+    return fftw_mpi_plan_many_dft_r2c(
+      dim, n, howmany, block0, block1, data1, data2, comm, flags);
+  }
+
+  //! @brief Generate one-dimensional discrete Fourier transform plan for
+  //! strided lines
+  static fftw_plan plan_guru64_dft(int rank,
+                                   const iodim* dims,
+                                   int howmanyRank,
+                                   const iodim* howmanyDims,
+                                   fftw_complex* data1,
+                                   fftw_complex* data2,
+                                   int direction,
+                                   unsigned int flags)
+  {
+    return fftw_plan_guru64_dft(
+      rank, dims, howmanyRank, howmanyDims, data1, data2, direction, flags);
+  }
+
+  //! @brief Generate one-dimensional real-to-complex discrete Fourier
+  //! transform plan for strided lines
+  static fftw_plan plan_guru64_dft_r2c(int rank,
+                                       const iodim* dims,
+                                       int howmanyRank,
+                                       const iodim* howmanyDims,
+                                       double* data1,
+                                       fftw_complex* data2,
+                                       unsigned int flags)
+  {
+    return fftw_plan_guru64_dft_r2c(
+      rank, dims, howmanyRank, howmanyDims, data1, data2, flags);
+  }
+
+  //! @brief Generate one-dimensional complex-to-real discrete Fourier
+  //! transform plan for strided lines
+  static fftw_plan plan_guru64_dft_c2r(int rank,
+                                       const iodim* dims,
+                                       int howmanyRank,
+                                       const iodim* howmanyDims,
+                                       fftw_complex* data1,
+                                       double* data2,
+                                       unsigned int flags)
+  {
+    return fftw_plan_guru64_dft_c2r(
+      rank, dims, howmanyRank, howmanyDims, data1, data2, flags);
+  }
+
+  //! @brief Generate plan for transpose of distributed matrix
+  static fftw_plan mpi_plan_many_transpose(ptrdiff_t n0,
+                                           ptrdiff_t n1,
+                                           ptrdiff_t howmany,
+                                           ptrdiff_t block0,
+                                           ptrdiff_t block1,
+                                           double* data1,
+                                           double* data2,
+                                           MPI_Comm comm,
+                                           unsigned int flags)
+  {
+    return fftw_mpi_plan_many_transpose(
+      n0, n1, howmany, block0, block1, data1, data2, comm, flags);
+  }
+
   // plan execution and destruction
 
   //! @brief Perform discrete transform
@@ -407,11 +642,29 @@ public:
   //! @brief Receive optimized DFT configuration in parallel case
   static void mpi_gather_wisdom(MPI_Comm comm) { fftw_mpi_gather_wisdom(comm); }
 
+  //! @brief Read in optimized DFT configuration from string
+  static void import_wisdom_from_string(const std::string& wisdom)
+  {
+    fftw_import_wisdom_from_string(wisdom.c_str());
+  }
+
+  //! @brief Discard all accumulated DFT configurations
+  static void forget_wisdom() { fftw_forget_wisdom(); }
+
   //! @brief Write out optimized DFT configuration
   static void export_wisdom_to_filename(const char* filename)
   {
     fftw_export_wisdom_to_filename(filename);
   }
+
+  //! @brief Write out optimized DFT configuration to string
+  static std::string export_wisdom_to_string()
+  {
+    char* buffer = fftw_export_wisdom_to_string();
+    std::string wisdom(buffer);
+    std::free(buffer);
+    return wisdom;
+  }
 };
 #endif // HAVE_FFTW3_DOUBLE
 
@@ -430,6 +683,12 @@ public:
   using complex = fftwl_complex;
   using plan = fftwl_plan;
   using r2r_kind = fftwl_r2r_kind;
+  using iodim = fftwl_iodim64;
+
+  // setup
+
+  //! @brief Initialize FFTW-MPI
+  static void mpi_init() { fftwl_mpi_init(); }
 
   // allocation and deallocation
 
@@ -581,6 +840,107 @@ public:
       dim, n, howmany, block0, block1, data1, data2, comm, kinds, flags);
   }
 
+  //! @brief Generate sequential one-dimensional discrete cosine / sine
+  //! transform plan
+  static fftwl_plan plan_r2r_1d(int n,
+                                long double* data1,
+                                long double* data2,
+                                r2r_kind kind,
+                                unsigned int flags)
+  {
+    return fftwl_plan_r2r_1d(n, data1, data2, kind, flags);
+  }
+
+  //! @brief Generate discrete Fourier transform plan, second version
+  static fftwl_plan mpi_plan_many_dft(unsigned int dim,
+                                      const ptrdiff_t* n,
+                                      ptrdiff_t howmany,
+                                      ptrdiff_t block0,
+                                      ptrdiff_t block1,
+                                      fftwl_complex* data1,
+                                      fftwl_complex* data2,
+                                      MPI_Comm comm,
+                                      int direction,
+                                      unsigned int flags)
+  {
+    return fftwl_mpi_plan_many_dft(
+      dim, n, howmany, block0, block1, data1, data2, comm, direction, flags);
+  }
+
+  //! @brief Generate real-to-complex discrete Fourier transform plan, second
+  //! version
+  static fftwl_plan mpi_plan_many_dft_r2c(unsigned int dim,
+                                          const ptrdiff_t* n,
+                                          ptrdiff_t howmany,
+                                          ptrdiff_t block0,
+                                          ptrdiff_t block1,
+                                          long double* data1,
+                                          fftwl_complex* data2,
+                                          MPI_Comm comm,
+                                          unsigned int flags)
+  {
+    return fftwl_mpi_plan_many_dft_r2c(
+      dim, n, howmany, block0, block1, data1, data2, comm, flags);
+  }
+
+  //! @brief Generate one-dimensional discrete Fourier transform plan for
+  //! strided lines
+  static fftwl_plan plan_guru64_dft(int rank,
+                                    const iodim* dims,
+                                    int howmanyRank,
+                                    const iodim* howmanyDims,
+                                    fftwl_complex* data1,
+                                    fftwl_complex* data2,
+                                    int direction,
+                                    unsigned int flags)
+  {
+    return fftwl_plan_guru64_dft(
+      rank, dims, howmanyRank, howmanyDims, data1, data2, direction, flags);
+  }
+
+  //! @brief Generate one-dimensional real-to-complex discrete Fourier
+  //! transform plan for strided lines
+  static fftwl_plan plan_guru64_dft_r2c(int rank,
+                                        const iodim* dims,
+                                        int howmanyRank,
+                                        const iodim* howmanyDims,
+                                        long double* data1,
+                                        fftwl_complex* data2,
+                                        unsigned int flags)
+  {
+    return fftwl_plan_guru64_dft_r2c(
+      rank, dims, howmanyRank, howmanyDims, data1, data2, flags);
+  }
+
+  //! @brief Generate one-dimensional complex-to-real discrete Fourier
+  //! transform plan for strided lines
+  static fftwl_plan plan_guru64_dft_c2r(int rank,
+                                        const iodim* dims,
+                                        int howmanyRank,
+                                        const iodim* howmanyDims,
+                                        fftwl_complex* data1,
+                                        long double* data2,
+                                        unsigned int flags)
+  {
+    return fftwl_plan_guru64_dft_c2r(
+      rank, dims, howmanyRank, howmanyDims, data1, data2, flags);
+  }
+
+  //! @brief Generate plan for transpose of distributed matrix
+  static fftwl_plan mpi_plan_many_transpose(ptrdiff_t n0,
+                                            ptrdiff_t n1,
+                                            ptrdiff_t howmany,
+                                            ptrdiff_t block0,
+                                            ptrdiff_t block1,
+                                            long double* data1,
+                                            long double* data2,
+                                            MPI_Comm comm,
+                                            unsigned int flags)
+  {
+    return fftwl_mpi_plan_many_transpose(
+      n0, n1, howmany, block0, block1, data1, data2, comm, flags);
+  }
+
   // plan execution and destruction
 
   //! @brief Perform discrete transform
@@ -609,11 +969,29 @@ public:
     fftwl_mpi_gather_wisdom(comm);
   }
 
+  //! @brief Read in optimized DFT configuration from string
+  static void import_wisdom_from_string(const std::string& wisdom)
+  {
+    fftwl_import_wisdom_from_string(wisdom.c_str());
+  }
+
+  //! @brief Discard all accumulated DFT configurations
+  static void forget_wisdom() { fftwl_forget_wisdom(); }
+
   //! @brief Write out optimized DFT configuration
   static void export_wisdom_to_filename(const char* filename)
   {
     fftwl_export_wisdom_to_filename(filename);
   }
+
+  //! @brief Write out optimized DFT configuration to string
+  static std::string export_wisdom_to_string()
+  {
+    char* buffer = fftwl_export_wisdom_to_string();
+    std::string wisdom(buffer);
+    std::free(buffer);
+    return wisdom;
+  }
 };
 #endif // HAVE_FFTW3_LONGDOUBLE
 
@@ -0,0 +1,326 @@
+#pragma once
+
+namespace parafields {
+
+/**
+ * @brief Extended field backend for 1D using a four-step Fourier transform
+ *
+ * This field backend is the onedimensional counterpart of the DFT field
+ * backend: complex white noise is multiplied with the transformed extended
+ * covariance matrix and transformed back, which produces two uncorrelated
+ * extended random fields, one in the real part and one in the imaginary
+ * part. The transform is that of FourStepTransform, which only needs the
+ * extended domain to be a multiple of the number of processors, and this
+ * backend can therefore only be combined with the four-step matrix backend.
+ * If fftw.forceFourStep is set, the factorization is used on a single
+ * processor as well, which is mainly meant for testing.
+ *
+ * @tparam Traits traits class with data types and definitions
+ */
+template<typename Traits>
+class FourStepFieldBackend
+{
+  using RF = typename Traits::RF;
+  using Index = typename Traits::Index;
+  using Indices = typename Traits::Indices;
+
+  enum
+  {
+    dim = Traits::dim
+  };
+
+  static_assert(dim == 1, "FourStepFieldBackend requires dim == 1");
+
+  const std::shared_ptr<Traits> traits;
+
+  int rank, commSize;
+
+  Index allocLocal;
+
+  Indices localCells;
+  Index localDomainSize;
+  Index extendedDomainSize;
+  Indices localExtendedCells;
+  Index localExtendedDomainSize;
+
+  mutable typename FFTEngine<RF>::complex* fieldData;
+
+  bool spectral;
+
+  SlabExchange<Traits> slabExchange;
+  FourStepTransform<Traits> transform;
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param traits_ traits object with parameters and communication
+   */
+  FourStepFieldBackend(const std::shared_ptr<Traits>& traits_)
+    : traits(traits_)
+    , fieldData(nullptr)
+    , spectral(false)
+  {
+    if ((*traits).verbose && (*traits).rank == 0)
+      std::cout << "using FourStepFieldBackend" << std::endl;
+  }
+
+  /**
+   * @brief Destructor
+   *
+   * Cleans up allocated arrays. Stores new FFTW wisdom if configured
+   * to do so.
+   */
+  ~FourStepFieldBackend()
+  {
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::store(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
+
+    if (fieldData != nullptr) {
+      FFTEngine<RF>::free(fieldData);
+      fieldData = nullptr;
+    }
+  }
+
+  /*
+   * @brief Update internal data after creation or refinement
+   *
+   * This function has to be called after the creation of
+   * the random field object or its refinement. It updates
+   * parameters like the number of cells per dimension, and
+   * imports FFTW wisdom for the new geometry if configured to do so.
+   */
+  void update()
+  {
+    rank = (*traits).rank;
+    commSize = (*traits).commSize;
+
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::load(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
+
+    localCells = (*traits).localCells;
+    localDomainSize = (*traits).localDomainSize;
+    extendedDomainSize = (*traits).extendedDomainSize;
+    spectral = false;
+
+    transform.update(
+      (*traits).comm,
+      (*traits).extendedCells[0],
+      (*traits).config.template get<bool>("fftw.forceFourStep", false));
+    allocLocal = transform.localAllocSize();
+    localExtendedCells[0] = transform.localSpatialSize();
+    localExtendedDomainSize = localExtendedCells[0];
+
+    if (commSize > 1)
+      slabExchange.update((*traits).comm,
+                          1,
+                          localCells[0],
+                          localExtendedCells[0],
+                          rank * localExtendedCells[0]);
+
+    if (fieldData != nullptr) {
+      FFTEngine<RF>::free(fieldData);
+      fieldData = nullptr;
+    }
+  }
+
+  /**
+   * @brief Number of extended field entries stored on this processor
+   *
+   * This is the local block of the extended domain in the original
+   * layout, and the local part of the frequency layout after a forward
+   * transform.
+   *
+   * @return number of local degrees of freedom
+   */
+  Index localFieldSize() const { return localExtendedDomainSize; }
+
+  /**
+   * @brief Number of entries per dim on this processor
+   *
+   * @return tuple of local cells per dimension
+   */
+  const Indices& localFieldCells() const { return localExtendedCells; }
+
+  /**
+   * @brief Global frequency of a field entry
+   *
+   * Only meaningful in the frequency layout, i.e., after a forward
+   * transform or a call to transposeIfNeeded on a new field.
+   *
+   * @param index flat index of local field entry
+   *
+   * @return frequency of the entry, one per dimension
+   */
+  Indices frequency(Index index) const
+  {
+    Indices output;
+    output[0] = transform.frequency(index);
+    return output;
+  }
+
+  /**
+   * @brief Reserve memory before storing any field entries
+   *
+   * Explicitly request the field backend to reserve storage for the
+   * array. This ensures that the backend doesn't waste memory when it
+   * won't be used.
+   */
+  void allocate()
+  {
+    if (fieldData == nullptr)
+      fieldData = FFTEngine<RF>::alloc_complex(allocLocal);
+  }
+
+  /**
+   * @brief Switch between original layout and frequency layout
+   *
+   * Is automatically called by the transform methods, but is needed
+   * when a newly created backend should be filled directly in frequency
+   * space.
+   */
+  void transposeIfNeeded()
+  {
+    spectral = !spectral;
+    localExtendedCells[0] =
+      spectral ? transform.localSpectralSize() : transform.localSpatialSize();
+    localExtendedDomainSize = localExtendedCells[0];
+  }
+
+  /**
+   * @brief Transform into Fourier (i.e., frequency) space
+   *
+   * Perform a forward Fourier transform, mapping from the original
+   * domain to the frequency domain, using the four-step transform.
+   *
+   * @param normalize divide result by extended domain size if true
+   */
+  void forwardTransform(bool normalize = true)
+  {
+    transform.forward(fieldData, plannerFlags(*traits));
+
+    transposeIfNeeded();
+
+    if (normalize)
+      for (Index i = 0; i < localExtendedDomainSize; i++) {
+        fieldData[i][0] /= extendedDomainSize;
+        fieldData[i][1] /= extendedDomainSize;
+      }
+  }
+
+  /**
+   * @brief Transform from Fourier (i.e., frequency) space
+   *
+   * Perform a backward Fourier transform, mapping from the frequency
+   * domain back to the original domain, using the four-step transform.
+   * Spectrally truncated input is transformed in full.
+   *
+   * @param bandLimited whether the input is spectrally truncated, ignored
+   */
+  void backwardTransform([[maybe_unused]] bool bandLimited = false)
+  {
+    transposeIfNeeded();
+
+    transform.backward(fieldData, plannerFlags(*traits));
+  }
+
+  /**
+   * @brief Whether this kind of backend produces two fields at once
+   *
+   * This backend produces two separate uncorrelated fields at once,
+   * one in the real part and one in the imaginary part of the
+   * complex-valued scalar field.
+   *
+   * @return true
+   */
+  bool hasSpareField() const { return true; }
+
+  /**
+   * @brief Set entry based on pair of random numbers
+   *
+   * @param index  index of extended field cell to fill
+   * @param lambda square root of covariance matrix eigenvalue
+   * @param rand1  normally distributed random number
+   * @param rand2  second normally distributed random number
+   */
+  void set(Index index, RF lambda, RF rand1, RF rand2)
+  {
+    fieldData[index][0] = lambda * rand1;
+    fieldData[index][1] = lambda * rand2;
+  }
+
+  /**
+   * @brief Multiply entry with given number
+   *
+   * @param index  index of extended field cell to scale
+   * @param lambda scalar factor
+   */
+  void mult(Index index, RF lambda)
+  {
+    fieldData[index][0] *= lambda;
+    fieldData[index][1] *= lambda;
+  }
+
+  /**
+   * @brief Embed a random field in the extended domain
+   *
+   * This function maps a random field onto the extended domain,
+   * filling any cells that are not part of the original domain
+   * with zero values.
+   *
+   * @param field random field to embed in larger domain
+   */
+  void fieldToExtendedField(std::vector<RF>& field)
+  {
+    if (fieldData == nullptr)
+      fieldData = FFTEngine<RF>::alloc_complex(allocLocal);
+
+    for (Index i = 0; i < localExtendedDomainSize; i++) {
+      fieldData[i][0] = 0.;
+      fieldData[i][1] = 0.;
+    }
+
+    if (commSize == 1) {
+      for (Index index = 0; index < localDomainSize; index++)
+        fieldData[index][0] = field[index];
+    } else {
+      std::vector<RF> slab;
+      slabExchange.toExtended(field, slab);
+
+      for (Index index = 0; index < slab.size(); index++)
+        fieldData[index][0] = slab[index];
+    }
+  }
+
+  /**
+   * @brief Restrict an extended random field to the original domain
+   *
+   * This function restricts an extended random field and cuts out the
+   * part that lies on the original domain. The optional argument can
+   * be used to select between the two fields that are stored in the
+   * real and imaginary part of the extended random field.
+   *
+   * @param[out] field     random field to fill with restriction
+   * @param      component extract real part if zero, else imaginary part
+   */
+  void extendedFieldToField(std::vector<RF>& field,
+                            unsigned int component = 0) const
+  {
+    field.resize(localDomainSize);
+
+    if (commSize == 1) {
+      for (Index index = 0; index < localDomainSize; index++)
+        field[index] = fieldData[index][component];
+    } else {
+      std::vector<RF> slab(slabExchange.embeddedRows());
+      for (Index index = 0; index < slab.size(); index++)
+        slab[index] = fieldData[index][component];
+
+      slabExchange.fromExtended(slab, field);
+    }
+  }
+};
+
+} // namespace parafields
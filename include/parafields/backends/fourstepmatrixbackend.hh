@@ -0,0 +1,370 @@
+#pragma once
+
+namespace parafields {
+
+/**
+ * @brief Matrix backend for 1D using a four-step Fourier transform
+ *
+ * This matrix backend is the onedimensional counterpart of the DFT matrix
+ * backend, but instead of the onedimensional transforms of FFTW-MPI, which
+ * require that the number of cells is a multiple of the square of the
+ * number of processors, it uses a four-step transform with its own data
+ * exchange. The extended domain is split into equal blocks, independent
+ * of the distribution FFTW would choose, and therefore only has to be a
+ * multiple of the number of processors. The transformed
+ * matrix is stored in the frequency layout of FourStepTransform, which
+ * means it can only be combined with the four-step field backend.
+ *
+ * @tparam Traits traits class with data types and definitions
+ */
+template<typename Traits>
+class FourStepMatrixBackend
+{
+  using RF = typename Traits::RF;
+  using Index = typename Traits::Index;
+  using Indices = typename Traits::Indices;
+
+  enum
+  {
+    dim = Traits::dim
+  };
+
+  static_assert(dim == 1, "FourStepMatrixBackend requires dim == 1");
+
+  const std::shared_ptr<Traits> traits;
+
+  int rank, commSize;
+
+  Index allocLocal;
+
+  Index extendedDomainSize;
+  Indices localExtendedCells;
+  Indices localExtendedOffset;
+  Index localExtendedDomainSize;
+
+  mutable typename FFTEngine<RF>::complex* matrixData;
+
+  std::size_t peakMemory;
+
+  bool spectral;
+
+  FourStepTransform<Traits> transform;
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param traits_ traits object with parameters and communication
+   */
+  FourStepMatrixBackend(const std::shared_ptr<Traits>& traits_)
+    : traits(traits_)
+    , matrixData(nullptr)
+    , peakMemory(0)
+    , spectral(false)
+  {
+    if ((*traits).verbose && (*traits).rank == 0)
+      std::cout << "using FourStepMatrixBackend" << std::endl;
+  }
+
+  /**
+   * @brief Destructor
+   *
+   * Cleans up allocated arrays. Stores new FFTW wisdom if configured
+   * to do so.
+   */
+  ~FourStepMatrixBackend()
+  {
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::store(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
+
+    if (matrixData != nullptr) {
+      FFTEngine<RF>::free(matrixData);
+      matrixData = nullptr;
+    }
+  }
+
+  /*
+   * @brief Update internal data after creation or refinement
+   *
+   * This function has to be called after the creation of
+   * the random field object or its refinement. It updates
+   * parameters like the number of cells per dimension, and
+   * imports FFTW wisdom for the new geometry if configured to do so.
+   */
+  void update()
+  {
+    rank = (*traits).rank;
+    commSize = (*traits).commSize;
+
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::load(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
+
+    extendedDomainSize = (*traits).extendedDomainSize;
+    transform.update(
+      (*traits).comm,
+      (*traits).extendedCells[0],
+      (*traits).config.template get<bool>("fftw.forceFourStep", false));
+    allocLocal = transform.localAllocSize();
+    reset();
+
+    peakMemory = 0;
+
+    if (matrixData != nullptr) {
+      FFTEngine<RF>::free(matrixData);
+      matrixData = nullptr;
+    }
+  }
+
+  /**
+   * @brief Check whether matrix has already been created
+   *
+   * @return true if the matrix data is present, else false
+   */
+  bool valid() const { return (matrixData != nullptr); }
+
+  /**
+   * @brief Number of matrix entries stored on this processor
+   *
+   * This is the local block of the extended domain before the transform,
+   * and the local part of the frequency layout afterwards.
+   *
+   * @return number of local degrees of freedom
+   */
+  Index localMatrixSize() const { return localExtendedDomainSize; }
+
+  /**
+   * @brief Number of entries per dim on this processor
+   *
+   * @return tuple of local cells per dimension
+   */
+  const Indices& localMatrixCells() const { return localExtendedCells; }
+
+  /**
+   * @brief Offset between local indices and global indices per dim
+   *
+   * @return tuple of offsets
+   */
+  const Indices& localMatrixOffset() const { return localExtendedOffset; }
+
+  /**
+   * @brief Number of logical entries per dim on this processor
+   *
+   * For the given backend, this is identical with localMatrixCells.
+   *
+   * @return tuple of local cells per dimension
+   */
+  const Indices& localEvalMatrixCells() const { return localExtendedCells; }
+
+  /**
+   * @brief Reserve memory before storing any matrix entries
+   *
+   * Explicitly request the matrix backend to reserve storage for the
+   * array. This ensures that the backend doesn't waste memory when it
+   * won't be used.
+   */
+  void allocate()
+  {
+    if (matrixData == nullptr) {
+      matrixData = FFTEngine<RF>::alloc_complex(allocLocal);
+      peakMemory = std::max(
+        peakMemory, allocLocal * sizeof(typename FFTEngine<RF>::complex));
+    }
+  }
+
+  /**
+   * @brief Largest amount of memory used for matrix data
+   *
+   * This includes the scratch space of the transform.
+   *
+   * @return memory in bytes on this processor
+   */
+  std::size_t peakMemoryUsage() const { return peakMemory; }
+
+  /**
+   * @brief Number of values in the local array, including padding
+   *
+   * @return number of local values of type RF
+   */
+  Index localStorageSize() const { return 2 * allocLocal; }
+
+  /**
+   * @brief Raw access to the local array
+   *
+   * @return pointer to the local array
+   */
+  RF* rawData() const { return (RF*)matrixData; }
+
+  /**
+   * @brief Switch between original layout and frequency layout
+   *
+   * The two layouts have different local sizes if the factors of the
+   * four-step transform aren't multiples of the number of processors.
+   */
+  void transposeIfNeeded()
+  {
+    spectral = !spectral;
+    localExtendedCells[0] =
+      spectral ? transform.localSpectralSize() : transform.localSpatialSize();
+    localExtendedDomainSize = localExtendedCells[0];
+  }
+
+  /**
+   * @brief Switch to frequency space without transforming the data
+   */
+  void markTransformed() { transposeIfNeeded(); }
+
+  /**
+   * @brief Switch back to original domain without transforming the data
+   */
+  void reset()
+  {
+    spectral = false;
+    localExtendedCells[0] = transform.localSpatialSize();
+    localExtendedOffset[0] = rank * localExtendedCells[0];
+    localExtendedDomainSize = localExtendedCells[0];
+  }
+
+  /**
+   * @brief Multiply all stored entries with given factor
+   *
+   * @param factor scale factor, e.g., ratio of new and old variance
+   */
+  void scale(RF factor)
+  {
+    for (Index i = 0; i < allocLocal; i++) {
+      matrixData[i][0] *= factor;
+      matrixData[i][1] *= factor;
+    }
+  }
+
+  /**
+   * @brief Transform into Fourier (i.e., frequency) space
+   *
+   * Perform a forward Fourier transform, mapping from the original
+   * domain to the frequency domain, using the four-step transform.
+   */
+  void forwardTransform()
+  {
+    transform.forward(matrixData, plannerFlags(*traits));
+    peakMemory = std::max(
+      peakMemory, 2 * allocLocal * sizeof(typename FFTEngine<RF>::complex));
+
+    for (Index i = 0; i < allocLocal; i++) {
+      matrixData[i][0] /= extendedDomainSize;
+      matrixData[i][1] /= extendedDomainSize;
+    }
+
+    transposeIfNeeded();
+  }
+
+  /**
+   * @brief Transform several matrices into Fourier space
+   *
+   * Equivalent to calling forwardTransform on each of the backends. The
+   * four-step transform plans onedimensional transforms only, so there
+   * is little to be gained from batching them.
+   *
+   * @param backends backends containing the untransformed matrices
+   */
+  static void forwardTransform(
+    const std::vector<FourStepMatrixBackend*>& backends)
+  {
+    for (FourStepMatrixBackend* backend : backends)
+      backend->forwardTransform();
+  }
+
+  /**
+   * @brief Transform from Fourier (i.e., frequency) space
+   *
+   * Perform a backward Fourier transform, mapping from the frequency
+   * domain back to the original domain.
+   */
+  void backwardTransform()
+  {
+    transposeIfNeeded();
+
+    transform.backward(matrixData, plannerFlags(*traits));
+  }
+
+  /**
+   * @brief Evaluate matrix entry (in virtual, i.e., logical indices)
+   *
+   * @param index flat index for the local array
+   *
+   * @return value associated with index
+   */
+  RF eval(Index index) const { return get(index); }
+
+  /**
+   * @brief Evaluate matrix entry (in virtual, i.e., logical indices)
+   *
+   * @param indices tuple of local indices
+   *
+   * @return value associated with indices
+   */
+  RF eval(Indices indices) const { return eval(indices[0]); }
+
+  /**
+   * @brief Per-dimension contributions to storage index of matrix entries
+   *
+   * The storage index is the local index itself for this backend.
+   *
+   * @param cells local cells per dimension that should be tabulated
+   *
+   * @return table of index contributions, one per dimension
+   */
+  std::array<std::vector<Index>, dim> evalOffsets(const Indices& cells) const
+  {
+    std::array<std::vector<Index>, dim> offsets;
+    offsets[0].resize(cells[0]);
+    for (Index j = 0; j < cells[0]; j++)
+      offsets[0][j] = j;
+
+    return offsets;
+  }
+
+  /**
+   * @brief Evaluate matrix entry (using the storage index)
+   *
+   * @param index storage index, as assembled from evalOffsets
+   *
+   * @return value associated with index
+   */
+  RF evalStored(Index index) const { return matrixData[index][0]; }
+
+  /**
+   * @brief Get matrix entry (using the actual index)
+   *
+   * @param index flat index for the local array
+   *
+   * @return value associated with index
+   */
+  RF get(Index index) const { return matrixData[index][0]; }
+
+  /**
+   * @brief Set matrix entry (using the actual index)
+   *
+   * The argument is used for the real part, and the imaginary part is
+   * set zero.
+   *
+   * @param index flat index for the local array
+   * @param value value that should be associated with the index
+   */
+  void set(Index index, RF value)
+  {
+    matrixData[index][0] = value;
+    matrixData[index][1] = 0.;
+  }
+
+  /**
+   * @brief Dummy function, nothing to do after Fourier transform
+   */
+  void finalize()
+  {
+    // nothing to do
+  }
+};
+
+} // namespace parafields
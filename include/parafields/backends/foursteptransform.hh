@@ -0,0 +1,542 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+namespace parafields {
+
+/**
+ * @brief Distributed onedimensional Fourier transform in four steps
+ *
+ * The onedimensional transforms of FFTW-MPI require that the number of
+ * cells is a multiple of the square of the number of processors. This
+ * class instead splits the length N into N = N1 * N2, with N1 close to the
+ * square root of N, and interprets the array as N2 rows of N1 entries.
+ * With n = n1 + N1 * n2 and k = k2 + N2 * k1, the forward transform
+ *
+ *   X[k] = sum_n1 W_N1^(n1 k1) W_N^(n1 k2) sum_n2 W_N2^(n2 k2) x[n]
+ *
+ * is computed by redistributing the columns, transforming the columns,
+ * applying the twiddle factors, redistributing the rows of the result, and
+ * transforming the rows. The data is exchanged using MPI_Alltoallv, which
+ * means the original array only has to be split into equal blocks, i.e.,
+ * the number of cells only has to be a multiple of the number of
+ * processors, and the columns and rows are distributed as evenly as
+ * possible. The final transpose back into natural order is skipped, since
+ * matrix and field backends only need to agree on the layout of the
+ * frequency domain. Each processor stores a contiguous range of k2, and
+ * all k1 for each of them, with k1 running fastest. The backward transform
+ * maps this layout back to the original one. A single processor uses one
+ * plain FFTW transform instead, with frequencies in natural order, unless
+ * the factorization is forced, which is mainly meant for testing.
+ *
+ * @tparam Traits traits class with data types and definitions
+ */
+template<typename Traits>
+class FourStepTransform
+{
+  using RF = typename Traits::RF;
+  using Index = typename Traits::Index;
+  using Complex = typename FFTEngine<RF>::complex;
+  using IODim = typename FFTEngine<RF>::iodim;
+
+  MPI_Comm comm;
+  int rank, commSize;
+
+  bool fourStep;
+  Index cells, n1, n2;
+  Index localSize, localStart;
+  std::vector<Index> columnStart, rowStart;
+
+  std::vector<int> naturalCounts, naturalDispls;
+  std::vector<int> columnCounts, columnDispls;
+  std::vector<int> sendColumnCounts, sendColumnDispls;
+  std::vector<int> spectralCounts, spectralDispls;
+
+public:
+  /**
+   * @brief Set up factorization and data exchange
+   *
+   * This function has to be called after the creation of the backend
+   * using it, or after any change of the extended domain.
+   *
+   * @param comm_  MPI communicator of the random field
+   * @param cells_ number of cells of extended domain
+   * @param force  use factorization even on a single processor
+   */
+  void update(MPI_Comm comm_, Index cells_, bool force = false)
+  {
+    comm = comm_;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &commSize);
+
+    cells = cells_;
+    if (cells % commSize != 0)
+      throw std::runtime_error{
+        "four-step transform requires number of cells divisible by numProc"
+      };
+    localSize = cells / commSize;
+    localStart = rank * localSize;
+
+    fourStep = (commSize > 1 || force);
+    n1 = fourStep ? split(cells, commSize) : 1;
+    n2 = cells / n1;
+
+    columnStart.resize(commSize + 1);
+    rowStart.resize(commSize + 1);
+    for (int i = 0; i <= commSize; i++) {
+      columnStart[i] = blockStart(n1, i);
+      rowStart[i] = blockStart(n2, i);
+    }
+
+    // natural blocks and columns, counted by walking the blocks
+    naturalCounts.assign(commSize, 0);
+    columnCounts.assign(commSize, 0);
+    for (int i = 0; i < commSize; i++) {
+      forEachInBlock(localStart,
+                     columnStart[i],
+                     columnStart[i + 1],
+                     [&](Index, Index) { naturalCounts[i]++; });
+      forEachInBlock(i * localSize,
+                     columnStart[rank],
+                     columnStart[rank + 1],
+                     [&](Index, Index) { columnCounts[i]++; });
+    }
+
+    // columns and rows of the spectrum, full blocks in both directions
+    sendColumnCounts.assign(commSize, 0);
+    spectralCounts.assign(commSize, 0);
+    for (int i = 0; i < commSize; i++) {
+      sendColumnCounts[i] = localColumns() * (rowStart[i + 1] - rowStart[i]);
+      spectralCounts[i] = (columnStart[i + 1] - columnStart[i]) * localRows();
+    }
+
+    naturalDispls = displacements(naturalCounts);
+    columnDispls = displacements(columnCounts);
+    sendColumnDispls = displacements(sendColumnCounts);
+    spectralDispls = displacements(spectralCounts);
+  }
+
+  /**
+   * @brief Number of local entries in original layout
+   *
+   * @return local size of equal blocks
+   */
+  Index localSpatialSize() const { return localSize; }
+
+  /**
+   * @brief Number of local entries in frequency layout
+   *
+   * @return local number of k2 values times N1
+   */
+  Index localSpectralSize() const { return localRows() * n1; }
+
+  /**
+   * @brief Frequency of an entry in frequency layout
+   *
+   * @param index local index in frequency layout
+   *
+   * @return global frequency k = k2 + N2 * k1
+   */
+  Index frequency(Index index) const
+  {
+    return rowStart[rank] + index / n1 + n2 * (index % n1);
+  }
+
+  /**
+   * @brief Number of complex entries the local array has to hold
+   *
+   * This is the maximum over the original layout, the intermediate
+   * column layout, and the frequency layout.
+   *
+   * @return required size of local array
+   */
+  Index localAllocSize() const
+  {
+    return std::max({ localSize, localColumns() * n2, localSpectralSize() });
+  }
+
+  /**
+   * @brief Transform from original layout to frequency layout
+   *
+   * @param data  local array, overwritten with result
+   * @param flags FFTW planner flags
+   */
+  void forward(Complex* data, unsigned int flags) const
+  {
+    if (!fourStep) {
+      transformLines(data, cells, 1, FFTW_FORWARD, flags);
+      return;
+    }
+
+    std::vector<RF> storage(2 * localAllocSize());
+    Complex* buffer = (Complex*)storage.data();
+    toColumns(data, buffer);
+    transformLines(data, n2, localColumns(), FFTW_FORWARD, flags);
+    twiddle(data, -1);
+    toSpectrum(data, buffer);
+    transformLines(data, n1, localRows(), FFTW_FORWARD, flags);
+  }
+
+  /**
+   * @brief Transform from frequency layout to original layout
+   *
+   * @param data  local array, overwritten with result
+   * @param flags FFTW planner flags
+   */
+  void backward(Complex* data, unsigned int flags) const
+  {
+    if (!fourStep) {
+      transformLines(data, cells, 1, FFTW_BACKWARD, flags);
+      return;
+    }
+
+    std::vector<RF> storage(2 * localAllocSize());
+    Complex* buffer = (Complex*)storage.data();
+    transformLines(data, n1, localRows(), FFTW_BACKWARD, flags);
+    fromSpectrum(data, buffer);
+    twiddle(data, 1);
+    transformLines(data, n2, localColumns(), FFTW_BACKWARD, flags);
+    fromColumns(data, buffer);
+  }
+
+private:
+  //! @brief Number of local columns in intermediate layout
+  Index localColumns() const
+  {
+    return columnStart[rank + 1] - columnStart[rank];
+  }
+
+  //! @brief Number of local k2 values in frequency layout
+  Index localRows() const { return rowStart[rank + 1] - rowStart[rank]; }
+
+  /**
+   * @brief First index of given processor when distributing evenly
+   *
+   * @param size total number of indices
+   * @param i    rank of processor, or number of processors for the end
+   *
+   * @return first index
+   */
+  Index blockStart(Index size, int i) const
+  {
+    return i * (size / commSize) + std::min<Index>(i, size % commSize);
+  }
+
+  /**
+   * @brief Choose number of columns N1 for given length
+   *
+   * Prefers the largest divisor below the square root for which both
+   * factors are multiples of the number of processors, since then all
+   * processors get the same share of each step, and else the largest
+   * divisor below the square root.
+   *
+   * @param cells    length of transform
+   * @param commSize number of processors
+   *
+   * @return number of columns
+   */
+  static Index split(Index cells, int commSize)
+  {
+    Index best = 1;
+    bool bestBalanced = false;
+    for (std::uint64_t d = 1; d * d <= cells; d++) {
+      if (cells % d != 0)
+        continue;
+
+      const bool balanced = (d % commSize == 0 && (cells / d) % commSize == 0);
+      if (balanced || !bestBalanced) {
+        best = d;
+        bestBalanced = balanced;
+      }
+    }
+    return best;
+  }
+
+  /**
+   * @brief Exclusive prefix sum of exchange counts
+   */
+  static std::vector<int> displacements(const std::vector<int>& counts)
+  {
+    std::vector<int> displs(counts.size(), 0);
+    for (std::size_t i = 1; i < counts.size(); i++)
+      displs[i] = displs[i - 1] + counts[i - 1];
+    return displs;
+  }
+
+  /**
+   * @brief Visit entries of a block of the original layout in given columns
+   *
+   * Visits the entries of the block of length localSize starting at the
+   * given position whose column n1 lies in the given range, in natural
+   * order, passing column n1 and row n2 to the function.
+   *
+   * @param start    first index of block
+   * @param first    first column of range
+   * @param last     end of column range
+   * @param function function receiving column and row
+   */
+  template<typename Function>
+  void forEachInBlock(Index start,
+                      Index first,
+                      Index last,
+                      Function&& function) const
+  {
+    if (first >= last)
+      return;
+
+    const std::uint64_t end = std::uint64_t(start) + localSize;
+    for (std::uint64_t row = start / n1; row * n1 < end; row++) {
+      const std::uint64_t rowBegin = row * n1;
+      const Index from = std::max<std::uint64_t>(
+        first, start > rowBegin ? start - rowBegin : 0);
+      const Index to = std::min<std::uint64_t>(last, end - rowBegin);
+      for (Index column = from; column < to; column++)
+        function(column, Index(row));
+    }
+  }
+
+  /**
+   * @brief Move data from equal blocks to local columns
+   *
+   * Afterwards, column n1 is stored contiguously at offset (n1 - first
+   * local column) * N2.
+   */
+  void toColumns(Complex* data, Complex* buffer) const
+  {
+    Index pos = 0;
+    for (int i = 0; i < commSize; i++)
+      forEachInBlock(localStart,
+                     columnStart[i],
+                     columnStart[i + 1],
+                     [&](Index column, Index row) {
+                       copy(data[column + n1 * row - localStart],
+                            buffer[pos++]);
+                     });
+
+    exchange(buffer, naturalCounts, naturalDispls, data, columnCounts,
+             columnDispls);
+    copy(data, localColumns() * n2, buffer);
+
+    pos = 0;
+    for (int i = 0; i < commSize; i++)
+      forEachInBlock(i * localSize,
+                     columnStart[rank],
+                     columnStart[rank + 1],
+                     [&](Index column, Index row) {
+                       copy(buffer[pos++],
+                            data[(column - columnStart[rank]) * n2 + row]);
+                     });
+  }
+
+  /**
+   * @brief Move data from local columns back to equal blocks
+   */
+  void fromColumns(Complex* data, Complex* buffer) const
+  {
+    Index pos = 0;
+    for (int i = 0; i < commSize; i++)
+      forEachInBlock(i * localSize,
+                     columnStart[rank],
+                     columnStart[rank + 1],
+                     [&](Index column, Index row) {
+                       copy(data[(column - columnStart[rank]) * n2 + row],
+                            buffer[pos++]);
+                     });
+
+    exchange(buffer, columnCounts, columnDispls, data, naturalCounts,
+             naturalDispls);
+    copy(data, localSize, buffer);
+
+    pos = 0;
+    for (int i = 0; i < commSize; i++)
+      forEachInBlock(localStart,
+                     columnStart[i],
+                     columnStart[i + 1],
+                     [&](Index column, Index row) {
+                       copy(buffer[pos++],
+                            data[column + n1 * row - localStart]);
+                     });
+  }
+
+  /**
+   * @brief Move data from local columns to local rows of the spectrum
+   *
+   * Afterwards, all values for local k2 are stored contiguously at offset
+   * (k2 - first local k2) * N1.
+   */
+  void toSpectrum(Complex* data, Complex* buffer) const
+  {
+    Index pos = 0;
+    for (int i = 0; i < commSize; i++)
+      for (Index column = 0; column < localColumns(); column++)
+        for (Index row = rowStart[i]; row < rowStart[i + 1]; row++)
+          copy(data[column * n2 + row], buffer[pos++]);
+
+    exchange(buffer, sendColumnCounts, sendColumnDispls, data,
+             spectralCounts, spectralDispls);
+    copy(data, localSpectralSize(), buffer);
+
+    pos = 0;
+    for (int i = 0; i < commSize; i++)
+      for (Index column = columnStart[i]; column < columnStart[i + 1];
+           column++)
+        for (Index row = 0; row < localRows(); row++)
+          copy(buffer[pos++], data[row * n1 + column]);
+  }
+
+  /**
+   * @brief Move data from local rows of the spectrum back to local columns
+   */
+  void fromSpectrum(Complex* data, Complex* buffer) const
+  {
+    Index pos = 0;
+    for (int i = 0; i < commSize; i++)
+      for (Index column = columnStart[i]; column < columnStart[i + 1];
+           column++)
+        for (Index row = 0; row < localRows(); row++)
+          copy(data[row * n1 + column], buffer[pos++]);
+
+    exchange(buffer, spectralCounts, spectralDispls, data,
+             sendColumnCounts, sendColumnDispls);
+    copy(data, localColumns() * n2, buffer);
+
+    pos = 0;
+    for (int i = 0; i < commSize; i++)
+      for (Index column = 0; column < localColumns(); column++)
+        for (Index row = rowStart[i]; row < rowStart[i + 1]; row++)
+          copy(buffer[pos++], data[column * n2 + row]);
+  }
+
+  /**
+   * @brief Multiply local columns with twiddle factors W_N^(n1 k2)
+   *
+   * The factors are assembled from two tables of length sqrt(N2) per
+   * column, which avoids both a table of the size of the local array
+   * and the accumulation of rounding errors in recurrences.
+   *
+   * @param data local array in column layout
+   * @param sign -1 for forward transform, 1 for backward transform
+   */
+  void twiddle(Complex* data, int sign) const
+  {
+    const Index coarse = std::ceil(std::sqrt(RF(n2)));
+    std::vector<std::complex<RF>> coarseRoots(n2 / coarse + 1);
+    std::vector<std::complex<RF>> fineRoots(coarse);
+
+    for (Index column = 0; column < localColumns(); column++) {
+      const std::uint64_t n = columnStart[rank] + column;
+      for (Index i = 0; i < coarseRoots.size(); i++)
+        coarseRoots[i] = root(n * i * coarse, sign);
+      for (Index i = 0; i < coarse; i++)
+        fineRoots[i] = root(n * i, sign);
+
+      Complex* line = data + column * n2;
+      for (Index k = 0; k < n2; k++) {
+        const std::complex<RF> factor =
+          coarseRoots[k / coarse] * fineRoots[k % coarse];
+        const RF re = line[k][0];
+        line[k][0] = re * factor.real() - line[k][1] * factor.imag();
+        line[k][1] = re * factor.imag() + line[k][1] * factor.real();
+      }
+    }
+  }
+
+  /**
+   * @brief Root of unity exp(sign * 2 pi i * exponent / N)
+   */
+  std::complex<RF> root(std::uint64_t exponent, int sign) const
+  {
+    const RF angle =
+      sign * 2 * std::acos(RF(-1)) * RF(exponent % cells) / RF(cells);
+    return std::polar(RF(1), angle);
+  }
+
+  /**
+   * @brief Contiguous onedimensional transforms of given length
+   *
+   * @param data    local array
+   * @param length  length of each transform
+   * @param howmany number of transforms
+   * @param sign    FFTW_FORWARD or FFTW_BACKWARD
+   * @param flags   FFTW planner flags
+   */
+  static void transformLines(Complex* data,
+                             Index length,
+                             Index howmany,
+                             int sign,
+                             unsigned int flags)
+  {
+    if (howmany == 0 || length == 1)
+      return;
+
+    IODim line;
+    line.n = length;
+    line.is = 1;
+    line.os = 1;
+
+    IODim loop;
+    loop.n = howmany;
+    loop.is = length;
+    loop.os = length;
+
+    typename FFTEngine<RF>::plan plan =
+      createPlan((RF*)data, 2 * length * howmany, flags, [&] {
+        return FFTEngine<RF>::plan_guru64_dft(
+          1, &line, 1, &loop, data, data, sign, flags);
+      });
+    if (plan == nullptr)
+      throw std::runtime_error{ "parafields failed to create four-step plan" };
+
+    FFTEngine<RF>::execute(plan);
+    destroyPlan<RF>(plan);
+  }
+
+  /**
+   * @brief All-to-all exchange of complex values
+   *
+   * Counts and displacements refer to complex values, which keeps them
+   * within the range of int for twice as many entries.
+   */
+  void exchange(const Complex* send,
+                const std::vector<int>& sendCounts,
+                const std::vector<int>& sendDispls,
+                Complex* recv,
+                const std::vector<int>& recvCounts,
+                const std::vector<int>& recvDispls) const
+  {
+    MPI_Datatype complexType;
+    MPI_Type_contiguous(2, mpiType<RF>, &complexType);
+    MPI_Type_commit(&complexType);
+
+    MPI_Alltoallv(send,
+                  sendCounts.data(),
+                  sendDispls.data(),
+                  complexType,
+                  recv,
+                  recvCounts.data(),
+                  recvDispls.data(),
+                  complexType,
+                  comm);
+
+    MPI_Type_free(&complexType);
+  }
+
+  //! @brief Copy complex value
+  static void copy(const Complex& from, Complex& to)
+  {
+    to[0] = from[0];
+    to[1] = from[1];
+  }
+
+  //! @brief Copy array of complex values
+  static void copy(const Complex* from, Index count, Complex* to)
+  {
+    std::copy((const RF*)from, (const RF*)(from + count), (RF*)to);
+  }
+};
+
+} // namespace parafields
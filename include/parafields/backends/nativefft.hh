@@ -0,0 +1,926 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace parafields {
+
+/**
+ * @brief Number of threads used by subsequently created native plans
+ *
+ * @return reference to thread count, shared by all precisions
+ */
+inline int&
+nativeFFTThreads()
+{
+  static int threads = 1;
+  return threads;
+}
+
+/**
+ * @brief Onedimensional complex DFT of fixed length and sign
+ *
+ * Recursive mixed-radix decimation in time. Lengths are split into
+ * their prime factors, with a dedicated butterfly for radix 2 and a
+ * generic one for other factors, so that lengths with factors 2, 3 and
+ * 5 (the typical sizes of extended domains) are fast, while large prime
+ * factors lead to quadratic cost.
+ *
+ * @tparam RF data type of transformed values
+ */
+template<typename RF>
+class NativeDFT
+{
+  using Complex = std::complex<RF>;
+
+  std::size_t n;
+  std::size_t maxFactor;
+  std::vector<std::size_t> factors;
+  std::vector<Complex> twiddles;
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param n_   length of transform
+   * @param sign FFTW_FORWARD (-1) or FFTW_BACKWARD (+1)
+   */
+  NativeDFT(std::size_t n_, int sign)
+    : n(n_)
+    , maxFactor(1)
+    , twiddles(n_)
+  {
+    std::size_t rest = n;
+    for (std::size_t p = 2; p * p <= rest; p++)
+      while (rest % p == 0) {
+        factors.push_back(p);
+        rest /= p;
+      }
+    if (rest > 1)
+      factors.push_back(rest);
+    for (std::size_t p : factors)
+      maxFactor = std::max(maxFactor, p);
+
+    const long double pi = std::acos(-1.L);
+    for (std::size_t j = 0; j < n; j++) {
+      const long double angle = sign * 2 * pi * j / n;
+      twiddles[j] = Complex(std::cos(angle), std::sin(angle));
+    }
+  }
+
+  /**
+   * @brief Length of the transform
+   *
+   * @return number of entries
+   */
+  std::size_t size() const { return n; }
+
+  /**
+   * @brief Transform contiguous line in place
+   *
+   * @param data    line of n values
+   * @param scratch workspace, resized as needed
+   */
+  void apply(Complex* data, std::vector<Complex>& scratch) const
+  {
+    if (n < 2)
+      return;
+
+    scratch.resize(n + maxFactor);
+    std::copy(data, data + n, scratch.begin());
+    transform(scratch.data(), data, n, 1, 0, scratch.data() + n);
+  }
+
+private:
+  /**
+   * @brief Transform strided input into contiguous output
+   *
+   * @param in     first input entry
+   * @param out    contiguous output of given length
+   * @param length length of this subtransform
+   * @param stride distance between input entries
+   * @param f      index of factor used at this level
+   * @param values workspace for one butterfly
+   */
+  void transform(const Complex* in,
+                 Complex* out,
+                 std::size_t length,
+                 std::size_t stride,
+                 std::size_t f,
+                 Complex* values) const
+  {
+    const std::size_t p = factors[f];
+    const std::size_t m = length / p;
+    const std::size_t step = n / length;
+
+    if (m > 1)
+      for (std::size_t q = 0; q < p; q++)
+        transform(in + q * stride, out + q * m, m, stride * p, f + 1, values);
+    else
+      for (std::size_t q = 0; q < p; q++)
+        out[q] = in[q * stride];
+
+    if (p == 2) {
+      for (std::size_t k = 0; k < m; k++) {
+        const Complex a = out[k];
+        const Complex b = out[k + m] * twiddles[k * step];
+        out[k] = a + b;
+        out[k + m] = a - b;
+      }
+      return;
+    }
+
+    const std::size_t root = n / p;
+    for (std::size_t k = 0; k < m; k++) {
+      for (std::size_t q = 0; q < p; q++)
+        values[q] = out[q * m + k] * twiddles[q * k * step];
+
+      for (std::size_t r = 0; r < p; r++) {
+        Complex sum = values[0];
+        for (std::size_t q = 1; q < p; q++)
+          sum += values[q] * twiddles[(q * r % p) * root];
+        out[k + r * m] = sum;
+      }
+    }
+  }
+};
+
+/**
+ * @brief Dimension of native transform, same layout as fftw_iodim64
+ */
+struct NativeIODim
+{
+  ptrdiff_t n;
+  ptrdiff_t is;
+  ptrdiff_t os;
+};
+
+/**
+ * @brief Plan of the native FFT engine
+ *
+ * A plan describes a (multidimensional) transform of a set of arrays,
+ * like the guru interface of FFTW: a list of transform dimensions and a
+ * list of loop dimensions, each with input and output strides. Strides
+ * refer to complex entries for complex arrays and to real entries for
+ * real arrays. Execution gathers the input into a contiguous work array,
+ * transforms it one dimension at a time, and scatters the result, which
+ * makes in-place and out-of-place transforms equally safe at the cost of
+ * a temporary copy of the data.
+ *
+ * @tparam RF data type of transformed values
+ */
+template<typename RF>
+class NativePlan
+{
+  using Complex = std::complex<RF>;
+
+public:
+  enum Kind
+  {
+    c2c,
+    r2c,
+    c2r,
+    r2r
+  };
+
+private:
+  Kind kind;
+  int threads;
+  RF* in;
+  RF* out;
+
+  std::vector<ptrdiff_t> loopCells, loopInStrides, loopOutStrides;
+  std::vector<ptrdiff_t> cells, inStrides, outStrides;
+  std::vector<ptrdiff_t> outCells, workStrides;
+  std::vector<int> kinds;
+  std::vector<NativeDFT<RF>> dfts;
+
+  std::size_t loopSize, size;
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param kind_     type of transform
+   * @param dims      transform dimensions
+   * @param loops     loop dimensions
+   * @param in_       input array
+   * @param out_      output array
+   * @param sign      FFTW_FORWARD or FFTW_BACKWARD, for c2c transforms
+   * @param r2rKinds  one FFTW_REDFT00 or FFTW_RODFT00 per dim, for r2r
+   */
+  NativePlan(Kind kind_,
+             const std::vector<NativeIODim>& dims,
+             const std::vector<NativeIODim>& loops,
+             RF* in_,
+             RF* out_,
+             int sign = -1,
+             const std::vector<int>& r2rKinds = {})
+    : kind(kind_)
+    , threads(nativeFFTThreads())
+    , in(in_)
+    , out(out_)
+    , kinds(r2rKinds)
+    , loopSize(1)
+    , size(1)
+  {
+    for (const NativeIODim& loop : loops) {
+      loopCells.push_back(loop.n);
+      loopInStrides.push_back(loop.is);
+      loopOutStrides.push_back(loop.os);
+      loopSize *= loop.n;
+    }
+
+    for (const NativeIODim& dim : dims) {
+      cells.push_back(dim.n);
+      inStrides.push_back(dim.is);
+      outStrides.push_back(dim.os);
+      size *= dim.n;
+    }
+
+    // complex output of r2c transforms stores half of last dim
+    outCells = cells;
+    if (kind == r2c && !cells.empty())
+      outCells.back() = cells.back() / 2 + 1;
+
+    workStrides.resize(cells.size());
+    ptrdiff_t stride = 1;
+    for (std::size_t i = cells.size(); i-- > 0;) {
+      workStrides[i] = stride;
+      stride *= cells[i];
+    }
+
+    if (kind == r2c)
+      sign = -1;
+    else if (kind == c2r)
+      sign = 1;
+
+    for (std::size_t i = 0; i < cells.size(); i++) {
+      if (kind != r2r)
+        dfts.emplace_back(cells[i], sign);
+      else if (kinds[i] == FFTW_REDFT00)
+        dfts.emplace_back(2 * (cells[i] - 1), -1);
+      else
+        dfts.emplace_back(2 * (cells[i] + 1), -1);
+    }
+  }
+
+  /**
+   * @brief Perform the planned transform
+   */
+  void execute() const
+  {
+    std::vector<Complex> work(loopSize * size);
+
+    gather(work);
+
+    for (std::size_t i = 0; i < cells.size(); i++)
+      transformLines(work, i);
+
+    scatter(work);
+  }
+
+private:
+  /**
+   * @brief Offset of entry with given flat index in strided array
+   *
+   * @param flat    row-major index of entry
+   * @param extents number of entries per dimension
+   * @param strides distance between entries per dimension
+   *
+   * @return offset in array
+   */
+  static ptrdiff_t offset(std::size_t flat,
+                          const std::vector<ptrdiff_t>& extents,
+                          const std::vector<ptrdiff_t>& strides)
+  {
+    ptrdiff_t result = 0;
+    for (std::size_t i = extents.size(); i-- > 0;) {
+      result += (flat % extents[i]) * strides[i];
+      flat /= extents[i];
+    }
+    return result;
+  }
+
+  /**
+   * @brief Split loop over given number of items among threads
+   *
+   * @param count number of items
+   * @param func  function called with begin and end of a chunk
+   */
+  template<typename Func>
+  void parallelFor(std::size_t count, Func&& func) const
+  {
+    const std::size_t chunks =
+      std::min<std::size_t>(std::max(threads, 1), count);
+    if (chunks <= 1) {
+      func(std::size_t(0), count);
+      return;
+    }
+
+    std::vector<std::thread> workers;
+    for (std::size_t c = 1; c < chunks; c++)
+      workers.emplace_back(func, c * count / chunks, (c + 1) * count / chunks);
+    func(std::size_t(0), count / chunks);
+    for (std::thread& worker : workers)
+      worker.join();
+  }
+
+  /**
+   * @brief Copy input into contiguous work array
+   *
+   * The Hermitian input of c2r transforms is expanded to the full array.
+   *
+   * @param[out] work work array, one block per loop iteration
+   */
+  void gather(std::vector<Complex>& work) const
+  {
+    for (std::size_t l = 0; l < loopSize; l++) {
+      const ptrdiff_t base = offset(l, loopCells, loopInStrides);
+      Complex* block = work.data() + l * size;
+
+      for (std::size_t d = 0; d < size; d++) {
+        if (kind == r2c || kind == r2r) {
+          block[d] = in[base + offset(d, cells, inStrides)];
+          continue;
+        }
+
+        if (kind == c2c) {
+          const ptrdiff_t index = 2 * (base + offset(d, cells, inStrides));
+          block[d] = Complex(in[index], in[index + 1]);
+          continue;
+        }
+
+        // c2r: second half of last dim is given by symmetry
+        ptrdiff_t index = base, flat = d;
+        bool mirrored = (flat % cells.back() > cells.back() / 2);
+        for (std::size_t i = cells.size(); i-- > 0;) {
+          ptrdiff_t j = flat % cells[i];
+          if (mirrored)
+            j = (cells[i] - j) % cells[i];
+          index += j * inStrides[i];
+          flat /= cells[i];
+        }
+        const Complex value(in[2 * index], in[2 * index + 1]);
+        block[d] = mirrored ? std::conj(value) : value;
+      }
+    }
+  }
+
+  /**
+   * @brief Transform all lines of the work array along given dimension
+   *
+   * @param work work array
+   * @param dim  dimension of the lines
+   */
+  void transformLines(std::vector<Complex>& work, std::size_t dim) const
+  {
+    const std::size_t length = cells[dim];
+    const std::size_t stride = workStrides[dim];
+    const std::size_t perBlock = size / length;
+
+    parallelFor(loopSize * perBlock, [&](std::size_t begin, std::size_t end) {
+      std::vector<Complex> line(dfts[dim].size()), scratch;
+
+      for (std::size_t t = begin; t < end; t++) {
+        const std::size_t l = t / perBlock, r = t % perBlock;
+        Complex* start = work.data() + l * size +
+                         (r / stride) * length * stride + r % stride;
+
+        if (kind != r2r) {
+          for (std::size_t j = 0; j < length; j++)
+            line[j] = start[j * stride];
+          dfts[dim].apply(line.data(), scratch);
+          for (std::size_t j = 0; j < length; j++)
+            start[j * stride] = line[j];
+        } else if (kinds[dim] == FFTW_REDFT00) {
+          // DCT-I is the DFT of the even extension
+          for (std::size_t j = 0; j < length; j++)
+            line[j] = start[j * stride].real();
+          for (std::size_t j = 1; j + 1 < length; j++)
+            line[2 * (length - 1) - j] = line[j];
+          dfts[dim].apply(line.data(), scratch);
+          for (std::size_t j = 0; j < length; j++)
+            start[j * stride] = line[j].real();
+        } else {
+          // DST-I is the DFT of the odd extension
+          line[0] = line[length + 1] = 0.;
+          for (std::size_t j = 0; j < length; j++) {
+            line[j + 1] = start[j * stride].real();
+            line[2 * (length + 1) - (j + 1)] = -start[j * stride].real();
+          }
+          dfts[dim].apply(line.data(), scratch);
+          for (std::size_t j = 0; j < length; j++)
+            start[j * stride] = -line[j + 1].imag();
+        }
+      }
+    });
+  }
+
+  /**
+   * @brief Copy work array into output
+   *
+   * Only the first half of the last dim is stored for r2c transforms.
+   *
+   * @param work work array, one block per loop iteration
+   */
+  void scatter(const std::vector<Complex>& work) const
+  {
+    std::size_t outSize = 1;
+    for (ptrdiff_t n : outCells)
+      outSize *= n;
+
+    for (std::size_t l = 0; l < loopSize; l++) {
+      const ptrdiff_t base = offset(l, loopCells, loopOutStrides);
+      const Complex* block = work.data() + l * size;
+
+      for (std::size_t d = 0; d < outSize; d++) {
+        const ptrdiff_t index = base + offset(d, outCells, outStrides);
+        const Complex& value = block[offset(d, outCells, workStrides)];
+        if (kind == c2r || kind == r2r)
+          out[index] = value.real();
+        else {
+          out[2 * index] = value.real();
+          out[2 * index + 1] = value.imag();
+        }
+      }
+    }
+  }
+};
+
+/**
+ * @brief Header-only FFT engine for a single processor
+ *
+ * Implements the same interface as the FFTW wrapper, so that it can be
+ * selected as FFTEngine instead of FFTW, e.g., for benchmarking or for
+ * builds without FFTW. The parallel planners and layout queries accept
+ * communicators with a single processor only, and return the layout of
+ * FFTW-MPI for that case. Transposed layouts aren't supported, and plans
+ * requesting them aren't created. Plans use the number of threads set
+ * by plan_with_nthreads, and wisdom is meaningless for this engine.
+ *
+ * @tparam RF data type of transformed values
+ */
+template<typename RF>
+class NativeFFT
+{
+public:
+  using complex = RF[2];
+  using plan = NativePlan<RF>*;
+  using r2r_kind = int;
+  using iodim = NativeIODim;
+
+  // setup
+
+  //! @brief Nothing to initialize
+  static void mpi_init() {}
+
+  //! @brief Set number of threads for subsequently created plans
+  static void plan_with_nthreads(int threads) { nativeFFTThreads() = threads; }
+
+  // allocation and deallocation
+
+  //! @brief Allocation of storage for real numbers
+  static RF* alloc_real(ptrdiff_t size)
+  {
+    return static_cast<RF*>(std::malloc(size * sizeof(RF)));
+  }
+
+  //! @brief Allocation of storage for complex numbers
+  static complex* alloc_complex(ptrdiff_t size)
+  {
+    return static_cast<complex*>(std::malloc(size * sizeof(complex)));
+  }
+
+  //! @brief Deallocation of allocated storage
+  template<typename Ptr>
+  static void free(Ptr& ptr)
+  {
+    std::free(ptr);
+  }
+
+  // data layout queries
+
+  //!@brief Determine array length and offset in distributed dimension
+  static ptrdiff_t mpi_local_size(unsigned int dim,
+                                  const ptrdiff_t* n,
+                                  MPI_Comm comm,
+                                  ptrdiff_t* localN0,
+                                  ptrdiff_t* local0Start)
+  {
+    checkComm(comm);
+    *localN0 = n[0];
+    *local0Start = 0;
+    return product(dim, n);
+  }
+
+  //!@brief Determine array length and offset in distributed dimension, 1D case
+  static ptrdiff_t mpi_local_size_1d(const ptrdiff_t n0,
+                                     MPI_Comm comm,
+                                     int,
+                                     unsigned int,
+                                     ptrdiff_t* localN0,
+                                     ptrdiff_t* local0Start,
+                                     ptrdiff_t* localN02,
+                                     ptrdiff_t* local0Start2)
+  {
+    checkComm(comm);
+    *localN0 = *localN02 = n0;
+    *local0Start = *local0Start2 = 0;
+    return n0;
+  }
+
+  //!@brief Determine array length and offset in distributed dimension,
+  //! transposed case
+  static ptrdiff_t mpi_local_size_transposed(unsigned int dim,
+                                             const ptrdiff_t* n,
+                                             MPI_Comm comm,
+                                             ptrdiff_t* localN0,
+                                             ptrdiff_t* local0Start,
+                                             ptrdiff_t* localN0Trans,
+                                             ptrdiff_t* local0StartTrans)
+  {
+    return mpi_local_size_many_transposed(dim,
+                                          n,
+                                          1,
+                                          0,
+                                          0,
+                                          comm,
+                                          localN0,
+                                          local0Start,
+                                          localN0Trans,
+                                          local0StartTrans);
+  }
+
+  //!@brief Determine array length and offset in distributed dimension, second
+  //! transposed case
+  static ptrdiff_t mpi_local_size_many_transposed(unsigned int dim,
+                                                  const ptrdiff_t* n,
+                                                  ptrdiff_t howmany,
+                                                  ptrdiff_t,
+                                                  ptrdiff_t,
+                                                  MPI_Comm comm,
+                                                  ptrdiff_t* localN0,
+                                                  ptrdiff_t* local0Start,
+                                                  ptrdiff_t* localN0Trans,
+                                                  ptrdiff_t* local0StartTrans)
+  {
+    checkComm(comm);
+    *localN0 = n[0];
+    *local0Start = 0;
+    *localN0Trans = (dim > 1) ? n[1] : n[0];
+    *local0StartTrans = 0;
+    return howmany * product(dim, n);
+  }
+
+  // plan creation
+
+  //! @brief Generate discrete Fourier transform plan
+  static plan mpi_plan_dft(unsigned int dim,
+                           const ptrdiff_t* n,
+                           complex* data1,
+                           complex* data2,
+                           MPI_Comm comm,
+                           int direction,
+                           unsigned int flags)
+  {
+    return mpi_plan_many_dft(
+      dim, n, 1, 0, 0, data1, data2, comm, direction, flags);
+  }
+
+  //! @brief Generate real-to-complex discrete Fourier transform plan
+  static plan mpi_plan_dft_r2c(unsigned int dim,
+                               const ptrdiff_t* n,
+                               RF* data1,
+                               complex* data2,
+                               MPI_Comm comm,
+                               unsigned int flags)
+  {
+    return mpi_plan_many_dft_r2c(dim, n, 1, 0, 0, data1, data2, comm, flags);
+  }
+
+  //! @brief Generate complex-to-real discrete Fourier transform plan
+  static plan mpi_plan_dft_c2r(unsigned int dim,
+                               const ptrdiff_t* n,
+                               complex* data1,
+                               RF* data2,
+                               MPI_Comm comm,
+                               unsigned int flags)
+  {
+    checkComm(comm);
+    if (transposedLayout(flags))
+      return nullptr;
+
+    const ptrdiff_t half = n[dim - 1] / 2 + 1;
+    return new NativePlan<RF>(NativePlan<RF>::c2r,
+                              layout(dim, n, 1, half, 2 * half),
+                              {},
+                              (RF*)data1,
+                              data2);
+  }
+
+  //! @brief Generate discrete cosine / sine transform plan
+  static plan mpi_plan_r2r(unsigned int dim,
+                           const ptrdiff_t* n,
+                           RF* data1,
+                           RF* data2,
+                           MPI_Comm comm,
+                           r2r_kind* kinds,
+                           unsigned int flags)
+  {
+    return mpi_plan_many_r2r(
+      dim, n, 1, 0, 0, data1, data2, comm, kinds, flags);
+  }
+
+  //! @brief Generate discrete cosine / sine transform plan, second version
+  static plan mpi_plan_many_r2r(unsigned int dim,
+                                const ptrdiff_t* n,
+                                ptrdiff_t howmany,
+                                ptrdiff_t,
+                                ptrdiff_t,
+                                RF* data1,
+                                RF* data2,
+                                MPI_Comm comm,
+                                r2r_kind* kinds,
+                                unsigned int flags)
+  {
+    checkComm(comm);
+    if (transposedLayout(flags) || !supported(dim, n, kinds))
+      return nullptr;
+
+    return new NativePlan<RF>(NativePlan<RF>::r2r,
+                              layout(dim, n, howmany, n[dim - 1], n[dim - 1]),
+                              loop(howmany),
+                              data1,
+                              data2,
+                              -1,
+                              std::vector<int>(kinds, kinds + dim));
+  }
+
+  //! @brief Generate sequential one-dimensional discrete cosine / sine
+  //! transform plan
+  static plan plan_r2r_1d(int n,
+                          RF* data1,
+                          RF* data2,
+                          r2r_kind kind,
+                          unsigned int)
+  {
+    const ptrdiff_t cells = n;
+    if (!supported(1, &cells, &kind))
+      return nullptr;
+
+    return new NativePlan<RF>(
+      NativePlan<RF>::r2r, { { n, 1, 1 } }, {}, data1, data2, -1, { kind });
+  }
+
+  //! @brief Generate discrete Fourier transform plan, second version
+  static plan mpi_plan_many_dft(unsigned int dim,
+                                const ptrdiff_t* n,
+                                ptrdiff_t howmany,
+                                ptrdiff_t,
+                                ptrdiff_t,
+                                complex* data1,
+                                complex* data2,
+                                MPI_Comm comm,
+                                int direction,
+                                unsigned int flags)
+  {
+    checkComm(comm);
+    if (transposedLayout(flags))
+      return nullptr;
+
+    return new NativePlan<RF>(NativePlan<RF>::c2c,
+                              layout(dim, n, howmany, n[dim - 1], n[dim - 1]),
+                              loop(howmany),
+                              (RF*)data1,
+                              (RF*)data2,
+                              direction);
+  }
+
+  //! @brief Generate real-to-complex discrete Fourier transform plan, second
+  //! version
+  static plan mpi_plan_many_dft_r2c(unsigned int dim,
+                                    const ptrdiff_t* n,
+                                    ptrdiff_t howmany,
+                                    ptrdiff_t,
+                                    ptrdiff_t,
+                                    RF* data1,
+                                    complex* data2,
+                                    MPI_Comm comm,
+                                    unsigned int flags)
+  {
+    checkComm(comm);
+    if (transposedLayout(flags))
+      return nullptr;
+
+    // real array is padded like the complex one, as in FFTW-MPI
+    const ptrdiff_t half = n[dim - 1] / 2 + 1;
+    return new NativePlan<RF>(NativePlan<RF>::r2c,
+                              layout(dim, n, howmany, 2 * half, half),
+                              loop(howmany),
+                              data1,
+                              (RF*)data2);
+  }
+
+  //! @brief Generate one-dimensional discrete Fourier transform plan for
+  //! strided lines
+  static plan plan_guru64_dft(int rank,
+                              const iodim* dims,
+                              int howmanyRank,
+                              const iodim* howmanyDims,
+                              complex* data1,
+                              complex* data2,
+                              int direction,
+                              unsigned int)
+  {
+    return new NativePlan<RF>(NativePlan<RF>::c2c,
+                              { dims, dims + rank },
+                              { howmanyDims, howmanyDims + howmanyRank },
+                              (RF*)data1,
+                              (RF*)data2,
+                              direction);
+  }
+
+  //! @brief Generate one-dimensional real-to-complex discrete Fourier
+  //! transform plan for strided lines
+  static plan plan_guru64_dft_r2c(int rank,
+                                  const iodim* dims,
+                                  int howmanyRank,
+                                  const iodim* howmanyDims,
+                                  RF* data1,
+                                  complex* data2,
+                                  unsigned int)
+  {
+    return new NativePlan<RF>(NativePlan<RF>::r2c,
+                              { dims, dims + rank },
+                              { howmanyDims, howmanyDims + howmanyRank },
+                              data1,
+                              (RF*)data2);
+  }
+
+  //! @brief Generate one-dimensional complex-to-real discrete Fourier
+  //! transform plan for strided lines
+  static plan plan_guru64_dft_c2r(int rank,
+                                  const iodim* dims,
+                                  int howmanyRank,
+                                  const iodim* howmanyDims,
+                                  complex* data1,
+                                  RF* data2,
+                                  unsigned int)
+  {
+    return new NativePlan<RF>(NativePlan<RF>::c2r,
+                              { dims, dims + rank },
+                              { howmanyDims, howmanyDims + howmanyRank },
+                              (RF*)data1,
+                              data2);
+  }
+
+  //! @brief Generate plan for transpose of distributed matrix
+  static plan mpi_plan_many_transpose(ptrdiff_t n0,
+                                      ptrdiff_t n1,
+                                      ptrdiff_t howmany,
+                                      ptrdiff_t,
+                                      ptrdiff_t,
+                                      RF* data1,
+                                      RF* data2,
+                                      MPI_Comm comm,
+                                      unsigned int)
+  {
+    checkComm(comm);
+
+    // rank zero transform with strides, i.e., a plain transpose
+    return new NativePlan<RF>(NativePlan<RF>::r2r,
+                              {},
+                              { { n0, n1 * howmany, howmany },
+                                { n1, howmany, n0 * howmany },
+                                { howmany, 1, 1 } },
+                              data1,
+                              data2);
+  }
+
+  // plan execution and destruction
+
+  //! @brief Perform discrete transform
+  static void execute(plan& p) { p->execute(); }
+
+  //! @brief Clean up generated plan
+  static void destroy_plan(plan& p)
+  {
+    delete p;
+    p = nullptr;
+  }
+
+  // wisdom storage, not applicable
+
+  //! @brief Read in optimized DFT configuration
+  static void import_wisdom_from_filename(const char*) {}
+
+  //! @brief Communicate optimized DFT configuration in parallel case
+  static void mpi_broadcast_wisdom(MPI_Comm) {}
+
+  //! @brief Receive optimized DFT configuration in parallel case
+  static void mpi_gather_wisdom(MPI_Comm) {}
+
+  //! @brief Read in optimized DFT configuration from string
+  static void import_wisdom_from_string(const std::string&) {}
+
+  //! @brief Discard all accumulated DFT configurations
+  static void forget_wisdom() {}
+
+  //! @brief Write out optimized DFT configuration
+  static void export_wisdom_to_filename(const char*) {}
+
+  //! @brief Write out optimized DFT configuration to string
+  static std::string export_wisdom_to_string() { return ""; }
+
+private:
+  /**
+   * @brief Ensure that the communicator contains a single processor
+   */
+  static void checkComm(MPI_Comm comm)
+  {
+    int commSize;
+    MPI_Comm_size(comm, &commSize);
+    if (commSize != 1)
+      throw std::runtime_error{
+        "native FFT engine only supports a single processor"
+      };
+  }
+
+  /**
+   * @brief Whether planner flags request a transposed layout
+   */
+  static bool transposedLayout(unsigned int flags)
+  {
+    return flags & (FFTW_MPI_TRANSPOSED_IN | FFTW_MPI_TRANSPOSED_OUT);
+  }
+
+  /**
+   * @brief Whether the given r2r kinds are implemented
+   */
+  static bool supported(unsigned int dim,
+                        const ptrdiff_t* n,
+                        const r2r_kind* kinds)
+  {
+    for (unsigned int i = 0; i < dim; i++)
+      if ((kinds[i] != FFTW_REDFT00 || n[i] < 2) && kinds[i] != FFTW_RODFT00)
+        return false;
+    return true;
+  }
+
+  /**
+   * @brief Product of the given extents
+   */
+  static ptrdiff_t product(unsigned int dim, const ptrdiff_t* n)
+  {
+    ptrdiff_t result = 1;
+    for (unsigned int i = 0; i < dim; i++)
+      result *= n[i];
+    return result;
+  }
+
+  /**
+   * @brief Row-major layout with interleaved arrays, as in FFTW-MPI
+   *
+   * @param dim     number of dimensions
+   * @param n       number of cells per dimension
+   * @param howmany number of interleaved arrays
+   * @param inLast  extent of last dimension of input, including padding
+   * @param outLast extent of last dimension of output, including padding
+   *
+   * @return transform dimensions with strides
+   */
+  static std::vector<iodim> layout(unsigned int dim,
+                                   const ptrdiff_t* n,
+                                   ptrdiff_t howmany,
+                                   ptrdiff_t inLast,
+                                   ptrdiff_t outLast)
+  {
+    std::vector<iodim> dims(dim);
+    ptrdiff_t inStride = howmany, outStride = howmany;
+    for (unsigned int i = dim; i-- > 0;) {
+      dims[i] = { n[i], inStride, outStride };
+      inStride *= (i == dim - 1) ? inLast : n[i];
+      outStride *= (i == dim - 1) ? outLast : n[i];
+    }
+    return dims;
+  }
+
+  /**
+   * @brief Loop over interleaved arrays
+   */
+  static std::vector<iodim> loop(ptrdiff_t howmany)
+  {
+    if (howmany == 1)
+      return {};
+    return { { howmany, 1, 1 } };
+  }
+};
+
+} // namespace parafields
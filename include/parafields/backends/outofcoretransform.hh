@@ -0,0 +1,436 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace parafields {
+
+/**
+ * @brief Array of fixed-size values stored in a scratch file
+ *
+ * Each processor creates its own file in the given directory, which should
+ * be on local storage. The file is unlinked right after creation, so that
+ * it disappears when the array is destroyed or the program terminates.
+ *
+ * @tparam T type of the stored values, e.g., RF or FFTW complex
+ */
+template<typename T>
+class ScratchArray
+{
+  std::FILE* file;
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param directory directory for the scratch file
+   */
+  explicit ScratchArray(const std::string& directory)
+  {
+    std::string name = directory + "/parafields-scratch-XXXXXX";
+    const int descriptor = mkstemp(name.data());
+    if (descriptor == -1)
+      throw std::runtime_error{ "could not create scratch file in " +
+                                directory };
+
+    unlink(name.c_str());
+    file = fdopen(descriptor, "w+b");
+    if (file == nullptr) {
+      close(descriptor);
+      throw std::runtime_error{ "could not open scratch file in " +
+                                directory };
+    }
+  }
+
+  ScratchArray(const ScratchArray&) = delete;
+  ScratchArray& operator=(const ScratchArray&) = delete;
+
+  /**
+   * @brief Destructor
+   */
+  ~ScratchArray() { std::fclose(file); }
+
+  /**
+   * @brief Read consecutive values
+   *
+   * @param      offset index of first value
+   * @param      count  number of values
+   * @param[out] data   buffer of at least count values
+   */
+  void read(std::uint64_t offset, std::uint64_t count, T* data) const
+  {
+    if (fseeko(file, offset * sizeof(T), SEEK_SET) != 0 ||
+        std::fread(data, sizeof(T), count, file) != count)
+      throw std::runtime_error{ "could not read from scratch file" };
+  }
+
+  /**
+   * @brief Write consecutive values
+   *
+   * @param offset index of first value
+   * @param count  number of values
+   * @param data   buffer of at least count values
+   */
+  void write(std::uint64_t offset, std::uint64_t count, const T* data)
+  {
+    if (fseeko(file, offset * sizeof(T), SEEK_SET) != 0 ||
+        std::fwrite(data, sizeof(T), count, file) != count)
+      throw std::runtime_error{ "could not write to scratch file" };
+  }
+};
+
+/**
+ * @brief Multidimensional Fourier transform of a disk-resident array
+ *
+ * The array is split into slabs along the last dimension, i.e., the one
+ * with the largest stride, and each processor keeps its slab of planes in
+ * a ScratchArray. The transform is computed in two passes, and each of
+ * them reads the slab in pieces that fit into the given memory budget:
+ *
+ * - chunks of complete planes are transformed along all dimensions but
+ *   the last one, which are local to the processor
+ * - blocks of columns, i.e., the same range of entries from each plane,
+ *   are redistributed with MPI_Alltoallv so that each processor holds
+ *   complete lines along the last dimension for part of the columns,
+ *   transformed along that dimension, and sent back
+ *
+ * The result is written back in place, in natural order and with the same
+ * distribution, and the transform is unnormalized, like those of FFTW. A
+ * single plane has to fit into memory, which means an extended domain of
+ * 8192^3 cells needs about 1 GiB per processor in double precision.
+ * Plans are only estimated, since measuring would overwrite the data.
+ *
+ * @tparam Traits traits class with data types and definitions
+ */
+template<typename Traits>
+class OutOfCoreTransform
+{
+  using RF = typename Traits::RF;
+  using Indices = typename Traits::Indices;
+  using Complex = typename FFTEngine<RF>::complex;
+  using IODim = typename FFTEngine<RF>::iodim;
+
+  enum
+  {
+    dim = Traits::dim
+  };
+
+  MPI_Comm comm;
+  int rank, commSize;
+
+  Indices cells;
+  std::uint64_t planeSize;
+  std::vector<std::uint64_t> planeStart;
+  std::uint64_t budget;
+
+public:
+  /**
+   * @brief Set up slab distribution
+   *
+   * @param comm_   MPI communicator of the random field
+   * @param cells_  number of cells per dimension of the array
+   * @param budget_ number of complex values that may be held in memory
+   */
+  void update(MPI_Comm comm_, const Indices& cells_, std::uint64_t budget_)
+  {
+    comm = comm_;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &commSize);
+
+    cells = cells_;
+    budget = budget_;
+
+    planeSize = 1;
+    for (unsigned int i = 0; i < dim - 1; i++)
+      planeSize *= cells[i];
+
+    planeStart.resize(commSize + 1);
+    for (int i = 0; i <= commSize; i++)
+      planeStart[i] = blockStart(cells[dim - 1], i);
+  }
+
+  /**
+   * @brief Number of entries per plane
+   *
+   * @return product of cells in all dimensions but the last one
+   */
+  std::uint64_t entriesPerPlane() const { return planeSize; }
+
+  /**
+   * @brief Number of planes stored on this processor
+   *
+   * @return local extent in the last dimension
+   */
+  std::uint64_t localPlanes() const
+  {
+    return planeStart[rank + 1] - planeStart[rank];
+  }
+
+  /**
+   * @brief Global index of first local plane
+   *
+   * @return offset in the last dimension
+   */
+  std::uint64_t firstPlane() const { return planeStart[rank]; }
+
+  /**
+   * @brief Number of planes that fit into the memory budget
+   *
+   * @return number of planes per chunk, at least one
+   */
+  std::uint64_t planesPerChunk() const
+  {
+    return std::max<std::uint64_t>(1, budget / planeSize);
+  }
+
+  /**
+   * @brief Transform from original domain to frequency domain
+   *
+   * @param array local slab of the array, overwritten with result
+   */
+  void forward(ScratchArray<Complex>& array) const
+  {
+    transformPlanes(array, FFTW_FORWARD);
+    transformColumns(array, FFTW_FORWARD);
+  }
+
+  /**
+   * @brief Transform from frequency domain to original domain
+   *
+   * @param array local slab of the array, overwritten with result
+   */
+  void backward(ScratchArray<Complex>& array) const
+  {
+    transformColumns(array, FFTW_BACKWARD);
+    transformPlanes(array, FFTW_BACKWARD);
+  }
+
+private:
+  /**
+   * @brief First index of given processor when distributing evenly
+   *
+   * @param size total number of indices
+   * @param i    rank of processor, or number of processors for the end
+   *
+   * @return first index
+   */
+  std::uint64_t blockStart(std::uint64_t size, int i) const
+  {
+    return i * (size / commSize) + std::min<std::uint64_t>(i, size % commSize);
+  }
+
+  /**
+   * @brief Transform chunks of local planes in all dimensions but the last
+   *
+   * @param array local slab of the array
+   * @param sign  FFTW_FORWARD or FFTW_BACKWARD
+   */
+  void transformPlanes(ScratchArray<Complex>& array, int sign) const
+  {
+    if (dim == 1 || localPlanes() == 0)
+      return;
+
+    std::array<IODim, dim - 1> dims;
+    std::uint64_t stride = 1;
+    for (unsigned int i = 0; i < dim - 1; i++) {
+      dims[dim - 2 - i].n = cells[i];
+      dims[dim - 2 - i].is = stride;
+      dims[dim - 2 - i].os = stride;
+      stride *= cells[i];
+    }
+
+    const std::uint64_t chunk = std::min(planesPerChunk(), localPlanes());
+    std::vector<RF> storage(2 * chunk * planeSize);
+    Complex* data = (Complex*)storage.data();
+
+    for (std::uint64_t plane = 0; plane < localPlanes(); plane += chunk) {
+      const std::uint64_t count = std::min(chunk, localPlanes() - plane);
+      array.read(plane * planeSize, count * planeSize, data);
+
+      IODim loop;
+      loop.n = count;
+      loop.is = planeSize;
+      loop.os = planeSize;
+      execute(dim - 1, dims.data(), loop, data, sign);
+
+      array.write(plane * planeSize, count * planeSize, data);
+    }
+  }
+
+  /**
+   * @brief Transform blocks of columns along the last dimension
+   *
+   * Each block is read from all local planes, redistributed so that each
+   * processor receives complete columns, transformed, and sent back. The
+   * block width is the same on all processors, so that they take part in
+   * the same number of exchanges.
+   *
+   * @param array local slab of the array
+   * @param sign  FFTW_FORWARD or FFTW_BACKWARD
+   */
+  void transformColumns(ScratchArray<Complex>& array, int sign) const
+  {
+    const std::uint64_t maxPlanes = std::max<std::uint64_t>(
+      1, planeStart[1] - planeStart[0]);
+    const std::uint64_t buffers = (commSize == 1) ? 1 : 3;
+    const std::uint64_t width = std::clamp<std::uint64_t>(
+      budget / (buffers * maxPlanes),
+      std::min<std::uint64_t>(commSize, planeSize),
+      std::min<std::uint64_t>(planeSize, INT_MAX / maxPlanes));
+
+    std::vector<RF> storage(2 * localPlanes() * width);
+    Complex* block = (Complex*)storage.data();
+
+    std::vector<RF> sendStorage, recvStorage;
+    if (commSize > 1) {
+      sendStorage.resize(2 * localPlanes() * width);
+      recvStorage.resize(2 * cells[dim - 1] * blockStart(width, 1));
+    }
+    Complex* send = (Complex*)sendStorage.data();
+    Complex* recv = (Complex*)recvStorage.data();
+
+    std::vector<std::uint64_t> columnStart(commSize + 1);
+    std::vector<int> sendCounts(commSize), sendDispls(commSize);
+    std::vector<int> recvCounts(commSize), recvDispls(commSize);
+
+    for (std::uint64_t first = 0; first < planeSize; first += width) {
+      const std::uint64_t count = std::min(width, planeSize - first);
+      for (std::uint64_t plane = 0; plane < localPlanes(); plane++)
+        array.read(plane * planeSize + first, count, block + plane * count);
+
+      if (commSize == 1) {
+        transformLines(block, cells[dim - 1], count, sign);
+      } else {
+        for (int i = 0; i <= commSize; i++)
+          columnStart[i] = blockStart(count, i);
+
+        const std::uint64_t localColumns =
+          columnStart[rank + 1] - columnStart[rank];
+        for (int i = 0; i < commSize; i++) {
+          sendCounts[i] =
+            localPlanes() * (columnStart[i + 1] - columnStart[i]);
+          recvCounts[i] = (planeStart[i + 1] - planeStart[i]) * localColumns;
+          sendDispls[i] = (i == 0) ? 0 : sendDispls[i - 1] + sendCounts[i - 1];
+          recvDispls[i] = (i == 0) ? 0 : recvDispls[i - 1] + recvCounts[i - 1];
+        }
+
+        // sorted by destination, then by plane
+        std::uint64_t pos = 0;
+        for (int i = 0; i < commSize; i++)
+          for (std::uint64_t plane = 0; plane < localPlanes(); plane++)
+            for (std::uint64_t c = columnStart[i]; c < columnStart[i + 1]; c++)
+              copy(block[plane * count + c], send[pos++]);
+
+        // received planes arrive in global order, since slabs are ordered
+        exchange(send, sendCounts, sendDispls, recv, recvCounts, recvDispls);
+        transformLines(recv, cells[dim - 1], localColumns, sign);
+        exchange(recv, recvCounts, recvDispls, send, sendCounts, sendDispls);
+
+        pos = 0;
+        for (int i = 0; i < commSize; i++)
+          for (std::uint64_t plane = 0; plane < localPlanes(); plane++)
+            for (std::uint64_t c = columnStart[i]; c < columnStart[i + 1]; c++)
+              copy(send[pos++], block[plane * count + c]);
+      }
+
+      for (std::uint64_t plane = 0; plane < localPlanes(); plane++)
+        array.write(plane * planeSize + first, count, block + plane * count);
+    }
+  }
+
+  /**
+   * @brief Transform interleaved lines along the slowest dimension
+   *
+   * @param data    array of length times howmany values, line index fastest
+   * @param length  length of each transform
+   * @param howmany number of transforms
+   * @param sign    FFTW_FORWARD or FFTW_BACKWARD
+   */
+  static void transformLines(Complex* data,
+                             std::uint64_t length,
+                             std::uint64_t howmany,
+                             int sign)
+  {
+    if (howmany == 0 || length == 1)
+      return;
+
+    IODim line;
+    line.n = length;
+    line.is = howmany;
+    line.os = howmany;
+
+    IODim loop;
+    loop.n = howmany;
+    loop.is = 1;
+    loop.os = 1;
+
+    execute(1, &line, loop, data, sign);
+  }
+
+  /**
+   * @brief Plan, execute and destroy in-place guru transform
+   */
+  static void execute(int rank,
+                      const IODim* dims,
+                      const IODim& loop,
+                      Complex* data,
+                      int sign)
+  {
+    typename FFTEngine<RF>::plan plan =
+      createPlan((RF*)data, 0, FFTW_ESTIMATE, [&] {
+        return FFTEngine<RF>::plan_guru64_dft(
+          rank, dims, 1, &loop, data, data, sign, FFTW_ESTIMATE);
+      });
+    if (plan == nullptr)
+      throw std::runtime_error{
+        "parafields failed to create out-of-core plan"
+      };
+
+    FFTEngine<RF>::execute(plan);
+    destroyPlan<RF>(plan);
+  }
+
+  /**
+   * @brief All-to-all exchange of complex values
+   */
+  void exchange(const Complex* send,
+                const std::vector<int>& sendCounts,
+                const std::vector<int>& sendDispls,
+                Complex* recv,
+                const std::vector<int>& recvCounts,
+                const std::vector<int>& recvDispls) const
+  {
+    MPI_Datatype complexType;
+    MPI_Type_contiguous(2, mpiType<RF>, &complexType);
+    MPI_Type_commit(&complexType);
+
+    MPI_Alltoallv(send,
+                  sendCounts.data(),
+                  sendDispls.data(),
+                  complexType,
+                  recv,
+                  recvCounts.data(),
+                  recvDispls.data(),
+                  complexType,
+                  comm);
+
+    MPI_Type_free(&complexType);
+  }
+
+  //! @brief Copy complex value
+  static void copy(const Complex& from, Complex& to)
+  {
+    to[0] = from[0];
+    to[1] = from[1];
+  }
+};
+
+} // namespace parafields
@@ -0,0 +1,407 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace parafields {
+
+/**
+ * @brief Multidimensional Fourier transforms that skip known zeros
+ *
+ * The field backends embed the original domain into the extended domain,
+ * which means that a forward transform acts on an array that is zero
+ * outside of the original domain, and that all entries outside of the
+ * original domain are discarded after a backward transform. This class
+ * splits the multidimensional transform into onedimensional transforms
+ * per dimension. The forward transform skips all lines that are known to be
+ * zero, i.e., lines that lie outside of the original domain in one of the
+ * dimensions that haven't been transformed yet, and the backward transform
+ * skips all lines that lie outside of the original domain in one of the
+ * dimensions that have already been transformed. For the default embedding
+ * factor of two, this saves a quarter of the onedimensional transforms in
+ * 2D, and more than a third in 3D.
+ *
+ * Optionally, the backward transform also exploits a band-limited input,
+ * as produced by spectral truncation: lines that lie outside of the band
+ * of nonzero frequencies in one of the dimensions that haven't been
+ * transformed yet are zero, and are skipped as well. This amounts to
+ * zero-padding interpolation of a coarse band-limited field onto the
+ * extended domain.
+ *
+ * The last dimension is distributed across processors. It is transformed
+ * after a global transpose of the last two dimensions, which directly
+ * produces the layout of FFTW_MPI_TRANSPOSED_OUT for transposed transforms.
+ * The arrays are stored with the first dimension running fastest, and for
+ * real input the first dimension is padded as for the FFTW R2C transform.
+ *
+ * Plans are created on the array itself, whose contents are preserved
+ * when the planner flags require measuring.
+ *
+ * @tparam Traits traits class with data types and definitions
+ */
+template<typename Traits>
+class PrunedTransform
+{
+  using RF = typename Traits::RF;
+  using Index = typename Traits::Index;
+  using Indices = typename Traits::Indices;
+  using IODim = typename FFTEngine<RF>::iodim;
+
+  enum
+  {
+    dim = Traits::dim
+  };
+
+  MPI_Comm comm;
+  int commSize;
+  bool realInput, transposed;
+
+  Indices lineCells;
+  Indices storedCells;
+  Indices stride;
+  Indices boxCells;
+  ptrdiff_t transposedRows;
+  std::size_t localSize;
+
+public:
+  /**
+   * @brief Set up the data layout
+   *
+   * This function has to be called after the creation of the backend
+   * using it, or after any change of the original or extended domain.
+   *
+   * @param comm_         MPI communicator of the random field
+   * @param extendedCells cells per dimension of extended domain
+   * @param localRows     number of local rows of extended domain
+   * @param boxCells_     local cells of original domain per dimension
+   * @param realInput_    whether the untransformed array is real
+   * @param transposed_   whether the transformed array is transposed
+   */
+  void update(MPI_Comm comm_,
+              const Indices& extendedCells,
+              Index localRows,
+              const Indices& boxCells_,
+              bool realInput_,
+              bool transposed_)
+  {
+    static_assert(dim != 1, "PrunedTransform requires dim > 1");
+
+    comm = comm_;
+    MPI_Comm_size(comm, &commSize);
+    realInput = realInput_;
+    transposed = transposed_;
+    lineCells = extendedCells;
+    boxCells = boxCells_;
+
+    storedCells = extendedCells;
+    if (realInput)
+      storedCells[0] = extendedCells[0] / 2 + 1;
+
+    ptrdiff_t n[dim];
+    for (unsigned int i = 0; i < dim; i++)
+      n[i] = storedCells[dim - 1 - i];
+    ptrdiff_t localN0, local0Start, local1Start;
+    FFTEngine<RF>::mpi_local_size_transposed(
+      dim, n, comm, &localN0, &local0Start, &transposedRows, &local1Start);
+
+    storedCells[dim - 1] = localRows;
+    stride[0] = 1;
+    for (unsigned int i = 1; i < dim; i++)
+      stride[i] = stride[i - 1] * storedCells[i - 1];
+
+    localSize = std::max<std::size_t>(
+      std::size_t(stride[dim - 1]) * storedCells[dim - 1],
+      std::size_t(stride[dim - 2]) * lineCells[dim - 1] * transposedRows);
+  }
+
+  /**
+   * @brief Transform into Fourier space, skipping zero input lines
+   *
+   * @param data  local array, zero outside of the original domain
+   * @param flags FFTW planner flags
+   */
+  void forward(typename FFTEngine<RF>::complex* data, unsigned int flags) const
+  {
+    // lines outside of the original domain are zero before their transform
+    Indices count = boxCells;
+    for (unsigned int i = 0; i < dim - 1; i++) {
+      transformLines(data, 0, i, count, FFTW_FORWARD, flags);
+      count[i] = storedCells[i];
+    }
+
+    if (commSize == 1 && !transposed)
+      transformLines(data, 0, dim - 1, count, FFTW_FORWARD, flags);
+    else {
+      transpose(data, false, flags);
+      transformTransposedLines(data, FFTW_FORWARD, flags);
+      if (!transposed)
+        transpose(data, true, flags);
+    }
+  }
+
+  /**
+   * @brief Transform from Fourier space, skipping discarded output lines
+   *
+   * @param data        local array, only valid in original domain afterwards
+   * @param flags       FFTW planner flags
+   * @param bandLimited whether lines outside of the nonzero band are skipped
+   */
+  void backward(typename FFTEngine<RF>::complex* data,
+                unsigned int flags,
+                bool bandLimited = false) const
+  {
+    Indices band = storedCells;
+    if (bandLimited)
+      band = nonzeroBand(data);
+
+    if (commSize == 1 && !transposed)
+      transformBandLines(
+        data, dim - 1, storedCells, band, dim - 1, FFTW_BACKWARD, flags);
+    else {
+      if (!transposed)
+        transpose(data, false, flags);
+      transformTransposedLines(data, FFTW_BACKWARD, flags);
+      transpose(data, true, flags);
+    }
+
+    // lines outside of the original domain are discarded after transform
+    Indices count = storedCells;
+    count[dim - 1] = boxCells[dim - 1];
+    for (int i = dim - 2; i >= 0; i--) {
+      transformBandLines(data, i, count, band, i, FFTW_BACKWARD, flags);
+      count[i] = boxCells[i];
+    }
+  }
+
+private:
+  /**
+   * @brief Determine band of nonzero frequencies
+   *
+   * Finds the largest absolute frequency with a nonzero entry for each
+   * dimension that isn't distributed, i.e., all but the last one, and all
+   * but the last two for transposed layout. The other dimensions are
+   * treated as full.
+   *
+   * @param data local array in Fourier space
+   *
+   * @return number of nonnegative frequencies in band per dimension
+   */
+  Indices nonzeroBand(const typename FFTEngine<RF>::complex* data) const
+  {
+    const unsigned int localDims = transposed ? dim - 2 : dim - 1;
+
+    std::size_t size = std::size_t(stride[dim - 1]) * storedCells[dim - 1];
+    if (transposed)
+      size = std::size_t(stride[dim - 2]) * lineCells[dim - 1] * transposedRows;
+
+    Indices myBand, band;
+    std::fill(myBand.begin(), myBand.end(), 0);
+    for (std::size_t index = 0; index < size; index++) {
+      if (data[index][0] == 0. && data[index][1] == 0.)
+        continue;
+
+      for (unsigned int i = 0; i < localDims; i++) {
+        const Index k = (index / stride[i]) % storedCells[i];
+        const Index frequency =
+          (realInput && i == 0) ? k : std::min(k, lineCells[i] - k);
+        myBand[i] = std::max(myBand[i], frequency + 1);
+      }
+    }
+
+    MPI_Allreduce(myBand.data(), band.data(), dim, MPI_UNSIGNED, MPI_MAX, comm);
+    for (unsigned int i = localDims; i < dim; i++)
+      band[i] = storedCells[i];
+
+    return band;
+  }
+
+  /**
+   * @brief Transform lines along given dimension within band
+   *
+   * Splits the lines into blocks that are contiguous in the first
+   * bandDims dimensions, skipping the frequencies outside of the band.
+   * Complex dimensions have a band of low frequencies at both ends, the
+   * padded first dimension of real input only at the beginning.
+   *
+   * @param data      local array
+   * @param direction dimension of the lines
+   * @param count     number of lines per dimension, ignored for direction
+   * @param band      number of nonnegative frequencies per dimension
+   * @param bandDims  number of leading dimensions restricted to band
+   * @param sign      FFTW_FORWARD or FFTW_BACKWARD
+   * @param flags     FFTW planner flags
+   */
+  void transformBandLines(typename FFTEngine<RF>::complex* data,
+                          unsigned int direction,
+                          const Indices& count,
+                          const Indices& band,
+                          unsigned int bandDims,
+                          int sign,
+                          unsigned int flags) const
+  {
+    Indices lower, upper;
+    for (unsigned int i = 0; i < dim; i++) {
+      lower[i] = count[i];
+      upper[i] = 0;
+      if (i == direction || i >= bandDims)
+        continue;
+
+      if (realInput && i == 0)
+        lower[i] = std::min(band[i], count[i]);
+      else if (2 * band[i] < lineCells[i] + 1) {
+        lower[i] = band[i];
+        upper[i] = band[i] > 0 ? band[i] - 1 : 0;
+      }
+    }
+
+    // each set bit selects the upper block of the corresponding dimension
+    for (unsigned int blocks = 0; blocks < (1u << dim); blocks++) {
+      Indices blockCount = lower;
+      std::size_t offset = 0;
+      bool empty = false;
+      for (unsigned int i = 0; i < dim; i++)
+        if (blocks & (1u << i)) {
+          if (upper[i] == 0) {
+            empty = true;
+            break;
+          }
+          blockCount[i] = upper[i];
+          offset += std::size_t(lineCells[i] - upper[i]) * stride[i];
+        }
+
+      if (!empty)
+        transformLines(data, offset, direction, blockCount, sign, flags);
+    }
+  }
+
+  /**
+   * @brief Transform all lines along given dimension in untransposed layout
+   *
+   * @param data      local array
+   * @param offset    position of first line in local array
+   * @param direction dimension of the lines
+   * @param count     number of lines per dimension, ignored for direction
+   * @param sign      FFTW_FORWARD or FFTW_BACKWARD
+   * @param flags     FFTW planner flags
+   */
+  void transformLines(typename FFTEngine<RF>::complex* data,
+                      std::size_t offset,
+                      unsigned int direction,
+                      const Indices& count,
+                      int sign,
+                      unsigned int flags) const
+  {
+    const bool r2c = realInput && direction == 0 && sign == FFTW_FORWARD;
+    const bool c2r = realInput && direction == 0 && sign == FFTW_BACKWARD;
+
+    // strides of real array are twice those of complex array
+    IODim line;
+    line.n = lineCells[direction];
+    line.is = (r2c || c2r) ? 1 : stride[direction];
+    line.os = line.is;
+
+    std::vector<IODim> loops;
+    for (unsigned int i = 0; i < dim; i++) {
+      if (i == direction)
+        continue;
+      if (count[i] == 0)
+        return;
+
+      IODim loop;
+      loop.n = count[i];
+      loop.is = r2c ? 2 * stride[i] : stride[i];
+      loop.os = c2r ? 2 * stride[i] : stride[i];
+      loops.push_back(loop);
+    }
+
+    typename FFTEngine<RF>::complex* lines = data + offset;
+    execute(createPlan((RF*)data, 2 * localSize, flags, [&] {
+      if (r2c)
+        return FFTEngine<RF>::plan_guru64_dft_r2c(
+          1, &line, loops.size(), loops.data(), (RF*)lines, lines, flags);
+      else if (c2r)
+        return FFTEngine<RF>::plan_guru64_dft_c2r(
+          1, &line, loops.size(), loops.data(), lines, (RF*)lines, flags);
+      else
+        return FFTEngine<RF>::plan_guru64_dft(
+          1, &line, loops.size(), loops.data(), lines, lines, sign, flags);
+    }));
+  }
+
+  /**
+   * @brief Transform all lines along last dimension in transposed layout
+   *
+   * @param data  local array, with last two dimensions switched
+   * @param sign  FFTW_FORWARD or FFTW_BACKWARD
+   * @param flags FFTW planner flags
+   */
+  void transformTransposedLines(typename FFTEngine<RF>::complex* data,
+                                int sign,
+                                unsigned int flags) const
+  {
+    if (transposedRows == 0)
+      return;
+
+    const ptrdiff_t slice = stride[dim - 2];
+
+    IODim line;
+    line.n = lineCells[dim - 1];
+    line.is = slice;
+    line.os = slice;
+
+    IODim loops[2];
+    loops[0].n = slice;
+    loops[0].is = 1;
+    loops[0].os = 1;
+    loops[1].n = transposedRows;
+    loops[1].is = lineCells[dim - 1] * slice;
+    loops[1].os = loops[1].is;
+
+    execute(createPlan((RF*)data, 2 * localSize, flags, [&] {
+      return FFTEngine<RF>::plan_guru64_dft(
+        1, &line, 2, loops, data, data, sign, flags);
+    }));
+  }
+
+  /**
+   * @brief Switch last two dimensions across processors
+   *
+   * @param data  local array
+   * @param back  true if array is currently transposed
+   * @param flags FFTW planner flags
+   */
+  void transpose(typename FFTEngine<RF>::complex* data,
+                 bool back,
+                 unsigned int flags) const
+  {
+    const ptrdiff_t n0 = lineCells[dim - 1];
+    const ptrdiff_t n1 = storedCells[dim - 2];
+    const ptrdiff_t howmany = 2 * stride[dim - 2];
+
+    execute(createPlan((RF*)data, 2 * localSize, flags, [&] {
+      return FFTEngine<RF>::mpi_plan_many_transpose(back ? n1 : n0,
+                                                    back ? n0 : n1,
+                                                    howmany,
+                                                    FFTW_MPI_DEFAULT_BLOCK,
+                                                    FFTW_MPI_DEFAULT_BLOCK,
+                                                    (RF*)data,
+                                                    (RF*)data,
+                                                    comm,
+                                                    flags);
+    }));
+  }
+
+  /**
+   * @brief Execute and destroy given plan
+   */
+  static void execute(typename FFTEngine<RF>::plan plan)
+  {
+    if (plan == nullptr)
+      throw std::runtime_error{ "parafields failed to create pruned plan" };
+
+    FFTEngine<RF>::execute(plan);
+    destroyPlan<RF>(plan);
+  }
+};
+
+} // namespace parafields
@@ -31,7 +31,7 @@ class R2CFieldBackend
 
   int rank, commSize;
 
-  ptrdiff_t allocLocal, localN0, local0Start;
+  ptrdiff_t allocLocal, localN0, local0Start, localN0Trans, local0StartTrans;
 
   Indices localCells;
   Index localDomainSize;
@@ -42,27 +42,23 @@ class R2CFieldBackend
   Index localExtendedDomainSize;
 
   Indices localR2CComplexCells;
+  Indices localR2CComplexOffset;
   Index localR2CComplexDomainSize;
   Indices localR2CRealCells;
   Index localR2CRealDomainSize;
 
-  mutable typename FFTW<RF>::complex* fieldData;
+  mutable typename FFTEngine<RF>::complex* fieldData;
   mutable Indices indices;
 
-  bool transposed;
+  bool transposed, pruned;
 
-  enum
-  {
-    toExtended,
-    fromExtended
-  };
+  SlabExchange<Traits> slabExchange;
+  PrunedTransform<Traits> prunedTransform;
 
 public:
   /**
    * @brief Constructor
    *
-   * Imports FFTW wisdom if configured to do so.
-   *
    * @param traits_ traits object with parameters and communication
    */
   R2CFieldBackend(const std::shared_ptr<Traits>& traits_)
@@ -71,32 +67,22 @@ public:
   {
     if ((*traits).verbose && (*traits).rank == 0)
       std::cout << "using R2CFieldBackend" << std::endl;
-
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      if ((*traits).rank == 0)
-        FFTW<RF>::import_wisdom_from_filename("wisdom-R2CField.ini");
-
-      FFTW<RF>::mpi_broadcast_wisdom((*traits).comm);
-    }
   }
 
   /**
    * @brief Destructor
    *
-   * Cleans up allocated arrays and FFTW plans. Exports FFTW
+   * Cleans up allocated arrays and FFTW plans. Stores new FFTW
    * wisdom if configured to do so.
    */
   ~R2CFieldBackend()
   {
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      FFTW<RF>::mpi_gather_wisdom((*traits).comm);
-
-      if ((*traits).rank == 0)
-        FFTW<RF>::export_wisdom_to_filename("wisdom-R2CField.ini");
-    }
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::store(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
 
     if (fieldData != nullptr) {
-      FFTW<RF>::free(fieldData);
+      FFTEngine<RF>::free(fieldData);
       fieldData = nullptr;
     }
   }
@@ -106,13 +92,18 @@ public:
    *
    * This function is has to be called after the creation of
    * the random field object or its refinement. It updates
-   * parameters like the number of cells per dimension.
+   * parameters like the number of cells per dimension, and
+   * imports FFTW wisdom for the new geometry if configured to do so.
    */
   void update()
   {
     rank = (*traits).rank;
     commSize = (*traits).commSize;
 
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::load(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
+
     localCells = (*traits).localCells;
     localDomainSize = (*traits).localDomainSize;
     extendedCells = (*traits).extendedCells;
@@ -121,18 +112,37 @@ public:
     localExtendedOffset = (*traits).localExtendedOffset;
     localExtendedDomainSize = (*traits).localExtendedDomainSize;
     transposed = (*traits).transposed;
-
-    if (dim == 2 && transposed)
-      throw std::runtime_error{
-        "R2CFieldBackend supports transposed output only for dim > 2"
-      };
+    pruned = (*traits).config.template get<bool>("fftw.pruned", true);
 
     getR2CData();
 
     getR2CCells();
 
+    if (commSize > 1) {
+      Index sliceSize = 1;
+      for (unsigned int i = 0; i < dim - 1; i++)
+        sliceSize *= localCells[i];
+      slabExchange.update((*traits).comm,
+                          sliceSize,
+                          localCells[dim - 1],
+                          (*traits).localExtendedCells[dim - 1],
+                          (*traits).localExtendedOffset[dim - 1]);
+    }
+
+    if (pruned) {
+      Indices boxCells = localCells;
+      if (commSize > 1)
+        boxCells[dim - 1] = slabExchange.embeddedRows();
+      prunedTransform.update((*traits).comm,
+                             extendedCells,
+                             localExtendedCells[dim - 1],
+                             boxCells,
+                             true,
+                             transposed);
+    }
+
     if (fieldData != nullptr) {
-      FFTW<RF>::free(fieldData);
+      FFTEngine<RF>::free(fieldData);
       fieldData = nullptr;
     }
   }
@@ -164,6 +174,30 @@ public:
    */
   const Indices& localFieldCells() const { return localR2CComplexCells; }
 
+  /**
+   * @brief Global frequency of a field entry
+   *
+   * Only meaningful in the frequency layout, i.e., after a forward
+   * transform or a call to transposeIfNeeded on a new field. The
+   * frequencies are given in the original order of dimensions, even if
+   * the last two dimensions are stored transposed, and the first one only
+   * covers the stored half of the spectrum.
+   *
+   * @param index flat index of local field entry
+   *
+   * @return frequency of the entry, one per dimension
+   */
+  Indices frequency(Index index) const
+  {
+    Indices output;
+    Traits::indexToIndices(index, output, localR2CComplexCells);
+    for (unsigned int i = 0; i < dim; i++)
+      output[i] += localR2CComplexOffset[i];
+    if (transposed)
+      std::swap(output[dim - 1], output[dim - 2]);
+    return output;
+  }
+
   /**
    * @brief Reserve memory before storing any field entries
    *
@@ -174,7 +208,7 @@ public:
   void allocate()
   {
     if (fieldData == nullptr)
-      fieldData = FFTW<RF>::alloc_complex(allocLocal);
+      fieldData = FFTEngine<RF>::alloc_complex(allocLocal);
   }
 
   /**
@@ -193,8 +227,6 @@ public:
       std::swap(extendedCells[dim - 1], extendedCells[dim - 2]);
       localExtendedCells[dim - 1] = extendedCells[dim - 1] / commSize;
       localExtendedCells[dim - 2] = extendedCells[dim - 2];
-
-      getR2CCells();
     }
   }
 
@@ -205,36 +237,44 @@ public:
    * domain to the frequency domain. Uses a single FFTW real-to-complex
    * DFT transform: the input is a multidimensional array of real numbers,
    * the output a Hermitian array of complex numbers, with half the
-   * data not stored because of redundancy.
+   * data not stored because of redundancy. Lines of the array that are
+   * known to be zero are skipped if pruned transforms are enabled.
+   *
+   * @param normalize divide result by extended domain size if true
    */
-  void forwardTransform()
+  void forwardTransform(bool normalize = true)
   {
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
-    if (transposed)
-      flags |= FFTW_MPI_TRANSPOSED_OUT;
+    unsigned int flags = plannerFlags(*traits);
 
-    ptrdiff_t n[dim];
-    for (unsigned int i = 0; i < dim; i++)
-      n[i] = extendedCells[dim - 1 - i];
+    if (pruned)
+      prunedTransform.forward(fieldData, flags);
+    else {
+      if (transposed)
+        flags |= FFTW_MPI_TRANSPOSED_OUT;
 
-    typename FFTW<RF>::plan plan_forward = FFTW<RF>::mpi_plan_dft_r2c(
-      dim, n, (RF*)fieldData, fieldData, (*traits).comm, flags);
+      ptrdiff_t n[dim];
+      for (unsigned int i = 0; i < dim; i++)
+        n[i] = extendedCells[dim - 1 - i];
 
-    if (plan_forward == nullptr)
-      throw std::runtime_error{ "parafields failed to create forward plan" };
+      typename FFTEngine<RF>::plan plan_forward =
+        createPlan((RF*)fieldData, 2 * allocLocal, flags, [&] {
+          return FFTEngine<RF>::mpi_plan_dft_r2c(
+            dim, n, (RF*)fieldData, fieldData, (*traits).comm, flags);
+        });
 
-    FFTW<RF>::execute(plan_forward);
-    FFTW<RF>::destroy_plan(plan_forward);
+      if (plan_forward == nullptr)
+        throw std::runtime_error{ "parafields failed to create forward plan" };
 
-    for (Index i = 0; i < allocLocal; i++) {
-      fieldData[i][0] /= extendedDomainSize;
-      fieldData[i][1] /= extendedDomainSize;
+      FFTEngine<RF>::execute(plan_forward);
+      destroyPlan<RF>(plan_forward);
     }
 
+    if (normalize)
+      for (Index i = 0; i < allocLocal; i++) {
+        fieldData[i][0] /= extendedDomainSize;
+        fieldData[i][1] /= extendedDomainSize;
+      }
+
     transposeIfNeeded();
   }
 
@@ -245,32 +285,43 @@ public:
    * domain back to the original domain. Uses a single FFTW complex-to-real
    * DFT transform: the input is a multidimensional Hermitian array of
    * complex numbers, with half the data not stored because of redundancy,
-   * and the output is an array of real numbers.
+   * and the output is an array of real numbers. If pruned transforms are
+   * enabled, only the part of the output on the original domain is valid,
+   * and lines outside of the band of nonzero frequencies are skipped for
+   * spectrally truncated input.
+   *
+   * @param bandLimited whether the input is spectrally truncated
    */
-  void backwardTransform()
+  void backwardTransform(bool bandLimited = false)
   {
     transposeIfNeeded();
 
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
-    if (transposed)
-      flags |= FFTW_MPI_TRANSPOSED_IN;
+    unsigned int flags = plannerFlags(*traits);
 
-    ptrdiff_t n[dim];
-    for (unsigned int i = 0; i < dim; i++)
-      n[i] = extendedCells[dim - 1 - i];
+    if (pruned)
+      prunedTransform.backward(fieldData, flags, bandLimited);
+    else {
+      if (transposed)
+        flags |= FFTW_MPI_TRANSPOSED_IN;
+
+      ptrdiff_t n[dim];
+      for (unsigned int i = 0; i < dim; i++)
+        n[i] = extendedCells[dim - 1 - i];
 
-    typename FFTW<RF>::plan plan_backward = FFTW<RF>::mpi_plan_dft_c2r(
-      dim, n, fieldData, (RF*)fieldData, (*traits).comm, flags);
+      typename FFTEngine<RF>::plan plan_backward =
+        createPlan((RF*)fieldData, 2 * allocLocal, flags, [&] {
+          return FFTEngine<RF>::mpi_plan_dft_c2r(
+            dim, n, fieldData, (RF*)fieldData, (*traits).comm, flags);
+        });
 
-    if (plan_backward == nullptr)
-      throw std::runtime_error{ "parafields failed to create backward plan" };
+      if (plan_backward == nullptr)
+        throw std::runtime_error{
+          "parafields failed to create backward plan"
+        };
 
-    FFTW<RF>::execute(plan_backward);
-    FFTW<RF>::destroy_plan(plan_backward);
+      FFTEngine<RF>::execute(plan_backward);
+      destroyPlan<RF>(plan_backward);
+    }
   }
 
   /**
@@ -310,7 +361,7 @@ public:
 
     bool allMultiple = true;
     for (unsigned int i = 0; i < dim; i++) {
-      const Index globalIndex = indices[i] + localExtendedOffset[i];
+      const Index globalIndex = indices[i] + localR2CComplexOffset[i];
       if ((2 * globalIndex) % extendedCells[i] != 0)
         allMultiple = false;
     }
@@ -352,7 +403,7 @@ public:
   void fieldToExtendedField(std::vector<RF>& field)
   {
     if (fieldData == nullptr)
-      fieldData = FFTW<RF>::alloc_complex(allocLocal);
+      fieldData = FFTEngine<RF>::alloc_complex(allocLocal);
 
     for (Index i = 0; i < localR2CRealDomainSize; i++)
       ((RF*)fieldData)[i] = 0.;
@@ -367,44 +418,19 @@ public:
         ((RF*)fieldData)[extIndex] = field[index];
       }
     } else {
-      const int embeddingFactor = (*traits).embeddingFactor;
-      MPI_Request request;
-
-      MPI_Isend(&(field[0]),
-                localDomainSize,
-                mpiType<RF>,
-                rank / embeddingFactor,
-                toExtended,
-                (*traits).comm,
-                &request);
-
-      if (rank * embeddingFactor < commSize) {
-        std::vector<RF> localCopy(localDomainSize);
-        Indices indices;
-
-        Index receiveSize =
-          std::min(embeddingFactor, commSize - rank * embeddingFactor);
-        for (Index i = 0; i < receiveSize; i++) {
-          MPI_Recv(&(localCopy[0]),
-                   localDomainSize,
-                   mpiType<RF>,
-                   rank * embeddingFactor + i,
-                   toExtended,
-                   (*traits).comm,
-                   MPI_STATUS_IGNORE);
-
-          for (Index index = 0; index < localDomainSize; index++) {
-            Traits::indexToIndices(index, indices, localCells);
-            const Index offset = i * localR2CRealDomainSize / embeddingFactor;
-            const Index extIndex =
-              Traits::indicesToIndex(indices, localR2CRealCells) + offset;
-
-            ((RF*)fieldData)[extIndex] = localCopy[index];
-          }
-        }
-      }
+      std::vector<RF> slab;
+      slabExchange.toExtended(field, slab);
+
+      Indices slabCells = localCells;
+      slabCells[dim - 1] = slabExchange.embeddedRows();
+      Indices indices;
+      for (Index index = 0; index < slab.size(); index++) {
+        Traits::indexToIndices(index, indices, slabCells);
+        const Index extIndex =
+          Traits::indicesToIndex(indices, localR2CRealCells);
 
-      MPI_Wait(&request, MPI_STATUS_IGNORE);
+        ((RF*)fieldData)[extIndex] = slab[index];
+      }
     }
   }
 
@@ -440,56 +466,23 @@ public:
         field[index] = ((RF*)fieldData)[extIndex];
       }
     } else {
-      const int embeddingFactor = (*traits).embeddingFactor;
-
-      if (rank * embeddingFactor < commSize) {
-        std::vector<std::vector<RF>> localCopy;
-        std::vector<MPI_Request> request;
-
-        unsigned int sendSize =
-          std::min(embeddingFactor, commSize - rank * embeddingFactor);
-        localCopy.resize(sendSize);
-        request.resize(sendSize);
-        Indices indices;
-
-        for (unsigned int i = 0; i < sendSize; i++) {
-          localCopy[i].resize(localDomainSize);
-          for (Index index = 0; index < localDomainSize; index++) {
-            Traits::indexToIndices(index, indices, localCells);
-            const Index offset = i * localR2CRealDomainSize / embeddingFactor;
-            const Index extIndex =
-              Traits::indicesToIndex(indices, localR2CRealCells);
-
-            localCopy[i][index] = ((RF*)fieldData)[extIndex + offset];
-          }
-
-          MPI_Isend(&(localCopy[i][0]),
-                    localDomainSize,
-                    mpiType<RF>,
-                    rank * embeddingFactor + i,
-                    fromExtended,
-                    (*traits).comm,
-                    &(request[i]));
-        }
-
-        MPI_Recv(&(field[0]),
-                 localDomainSize,
-                 mpiType<RF>,
-                 rank / embeddingFactor,
-                 fromExtended,
-                 (*traits).comm,
-                 MPI_STATUS_IGNORE);
-
-        MPI_Waitall(request.size(), &(request[0]), MPI_STATUSES_IGNORE);
-      } else {
-        MPI_Recv(&(field[0]),
-                 localDomainSize,
-                 mpiType<RF>,
-                 rank / embeddingFactor,
-                 fromExtended,
-                 (*traits).comm,
-                 MPI_STATUS_IGNORE);
+      Indices slabCells = localCells;
+      slabCells[dim - 1] = slabExchange.embeddedRows();
+      Index slabSize = 1;
+      for (unsigned int i = 0; i < dim; i++)
+        slabSize *= slabCells[i];
+
+      std::vector<RF> slab(slabSize);
+      Indices indices;
+      for (Index index = 0; index < slabSize; index++) {
+        Traits::indexToIndices(index, indices, slabCells);
+        const Index extIndex =
+          Traits::indicesToIndex(indices, localR2CRealCells);
+
+        slab[index] = ((RF*)fieldData)[extIndex];
       }
+
+      slabExchange.fromExtended(slab, field);
     }
   }
 
@@ -507,8 +500,18 @@ private:
       n[i] = extendedCells[dim - 1 - i];
     n[dim - 1] = extendedCells[0] / 2 + 1;
 
-    allocLocal =
-      FFTW<RF>::mpi_local_size(dim, n, (*traits).comm, &localN0, &local0Start);
+    // pruned transforms switch to transposed layout in between
+    if (transposed || pruned)
+      allocLocal = FFTEngine<RF>::mpi_local_size_transposed(dim,
+                                                            n,
+                                                            (*traits).comm,
+                                                            &localN0,
+                                                            &local0Start,
+                                                            &localN0Trans,
+                                                            &local0StartTrans);
+    else
+      allocLocal = FFTEngine<RF>::mpi_local_size(
+        dim, n, (*traits).comm, &localN0, &local0Start);
   }
 
   /**
@@ -519,15 +522,26 @@ private:
    * array, this is simply the number of cells of the extended domain,
    * with some slight padding in the first dimension, and for the
    * transformed array, the first dimension is cut in half, because the
-   * second half is redundant.
+   * second half is redundant. If the transformed array is stored transposed,
+   * its last two dimensions are switched, and the new last dimension is
+   * distributed as prescribed by FFTW. In 2D, this is the dimension that
+   * was cut in half, which is why it may not be divided evenly.
    */
   void getR2CCells()
   {
     localR2CComplexCells = localExtendedCells;
-    localR2CComplexCells[0] /= 2;
-    localR2CComplexCells[0]++;
-    localR2CComplexDomainSize =
-      localExtendedDomainSize / localExtendedCells[0] * localR2CComplexCells[0];
+    localR2CComplexCells[0] = extendedCells[0] / 2 + 1;
+    localR2CComplexOffset = localExtendedOffset;
+    if (transposed) {
+      localR2CComplexCells[dim - 2] = extendedCells[dim - 1];
+      localR2CComplexCells[dim - 1] = localN0Trans;
+      localR2CComplexOffset[dim - 2] = 0;
+      localR2CComplexOffset[dim - 1] = local0StartTrans;
+    }
+
+    localR2CComplexDomainSize = 1;
+    for (unsigned int i = 0; i < dim; i++)
+      localR2CComplexDomainSize *= localR2CComplexCells[i];
 
     localR2CRealCells = localExtendedCells;
     localR2CRealCells[0] = 2 * (localExtendedCells[0] / 2 + 1);
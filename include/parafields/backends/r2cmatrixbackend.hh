@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdlib>
+#include <new>
+
 namespace parafields {
 
 /**
@@ -18,6 +21,9 @@ namespace parafields {
  * is eliminated. This needs more time than a true real-to-real transform
  * would, but the additional memory use can be masked, since the storage
  * for the field backend hasn't been allocated at this point in time.
+ * The array is allocated with std::malloc instead of FFTW's allocator,
+ * so that the zero imaginary part can be eliminated in-place and the
+ * memory released with std::realloc, without a second buffer.
  *
  * @tparam Traits traits class with data types and definitions
  */
@@ -39,7 +45,7 @@ class R2CMatrixBackend
 
   int rank, commSize;
 
-  ptrdiff_t allocLocal, localN0, local0Start;
+  ptrdiff_t allocLocal, localN0, local0Start, localN0Trans, local0StartTrans;
 
   Indices extendedCells;
   Index extendedDomainSize;
@@ -52,9 +58,11 @@ class R2CMatrixBackend
   Indices localR2CRealCells;
   Index localR2CRealDomainSize;
 
-  mutable typename FFTW<RF>::complex* matrixData;
+  mutable typename FFTEngine<RF>::complex* matrixData;
   mutable Indices indices;
 
+  std::size_t peakMemory;
+
   bool transformed = false;
   bool transposed, finalized;
 
@@ -62,43 +70,32 @@ public:
   /**
    * @brief Constructor
    *
-   * Imports FFTW wisdom if configured to do so.
-   *
    * @param traits_ traits object with parameters and communication
    */
   R2CMatrixBackend(const std::shared_ptr<Traits>& traits_)
     : traits(traits_)
     , matrixData(nullptr)
+    , peakMemory(0)
     , finalized(false)
   {
     if ((*traits).verbose && (*traits).rank == 0)
       std::cout << "using R2CMatrixBackend" << std::endl;
-
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      if ((*traits).rank == 0)
-        FFTW<RF>::import_wisdom_from_filename("wisdom-R2CMatrix.ini");
-
-      FFTW<RF>::mpi_broadcast_wisdom((*traits).comm);
-    }
   }
 
   /**
    * @brief Destructor
    *
-   * Cleans up allocated arrays and FFTW plans. Exports FFTW
+   * Cleans up allocated arrays and FFTW plans. Stores new FFTW
    * wisdom if configured to do so.
    */
   ~R2CMatrixBackend()
   {
-    if ((*traits).config.template get<bool>("fftw.useWisdom", false)) {
-      FFTW<RF>::mpi_gather_wisdom((*traits).comm);
-
-      if ((*traits).rank == 0)
-        FFTW<RF>::export_wisdom_to_filename("wisdom-R2CMatrix.ini");
-    }
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::store(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
 
     if (matrixData != nullptr) {
-      FFTW<RF>::free(matrixData);
+      std::free(matrixData);
       matrixData = nullptr;
     }
   }
@@ -108,7 +105,8 @@ public:
    *
    * This function is has to be called after the creation of
    * the random field object or its refinement. It updates
-   * parameters like the number of cells per dimension.
+   * parameters like the number of cells per dimension, and
+   * imports FFTW wisdom for the new geometry if configured to do so.
    */
   void update()
   {
@@ -117,6 +115,10 @@ public:
     rank = (*traits).rank;
     commSize = (*traits).commSize;
 
+    if ((*traits).config.template get<bool>("fftw.useWisdom", false))
+      FFTWWisdom<RF>::load(
+        (*traits).comm, (*traits).config, (*traits).extendedCells);
+
     extendedCells = (*traits).extendedCells;
     extendedDomainSize = (*traits).extendedDomainSize;
     localExtendedCells = (*traits).localExtendedCells;
@@ -124,17 +126,14 @@ public:
     localExtendedDomainSize = (*traits).localExtendedDomainSize;
     transposed = (*traits).transposed;
 
-    if (dim == 2 && transposed)
-      throw std::runtime_error{
-        "R2CMatrixBackend supports transposed output only for dim > 2"
-      };
-
     getR2CData();
 
     getR2CCells();
 
+    peakMemory = 0;
+
     if (matrixData != nullptr) {
-      FFTW<RF>::free(matrixData);
+      std::free(matrixData);
       matrixData = nullptr;
     }
   }
@@ -215,10 +214,48 @@ public:
    */
   void allocate()
   {
-    if (matrixData == nullptr)
-      matrixData = FFTW<RF>::alloc_complex(allocLocal);
+    if (matrixData == nullptr) {
+      const std::size_t bytes =
+        allocLocal * sizeof(typename FFTEngine<RF>::complex);
+      matrixData = (typename FFTEngine<RF>::complex*)std::malloc(bytes);
+      if (matrixData == nullptr)
+        throw std::bad_alloc{};
+
+      peakMemory = std::max(peakMemory, bytes);
+    }
   }
 
+  /**
+   * @brief Largest amount of memory used for matrix data
+   *
+   * This is the largest amount of memory the backend has held at any
+   * point in time since the last update, including transient buffers
+   * used during finalization.
+   *
+   * @return memory in bytes on this processor
+   */
+  std::size_t peakMemoryUsage() const { return peakMemory; }
+
+  /**
+   * @brief Number of values in the local array, including padding
+   *
+   * This is the size of the array returned by rawData, which contains
+   * the transformed matrix between the transform and finalization.
+   *
+   * @return number of local values of type RF
+   */
+  Index localStorageSize() const { return 2 * allocLocal; }
+
+  /**
+   * @brief Raw access to the local array
+   *
+   * Used for storing the transformed matrix before finalization, and
+   * for restoring it, e.g., when it is cached on disk.
+   *
+   * @return pointer to the local array
+   */
+  RF* rawData() const { return (RF*)matrixData; }
+
   /**
    * @brief Switch last two dimensions (for transposed transforms)
    *
@@ -235,13 +272,63 @@ public:
       std::swap(extendedCells[dim - 1], extendedCells[dim - 2]);
       localExtendedCells[dim - 1] = extendedCells[dim - 1] / commSize;
       localExtendedCells[dim - 2] = extendedCells[dim - 2];
-
-      getR2CCells();
     }
 
     transformed = !transformed;
   }
 
+  /**
+   * @brief Switch to frequency space without transforming the data
+   *
+   * This performs the same changes to the data layout as the forward
+   * transform, but leaves the stored data untouched. It is used when
+   * the transformed matrix is restored instead of being computed.
+   */
+  void markTransformed()
+  {
+    checkFinalized();
+    transposeIfNeeded();
+  }
+
+  /**
+   * @brief Switch back to original domain without transforming the data
+   *
+   * This restores the data layout of the untransformed matrix, so that
+   * it can be filled anew, e.g., after the correlation length has been
+   * changed. This is also possible after finalization, since the compacted
+   * array is simply grown back to its original size.
+   */
+  void reset()
+  {
+    if (finalized) {
+      const std::size_t bytes =
+        allocLocal * sizeof(typename FFTEngine<RF>::complex);
+      void* grown = std::realloc(matrixData, bytes);
+      if (grown == nullptr)
+        throw std::bad_alloc{};
+
+      matrixData = (typename FFTEngine<RF>::complex*)grown;
+      peakMemory = std::max(peakMemory, bytes);
+      finalized = false;
+    }
+
+    if (transformed)
+      transposeIfNeeded();
+  }
+
+  /**
+   * @brief Multiply all stored entries with given factor
+   *
+   * @param factor scale factor, e.g., ratio of new and old variance
+   */
+  void scale(RF factor)
+  {
+    RF* data = (RF*)matrixData;
+    const Index size = finalized ? allocLocal : 2 * allocLocal;
+    for (Index i = 0; i < size; i++)
+      data[i] *= factor;
+  }
+
   /**
    * @brief Transform into Fourier (i.e., frequency) space
    *
@@ -255,11 +342,7 @@ public:
   {
     checkFinalized();
 
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
+    unsigned int flags = plannerFlags(*traits);
     if (transposed)
       flags |= FFTW_MPI_TRANSPOSED_OUT;
 
@@ -267,14 +350,17 @@ public:
     for (unsigned int i = 0; i < dim; i++)
       n[i] = extendedCells[dim - 1 - i];
 
-    typename FFTW<RF>::plan plan_forward = FFTW<RF>::mpi_plan_dft_r2c(
-      dim, n, (RF*)matrixData, matrixData, (*traits).comm, flags);
+    typename FFTEngine<RF>::plan plan_forward =
+      createPlan((RF*)matrixData, 2 * allocLocal, flags, [&] {
+        return FFTEngine<RF>::mpi_plan_dft_r2c(
+          dim, n, (RF*)matrixData, matrixData, (*traits).comm, flags);
+      });
 
     if (plan_forward == nullptr)
       throw std::runtime_error{ "parafields failed to create forward plan" };
 
-    FFTW<RF>::execute(plan_forward);
-    FFTW<RF>::destroy_plan(plan_forward);
+    FFTEngine<RF>::execute(plan_forward);
+    destroyPlan<RF>(plan_forward);
 
     for (Index i = 0; i < allocLocal; i++) {
       matrixData[i][0] /= extendedDomainSize;
@@ -284,6 +370,84 @@ public:
     transposeIfNeeded();
   }
 
+  /**
+   * @brief Transform several matrices into Fourier space at once
+   *
+   * Equivalent to calling forwardTransform on each of the backends, which
+   * have to share the extended domain and communicator. The local arrays
+   * are interleaved in a temporary buffer, so that a single FFTW plan
+   * with the number of matrices as howmany parameter transforms all of
+   * them, amortizing planning and communication.
+   *
+   * @param backends backends containing the untransformed matrices
+   */
+  static void forwardTransform(const std::vector<R2CMatrixBackend*>& backends)
+  {
+    const R2CMatrixBackend& first = *backends.front();
+    const ptrdiff_t howmany = backends.size();
+    const ptrdiff_t allocLocal = first.allocLocal;
+
+    for (const R2CMatrixBackend* backend : backends)
+      backend->checkFinalized();
+
+    unsigned int flags = plannerFlags(*first.traits);
+    if (first.transposed)
+      flags |= FFTW_MPI_TRANSPOSED_OUT;
+
+    ptrdiff_t n[dim];
+    for (unsigned int i = 0; i < dim; i++)
+      n[i] = first.extendedCells[dim - 1 - i];
+
+    // plan before filling the buffer, since planning may overwrite it
+    typename FFTEngine<RF>::complex* batch =
+      FFTEngine<RF>::alloc_complex(howmany * allocLocal);
+    RF* realBatch = (RF*)batch;
+    typename FFTEngine<RF>::plan plan_forward =
+      createPlan(realBatch, 0, flags, [&] {
+        return FFTEngine<RF>::mpi_plan_many_dft_r2c(dim,
+                                                    n,
+                                                    howmany,
+                                                    FFTW_MPI_DEFAULT_BLOCK,
+                                                    FFTW_MPI_DEFAULT_BLOCK,
+                                                    realBatch,
+                                                    batch,
+                                                    (*first.traits).comm,
+                                                    flags);
+      });
+
+    if (plan_forward == nullptr) {
+      FFTEngine<RF>::free(batch);
+      throw std::runtime_error{ "parafields failed to create forward plan" };
+    }
+
+    // real input is interleaved including padding, complex output per entry
+    for (ptrdiff_t j = 0; j < howmany; j++) {
+      const RF* realData = (RF*)backends[j]->matrixData;
+      for (ptrdiff_t i = 0; i < 2 * allocLocal; i++)
+        realBatch[i * howmany + j] = realData[i];
+    }
+
+    FFTEngine<RF>::execute(plan_forward);
+    destroyPlan<RF>(plan_forward);
+
+    for (ptrdiff_t j = 0; j < howmany; j++) {
+      R2CMatrixBackend& backend = *backends[j];
+      for (ptrdiff_t i = 0; i < allocLocal; i++) {
+        backend.matrixData[i][0] =
+          batch[i * howmany + j][0] / backend.extendedDomainSize;
+        backend.matrixData[i][1] =
+          batch[i * howmany + j][1] / backend.extendedDomainSize;
+      }
+
+      backend.peakMemory =
+        std::max(backend.peakMemory,
+                 2 * allocLocal * sizeof(typename FFTEngine<RF>::complex));
+      backend.transposeIfNeeded();
+    }
+
+    FFTEngine<RF>::free(batch);
+  }
+
   /**
    * @brief Transform from Fourier (i.e., frequency) space
    *
@@ -298,11 +462,7 @@ public:
     checkFinalized();
     transposeIfNeeded();
 
-    unsigned int flags;
-    if ((*traits).config.template get<bool>("fftw.measure", false))
-      flags = FFTW_MEASURE;
-    else
-      flags = FFTW_ESTIMATE;
+    unsigned int flags = plannerFlags(*traits);
     if (transposed)
       flags |= FFTW_MPI_TRANSPOSED_IN;
 
@@ -310,14 +470,17 @@ public:
     for (unsigned int i = 0; i < dim; i++)
       n[i] = extendedCells[dim - 1 - i];
 
-    typename FFTW<RF>::plan plan_backward = FFTW<RF>::mpi_plan_dft_c2r(
-      dim, n, matrixData, (RF*)matrixData, (*traits).comm, flags);
+    typename FFTEngine<RF>::plan plan_backward =
+      createPlan((RF*)matrixData, 2 * allocLocal, flags, [&] {
+        return FFTEngine<RF>::mpi_plan_dft_c2r(
+          dim, n, matrixData, (RF*)matrixData, (*traits).comm, flags);
+      });
 
     if (plan_backward == nullptr)
       throw std::runtime_error{ "parafields failed to create backward plan" };
 
-    FFTW<RF>::execute(plan_backward);
-    FFTW<RF>::destroy_plan(plan_backward);
+    FFTEngine<RF>::execute(plan_backward);
+    destroyPlan<RF>(plan_backward);
   }
 
   /**
@@ -361,11 +524,50 @@ public:
     return eval(index);
   }
 
+  /**
+   * @brief Per-dimension contributions to storage index of matrix entries
+   *
+   * The index remapping performed by eval(Indices) acts on each dimension
+   * separately. This function tabulates it for the given number of local
+   * cells per dimension, so that the storage index of an entry is the sum
+   * of the table entries for its indices, see evalStored.
+   *
+   * @param cells local cells per dimension that should be tabulated
+   *
+   * @return table of index contributions, one per dimension
+   */
+  std::array<std::vector<Index>, dim> evalOffsets(const Indices& cells) const
+  {
+    std::array<std::vector<Index>, dim> offsets;
+    Index stride = 1;
+    for (unsigned int i = 0; i < dim; i++) {
+      offsets[i].resize(cells[i]);
+      for (Index j = 0; j < cells[i]; j++)
+        if (j >= localR2CComplexCells[i])
+          offsets[i][j] = (localExtendedCells[i] - j) * stride;
+        else
+          offsets[i][j] = j * stride;
+      stride *= localR2CComplexCells[i];
+    }
+
+    return offsets;
+  }
+
+  /**
+   * @brief Evaluate matrix entry (using the storage index)
+   *
+   * @param index storage index, as assembled from evalOffsets
+   *
+   * @return value associated with index
+   */
+  RF evalStored(Index index) const { return ((RF*)matrixData)[index]; }
+
   /**
    * @brief Get matrix entry (using the actual index)
    *
    * This function returns the entry of the array associated with the
    * given index. It uses the actual index of the untransformed array,
+   * or the real part of the complex entry of the transformed array,
    * and may not be used after the matrix backend has been finalized.
    *
    * @param index flat index for the local array
@@ -378,15 +580,19 @@ public:
   RF get(Index index) const
   {
     checkFinalized();
-    return ((RF*)matrixData)[index];
+    if (transformed)
+      return matrixData[index][0];
+    else
+      return ((RF*)matrixData)[index];
   }
 
   /**
    * @brief Set matrix entry (using the actual index)
    *
    * This function sets the entry of the array associated with the given
-   * index. It uses the actual index of the untransformed array,
-   * and may not be used after the matrix backend has been finalized.
+   * index. It uses the actual index of the untransformed array, or sets
+   * the complex entry of the transformed array to a real value, and may
+   * not be used after the matrix backend has been finalized.
    *
    * @param index flat index for the local array
    * @param value value that should be associated with the index
@@ -396,7 +602,11 @@ public:
   void set(Index index, RF value)
   {
     checkFinalized();
-    ((RF*)matrixData)[index] = value;
+    if (transformed) {
+      matrixData[index][0] = value;
+      matrixData[index][1] = 0.;
+    } else
+      ((RF*)matrixData)[index] = value;
   }
 
   /**
@@ -407,15 +617,20 @@ public:
    * the original array, and deletes its imaginary part, since that is
    * zero. After this function has been called, the array will have half
    * the number of entries as the original array before the transform,
-   * and the backend can no longer be modified.
+   * and the backend can no longer be modified. The real parts are
+   * compacted in-place (entry i is written to a location that has
+   * already been read), and the second half of the array is then
+   * returned to the system, so no additional memory is needed.
    * */
   void finalize()
   {
-    typename FFTW<RF>::complex* uncut = matrixData;
-    matrixData = (typename FFTW<RF>::complex*)FFTW<RF>::alloc_real(allocLocal);
+    RF* compact = (RF*)matrixData;
     for (Index i = 0; i < allocLocal; i++)
-      ((RF*)matrixData)[i] = uncut[i][0];
-    FFTW<RF>::free(uncut);
+      compact[i] = matrixData[i][0];
+
+    void* shrunk = std::realloc(matrixData, allocLocal * sizeof(RF));
+    if (shrunk != nullptr)
+      matrixData = (typename FFTEngine<RF>::complex*)shrunk;
 
     finalized = true;
   }
@@ -434,8 +649,17 @@ private:
       n[i] = extendedCells[dim - 1 - i];
     n[dim - 1] = extendedCells[0] / 2 + 1;
 
-    allocLocal =
-      FFTW<RF>::mpi_local_size(dim, n, (*traits).comm, &localN0, &local0Start);
+    if (transposed)
+      allocLocal = FFTEngine<RF>::mpi_local_size_transposed(dim,
+                                                            n,
+                                                            (*traits).comm,
+                                                            &localN0,
+                                                            &local0Start,
+                                                            &localN0Trans,
+                                                            &local0StartTrans);
+    else
+      allocLocal = FFTEngine<RF>::mpi_local_size(
+        dim, n, (*traits).comm, &localN0, &local0Start);
   }
 
   /**
@@ -446,15 +670,23 @@ private:
    * array, this is simply the number of cells of the extended domain,
    * with some slight padding in the first dimension, and for the
    * transformed array, the first dimension is cut in half, because the
-   * second half is redundant.
+   * second half is redundant. If the transformed array is stored transposed,
+   * its last two dimensions are switched, and the new last dimension is
+   * distributed as prescribed by FFTW. In 2D, this is the dimension that
+   * was cut in half, which is why it may not be divided evenly.
    */
   void getR2CCells()
   {
     localR2CComplexCells = localExtendedCells;
-    localR2CComplexCells[0] /= 2;
-    localR2CComplexCells[0]++;
-    localR2CComplexDomainSize =
-      localExtendedDomainSize / localExtendedCells[0] * localR2CComplexCells[0];
+    localR2CComplexCells[0] = extendedCells[0] / 2 + 1;
+    if (transposed) {
+      localR2CComplexCells[dim - 2] = extendedCells[dim - 1];
+      localR2CComplexCells[dim - 1] = localN0Trans;
+    }
+
+    localR2CComplexDomainSize = 1;
+    for (unsigned int i = 0; i < dim; i++)
+      localR2CComplexDomainSize *= localR2CComplexCells[i];
 
     localR2CRealCells = localExtendedCells;
     localR2CRealCells[0] = 2 * (localExtendedCells[0] / 2 + 1);
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace parafields {
+
+/**
+ * @brief Exchange of slabs between original and extended domain
+ *
+ * Both the original domain and the extended domain are distributed
+ * along the last dimension, but the extended domain has a different
+ * number of rows (i.e., hyperplanes orthogonal to the last dimension)
+ * per processor. The rows of the original domain therefore generally
+ * belong to other processors when they are embedded in the extended
+ * domain. This class computes the overlap of the two distributions and
+ * moves the rows in either direction using a single MPI_Alltoallv call,
+ * for arbitrary sizes of the extended domain.
+ *
+ * @tparam Traits traits class with data types and definitions
+ */
+template<typename Traits>
+class SlabExchange
+{
+  using RF = typename Traits::RF;
+  using Index = typename Traits::Index;
+
+  MPI_Comm comm;
+  int rank, commSize;
+
+  Index rows;
+  std::vector<int> fieldCounts, fieldDispls;
+  std::vector<int> extendedCounts, extendedDispls;
+
+public:
+  /**
+   * @brief Compute overlap of data distributions
+   *
+   * This function has to be called after the creation of the backend
+   * using it, or after any change of the original or extended domain.
+   *
+   * @param comm_              MPI communicator of the random field
+   * @param sliceSize          number of entries per row of original domain
+   * @param localRows          number of rows of original domain per processor
+   * @param localExtendedRows  number of local rows of extended domain
+   * @param localExtendedStart first local row of extended domain
+   */
+  void update(MPI_Comm comm_,
+              Index sliceSize,
+              Index localRows,
+              Index localExtendedRows,
+              Index localExtendedStart)
+  {
+    comm = comm_;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &commSize);
+
+    std::vector<Index> extendedRows(commSize), extendedStart(commSize);
+    MPI_Allgather(&localExtendedRows,
+                  1,
+                  MPI_UNSIGNED,
+                  extendedRows.data(),
+                  1,
+                  MPI_UNSIGNED,
+                  comm);
+    MPI_Allgather(&localExtendedStart,
+                  1,
+                  MPI_UNSIGNED,
+                  extendedStart.data(),
+                  1,
+                  MPI_UNSIGNED,
+                  comm);
+
+    fieldCounts.assign(commSize, 0);
+    fieldDispls.assign(commSize, 0);
+    extendedCounts.assign(commSize, 0);
+    extendedDispls.assign(commSize, 0);
+
+    const Index myStart = rank * localRows;
+    const Index myEnd = myStart + localRows;
+    const Index myExtStart = extendedStart[rank];
+    const Index myExtEnd = myExtStart + extendedRows[rank];
+
+    rows = 0;
+    for (int i = 0; i < commSize; i++) {
+      // rows of original domain that processor i receives from us
+      const Index sendStart = std::max(myStart, extendedStart[i]);
+      const Index sendEnd = std::min(myEnd, extendedStart[i] + extendedRows[i]);
+      if (sendEnd > sendStart) {
+        fieldCounts[i] = (sendEnd - sendStart) * sliceSize;
+        fieldDispls[i] = (sendStart - myStart) * sliceSize;
+      }
+
+      // rows of original domain that we receive from processor i
+      const Index recvStart = std::max(Index(i * localRows), myExtStart);
+      const Index recvEnd = std::min(Index((i + 1) * localRows), myExtEnd);
+      if (recvEnd > recvStart) {
+        extendedCounts[i] = (recvEnd - recvStart) * sliceSize;
+        extendedDispls[i] = (recvStart - myExtStart) * sliceSize;
+        rows += recvEnd - recvStart;
+      }
+    }
+  }
+
+  /**
+   * @brief Number of rows of the original domain in local extended slab
+   *
+   * These rows are always the first rows of the local part of the
+   * extended domain, since the original domain starts at the origin.
+   *
+   * @return number of rows
+   */
+  Index embeddedRows() const { return rows; }
+
+  /**
+   * @brief Send rows of original domain to owners in extended domain
+   *
+   * @param      field local part of field on original domain
+   * @param[out] slab  rows of original domain in local extended slab
+   */
+  void toExtended(const std::vector<RF>& field, std::vector<RF>& slab) const
+  {
+    Index size = 0;
+    for (int i = 0; i < commSize; i++)
+      size += extendedCounts[i];
+    slab.resize(size);
+
+    MPI_Alltoallv(field.data(),
+                  fieldCounts.data(),
+                  fieldDispls.data(),
+                  mpiType<RF>,
+                  slab.data(),
+                  extendedCounts.data(),
+                  extendedDispls.data(),
+                  mpiType<RF>,
+                  comm);
+  }
+
+  /**
+   * @brief Send rows of extended domain back to owners in original domain
+   *
+   * @param      slab  rows of original domain in local extended slab
+   * @param[out] field local part of field on original domain
+   */
+  void fromExtended(const std::vector<RF>& slab, std::vector<RF>& field) const
+  {
+    MPI_Alltoallv(slab.data(),
+                  extendedCounts.data(),
+                  extendedDispls.data(),
+                  mpiType<RF>,
+                  field.data(),
+                  fieldCounts.data(),
+                  fieldDispls.data(),
+                  mpiType<RF>,
+                  comm);
+  }
+};
+
+} // namespace parafields
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+
+namespace parafields {
+
+/**
+ * @brief Row-wise kernels for boxes in multidimensional arrays
+ *
+ * All arrays are stored with the first dimension running fastest, and a
+ * box (i.e., a rectangular subset of the cells) therefore consists of
+ * contiguous rows along the first dimension. The functions in this class
+ * visit these rows with a loop nest that is unrolled at compile time and
+ * advances flat indices by precomputed strides, so that each row is
+ * handled by a single contiguous operation instead of per-entry index
+ * arithmetic. Source and target always share the ordering of dimensions,
+ * which means the rows are streamed through memory in order and no further
+ * blocking is needed.
+ *
+ * @tparam Index   integer type for flat indices
+ * @tparam Indices array type for per-dimension sizes
+ * @tparam dim     number of dimensions
+ */
+template<typename Index, typename Indices, unsigned int dim>
+class StridedCopy
+{
+public:
+  /**
+   * @brief Call function for each row of a box in two arrays
+   *
+   * The function receives the flat index of the first entry of the row
+   * in the source and target array. Rows are visited in increasing order,
+   * or in decreasing order if reverse is set, which allows in-place
+   * compaction and expansion of arrays, respectively.
+   *
+   * @tparam reverse visit rows in decreasing order if true
+   *
+   * @param count       extent of box per dimension
+   * @param sourceCells cells per dimension of source array
+   * @param sourceStart flat index of first box entry in source array
+   * @param targetCells cells per dimension of target array
+   * @param targetStart flat index of first box entry in target array
+   * @param function    function called for each row
+   */
+  template<bool reverse = false, typename Function>
+  static void forEachRow(const Indices& count,
+                         const Indices& sourceCells,
+                         Index sourceStart,
+                         const Indices& targetCells,
+                         Index targetStart,
+                         Function&& function)
+  {
+    for (unsigned int i = 0; i < dim; i++)
+      if (count[i] == 0)
+        return;
+
+    Indices sourceStride, targetStride;
+    sourceStride[0] = 1;
+    targetStride[0] = 1;
+    for (unsigned int i = 1; i < dim; i++) {
+      sourceStride[i] = sourceStride[i - 1] * sourceCells[i - 1];
+      targetStride[i] = targetStride[i - 1] * targetCells[i - 1];
+    }
+
+    rowLoop<dim - 1, reverse>(
+      count, sourceStride, targetStride, sourceStart, targetStart, function);
+  }
+
+  /**
+   * @brief Copy box from one array to another
+   *
+   * Source and target may be the same array, as long as each row is read
+   * before it is overwritten, i.e., for compaction with reverse set to
+   * false and for expansion with reverse set to true.
+   *
+   * @tparam reverse visit rows in decreasing order if true
+   */
+  template<bool reverse = false, typename RF>
+  static void copy(const Indices& count,
+                   const RF* source,
+                   const Indices& sourceCells,
+                   Index sourceStart,
+                   RF* target,
+                   const Indices& targetCells,
+                   Index targetStart)
+  {
+    const std::size_t rowBytes = count[0] * sizeof(RF);
+    forEachRow<reverse>(count,
+                        sourceCells,
+                        sourceStart,
+                        targetCells,
+                        targetStart,
+                        [&](Index sourceIndex, Index targetIndex) {
+                          std::memmove(target + targetIndex,
+                                       source + sourceIndex,
+                                       rowBytes);
+                        });
+  }
+
+  /**
+   * @brief Add box of one array to another
+   */
+  template<typename RF>
+  static void add(const Indices& count,
+                  const RF* source,
+                  const Indices& sourceCells,
+                  Index sourceStart,
+                  RF* target,
+                  const Indices& targetCells,
+                  Index targetStart)
+  {
+    const Index rowLength = count[0];
+    forEachRow(count,
+               sourceCells,
+               sourceStart,
+               targetCells,
+               targetStart,
+               [&](Index sourceIndex, Index targetIndex) {
+                 const RF* in = source + sourceIndex;
+                 RF* out = target + targetIndex;
+                 for (Index i = 0; i < rowLength; i++)
+                   out[i] += in[i];
+               });
+  }
+
+  /**
+   * @brief Set box of an array to given value
+   */
+  template<typename RF>
+  static void fill(const Indices& count,
+                   RF* target,
+                   const Indices& targetCells,
+                   Index targetStart,
+                   RF value)
+  {
+    const Index rowLength = count[0];
+    forEachRow(count,
+               targetCells,
+               targetStart,
+               targetCells,
+               targetStart,
+               [&](Index, Index targetIndex) {
+                 std::fill_n(target + targetIndex, rowLength, value);
+               });
+  }
+
+private:
+  /**
+   * @brief Loop nest for forEachRow, unrolled over dimensions
+   */
+  template<unsigned int currentDim, bool reverse, typename Function>
+  static void rowLoop(const Indices& count,
+                      const Indices& sourceStride,
+                      const Indices& targetStride,
+                      Index source,
+                      Index target,
+                      Function& function)
+  {
+    if constexpr (currentDim == 0)
+      function(source, target);
+    else if constexpr (reverse) {
+      source += (count[currentDim] - 1) * sourceStride[currentDim];
+      target += (count[currentDim] - 1) * targetStride[currentDim];
+      for (Index i = 0; i < count[currentDim]; i++) {
+        rowLoop<currentDim - 1, reverse>(
+          count, sourceStride, targetStride, source, target, function);
+        source -= sourceStride[currentDim];
+        target -= targetStride[currentDim];
+      }
+    } else {
+      for (Index i = 0; i < count[currentDim]; i++) {
+        rowLoop<currentDim - 1, reverse>(
+          count, sourceStride, targetStride, source, target, function);
+        source += sourceStride[currentDim];
+        target += targetStride[currentDim];
+      }
+    }
+  }
+};
+
+} // namespace parafields
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dune/common/parametertree.hh>
+
+#include <parafields/backends/fftengine.hh>
+
+namespace parafields {
+
+/**
+ * @brief Mutex serializing access to the FFTW planner
+ *
+ * Only the execution of plans is thread-safe in FFTW, while creating and
+ * destroying plans and handling wisdom modify global state. This mutex
+ * protects these operations in all backends, e.g., during background
+ * setup of covariance matrices. In MPI builds, planning and wisdom
+ * handling may be collective, so all processors have to acquire the
+ * mutex in the same order, see Matrix::prepareAsync.
+ *
+ * @return process-wide planner mutex
+ */
+inline std::mutex&
+plannerMutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+/**
+ * @brief Planner settings requested by the calling thread
+ *
+ * The number of threads and the current wisdom are global state of FFTW,
+ * so plannerFlags only records them per thread, and createPlan applies
+ * them while holding the planner mutex.
+ */
+struct PlannerSettings
+{
+  //! number of threads per plan
+  int threads = 1;
+  //! switches to the wisdom of the planned geometry, if any
+  std::function<void()> activateWisdom;
+};
+
+/**
+ * @brief Planner settings of the calling thread
+ *
+ * @return thread-local settings object
+ */
+inline PlannerSettings&
+plannerSettings()
+{
+  thread_local PlannerSettings settings;
+  return settings;
+}
+
+/**
+ * @brief Create plan without losing the contents of its array
+ *
+ * FFTW overwrites the arrays of a plan while measuring, i.e., for all
+ * planner flags except FFTW_ESTIMATE, and plans are created directly on
+ * the local arrays of the backends, which already contain data at that
+ * point. In that case, the array is saved in a scratch buffer before
+ * planning and restored afterwards. A size of zero can be passed if the
+ * array doesn't contain data yet. The planner function is called with
+ * the planner mutex held, and with the settings of the last call to
+ * plannerFlags on this thread.
+ *
+ * @param data    local array the plan acts on
+ * @param size    number of real values in the local array
+ * @param flags   FFTW planner flags
+ * @param planner function creating and returning the plan
+ *
+ * @return plan created by the planner function
+ */
+template<typename RF, typename Planner>
+typename FFTEngine<RF>::plan
+createPlan(RF* data, std::size_t size, unsigned int flags, Planner&& planner)
+{
+  const std::lock_guard<std::mutex> lock(plannerMutex());
+  plannerThreads(plannerSettings().threads);
+  if (plannerSettings().activateWisdom)
+    plannerSettings().activateWisdom();
+
+  if (flags & FFTW_ESTIMATE)
+    return planner();
+
+  const std::vector<RF> scratch(data, data + size);
+  typename FFTEngine<RF>::plan plan = planner();
+  std::copy(scratch.begin(), scratch.end(), data);
+  return plan;
+}
+
+/**
+ * @brief Destroy plan while holding the planner mutex
+ *
+ * @param plan plan created by createPlan
+ */
+template<typename RF>
+void
+destroyPlan(typename FFTEngine<RF>::plan plan)
+{
+  const std::lock_guard<std::mutex> lock(plannerMutex());
+  FFTEngine<RF>::destroy_plan(plan);
+}
+
+/**
+ * @brief Process-wide manager for FFTW wisdom files
+ *
+ * FFTW wisdom is global state of the process, so it is sufficient to
+ * load it once per process and geometry, instead of once per backend
+ * object. Wisdom is stored in the directory fftw.wisdomDirectory (default:
+ * working directory), in files named after the precision, the number of
+ * processors and the extended domain, since plans for other geometries
+ * are useless for a given run anyway. Loading and storing are collective
+ * operations, but communication beyond a single reduction and file access
+ * only take place if a file hasn't been loaded yet, or if planning has
+ * produced new wisdom since it was last written. Files are written to a
+ * temporary file first, which is then renamed, so that concurrent runs
+ * in the same directory never see incomplete files.
+ *
+ * FFTW can only export all of its wisdom at once, so only the wisdom of
+ * a single geometry is kept in FFTW at any time, and that of the others
+ * is set aside. Switching between geometries happens in plannerFlags,
+ * right before planning, which keeps the files free of plans for other
+ * geometries. Loading and storing lock the planner mutex.
+ *
+ * @tparam RF data type of FFTW library
+ */
+template<typename RF>
+class FFTWWisdom
+{
+public:
+  /**
+   * @brief Import wisdom for given geometry, if not done already
+   *
+   * Has to be called collectively.
+   *
+   * @param comm          communicator of the random field
+   * @param config        configuration of the random field
+   * @param extendedCells number of cells of the extended domain
+   */
+  template<typename Indices>
+  static void load(MPI_Comm comm,
+                   const Dune::ParameterTree& config,
+                   const Indices& extendedCells)
+  {
+    const std::lock_guard<std::mutex> lock(plannerMutex());
+    const std::string& name = fileName(comm, config, extendedCells);
+    activate(name);
+    int missing = (known().count(name) == 0);
+    MPI_Allreduce(MPI_IN_PLACE, &missing, 1, MPI_INT, MPI_LOR, comm);
+    if (!missing)
+      return;
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0)
+      FFTEngine<RF>::import_wisdom_from_filename(name.c_str());
+    FFTEngine<RF>::mpi_broadcast_wisdom(comm);
+
+    known()[name] = FFTEngine<RF>::export_wisdom_to_string();
+  }
+
+  /**
+   * @brief Export wisdom for given geometry, if it has changed
+   *
+   * Has to be called collectively. Failure to write is not an error,
+   * since wisdom only affects performance.
+   *
+   * @param comm          communicator of the random field
+   * @param config        configuration of the random field
+   * @param extendedCells number of cells of the extended domain
+   */
+  template<typename Indices>
+  static void store(MPI_Comm comm,
+                    const Dune::ParameterTree& config,
+                    const Indices& extendedCells)
+  {
+    const std::lock_guard<std::mutex> lock(plannerMutex());
+    const std::string& name = fileName(comm, config, extendedCells);
+    activate(name);
+    const std::string& wisdom = FFTEngine<RF>::export_wisdom_to_string();
+    int changed = (known()[name] != wisdom);
+    MPI_Allreduce(MPI_IN_PLACE, &changed, 1, MPI_INT, MPI_LOR, comm);
+    if (!changed)
+      return;
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    FFTEngine<RF>::mpi_gather_wisdom(comm);
+    if (rank == 0)
+      writeAtomically(name, FFTEngine<RF>::export_wisdom_to_string());
+
+    known()[name] = FFTEngine<RF>::export_wisdom_to_string();
+  }
+
+  /**
+   * @brief Function making wisdom of given geometry the current wisdom
+   *
+   * The returned function sets the wisdom of the current geometry aside,
+   * and restores the wisdom of the given one, if there is any. It doesn't
+   * communicate, and has to be called with the planner mutex held.
+   *
+   * @param comm          communicator of the random field
+   * @param config        configuration of the random field
+   * @param extendedCells number of cells of the extended domain
+   *
+   * @return function switching the current wisdom
+   */
+  template<typename Indices>
+  static std::function<void()> activation(MPI_Comm comm,
+                                          const Dune::ParameterTree& config,
+                                          const Indices& extendedCells)
+  {
+    return [name = fileName(comm, config, extendedCells)] { activate(name); };
+  }
+
+  /**
+   * @brief Replace file contents without exposing incomplete files
+   *
+   * @param name     name of the file
+   * @param contents new contents of the file
+   *
+   * @return true if the file was written, else false
+   */
+  static bool writeAtomically(const std::string& name,
+                              const std::string& contents)
+  {
+    const std::string tmpName =
+      name + "." + std::to_string(std::uint64_t(std::random_device{}()));
+    {
+      std::ofstream file(tmpName, std::ofstream::trunc);
+      file << contents;
+      if (!file) {
+        std::remove(tmpName.c_str());
+        return false;
+      }
+    }
+
+    if (std::rename(tmpName.c_str(), name.c_str()) != 0) {
+      std::remove(tmpName.c_str());
+      return false;
+    }
+    return true;
+  }
+
+private:
+  /**
+   * @brief Switch current wisdom of FFTW to given file
+   *
+   * @param name name of the wisdom file
+   */
+  static void activate(const std::string& name)
+  {
+    if (name == active())
+      return;
+
+    if (!active().empty())
+      inactive()[active()] = FFTEngine<RF>::export_wisdom_to_string();
+    FFTEngine<RF>::forget_wisdom();
+
+    const auto it = inactive().find(name);
+    if (it != inactive().end()) {
+      FFTEngine<RF>::import_wisdom_from_string(it->second);
+      inactive().erase(it);
+    }
+    active() = name;
+  }
+
+  /**
+   * @brief Wisdom as of last import or export, per file
+   *
+   * @return map from file name to wisdom string
+   */
+  static std::map<std::string, std::string>& known()
+  {
+    static std::map<std::string, std::string> wisdom;
+    return wisdom;
+  }
+
+  /**
+   * @brief Wisdom of geometries that are currently set aside, per file
+   *
+   * @return map from file name to wisdom string
+   */
+  static std::map<std::string, std::string>& inactive()
+  {
+    static std::map<std::string, std::string> wisdom;
+    return wisdom;
+  }
+
+  /**
+   * @brief File whose wisdom is the current wisdom of FFTW
+   *
+   * @return file name, or empty string if there is none
+   */
+  static std::string& active()
+  {
+    static std::string name;
+    return name;
+  }
+
+  /**
+   * @brief Name of wisdom file for given geometry
+   *
+   * @param comm          communicator of the random field
+   * @param config        configuration of the random field
+   * @param extendedCells number of cells of the extended domain
+   *
+   * @return file name, including directory
+   */
+  template<typename Indices>
+  static std::string fileName(MPI_Comm comm,
+                              const Dune::ParameterTree& config,
+                              const Indices& extendedCells)
+  {
+    int commSize;
+    MPI_Comm_size(comm, &commSize);
+
+    std::ostringstream name;
+    name << config.get<std::string>("fftw.wisdomDirectory", ".")
+         << "/wisdom-" << 8 * sizeof(RF) << "bit-" << commSize << "procs-"
+         << extendedCells[0];
+    for (unsigned int i = 1; i < extendedCells.size(); i++)
+      name << "x" << extendedCells[i];
+    name << ".fftw";
+    return name.str();
+  }
+};
+
+/**
+ * @brief FFTW planner flags requested by configuration
+ *
+ * The planner is FFTW_PATIENT if fftw.patient is set, FFTW_MEASURE if
+ * fftw.measure is set, and FFTW_ESTIMATE otherwise. Patient planning is
+ * typically too expensive to be done during production runs, and is
+ * meant to be combined with wisdom that has been created beforehand,
+ * e.g., using the parafields-wisdom tool. Has to be called before
+ * planning, since it records the planner settings of the given field
+ * for the calling thread, which are then applied by createPlan.
+ *
+ * In serial builds and with the native FFT engine, this includes the
+ * number of threads of the plan, as given by fftw.threads (default: one).
+ * If fftw.useWisdom is set, the wisdom of the geometry of the field is
+ * activated, so that the resulting plans are stored in its file.
+ *
+ * @param traits traits object of the random field
+ *
+ * @return flags for FFTW plan creation
+ */
+template<typename Traits>
+unsigned int
+plannerFlags(const Traits& traits)
+{
+  const Dune::ParameterTree& config = traits.config;
+  PlannerSettings& settings = plannerSettings();
+  settings.threads = config.template get<int>("fftw.threads", 1);
+  settings.activateWisdom = nullptr;
+  if (config.template get<bool>("fftw.useWisdom", false))
+    settings.activateWisdom = FFTWWisdom<typename Traits::RF>::activation(
+      traits.comm, config, traits.extendedCells);
+
+  if (config.template get<bool>("fftw.patient", false))
+    return FFTW_PATIENT;
+  else if (config.template get<bool>("fftw.measure", false))
+    return FFTW_MEASURE;
+  else
+    return FFTW_ESTIMATE;
+}
+
+} // namespace parafields
@@ -0,0 +1,755 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <dune/common/parametertree.hh>
+#include <dune/common/parametertreeparser.hh>
+
+#include "parafields/backends/cpprngbackend.hh"
+#include "parafields/matrix.hh"
+
+namespace parafields {
+
+/**
+ * @brief Short name of a built-in backend, used in configuration files
+ */
+template<typename Backend>
+struct BackendName;
+
+template<typename Traits>
+struct BackendName<DCTMatrixBackend<Traits>>
+{
+  static constexpr const char* value = "dct";
+};
+
+template<typename Traits>
+struct BackendName<FourStepMatrixBackend<Traits>>
+{
+  static constexpr const char* value = "fourstep";
+};
+
+template<typename Traits>
+struct BackendName<DFTMatrixBackend<Traits>>
+{
+  static constexpr const char* value = "dft";
+};
+
+template<typename Traits>
+struct BackendName<R2CMatrixBackend<Traits>>
+{
+  static constexpr const char* value = "r2c";
+};
+
+template<typename Traits>
+struct BackendName<DCTDSTFieldBackend<Traits>>
+{
+  static constexpr const char* value = "dctdst";
+};
+
+template<typename Traits>
+struct BackendName<DFTFieldBackend<Traits>>
+{
+  static constexpr const char* value = "dft";
+};
+
+template<typename Traits>
+struct BackendName<FourStepFieldBackend<Traits>>
+{
+  static constexpr const char* value = "fourstep";
+};
+
+template<typename Traits>
+struct BackendName<R2CFieldBackend<Traits>>
+{
+  static constexpr const char* value = "r2c";
+};
+
+/**
+ * @brief Covariance matrix with backends chosen at runtime
+ *
+ * Which combination of matrix backend and field backend is fastest depends
+ * on dimension, grid shape, number of processors and precision. This class
+ * holds one of several Matrix types and forwards all calls to it. The
+ * combination is chosen through the configuration key randomField.backends,
+ * which is either the name of a candidate, i.e., the names of matrix and
+ * field backend joined by a hyphen (e.g., "dct-r2c"), "default" for the
+ * first candidate that supports the covariance function, or "autotune".
+ * In 1D, the default skips the DCT matrix backend on several processors,
+ * since its transforms aren't distributed, unless nothing else fits.
+ * In the latter case, each candidate that supports the covariance function
+ * is set up on the actual communicator, one field is generated and
+ * multiplied with the matrix, and the candidate with the shortest time is
+ * kept, including its transformed matrix. If fftw.useWisdom is set, the
+ * decision is stored in the file wisdom-DispatchMatrix.ini in the
+ * directory fftw.wisdomDirectory, next to the FFTW wisdom, under a key
+ * describing the geometry, and later runs with the same geometry use it
+ * directly.
+ *
+ * The choice is made on first use, and made anew after refinement or
+ * coarsening, i.e., whenever the geometry changes. Custom covariance
+ * functions can only be autotuned if they are passed using
+ * fillTransformedMatrix before the matrix is used in any other way, else
+ * the default candidate is used. In 2D, at least one candidate combines
+ * R2C and non-R2C backends, which means the transposed frequency layout
+ * is disabled for all of them.
+ *
+ * @tparam Traits     traits class with data types and definitions
+ * @tparam Candidates Matrix types that may be selected
+ */
+template<typename Traits, typename... Candidates>
+class DispatchMatrix
+{
+  using First = std::tuple_element_t<0, std::tuple<Candidates...>>;
+
+public:
+  // backends of first candidate, for type queries of the traits class
+  using MatrixBackendType = typename First::MatrixBackendType;
+  using FieldBackendType = typename First::FieldBackendType;
+
+  using StochasticPartType = StochasticPart<Traits>;
+
+  //! whether all candidates agree on the transposed frequency layout in 2D
+  static constexpr bool transposedLayoutCompatible =
+    (Candidates::transposedLayoutCompatible && ...);
+
+  //! whether all candidates split 1D data into equal blocks
+  static constexpr bool blockDistribution =
+    (Candidates::blockDistribution && ...);
+
+private:
+  using RF = typename Traits::RF;
+
+  static constexpr std::size_t candidateCount = sizeof...(Candidates);
+
+  const std::shared_ptr<Traits> traits;
+
+  mutable std::variant<std::shared_ptr<Candidates>...> matrix;
+  mutable std::string selectedGeometry;
+
+  mutable std::shared_ptr<OutOfCoreGenerator<Traits>> outOfCore;
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param traits_ shared pointer to traits class containing parameters
+   */
+  DispatchMatrix(const std::shared_ptr<Traits>& traits_)
+    : traits(traits_)
+  {}
+
+  /*
+   * @brief Update internal data after creation or refinement
+   *
+   * Discards the selected candidate if the geometry has changed, since
+   * the best choice depends on it, and a new candidate is selected on
+   * next use. Else the selected candidate is kept and updated, which
+   * preserves the result of autotuning.
+   */
+  void update()
+  {
+    outOfCore.reset();
+    if (selected() && decisionKey() == selectedGeometry)
+      visit([](auto& candidate) { candidate.update(); });
+    else
+      matrix = std::shared_ptr<First>();
+  }
+
+  /**
+   * @brief Update matrix after change of variance or correlation length
+   *
+   * @param corrLengthChanged true if the correlation length is different
+   *
+   * @see Matrix::updateHyperparameters
+   */
+  void updateHyperparameters(bool corrLengthChanged)
+  {
+    outOfCore.reset();
+    if (selected())
+      visit([&](auto& candidate) {
+        candidate.updateHyperparameters(corrLengthChanged);
+      });
+  }
+
+  /**
+   * @brief Multiply random field with covariance matrix
+   *
+   * @see Matrix::operator*
+   */
+  StochasticPartType operator*(const StochasticPartType& input) const
+  {
+    return visit([&](auto& candidate) { return candidate * input; });
+  }
+
+  /**
+   * @brief Multiply random field with root of covariance matrix
+   *
+   * @see Matrix::multiplyRoot
+   */
+  StochasticPartType multiplyRoot(const StochasticPartType& input) const
+  {
+    return visit(
+      [&](auto& candidate) { return candidate.multiplyRoot(input); });
+  }
+
+  /**
+   * @brief Multiply random field with inverse of covariance matrix
+   *
+   * @see Matrix::multiplyInverse
+   */
+  StochasticPartType multiplyInverse(const StochasticPartType& input) const
+  {
+    return visit(
+      [&](auto& candidate) { return candidate.multiplyInverse(input); });
+  }
+
+  /**
+   * @brief Compute entries of Fourier-transformed covariance matrix
+   *
+   * If no candidate has been selected yet and autotuning has been
+   * requested, the candidates are set up with the given covariance
+   * function while timing them.
+   *
+   * @tparam Covariance type of custom covariance class, or string
+   *
+   * @see Matrix::fillTransformedMatrix
+   */
+  template<typename Covariance>
+  void fillTransformedMatrix(Covariance&& covariance) const
+  {
+    const auto setup = [&](auto& candidate) {
+      candidate.fillTransformedMatrix(covariance);
+    };
+
+    if (!select(setup, true))
+      visit(setup);
+  }
+
+  /**
+   * @brief Start computation of transformed matrix in the background
+   *
+   * Autotuning, if requested, happens before this function returns, since
+   * it has to set up and time the candidates collectively.
+   *
+   * @see Matrix::prepareAsync
+   */
+  void prepareAsync() const
+  {
+    visit([](auto& candidate) { candidate.prepareAsync(); });
+  }
+
+  /**
+   * @brief Wait for background computation of transformed matrix
+   *
+   * @see Matrix::waitReady
+   */
+  void waitReady() const
+  {
+    if (selected())
+      visit([](auto& candidate) { candidate.waitReady(); });
+  }
+
+  /**
+   * @brief Compute transformed matrices for several sets of hyperparameters
+   *
+   * Selects a candidate for each of the matrices, and then forwards the
+   * matrices that use the same candidate as one batch.
+   *
+   * @param matrices matrices that should be set up
+   *
+   * @see Matrix::fillTransformedMatrices
+   */
+  static void fillTransformedMatrices(
+    const std::vector<const DispatchMatrix*>& matrices)
+  {
+    for (const DispatchMatrix* matrix : matrices)
+      matrix->visit([](auto&) {});
+
+    (fillBatch<Candidates>(matrices), ...);
+  }
+
+  /**
+   * @brief Generate random field based on covariance matrix
+   *
+   * @see Matrix::generateField
+   */
+  template<typename RNG>
+  void generateField(RNG& rngBackend, StochasticPartType& stochasticPart) const
+  {
+    visit([&](auto& candidate) {
+      candidate.generateField(rngBackend, stochasticPart);
+    });
+  }
+
+  /**
+   * @brief Select modes for reduced-rank sampling
+   *
+   * @see Matrix::setupReducedRank
+   */
+  void setupReducedRank(unsigned int count) const
+  {
+    visit([&](auto& candidate) { candidate.setupReducedRank(count); });
+  }
+
+  /**
+   * @brief Modes selected for reduced-rank sampling
+   *
+   * @see Matrix::reducedRankModes
+   */
+  const ReducedRankModes<Traits>& reducedRankModes() const
+  {
+    return visit([](auto& candidate) -> const ReducedRankModes<Traits>& {
+      return candidate.reducedRankModes();
+    });
+  }
+
+  /**
+   * @brief Generate random field from reduced-rank coefficients
+   *
+   * @see Matrix::generateFieldFromCoefficients
+   */
+  void generateFieldFromCoefficients(const std::vector<RF>& coefficients,
+                                     StochasticPartType& stochasticPart) const
+  {
+    visit([&](auto& candidate) {
+      candidate.generateFieldFromCoefficients(coefficients, stochasticPart);
+    });
+  }
+
+  /**
+   * @brief Generate random field without keeping it in memory
+   *
+   * Out-of-core generation doesn't use the backends, so no candidate is
+   * selected, and the covariance function is taken from the first one.
+   *
+   * @see Matrix::generateFieldOutOfCore
+   */
+  template<typename RNG>
+  void generateFieldOutOfCore(RNG& rngBackend,
+                              const std::string& fileName) const
+  {
+    if ((*traits).covariance == "custom-iso" ||
+        (*traits).covariance == "custom-aniso")
+      throw std::runtime_error{
+        "out-of-core generation requires a built-in covariance function"
+      };
+
+    if (!outOfCore)
+      outOfCore = std::make_shared<OutOfCoreGenerator<Traits>>(
+        traits, First(traits).covarianceEvaluator());
+
+    outOfCore->generate(rngBackend, fileName);
+  }
+
+  /**
+   * @brief Generate uncorrelated random field (i.e., noise)
+   *
+   * @see Matrix::generateUncorrelatedField
+   */
+  void generateUncorrelatedField(unsigned int seed,
+                                 StochasticPartType& stochasticPart) const
+  {
+    visit([&](auto& candidate) {
+      candidate.generateUncorrelatedField(seed, stochasticPart);
+    });
+  }
+
+  /**
+   * @brief Create field that represents the local variance
+   *
+   * @see Matrix::setVarianceAsField
+   */
+  void setVarianceAsField(StochasticPartType& stochasticPart) const
+  {
+    visit(
+      [&](auto& candidate) { candidate.setVarianceAsField(stochasticPart); });
+  }
+
+  /**
+   * @brief Name of the selected candidate
+   *
+   * Selects a candidate if this hasn't happened yet.
+   *
+   * @return names of matrix and field backend, joined by a hyphen
+   */
+  std::string backends() const
+  {
+    visit([](auto&) {});
+    return names()[matrix.index()];
+  }
+
+private:
+  /**
+   * @brief Whether a candidate has been selected
+   */
+  bool selected() const
+  {
+    return std::visit([](const auto& candidate) { return bool(candidate); },
+                      matrix);
+  }
+
+  /**
+   * @brief Call function with selected candidate, selecting one if needed
+   *
+   * @param function function receiving reference to candidate
+   *
+   * @return return value of function
+   */
+  template<typename Function>
+  decltype(auto) visit(Function&& function) const
+  {
+    // custom covariance functions have to be passed for autotuning
+    const bool custom = (*traits).covariance == "custom-iso" ||
+                        (*traits).covariance == "custom-aniso";
+    select(
+      [&](auto& candidate) {
+        candidate.fillTransformedMatrix((*traits).covariance);
+      },
+      !custom);
+
+    return std::visit(
+      [&](const auto& candidate) -> decltype(auto) {
+        return function(*candidate);
+      },
+      matrix);
+  }
+
+  /**
+   * @brief Forward matrices using a given candidate as a batch
+   *
+   * @tparam Candidate candidate the batch is restricted to
+   *
+   * @param matrices matrices that should be set up
+   */
+  template<typename Candidate>
+  static void fillBatch(const std::vector<const DispatchMatrix*>& matrices)
+  {
+    std::vector<const Candidate*> batch;
+    for (const DispatchMatrix* matrix : matrices)
+      if (auto candidate =
+            std::get_if<std::shared_ptr<Candidate>>(&matrix->matrix))
+        batch.push_back(candidate->get());
+
+    Candidate::fillTransformedMatrices(batch);
+  }
+
+  /**
+   * @brief Names of the candidates, in order
+   */
+  static const std::array<std::string, candidateCount>& names()
+  {
+    static const std::array<std::string, candidateCount> list = {
+      (std::string(BackendName<typename Candidates::MatrixBackendType>::value) +
+       "-" + BackendName<typename Candidates::FieldBackendType>::value)...
+    };
+    return list;
+  }
+
+  /**
+   * @brief Whether the covariance function is symmetric in each dimension
+   */
+  bool symmetric() const
+  {
+    const std::string& anisotropy = (*traits).config.template get<std::string>(
+      "stochastic.anisotropy", "none");
+    return (*traits).covariance != "custom-aniso" &&
+           (anisotropy == "none" || anisotropy == "axiparallel");
+  }
+
+  /**
+   * @brief Whether each candidate supports the configured covariance
+   *
+   * The DCT matrix backend relies on symmetry of the covariance function
+   * in each dimension, which excludes general anisotropy.
+   */
+  std::array<bool, candidateCount> compatible() const
+  {
+    return { (symmetric() ||
+              !std::is_same<typename Candidates::MatrixBackendType,
+                            DCTMatrixBackend<Traits>>::value)... };
+  }
+
+  /**
+   * @brief Whether each candidate may be chosen by default
+   *
+   * In 1D, each processor gathers the whole DCT matrix and transforms it
+   * sequentially, which only pays off on a single processor.
+   */
+  std::array<bool, candidateCount> preferred() const
+  {
+    return { (Traits::dim > 1 || (*traits).commSize == 1 ||
+              !std::is_same<typename Candidates::MatrixBackendType,
+                            DCTMatrixBackend<Traits>>::value)... };
+  }
+
+  /**
+   * @brief Create candidate with given index
+   */
+  template<std::size_t... I>
+  void create(std::size_t index, std::index_sequence<I...>) const
+  {
+    ((index == I ? (void)(matrix = std::make_shared<Candidates>(traits))
+                 : (void)0),
+     ...);
+  }
+
+  /**
+   * @brief Select candidate according to configuration
+   *
+   * @param setup   function setting up the matrix of a candidate
+   * @param tunable whether setup can be used for autotuning
+   *
+   * @return true if the matrix of the selected candidate has been set up
+   */
+  template<typename Setup>
+  bool select(Setup&& setup, bool tunable) const
+  {
+    if (selected())
+      return false;
+
+    const std::string& choice = (*traits).config.template get<std::string>(
+      "randomField.backends", "default");
+    const std::array<bool, candidateCount> supported = compatible();
+
+    const std::array<bool, candidateCount> usual = preferred();
+
+    std::size_t index = 0;
+    while (!supported[index])
+      index++;
+    for (std::size_t i = index; i < candidateCount; i++)
+      if (supported[i] && usual[i]) {
+        index = i;
+        break;
+      }
+
+    bool tuned = false;
+    if (choice == "autotune") {
+      const bool useWisdom =
+        (*traits).config.template get<bool>("fftw.useWisdom", false);
+      const std::size_t stored = useWisdom ? loadDecision() : candidateCount;
+
+      if (stored < candidateCount && supported[stored])
+        index = stored;
+      else if (tunable) {
+        index = tune(supported, setup);
+        tuned = true;
+        if (useWisdom)
+          storeDecision(index);
+      }
+    } else if (choice != "default") {
+      for (index = 0; index < candidateCount; index++)
+        if (names()[index] == choice)
+          break;
+
+      if (index == candidateCount)
+        throw std::runtime_error{ "unknown backends: " + choice };
+      if (!supported[index])
+        throw std::runtime_error{ "backends " + choice +
+                                  " don't support covariance function" };
+    }
+
+    if (!tuned)
+      create(index, std::index_sequence_for<Candidates...>{});
+    selectedGeometry = decisionKey();
+
+    if ((*traits).verbose && (*traits).rank == 0)
+      std::cout << "using backends " << names()[index] << std::endl;
+
+    return tuned;
+  }
+
+  /**
+   * @brief Time all supported candidates and keep the fastest one
+   *
+   * Each candidate is set up, and the time needed for generating one field
+   * and multiplying it with the matrix is measured. The maximum across
+   * processors counts, and the candidate with the shortest time is kept.
+   *
+   * @param supported whether each candidate supports the covariance
+   * @param setup     function setting up the matrix of a candidate
+   *
+   * @return index of fastest candidate
+   */
+  template<typename Setup>
+  std::size_t tune(const std::array<bool, candidateCount>& supported,
+                   Setup&& setup) const
+  {
+    std::size_t best = candidateCount;
+    double bestTime = std::numeric_limits<double>::max();
+    std::variant<std::shared_ptr<Candidates>...> bestMatrix;
+
+    for (std::size_t index = 0; index < candidateCount; index++) {
+      if (!supported[index])
+        continue;
+
+      create(index, std::index_sequence_for<Candidates...>{});
+      const double time = std::visit(
+        [&](const auto& candidate) {
+          setup(*candidate);
+
+          StochasticPartType field(traits, "");
+          CppRNGBackend<Traits> rngBackend(traits);
+          rngBackend.seed(0);
+
+          MPI_Barrier((*traits).comm);
+          const auto start = std::chrono::steady_clock::now();
+          candidate->generateField(rngBackend, field);
+          const StochasticPartType product = (*candidate) * field;
+          const std::chrono::duration<double> duration =
+            std::chrono::steady_clock::now() - start;
+
+          // the spare field of the timing run mustn't become the next sample
+          candidate->spareValid = false;
+
+          double time = duration.count();
+          MPI_Allreduce(
+            MPI_IN_PLACE, &time, 1, MPI_DOUBLE, MPI_MAX, (*traits).comm);
+          return time;
+        },
+        matrix);
+
+      if ((*traits).verbose && (*traits).rank == 0)
+        std::cout << "autotune: " << names()[index] << " " << time << "s"
+                  << std::endl;
+
+      if (time < bestTime) {
+        best = index;
+        bestTime = time;
+        bestMatrix = matrix;
+      }
+    }
+
+    matrix = bestMatrix;
+    return best;
+  }
+
+  /**
+   * @brief Key describing the geometry in the decision file
+   */
+  std::string decisionKey() const
+  {
+    std::ostringstream key;
+    key << (symmetric() ? "iso" : "aniso") << "_" << 8 * sizeof(RF) << "bit_"
+        << (*traits).commSize << "procs";
+    for (const auto& cells : { (*traits).cells, (*traits).extendedCells }) {
+      key << "_" << cells[0];
+      for (unsigned int i = 1; i < Traits::dim; i++)
+        key << "x" << cells[i];
+    }
+    return key.str();
+  }
+
+  /**
+   * @brief Name of file containing stored decisions
+   *
+   * @return file name, including directory
+   */
+  std::string decisionFile() const
+  {
+    return (*traits).config.template get<std::string>(
+             "fftw.wisdomDirectory", ".") +
+           "/wisdom-DispatchMatrix.ini";
+  }
+
+  /**
+   * @brief Read decision for current geometry from file
+   *
+   * @return index of stored candidate, or number of candidates if none
+   */
+  std::size_t loadDecision() const
+  {
+    unsigned int index = candidateCount;
+    if ((*traits).rank == 0) {
+      Dune::ParameterTree decisions;
+      std::ifstream file(decisionFile());
+      if (file)
+        Dune::ParameterTreeParser::readINITree(file, decisions);
+
+      const std::string& name =
+        decisions.get<std::string>(decisionKey(), "");
+      for (index = 0; index < candidateCount; index++)
+        if (names()[index] == name)
+          break;
+    }
+
+    MPI_Bcast(&index, 1, MPI_UNSIGNED, 0, (*traits).comm);
+    return index;
+  }
+
+  /**
+   * @brief Write decision for current geometry to file
+   *
+   * @param index index of selected candidate
+   */
+  void storeDecision(std::size_t index) const
+  {
+    if ((*traits).rank != 0)
+      return;
+
+    Dune::ParameterTree decisions;
+    {
+      std::ifstream file(decisionFile());
+      if (file)
+        Dune::ParameterTreeParser::readINITree(file, decisions);
+    }
+
+    decisions[decisionKey()] = names()[index];
+    std::ostringstream contents;
+    decisions.report(contents);
+    FFTWWisdom<RF>::writeAtomically(decisionFile(), contents.str());
+  }
+};
+
+/**
+ * @brief Runtime-dispatching matrix selector for nD, n > 1
+ *
+ * The first candidate that supports the covariance function is the
+ * default, which matches DefaultIsoMatrix and DefaultAnisoMatrix.
+ */
+template<long unsigned int dim>
+class AutoMatrix
+{
+public:
+  template<typename T>
+  using Type = DispatchMatrix<T,
+                              Matrix<T, DCTMatrixBackend, R2CFieldBackend>,
+                              Matrix<T, R2CMatrixBackend, R2CFieldBackend>,
+                              Matrix<T, DFTMatrixBackend, DFTFieldBackend>,
+                              Matrix<T, DCTMatrixBackend, DCTDSTFieldBackend>>;
+};
+
+/**
+ * @brief Runtime-dispatching matrix selector for 1D: DCT, DFT or four-step
+ *
+ * The first candidate that supports the covariance function is the
+ * default, as for nD, except that the DFT matrix backend replaces the DCT
+ * one on several processors, which matches DefaultIsoMatrix. Since the
+ * DFT field backend is among the candidates, the number of cells has to
+ * be a multiple of the square of the number of processors.
+ */
+template<>
+class AutoMatrix<1>
+{
+public:
+  template<typename T>
+  using Type =
+    DispatchMatrix<T,
+                   Matrix<T, DCTMatrixBackend, DFTFieldBackend>,
+                   Matrix<T, DFTMatrixBackend, DFTFieldBackend>,
+                   Matrix<T, FourStepMatrixBackend, FourStepFieldBackend>>;
+};
+
+} // namespace parafields
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include <dune/common/parametertree.hh>
+
+#include "parafields/fieldtraits.hh"
+
+namespace parafields {
+
+/**
+ * @brief Screening of the eigenvalues of an extended covariance matrix
+ *
+ * Counts small, approximately zero and negative eigenvalues, and keeps
+ * track of the smallest one. Eigenvalues below the negative of
+ * embedding.threshold (default: 1e-14) count as negative, i.e., they mean
+ * that the embedding only produces approximate samples. This is shared by
+ * the in-memory and out-of-core matrices, which only differ in how they
+ * traverse the eigenvalues.
+ *
+ * @tparam RF data type of eigenvalues
+ */
+template<typename RF>
+class EigenvalueScreening
+{
+  RF threshold;
+  unsigned long small = 0;
+  unsigned long negative = 0;
+  unsigned long zero = 0;
+  RF smallest = std::numeric_limits<RF>::max();
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param config configuration of the random field
+   */
+  EigenvalueScreening(const Dune::ParameterTree& config)
+    : threshold(config.template get<RF>("embedding.threshold", 1e-14))
+  {}
+
+  /**
+   * @brief Take a local eigenvalue into account
+   *
+   * @param value eigenvalue of the extended matrix
+   */
+  void add(RF value)
+  {
+    smallest = std::min(smallest, value);
+
+    if (value < 1e-6) {
+      if (value < threshold) {
+        if (value > -threshold)
+          zero++;
+        else
+          negative++;
+      } else
+        small++;
+    }
+  }
+
+  /**
+   * @brief Sum counts over all processors and report them
+   *
+   * Has to be called collectively, after all local eigenvalues have been
+   * added.
+   *
+   * @param comm    communicator of the random field
+   * @param verbose print counts on first processor if true
+   *
+   * @return global number of eigenvalues below negative threshold
+   */
+  unsigned long reduce(MPI_Comm comm, bool verbose)
+  {
+    MPI_Allreduce(MPI_IN_PLACE, &small, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+    MPI_Allreduce(
+      MPI_IN_PLACE, &negative, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &zero, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &smallest, 1, mpiType<RF>, MPI_MIN, comm);
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (verbose && rank == 0)
+      std::cout << small << " small, " << zero << " approx. zero and "
+                << negative
+                << " large negative eigenvalues in covariance matrix, smallest "
+                << smallest << std::endl;
+
+    return negative;
+  }
+};
+
+} // namespace parafields
@@ -1,10 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <numeric>
 #include <vector>
 
-#include <fftw3-mpi.h>
-#include <fftw3.h>
+#include <parafields/backends/fftengine.hh>
 
 #include <dune/common/parametertreeparser.hh>
 
@@ -19,6 +20,12 @@ template<typename Traits>
 class ImageComponent;
 template<typename Traits>
 class StochasticPart;
+template<typename Traits>
+class SpectrumCache;
+template<typename Traits>
+class OutOfCoreGenerator;
+template<typename Traits>
+class ReducedRankModes;
 template<typename GridTraits,
          template<typename>
          class IsoMatrix,
@@ -26,11 +33,29 @@ template<typename GridTraits,
          class AnisoMatrix>
 class RandomField;
 
-// forward declarations for transposed test
+// forward declarations for runtime-dispatched backend combinations
+template<typename Traits,
+         template<typename>
+         class MatrixBackend,
+         template<typename>
+         class FieldBackend>
+class Matrix;
+template<typename Traits>
+class DCTMatrixBackend;
+template<typename Traits>
+class DFTMatrixBackend;
 template<typename Traits>
 class R2CMatrixBackend;
 template<typename Traits>
+class DCTDSTFieldBackend;
+template<typename Traits>
+class DFTFieldBackend;
+template<typename Traits>
 class R2CFieldBackend;
+template<typename Traits>
+class FourStepMatrixBackend;
+template<typename Traits>
+class FourStepFieldBackend;
 
 // constants for MPI communications
 template<typename>
@@ -98,6 +123,9 @@ private:
   friend TrendComponent<ThisType>;
   friend ImageComponent<ThisType>;
   friend StochasticPart<ThisType>;
+  friend SpectrumCache<ThisType>;
+  friend OutOfCoreGenerator<ThisType>;
+  friend ReducedRankModes<ThisType>;
 
   friend IsoMatrix<ThisType>;
   friend AnisoMatrix<ThisType>;
@@ -106,6 +134,25 @@ private:
   friend typename AnisoMatrix<ThisType>::MatrixBackendType;
   friend typename AnisoMatrix<ThisType>::FieldBackendType;
 
+  // a DispatchMatrix may instantiate any combination of built-in backends
+  template<typename,
+           template<typename>
+           class,
+           template<typename>
+           class>
+  friend class Matrix;
+  friend DCTMatrixBackend<ThisType>;
+  friend DFTMatrixBackend<ThisType>;
+  friend R2CMatrixBackend<ThisType>;
+  friend DCTDSTFieldBackend<ThisType>;
+  friend DFTFieldBackend<ThisType>;
+  friend R2CFieldBackend<ThisType>;
+  friend FourStepMatrixBackend<ThisType>;
+  friend FourStepFieldBackend<ThisType>;
+
+  template<typename T>
+  friend unsigned int plannerFlags(const T&);
+
   friend CppRNGBackend<ThisType>;
 #if HAVE_GSL
   friend GSLRNGBackend<ThisType>;
@@ -119,14 +166,17 @@ private:
   std::array<int, dim> procPerDim;
 
   const Dune::ParameterTree& config;
-  const MPI_Comm comm;
+  // not const, copies may use a duplicate for background matrix setup
+  MPI_Comm comm;
 
   const std::array<RF, dim> extensions;
   unsigned int level;
   std::array<RF, dim> meshsize;
   RF cellVolume;
 
-  const RF variance;
+  RF variance;
+  // current variance and correlation length, may differ from config
+  Dune::ParameterTree hyperparameters;
   const std::string covariance;
   const bool periodic;
   const bool approximate;
@@ -137,9 +187,13 @@ private:
 
   ptrdiff_t allocLocal, localN0, local0Start;
   bool transposed;
+  // 1D extended domain is split into equal blocks (four-step backends)
+  bool blockDistribution;
 
-  // factor used in domain embedding
-  unsigned int embeddingFactor;
+  // factors used in domain embedding, one per dimension
+  Indices embeddingFactors;
+  // choose extended domain automatically
+  bool autoEmbedding;
 
   // properties of random field
   Indices cells;
@@ -149,6 +203,7 @@ private:
   Index localDomainSize;
 
   // properties on extended domain
+  std::array<RF, dim> extendedExtensions;
   Indices extendedCells;
   Index extendedDomainSize;
   Indices localExtendedCells;
@@ -182,12 +237,17 @@ public:
     , cacheInvMatvec(config.get<bool>("randomField.cacheInvMatvec", false))
     , cacheInvRootMatvec(
         config.get<bool>("randomField.cacheInvRootMatvec", false))
-    , embeddingFactor(config.get<unsigned int>("embedding.factor", 2))
+    , autoEmbedding(config.get<std::string>("embedding.factor", "2") == "auto")
     , cells(config.get<Indices>("grid.cells"))
   {
     MPI_Comm_rank(comm, &rank);
     MPI_Comm_size(comm, &commSize);
 
+    for (const std::string key :
+         { "stochastic.variance", "stochastic.corrLength" })
+      if (config.hasKey(key))
+        hyperparameters[key] = config[key];
+
     // dune-grid load balancers want int as data type
     std::array<int, dim> intCells;
     for (unsigned int i = 0; i < dim; i++)
@@ -196,15 +256,43 @@ public:
 
     level = 0;
 
-    if (periodic && embeddingFactor != 1) {
-      if (verbose && rank == 0)
+    // either a single factor, or one factor per dimension
+    embeddingFactors.fill(2);
+    if (!autoEmbedding) {
+      const std::vector<unsigned int> factors =
+        config.get<std::vector<unsigned int>>("embedding.factor", { 2 });
+      if (factors.size() == 1)
+        embeddingFactors.fill(factors[0]);
+      else if (factors.size() == dim)
+        std::copy(factors.begin(), factors.end(), embeddingFactors.begin());
+      else
+        throw std::runtime_error{ "embedding.factor has to be a single value, "
+                                  "one value per dimension, or auto" };
+    }
+
+    if (periodic) {
+      bool consistent =
+        !autoEmbedding && !config.hasKey("embedding.extendedCells");
+      for (unsigned int i = 0; i < dim; i++)
+        if (embeddingFactors[i] != 1)
+          consistent = false;
+
+      if (!consistent && verbose && rank == 0)
         std::cout << "periodic boundary conditions are synonymous with "
                      "embeddingFactor == 1,"
                   << " enforcing consistency" << std::endl;
-      embeddingFactor = 1;
+      embeddingFactors.fill(1);
+      autoEmbedding = false;
     }
 
-    fftw_mpi_init();
+    const std::string& anisotropy =
+      config.get<std::string>("stochastic.anisotropy", "none");
+    if (anisotropy == "none" || anisotropy == "axiparallel")
+      blockDistribution = IsoMatrix<ThisType>::blockDistribution;
+    else
+      blockDistribution = AnisoMatrix<ThisType>::blockDistribution;
+
+    FFTEngine<RF>::mpi_init();
     update();
   }
 
@@ -212,27 +300,100 @@ public:
    * @brief Compute constants after construction or refinement
    *
    * This function checks the configuration for consistency, and
-   * updates parameters if the resolution has been changed.
+   * updates parameters if the resolution has been changed. The
+   * extended domain is either the smallest admissible size if
+   * automatic embedding has been requested, the explicitly given
+   * size (scaled after refinement), or a multiple of the original
+   * domain, with a separate factor per dimension. Odd sizes are rounded
+   * up, since the embedding has to be symmetric.
    */
   void update()
+  {
+    Indices newExtendedCells;
+    if (autoEmbedding) {
+      for (unsigned int i = 0; i < dim; i++)
+        newExtendedCells[i] = nextEmbeddingCells(i, 0);
+    } else if (!periodic && config.hasKey("embedding.extendedCells")) {
+      // explicit size refers to configured resolution
+      const Indices baseCells = config.get<Indices>("grid.cells");
+      const Indices baseExtendedCells =
+        config.get<Indices>("embedding.extendedCells");
+      for (unsigned int i = 0; i < dim; i++)
+        newExtendedCells[i] =
+          (baseExtendedCells[i] * cells[i] + baseCells[i] - 1) / baseCells[i];
+    } else {
+      for (unsigned int i = 0; i < dim; i++)
+        newExtendedCells[i] = embeddingFactors[i] * cells[i];
+    }
+
+    // symmetric embeddings (DCT/DST backends) require even sizes
+    if (!periodic)
+      for (unsigned int i = 0; i < dim; i++)
+        if (newExtendedCells[i] % 2 != 0) {
+          if (verbose && rank == 0)
+            std::cout << "extended domain has to be even in each dimension, "
+                         "rounding up "
+                      << newExtendedCells[i] << " to "
+                      << newExtendedCells[i] + 1 << std::endl;
+          newExtendedCells[i]++;
+        }
+
+    setExtendedCells(newExtendedCells);
+  }
+
+  /**
+   * @brief Set number of cells of extended domain
+   *
+   * This function checks the configuration for consistency, and
+   * updates all parameters that depend on the size of the extended
+   * domain. The matrix and field backends have to be updated
+   * afterwards.
+   *
+   * @param newExtendedCells number of cells per dimension of extended domain
+   */
+  void setExtendedCells(const Indices& newExtendedCells)
   {
     // ensures that FFTW can divide data equally between processes
     if (cells[dim - 1] % commSize != 0)
       throw std::runtime_error{
         "number of cells in last dimension has to be multiple of numProc"
       };
-    if (dim == 1 && cells[0] % (commSize * commSize) != 0)
-      throw std::runtime_error{
-        "in 1D, number of cells has to be multiple of numProc^2"
-      };
+    if (dim == 1 && cells[0] % distributionDivisor() != 0)
+      throw std::runtime_error{ "in 1D, number of cells has to be multiple of "
+                                "numProc^2, unless four-step backends are "
+                                "used" };
+
+    extendedCells = newExtendedCells;
+    for (unsigned int i = 0; i < dim; i++) {
+      if (extendedCells[i] < cells[i])
+        throw std::runtime_error{
+          "extended domain has to be at least as large as original domain"
+        };
+      if (!periodic && extendedCells[i] % 2 != 0)
+        throw std::runtime_error{
+          "number of cells of extended domain has to be even"
+        };
+    }
+
+    // ensures that FFTW can divide extended domain equally between processes
+    if (extendedCells[dim - 1] % distributionDivisor() != 0)
+      throw std::runtime_error{ "number of cells of extended domain in last "
+                                "dimension has to be multiple of numProc "
+                                "(numProc^2 in 1D, unless four-step backends "
+                                "are used)" };
 
     transposed = config.template get<bool>("fftw.transposed", dim > 1);
+#if PARAFIELDS_NO_MPI || PARAFIELDS_NATIVE_FFT
+    // transposed format only saves communication, which doesn't exist here
+    transposed = false;
+#endif
     if (transposed) {
       // transposed format requires more than one dimension
       if (dim == 1)
         transposed = false;
       // ensures that FFTW can store data in transposed format
-      else if (cells[dim - 2] % commSize != 0) {
+      else if (cells[dim - 2] % commSize != 0 ||
+               extendedCells[dim - 2] % commSize != 0) {
         transposed = false;
         if (verbose && rank == 0)
           std::cout
@@ -240,35 +401,32 @@ public:
             << " multiple of numProc, defaulting to non-transposed"
             << std::endl;
       }
-      // avoid R2C transposed format, since it both cuts and transposes first
-      // dim
+      // R2C backends cut the first dimension in half, and in 2D the
+      // transposed transform moves it into the distributed dimension, which
+      // results in a layout that only other R2C backends can match
       else if (dim == 2) {
         const std::string& anisotropy =
           config.template get<std::string>("stochastic.anisotropy", "none");
 
-        // check if R2C will be used
-        if ((std::is_same<typename IsoMatrix<ThisType>::MatrixBackendType,
-                          R2CMatrixBackend<ThisType>>::value &&
-             (anisotropy == "none" || anisotropy == "axiparallel")) ||
-            (std::is_same<typename AnisoMatrix<ThisType>::MatrixBackendType,
-                          R2CMatrixBackend<ThisType>>::value &&
-             (anisotropy != "none" && anisotropy != "axiparallel")) ||
-            std::is_same<typename IsoMatrix<ThisType>::FieldBackendType,
-                         R2CFieldBackend<ThisType>>::value) {
+        bool compatible;
+        if (anisotropy == "none" || anisotropy == "axiparallel")
+          compatible = IsoMatrix<ThisType>::transposedLayoutCompatible;
+        else
+          compatible = AnisoMatrix<ThisType>::transposedLayoutCompatible;
+
+        if (!compatible) {
           transposed = false;
           if (verbose && rank == 0)
-            std::cout
-              << "R2C backends need more than two dimensions for transposed "
-                 "output"
-              << " to avoid confusing layout, defaulting to non-transposed"
-              << std::endl;
+            std::cout << "R2C backends can only be combined with other "
+                         "backends for transposed output if dim > 2,"
+                      << " defaulting to non-transposed" << std::endl;
         }
       }
     }
 
     for (unsigned int i = 0; i < dim; i++) {
       meshsize[i] = extensions[i] / cells[i];
-      extendedCells[i] = embeddingFactor * cells[i];
+      extendedExtensions[i] = extendedCells[i] * meshsize[i];
     }
 
     getFFTData(allocLocal, localN0, local0Start);
@@ -281,8 +439,8 @@ public:
     }
     localExtendedCells[dim - 1] = localN0;
     localExtendedOffset[dim - 1] = local0Start;
-    localCells[dim - 1] = localN0 / embeddingFactor;
-    localOffset[dim - 1] = local0Start / embeddingFactor;
+    localCells[dim - 1] = cells[dim - 1] / commSize;
+    localOffset[dim - 1] = rank * localCells[dim - 1];
 
     domainSize = 1;
     extendedDomainSize = 1;
@@ -309,10 +467,119 @@ public:
         std::cout << localCells[i] << " ";
       }
       std::cout << std::endl;
+      std::cout << "RandomField ext. cells:  ";
+      for (unsigned int i = 0; i < dim; i++) {
+        std::cout << extendedCells[i] << " ";
+      }
+      std::cout << std::endl;
       std::cout << "RandomField cell volume: " << cellVolume << std::endl;
     }
   }
 
+  /**
+   * @brief Required divisor of the number of cells in distributed dimension
+   *
+   * The onedimensional transforms of FFTW-MPI need a multiple of the
+   * square of the number of processors, while all other transforms,
+   * including those of the four-step backends, only need a multiple of
+   * the number of processors.
+   *
+   * @return divisor for the last dimension
+   */
+  Index distributionDivisor() const
+  {
+    if (dim == 1 && !blockDistribution)
+      return commSize * commSize;
+    else
+      return commSize;
+  }
+
+  /**
+   * @brief Next admissible size of extended domain in given dimension
+   *
+   * This function is used for automatic embedding. Admissible sizes are
+   * at least as large as the minimal circulant embedding, i.e.,
+   * 2 * (cells - 1), and multiples of a step size. The step is two,
+   * combined (least common multiple) with the number of processes for
+   * the last dimension (its square in 1D, unless four-step backends are
+   * used) and the second to last dimension (to allow transposed
+   * transforms). The size divided by the step only has the prime factors
+   * 2, 3, 5 and 7, which FFTW handles efficiently, so the size itself
+   * may also contain the prime factors of the number of processes. Sizes
+   * larger than embedding.autoMaxFactor times the number of cells are not
+   * considered.
+   *
+   * @param i       dimension that should be considered
+   * @param current current number of cells, or zero for initial size
+   *
+   * @return next larger admissible size, or zero if there is none
+   */
+  Index nextEmbeddingCells(unsigned int i, Index current) const
+  {
+    const Index minCells = std::max<Index>(2 * cells[i], 4) - 2;
+    const Index maxCells =
+      config.template get<RF>("embedding.autoMaxFactor", 8.) * cells[i];
+
+    Index step = 2;
+    if (i == dim - 1)
+      step = std::lcm(step, distributionDivisor());
+    else if (i == dim - 2)
+      step = std::lcm(step, Index(commSize));
+    const Index start = std::max(minCells, current + 1);
+    for (Index candidate = (start + step - 1) / step * step;;
+         candidate += step) {
+      if (current != 0 && candidate > maxCells)
+        return 0;
+      if (isSmooth(candidate / step))
+        return candidate;
+    }
+  }
+
+  /**
+   * @brief Turn traits object into coarse version for embedding screening
+   *
+   * This function is meant to be called on a copy of the traits object.
+   * It halves the number of cells and the given candidate size of the
+   * extended domain in each dimension, as long as the result is large
+   * enough (embedding.autoScreenCells) and the ratio of the sizes stays
+   * the same, i.e., the coarse extended domain represents the same
+   * physical domain as the candidate.
+   *
+   * @param candidate extended domain that should be screened
+   *
+   * @return true if the object has been coarsened, else false
+   */
+  bool coarsenForScreening(const Indices& candidate)
+  {
+    const Index screenCells =
+      config.template get<Index>("embedding.autoScreenCells", 32);
+
+    Indices coarseExtendedCells = candidate;
+    bool coarsened = false;
+    for (unsigned int i = 0; i < dim; i++) {
+      // keep distributed dimension divisible as required by update()
+      Index divisor = 1;
+      if (i == dim - 1)
+        divisor = distributionDivisor();
+
+      while (coarseExtendedCells[i] % 4 == 0 &&
+             coarseExtendedCells[i] / 2 >= screenCells && cells[i] % 2 == 0 &&
+             (cells[i] / 2) % divisor == 0 &&
+             (coarseExtendedCells[i] / 2) % divisor == 0) {
+        cells[i] /= 2;
+        coarseExtendedCells[i] /= 2;
+        coarsened = true;
+      }
+    }
+
+    if (!coarsened)
+      return false;
+
+    autoEmbedding = false;
+    setExtendedCells(coarseExtendedCells);
+    return true;
+  }
+
   /**
    * @brief Request global refinement of the data structure
    *
@@ -347,12 +614,47 @@ public:
     update();
   }
 
+  /**
+   * @brief Change variance and / or correlation length
+   *
+   * This function replaces the hyperparameters of the covariance function
+   * with the values for stochastic.variance and stochastic.corrLength
+   * contained in the given ParameterTree object. Values that aren't
+   * contained in it are left unchanged. The covariance matrix has to be
+   * updated afterwards.
+   *
+   * @param newHyperparameters ParameterTree object containing new values
+   *
+   * @return true if the correlation length has been changed, else false
+   */
+  bool setHyperparameters(const Dune::ParameterTree& newHyperparameters)
+  {
+    if (newHyperparameters.hasKey("stochastic.variance")) {
+      variance = newHyperparameters.template get<RF>("stochastic.variance");
+      hyperparameters["stochastic.variance"] =
+        newHyperparameters["stochastic.variance"];
+    }
+
+    bool corrLengthChanged = false;
+    if (newHyperparameters.hasKey("stochastic.corrLength")) {
+      const std::string key = "stochastic.corrLength";
+      corrLengthChanged =
+        !hyperparameters.hasKey(key) ||
+        newHyperparameters.template get<std::vector<RF>>(key) !=
+          hyperparameters.template get<std::vector<RF>>(key);
+      hyperparameters[key] = newHyperparameters[key];
+    }
+
+    return corrLengthChanged;
+  }
+
   /**
    * @brief Get the domain decomposition data of the Fourier transform
    *
    * This function returns the size of the memory region, the number of
    * cells in the distributed dimension including padding, and the first
-   * local index in the distributed dimension, as returned by FFTW.
+   * local index in the distributed dimension, as returned by FFTW, or
+   * for equal blocks in the case of the four-step backends.
    *
    * @param[out] allocLocal  number of array entries needed for FFT
    * @param[out] localN0     local number of cells in distributed dimension
@@ -366,20 +668,25 @@ public:
     for (unsigned int i = 0; i < dim; i++)
       n[i] = extendedCells[dim - 1 - i];
 
-    if (dim == 1) {
+    if (dim == 1 && blockDistribution) {
+      localN0 = n[0] / commSize;
+      local0Start = rank * localN0;
+      allocLocal = localN0;
+    } else if (dim == 1) {
       ptrdiff_t localN02, local0Start2;
-      allocLocal = fftw_mpi_local_size_1d(n[0],
-                                          comm,
-                                          FFTW_FORWARD,
-                                          FFTW_ESTIMATE,
-                                          &localN0,
-                                          &local0Start,
-                                          &localN02,
-                                          &local0Start2);
+      allocLocal = FFTEngine<RF>::mpi_local_size_1d(n[0],
+                                                    comm,
+                                                    FFTW_FORWARD,
+                                                    FFTW_ESTIMATE,
+                                                    &localN0,
+                                                    &local0Start,
+                                                    &localN02,
+                                                    &local0Start2);
       if (localN0 != localN02 || local0Start != local0Start2)
         throw std::runtime_error{ "1d size / offset results don't match" };
     } else
-      allocLocal = fftw_mpi_local_size(dim, n, comm, &localN0, &local0Start);
+      allocLocal =
+        FFTEngine<RF>::mpi_local_size(dim, n, comm, &localN0, &local0Start);
   }
 
   /**
@@ -429,6 +736,25 @@ public:
       indexToIndices<currentDim + 1>(index / bound[currentDim], indices, bound);
   }
 
+  /**
+   * @brief Check whether number only has small prime factors
+   *
+   * @param n number that should be checked
+   *
+   * @return true if 2, 3, 5 and 7 are the only prime factors, else false
+   */
+  static bool isSmooth(Index n)
+  {
+    if (n == 0)
+      return false;
+
+    for (const Index p : { 2, 3, 5, 7 })
+      while (n % p == 0)
+        n /= p;
+
+    return n == 1;
+  }
+
   /**
    * @brief Convert spatial coordinates into the corresponding integer indices
    *
@@ -284,6 +284,116 @@ writeParallelToHDF5(const std::array<unsigned int, dim>& global_dim,
   // propably not needed. because the H5Dwrite blocks anyway
   MPI_Barrier(communicator);
 }
+
+/**
+ * @brief Write a distributed array to an HDF5 file piece by piece
+ *
+ * Counterpart of writeParallelToHDF5 for arrays that are never completely
+ * in memory. The file and data set are created collectively by the
+ * constructor, and the processors may then write an arbitrary number of
+ * hyperslabs each, using independent I/O. The file is closed collectively
+ * by the destructor.
+ *
+ * @tparam RF  data type for entries in array
+ * @tparam dim dimension of array
+ */
+template<typename RF, unsigned int dim>
+class HDF5SlabWriter
+{
+  hid_t file_id, dset_id;
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param global_dim    number of cells per dimension of complete array
+   * @param communicator  MPI communicator used by HDF5
+   * @param data_name     name of data set within file
+   * @param data_filename file name to write to
+   */
+  HDF5SlabWriter(const std::array<unsigned int, dim>& global_dim,
+                 const MPI_Comm& communicator,
+                 const std::string& data_name,
+                 const std::string& data_filename)
+  {
+    hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_mpio(plist_id, communicator, MPI_INFO_NULL);
+    assert(plist_id > -1);
+
+    file_id =
+      H5Fcreate(data_filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+    assert(file_id > -1);
+    H5Pclose(plist_id);
+
+    hsize_t global_dim_HDF5[dim];
+    for (unsigned int i = 0; i < dim; i++)
+      global_dim_HDF5[dim - i - 1] = global_dim[i];
+
+    hid_t filespace = H5Screate_simple(dim, global_dim_HDF5, NULL);
+    assert(filespace > -1);
+
+    dset_id = H5Dcreate(file_id,
+                        data_name.c_str(),
+                        HDF5_DATA_TYPE,
+                        filespace,
+                        H5P_DEFAULT,
+                        H5P_DEFAULT,
+                        H5P_DEFAULT);
+    H5Sclose(filespace);
+    assert(dset_id > -1);
+  }
+
+  HDF5SlabWriter(const HDF5SlabWriter&) = delete;
+  HDF5SlabWriter& operator=(const HDF5SlabWriter&) = delete;
+
+  /**
+   * @brief Destructor, closes data set and file
+   */
+  ~HDF5SlabWriter()
+  {
+    H5Dclose(dset_id);
+    H5Fclose(file_id);
+  }
+
+  /**
+   * @brief Write hyperslab of the array
+   *
+   * @param local_data   values of hyperslab, first dimension fastest
+   * @param local_count  number of cells per dimension of hyperslab
+   * @param local_offset offsets of hyperslab in each dimension
+   */
+  void write(const std::vector<RF>& local_data,
+             const std::array<unsigned int, dim>& local_count,
+             const std::array<unsigned int, dim>& local_offset)
+  {
+    hsize_t count[dim], offset[dim];
+    for (unsigned int i = 0; i < dim; i++) {
+      count[dim - i - 1] = local_count[i];
+      offset[dim - i - 1] = local_offset[i];
+    }
+
+    hid_t memspace_id = H5Screate_simple(dim, count, NULL);
+    assert(memspace_id > -1);
+
+    hid_t filespace = H5Dget_space(dset_id);
+    H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, count, NULL);
+
+    hid_t plist_id = H5Pcreate(H5P_DATASET_XFER);
+    H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_INDEPENDENT);
+
+    herr_t status = H5Dwrite(dset_id,
+                             hdf5Type<RF>,
+                             memspace_id,
+                             filespace,
+                             plist_id,
+                             &(local_data[0]));
+    assert(status > -1);
+
+    H5Pclose(plist_id);
+    H5Sclose(filespace);
+    H5Sclose(memspace_id);
+  }
+};
 #endif // HAVE_HDF5
 
 /**
@@ -1,25 +1,42 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <exception>
+#include <functional>
+#include <future>
 #include <string>
+#include <type_traits>
+#include <typeinfo>
 #include <vector>
 
-#include <fftw3-mpi.h>
-#include <fftw3.h>
-
 #include "parafields/exceptions.hh"
 
 #include "parafields/covariance.hh"
+#include "parafields/eigenvalues.hh"
 #include "parafields/gslfallback.hh"
 
-#include "parafields/backends/fftwwrapper.hh"
+#include "parafields/backends/fftengine.hh"
+#include "parafields/backends/wisdom.hh"
+
+#include "parafields/backends/slabexchange.hh"
+#include "parafields/backends/foursteptransform.hh"
 
 #include "parafields/backends/dctmatrixbackend.hh"
 #include "parafields/backends/dftmatrixbackend.hh"
+#include "parafields/backends/fourstepmatrixbackend.hh"
 #include "parafields/backends/r2cmatrixbackend.hh"
 
+#include "parafields/backends/prunedtransform.hh"
+#include "parafields/backends/stridedcopy.hh"
+#include "parafields/spectrumcache.hh"
+
+#include "parafields/outofcore.hh"
+#include "parafields/reducedrank.hh"
+
 #include "parafields/backends/dctdstfieldbackend.hh"
 #include "parafields/backends/dftfieldbackend.hh"
+#include "parafields/backends/fourstepfieldbackend.hh"
 #include "parafields/backends/r2cfieldbackend.hh"
 
 #if HAVE_GSL
@@ -37,6 +54,23 @@ template<long unsigned int>
 class DefaultMatrixBackend;
 template<long unsigned int>
 class DefaultFieldBackend;
+template<typename Traits, typename... Candidates>
+class DispatchMatrix;
+
+/**
+ * @brief Most recently started background setup of any covariance matrix
+ *
+ * Each background setup waits for its predecessor, so that the planner
+ * mutex is acquired in the same order on all processors.
+ *
+ * @return shared future of last background setup
+ */
+inline std::shared_future<void>&
+lastAsyncSetup()
+{
+  static std::shared_future<void> setup;
+  return setup;
+}
 
 /**
  * @brief Covariance matrix for stationary Gaussian random fields
@@ -65,7 +99,24 @@ public:
 
   using StochasticPartType = StochasticPart<Traits>;
 
+  //! whether the backends agree on the transposed frequency layout in 2D
+  static constexpr bool transposedLayoutCompatible =
+    std::is_same<MatrixBackend<Traits>, R2CMatrixBackend<Traits>>::value ==
+    std::is_same<FieldBackend<Traits>, R2CFieldBackend<Traits>>::value;
+
+  //! whether the backends split 1D data into equal blocks, see fieldtraits
+  static constexpr bool blockDistribution =
+    std::is_same<MatrixBackend<Traits>, FourStepMatrixBackend<Traits>>::value;
+
+  static_assert(
+    blockDistribution ==
+      std::is_same<FieldBackend<Traits>, FourStepFieldBackend<Traits>>::value,
+    "four-step backends can only be combined with each other");
+
 private:
+  template<typename, typename...>
+  friend class DispatchMatrix;
+
   using RF = typename Traits::RF;
   using Index = typename Traits::Index;
   using Indices = typename Traits::Indices;
@@ -83,11 +134,20 @@ private:
   RF variance;
   std::string covariance;
   unsigned int cgIterations;
+  bool truncate;
+  RF truncationThreshold;
 
   mutable MatrixBackend<Traits> matrixBackend;
   mutable FieldBackend<Traits> fieldBackend;
 
-  mutable std::vector<RF>* spareField;
+  mutable std::vector<RF> spareField;
+  mutable bool spareValid;
+
+  mutable std::shared_ptr<Matrix> asyncMatrix;
+  mutable std::shared_future<void> asyncSetup;
+
+  mutable std::shared_ptr<OutOfCoreGenerator<Traits>> outOfCore;
+  mutable std::shared_ptr<ReducedRankModes<Traits>> reducedRank;
 
 public:
   /**
@@ -99,7 +159,7 @@ public:
     : traits(traits_)
     , matrixBackend(traits)
     , fieldBackend(traits)
-    , spareField(nullptr)
+    , spareValid(false)
   {
     update();
   }
@@ -109,8 +169,10 @@ public:
    */
   ~Matrix()
   {
-    if (spareField != nullptr)
-      delete spareField;
+    if (asyncSetup.valid()) {
+      asyncSetup.wait();
+      MPI_Comm_free(&(*asyncMatrix->traits).comm);
+    }
   }
 
   /*
@@ -120,8 +182,13 @@ public:
    */
   void update()
   {
+    waitReady();
+
     matrixBackend.update();
     fieldBackend.update();
+    spareValid = false;
+    outOfCore.reset();
+    reducedRank.reset();
 
     rank = (*traits).rank;
     commSize = (*traits).commSize;
@@ -130,6 +197,47 @@ public:
     variance = (*traits).variance;
     covariance = (*traits).covariance;
     cgIterations = (*traits).cgIterations;
+    truncate = (*traits).config.template get<bool>("embedding.truncate", false);
+    truncationThreshold =
+      (*traits).config.template get<RF>("embedding.threshold", 1e-14);
+  }
+
+  /**
+   * @brief Update matrix after change of variance or correlation length
+   *
+   * This function has to be called after the hyperparameters stored in
+   * the traits object have been changed. If only the variance has been
+   * changed, the stored eigenvalues are rescaled. If the correlation
+   * length has been changed, the matrix is filled and transformed anew,
+   * reusing the existing data layout and, where possible, memory. A custom
+   * covariance function has to be passed again using fillTransformedMatrix
+   * in that case. A matrix that hasn't been set up yet is left untouched.
+   *
+   * @param corrLengthChanged true if the correlation length is different
+   */
+  void updateHyperparameters(bool corrLengthChanged)
+  {
+    // spare field, out-of-core eigenvalues and modes belong to old covariance
+    spareValid = false;
+    outOfCore.reset();
+    reducedRank.reset();
+
+    waitReady();
+
+    const RF oldVariance = variance;
+    variance = (*traits).variance;
+
+    if (!matrixBackend.valid())
+      return;
+
+    if (corrLengthChanged || oldVariance == 0.) {
+      matrixBackend.reset();
+      if (covariance == "custom-iso" || covariance == "custom-aniso")
+        matrixBackend.update();
+      else
+        fillTransformedMatrix(covariance);
+    } else if (variance != oldVariance)
+      matrixBackend.scale(variance / oldVariance);
   }
 
   /**
@@ -218,103 +326,200 @@ public:
    * function is truly symmetrical in each dimension if "custom-iso" is
    * chosen.
    *
+   * If automatic embedding has been requested, the extended domain
+   * starts with the minimal admissible size and is enlarged until
+   * the extended covariance matrix is positive semidefinite. In verbose
+   * mode, the peak memory used by the matrix backend is reported.
+   *
+   * If a cache directory has been configured, the transformed matrix is
+   * read from there if possible, and else stored there after it has
+   * been computed.
+   *
    * @tparam Covariance type of custom covariance class, if desired
    */
   template<typename Covariance>
   void fillTransformedMatrix(Covariance&& covariance) const
   {
-    if constexpr (std::is_same<std::decay_t<Covariance>, std::string>::value) {
-      if (covariance == "custom-iso" || covariance == "custom-aniso")
-        throw std::runtime_error{
-          "you need to call fillMatrix with your covariance class as parameter"
-        };
+    setupTransformedMatrix(covariance);
+    finalizeTransformedMatrix();
+  }
 
-      if (covariance == "exponential")
-        fillCovarianceMatrix(ExponentialCovariance());
-      else if (covariance == "gaussian")
-        fillCovarianceMatrix(GaussianCovariance());
-      else if (covariance == "spherical")
-        fillCovarianceMatrix(SphericalCovariance());
-      else if (covariance == "separableExponential")
-        fillCovarianceMatrix(SeparableExponentialCovariance());
-      else if (covariance == "matern")
-        fillCovarianceMatrix(MaternCovariance(traits->config));
-      else if (covariance == "matern32")
-        fillCovarianceMatrix(Matern32Covariance());
-      else if (covariance == "matern52")
-        fillCovarianceMatrix(Matern52Covariance());
-      else if (covariance == "dampedOscillation")
-        fillCovarianceMatrix(DampedOscillationCovariance());
-      else if (covariance == "gammaExponential")
-        fillCovarianceMatrix(GammaExponentialCovariance(traits->config));
-      else if (covariance == "cauchy")
-        fillCovarianceMatrix(CauchyCovariance());
-      else if (covariance == "generalizedCauchy")
-        fillCovarianceMatrix(GeneralizedCauchyCovariance(traits->config));
-      else if (covariance == "cubic")
-        fillCovarianceMatrix(CubicCovariance());
-      else if (covariance == "whiteNoise")
-        fillCovarianceMatrix(WhiteNoiseCovariance());
-      else
-        throw std::runtime_error{ "covariance structure " + covariance +
-                                  " not known" };
-    } else {
-      computeCovarianceMatrixEntries<Covariance, ScaledIdentityMatrix<RF, dim>>(
-        std::forward<Covariance>(covariance));
+  /**
+   * @brief Start computation of transformed matrix in the background
+   *
+   * This function starts the setup of the matrix on a separate thread,
+   * so that it can overlap with other work of the application, e.g.,
+   * mesh generation and assembly. The background thread works on a copy
+   * of the traits object with a duplicated communicator, so collective
+   * operations of the field itself remain possible in the meantime. Any
+   * function that needs the matrix waits for the setup to complete, and
+   * waitReady can be used to do so explicitly. Requires MPI_THREAD_MULTIPLE,
+   * else the matrix is set up immediately. Planning is serialized by the
+   * planner mutex, and background setups run one after the other, in the
+   * order they were started. Planning may be collective in MPI builds, so
+   * other random fields and the application mustn't create FFTW plans
+   * until waitReady has returned, else the processors could acquire the
+   * planner mutex in different orders and deadlock. Has no effect for
+   * custom covariance functions, which have to be passed using
+   * fillTransformedMatrix.
+   *
+   * Has to be called collectively.
+   */
+  void prepareAsync() const
+  {
+    if (matrixBackend.valid() || asyncSetup.valid() ||
+        covariance == "custom-iso" || covariance == "custom-aniso")
+      return;
+
+    int provided;
+    MPI_Query_thread(&provided);
+    if (provided < MPI_THREAD_MULTIPLE) {
+      if ((*traits).verbose && rank == 0)
+        std::cout << "MPI_THREAD_MULTIPLE not available, setting up "
+                     "covariance matrix synchronously"
+                  << std::endl;
+      fillTransformedMatrix(covariance);
+      return;
     }
 
-    matrixBackend.forwardTransform();
+    auto asyncTraits = std::make_shared<Traits>(*traits);
+    MPI_Comm_dup((*traits).comm, &(*asyncTraits).comm);
+    asyncMatrix = std::make_shared<Matrix>(asyncTraits);
+    const std::shared_future<void> previous = lastAsyncSetup();
+    asyncSetup =
+      std::async(std::launch::async, [matrix = asyncMatrix, previous] {
+        if (previous.valid())
+          previous.wait();
+        matrix->setupTransformedMatrix(matrix->covariance);
+      }).share();
+    lastAsyncSetup() = asyncSetup;
+  }
 
-    const RF threshold =
-      (*traits).config.template get<RF>("embedding.threshold", 1e-14);
-    unsigned int mySmall = 0;
-    unsigned int myNegative = 0;
-    unsigned int myZero = 0;
-    RF mySmallest = std::numeric_limits<RF>::max();
-    for (Index index = 0; index < matrixBackend.localMatrixSize(); index++) {
-      const RF value = matrixBackend.get(index);
-      if (value < mySmallest)
-        mySmallest = value;
-
-      if (value < 1e-6) {
-        if (value < threshold) {
-          if (value > -threshold)
-            myZero++;
-          else
-            myNegative++;
-        } else
-          mySmall++;
+  /**
+   * @brief Wait for background computation of transformed matrix
+   *
+   * Returns immediately if prepareAsync hasn't been called. Else blocks
+   * until the background setup is complete, takes over the resulting
+   * matrix, and rethrows any exception raised during setup. Has to be
+   * called collectively.
+   */
+  void waitReady() const
+  {
+    if (!asyncSetup.valid())
+      return;
+
+    std::exception_ptr error;
+    try {
+      asyncSetup.get();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    asyncSetup = std::shared_future<void>();
+
+    if (!error) {
+      const Indices& extendedCells = (*asyncMatrix->traits).extendedCells;
+      if (extendedCells != (*traits).extendedCells)
+        setExtendedCells(extendedCells);
+
+      matrixBackend.allocate();
+      std::copy_n(asyncMatrix->matrixBackend.rawData(),
+                  matrixBackend.localStorageSize(),
+                  matrixBackend.rawData());
+      matrixBackend.markTransformed();
+      finalizeTransformedMatrix();
+    }
+
+    MPI_Comm_free(&(*asyncMatrix->traits).comm);
+    asyncMatrix.reset();
+
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  /**
+   * @brief Compute transformed matrices for several sets of hyperparameters
+   *
+   * This function has the same effect as calling fillTransformedMatrix on
+   * each of the given matrices, but evaluates the covariance functions in
+   * a single pass over the extended domain, and transforms all matrices
+   * with a single batched FFT. This is meant for hyperparameter sweeps,
+   * where many matrices for the same grid are needed. Matrices that have
+   * already been set up are skipped. Matrices that can be read from the
+   * spectrum cache, that use automatic embedding, a periodization other
+   * than classical, optimization or a custom covariance function, or that
+   * have a different extended domain than the first matrix of the batch,
+   * are set up individually instead.
+   *
+   * Has to be called collectively, with the same list on all processors.
+   *
+   * @param matrices matrices that should be set up
+   */
+  static void fillTransformedMatrices(
+    const std::vector<const Matrix*>& matrices)
+  {
+    std::vector<const Matrix*> batch;
+    for (const Matrix* matrix : matrices) {
+      matrix->waitReady();
+      if (matrix->matrixBackend.valid() ||
+          std::find(batch.begin(), batch.end(), matrix) != batch.end())
+        continue;
+
+      if (!matrix->batchable() ||
+          (!batch.empty() && !matrix->sameGeometry(*batch.front()))) {
+        matrix->fillTransformedMatrix(matrix->covariance);
+        continue;
       }
 
-      if (value < 0.)
-        matrixBackend.set(index, 0.);
+      SpectrumCache<Traits> cache(matrix->traits,
+                                  typeid(MatrixBackend<Traits>).name());
+      if (matrix->loadTransformedMatrix(cache))
+        matrix->finalizeTransformedMatrix();
+      else
+        batch.push_back(matrix);
     }
 
-    int small, negative, zero;
-    RF smallest;
-    MPI_Allreduce(&mySmall, &small, 1, MPI_INT, MPI_SUM, (*traits).comm);
-    MPI_Allreduce(&myNegative, &negative, 1, MPI_INT, MPI_SUM, (*traits).comm);
-    MPI_Allreduce(&myZero, &zero, 1, MPI_INT, MPI_SUM, (*traits).comm);
-    MPI_Allreduce(
-      &mySmallest, &smallest, 1, mpiType<RF>, MPI_MIN, (*traits).comm);
+    if (batch.empty())
+      return;
 
-    if ((*traits).verbose && rank == 0)
-      std::cout << small << " small, " << zero << " approx. zero and "
-                << negative
-                << " large negative eigenvalues in covariance matrix, smallest "
-                << smallest << std::endl;
+    const Matrix& first = *batch.front();
+    if ((*first.traits).verbose && first.rank == 0)
+      std::cout << "classical circulant embedding, batch of " << batch.size()
+                << " matrices" << std::endl;
+
+    std::vector<MatrixBackend<Traits>*> backends;
+    std::vector<std::function<RF(const std::array<RF, dim>&)>> evaluators;
+    for (const Matrix* matrix : batch) {
+      matrix->matrixBackend.allocate();
+      backends.push_back(&matrix->matrixBackend);
+      evaluators.push_back(matrix->covarianceEvaluator());
+    }
 
-    if (negative > 0 && !(*traits).approximate) {
-      if (rank == 0)
-        std::cerr << "negative eigenvalues in covariance matrix, "
-                  << "consider increasing embeddingFactor, or alternatively "
-                  << "allow generation of approximate samples" << std::endl;
-      throw NegativeEigenvalueError{
-        "negative eigenvalues in covariance matrix"
-      };
+    // coordinates are computed once and shared by all matrices
+    MatrixBackend<Traits>& layout = first.matrixBackend;
+    std::array<RF, dim> coord;
+    Indices indices;
+    for (Index index = 0; index < layout.localMatrixSize(); index++) {
+      Traits::indexToIndices(index, indices, layout.localMatrixCells());
+
+      for (unsigned int i = 0; i < dim; i++) {
+        coord[i] = (indices[i] + layout.localMatrixOffset()[i]) *
+                   first.meshsize[i];
+        if (coord[i] > 0.5 * (*first.traits).extendedExtensions[i])
+          coord[i] -= (*first.traits).extendedExtensions[i];
+      }
+
+      for (std::size_t j = 0; j < batch.size(); j++)
+        backends[j]->set(index, evaluators[j](coord));
     }
 
-    matrixBackend.finalize();
+    MatrixBackend<Traits>::forwardTransform(backends);
+
+    for (const Matrix* matrix : batch) {
+      SpectrumCache<Traits> cache(matrix->traits,
+                                  typeid(MatrixBackend<Traits>).name());
+      matrix->acceptTransformedMatrix(matrix->checkEigenvalues(), cache);
+      matrix->finalizeTransformedMatrix();
+    }
   }
 
   /**
@@ -323,6 +528,17 @@ public:
    * This function creates a random field from noise, using the circulant
    * embedding technique. The extended covariance matrix is created
    * automatically if this is the first time the function is called.
+   * Field backends that produce two fields per transform, see
+   * hasSpareField, keep the second field in a reusable slot, and it is
+   * returned by the next call without any transform.
+   *
+   * With embedding.truncate, modes with eigenvalues below
+   * embedding.threshold are set to zero without drawing random numbers,
+   * which is appropriate for smooth covariance functions with rapidly
+   * decaying spectrum. The backward transform then skips the lines outside
+   * of the remaining band of frequencies if pruned transforms are enabled.
+   * Note that the random numbers are consumed differently than without
+   * truncation, so the same seed produces a different field.
    *
    * @param      seed           seed value for random number generation
    * @param[out] stochasticPart resulting random field
@@ -330,10 +546,11 @@ public:
   template<typename RNG>
   void generateField(RNG& rngBackend, StochasticPartType& stochasticPart) const
   {
+    waitReady();
     if (!matrixBackend.valid())
       fillTransformedMatrix(covariance);
 
-    if (!spareField) {
+    if (!spareValid) {
       fieldBackend.allocate();
 
       RF lambda = 0.;
@@ -345,6 +562,8 @@ public:
           std::is_same<MatrixBackend<Traits>, DCTMatrixBackend<Traits>>::value,
           "DCTDSTFieldBackend requires DCTMatrixBackend");
 
+        fieldBackend.clearSum();
+
         Indices indices;
         for (unsigned int type = 0; type < (1 << dim); type++) {
           fieldBackend.setType(type);
@@ -355,71 +574,156 @@ public:
                index++) {
             Traits::indexToIndices(
               index, indices, fieldBackend.localFieldCells());
-            lambda = std::sqrt(matrixBackend.eval(indices));
+            const RF eigenvalue = matrixBackend.eval(indices);
+            if (truncate && eigenvalue < truncationThreshold) {
+              fieldBackend.set(index, indices, 0., 0.);
+              continue;
+            }
+
+            lambda = std::sqrt(eigenvalue);
 
             const RF& rand = rngBackend.sample();
 
             fieldBackend.set(index, indices, lambda, rand);
           }
 
-          fieldBackend.backwardTransform();
-
-          fieldBackend.extendedFieldToField(
-            stochasticPart.dataVector, 0, type != 0);
+          fieldBackend.backwardTransform(true);
         }
 
+        fieldBackend.extendedSumToField(stochasticPart.dataVector);
         stochasticPart.evalValid = false;
       }
       // general version
       else {
         fieldBackend.transposeIfNeeded();
 
-        // raw (flat) index can be used
-        if (sameLayout()) {
-          for (Index index = 0; index < fieldBackend.localFieldSize();
-               index++) {
-            lambda = std::sqrt(matrixBackend.eval(index));
-
-            const RF& rand1 = rngBackend.sample();
-            const RF& rand2 = rngBackend.sample();
-
-            fieldBackend.set(index, lambda, rand1, rand2);
+        forEachEigenvalue([&](Index index, RF eigenvalue) {
+          if (truncate && eigenvalue < truncationThreshold) {
+            fieldBackend.set(index, 0., 0., 0.);
+            return;
           }
-        }
-        // matrix and field layout differ, conversion needed
-        else {
-          Indices indices;
-          for (Index index = 0; index < fieldBackend.localFieldSize();
-               index++) {
-            Traits::indexToIndices(
-              index, indices, fieldBackend.localFieldCells());
 
-            lambda = std::sqrt(matrixBackend.eval(indices));
+          lambda = std::sqrt(eigenvalue);
 
-            const RF& rand1 = rngBackend.sample();
-            const RF& rand2 = rngBackend.sample();
+          const RF& rand1 = rngBackend.sample();
+          const RF& rand2 = rngBackend.sample();
 
-            fieldBackend.set(index, lambda, rand1, rand2);
-          }
-        }
+          fieldBackend.set(index, lambda, rand1, rand2);
+        });
 
-        fieldBackend.backwardTransform();
+        fieldBackend.backwardTransform(truncate);
 
         fieldBackend.extendedFieldToField(stochasticPart.dataVector, 0);
         stochasticPart.evalValid = false;
 
         if (fieldBackend.hasSpareField()) {
-          spareField = new std::vector<RF>(stochasticPart.dataVector.size());
-          fieldBackend.extendedFieldToField(*spareField, 1);
+          fieldBackend.extendedFieldToField(spareField, 1);
+          spareValid = true;
         }
       }
     } else {
-      stochasticPart.dataVector = *spareField;
-      delete spareField;
-      spareField = nullptr;
+      // swap, so that the old field becomes the slot for the next spare
+      stochasticPart.dataVector.swap(spareField);
+      spareValid = false;
     }
   }
 
+  /**
+   * @brief Generate random field without keeping it in memory
+   *
+   * This function generates a random field using extended arrays on disk
+   * instead of the backends, and writes its restriction to the original
+   * domain directly to file. The eigenvalues are kept on disk and reused
+   * until the matrix is updated.
+   *
+   * @param rngBackend random number generator, seeded per processor
+   * @param fileName   base file name for the output
+   *
+   * @see OutOfCoreGenerator
+   */
+  template<typename RNG>
+  void generateFieldOutOfCore(RNG& rngBackend,
+                              const std::string& fileName) const
+  {
+    if (covariance == "custom-iso" || covariance == "custom-aniso")
+      throw std::runtime_error{
+        "out-of-core generation requires a built-in covariance function"
+      };
+
+    if (!outOfCore)
+      outOfCore = std::make_shared<OutOfCoreGenerator<Traits>>(
+        traits, covarianceEvaluator());
+
+    outOfCore->generate(rngBackend, fileName);
+  }
+
+  /**
+   * @brief Select modes for reduced-rank sampling
+   *
+   * Collects the count eigenpairs of the real part of the extended
+   * circulant matrix with the largest eigenvalues, see ReducedRankModes.
+   * Has to be called on all processors. The modes are kept until the
+   * matrix is updated.
+   *
+   * @param count number of modes that should be kept
+   */
+  void setupReducedRank(unsigned int count) const
+  {
+    if constexpr (std::is_same<FieldBackend<Traits>,
+                               DCTDSTFieldBackend<Traits>>::value)
+      throw std::runtime_error{
+        "reduced-rank sampling isn't supported by DCTDSTFieldBackend"
+      };
+    else {
+      waitReady();
+
+      if (!matrixBackend.valid())
+        fillTransformedMatrix(covariance);
+
+      reducedRank = std::make_shared<ReducedRankModes<Traits>>(traits);
+
+      fieldBackend.transposeIfNeeded();
+      forEachEigenvalue([&](Index index, RF eigenvalue) {
+        reducedRank->addCandidate(fieldBackend.frequency(index), eigenvalue);
+      });
+      fieldBackend.transposeIfNeeded();
+
+      reducedRank->select(count);
+    }
+  }
+
+  /**
+   * @brief Modes selected for reduced-rank sampling
+   *
+   * @return modes with largest eigenvalues
+   *
+   * @see setupReducedRank
+   */
+  const ReducedRankModes<Traits>& reducedRankModes() const
+  {
+    if (!reducedRank)
+      throw std::runtime_error{
+        "reduced-rank modes requested before calling setupReducedRank"
+      };
+
+    return *reducedRank;
+  }
+
+  /**
+   * @brief Generate random field from reduced-rank coefficients
+   *
+   * @param      coefficients   one coefficient per mode
+   * @param[out] stochasticPart resulting random field
+   *
+   * @see ReducedRankModes::generate
+   */
+  void generateFieldFromCoefficients(const std::vector<RF>& coefficients,
+                                     StochasticPartType& stochasticPart) const
+  {
+    reducedRankModes().generate(coefficients, stochasticPart.dataVector);
+    stochasticPart.evalValid = false;
+  }
+
   /**
    * @brief Generate uncorrelated random field (i.e., noise)
    *
@@ -438,6 +742,7 @@ public:
     std::default_random_engine generator(seed);
     std::normal_distribution<RF> normalDist(0., 1.);
 
+    stochasticPart.dataVector.resize(stochasticPart.localDomainSize);
     for (Index index = 0; index < stochasticPart.localDomainSize; index++)
       stochasticPart.dataVector[index] = normalDist(generator);
 
@@ -462,6 +767,421 @@ public:
   }
 
 private:
+  /**
+   * @brief Fill extended covariance matrix and transform it
+   *
+   * This function computes the entries of the extended covariance matrix
+   * and transforms it into Fourier space, without any checks.
+   *
+   * @tparam Covariance type of custom covariance class, or string
+   */
+  template<typename Covariance>
+  void computeTransformedMatrix(Covariance&& covariance) const
+  {
+    if constexpr (std::is_same<std::decay_t<Covariance>, std::string>::value) {
+      if (covariance == "custom-iso" || covariance == "custom-aniso")
+        throw std::runtime_error{
+          "you need to call fillMatrix with your covariance class as parameter"
+        };
+
+      visitCovariance(covariance,
+                      [&](auto&& function) { fillCovarianceMatrix(function); });
+    } else {
+      computeCovarianceMatrixEntries<Covariance, ScaledIdentityMatrix<RF, dim>>(
+        std::forward<Covariance>(covariance));
+    }
+
+    matrixBackend.forwardTransform();
+  }
+
+  /**
+   * @brief Load or compute transformed matrix, without finalizing it
+   *
+   * @tparam Covariance type of custom covariance class, or string
+   *
+   * @see fillTransformedMatrix
+   */
+  template<typename Covariance>
+  void setupTransformedMatrix(Covariance&& covariance) const
+  {
+    SpectrumCache<Traits> cache(traits, typeid(MatrixBackend<Traits>).name());
+
+    if (!loadTransformedMatrix(cache)) {
+      if ((*traits).autoEmbedding &&
+          !screenEmbedding(covariance, (*traits).extendedCells))
+        growEmbedding(covariance);
+
+      computeTransformedMatrix(covariance);
+      int negative = checkEigenvalues();
+
+      while (negative > 0 && (*traits).autoEmbedding &&
+             growEmbedding(covariance)) {
+        computeTransformedMatrix(covariance);
+        negative = checkEigenvalues();
+      }
+
+      acceptTransformedMatrix(negative, cache);
+    }
+  }
+
+  /**
+   * @brief Reject or store newly transformed matrix
+   *
+   * Throws if the matrix has negative eigenvalues and approximate samples
+   * haven't been allowed, and else writes the matrix to the spectrum cache
+   * if one has been configured.
+   *
+   * @param negative number of eigenvalues below negative threshold
+   * @param cache    cache object for current configuration
+   */
+  void acceptTransformedMatrix(int negative, SpectrumCache<Traits>& cache) const
+  {
+    if (negative > 0 && !(*traits).approximate) {
+      if (rank == 0)
+        std::cerr << "negative eigenvalues in covariance matrix, "
+                  << "consider increasing embeddingFactor (or setting it to "
+                  << "auto), or alternatively "
+                  << "allow generation of approximate samples" << std::endl;
+      throw NegativeEigenvalueError{
+        "negative eigenvalues in covariance matrix"
+      };
+    }
+
+    if (cache.write((*traits).extendedCells,
+                    matrixBackend.rawData(),
+                    matrixBackend.localStorageSize()) &&
+        (*traits).verbose && rank == 0)
+      std::cout << "stored covariance matrix in " << cache.name() << std::endl;
+  }
+
+  /**
+   * @brief Finalize matrix backend and report its peak memory
+   */
+  void finalizeTransformedMatrix() const
+  {
+    matrixBackend.finalize();
+
+    if ((*traits).verbose) {
+      const unsigned long myPeak = matrixBackend.peakMemoryUsage();
+      unsigned long peak;
+      MPI_Reduce(
+        &myPeak, &peak, 1, MPI_UNSIGNED_LONG, MPI_MAX, 0, (*traits).comm);
+
+      if (rank == 0)
+        std::cout << "peak memory of covariance matrix: "
+                  << peak / (1024. * 1024.) << " MiB per processor"
+                  << std::endl;
+    }
+  }
+
+  /**
+   * @brief Check whether matrix can be part of a batched setup
+   *
+   * @return true if classical embedding with a built-in covariance function
+   * and fixed extended domain is used, else false
+   */
+  bool batchable() const
+  {
+    return covariance != "custom-iso" && covariance != "custom-aniso" &&
+           !(*traits).autoEmbedding &&
+           (*traits).config.template get<std::string>(
+             "embedding.periodization", "classical") == "classical" &&
+           (*traits).config.template get<std::string>("embedding.optim",
+                                                      "none") == "none";
+  }
+
+  /**
+   * @brief Check whether two matrices share extended domain and layout
+   *
+   * @param other matrix that should be compared with
+   *
+   * @return true if both matrices have the same data distribution, else false
+   */
+  bool sameGeometry(const Matrix& other) const
+  {
+    int comparison;
+    MPI_Comm_compare((*traits).comm, (*other.traits).comm, &comparison);
+
+    return (comparison == MPI_IDENT || comparison == MPI_CONGRUENT) &&
+           (*traits).transposed == (*other.traits).transposed &&
+           (*traits).extendedCells == (*other.traits).extendedCells &&
+           (*traits).extendedExtensions == (*other.traits).extendedExtensions;
+  }
+
+  /**
+   * @brief Read transformed matrix from cache, if available
+   *
+   * If automatic embedding is used, the extended domain is adjusted to the
+   * one stored in the cache file, which may be larger than the initial
+   * one. Otherwise, files for a different extended domain are ignored.
+   *
+   * @param cache cache object for current configuration
+   *
+   * @return true if matrix was read from cache, else false
+   */
+  bool loadTransformedMatrix(SpectrumCache<Traits>& cache) const
+  {
+    Indices extendedCells;
+    if (!cache.readHeader(extendedCells))
+      return false;
+
+    if (extendedCells != (*traits).extendedCells) {
+      if (!(*traits).autoEmbedding) {
+        cache.close();
+        return false;
+      }
+
+      setExtendedCells(extendedCells);
+    }
+
+    matrixBackend.allocate();
+    if (!cache.readData(matrixBackend.rawData(),
+                        matrixBackend.localStorageSize()))
+      return false;
+
+    matrixBackend.markTransformed();
+
+    if ((*traits).verbose && rank == 0)
+      std::cout << "loaded covariance matrix from " << cache.name()
+                << std::endl;
+
+    return true;
+  }
+
+  /**
+   * @brief Check eigenvalues of extended covariance matrix
+   *
+   * This function counts small, approximately zero and negative
+   * eigenvalues of the transformed matrix, and sets negative
+   * ones to zero.
+   *
+   * @return number of eigenvalues below negative threshold
+   */
+  int checkEigenvalues() const
+  {
+    EigenvalueScreening<RF> screening((*traits).config);
+    for (Index index = 0; index < matrixBackend.localMatrixSize(); index++) {
+      const RF value = matrixBackend.get(index);
+      screening.add(value);
+
+      if (value < 0.)
+        matrixBackend.set(index, 0.);
+    }
+
+    return screening.reduce((*traits).comm, (*traits).verbose);
+  }
+
+  /**
+   * @brief Quick check whether extended domain is large enough
+   *
+   * This function computes the extended covariance matrix for the given
+   * extended domain on a coarser grid, and checks its eigenvalues. This
+   * filters candidates for automatic embedding before the (expensive)
+   * computation on the actual grid. Candidates that can't be coarsened
+   * are always accepted.
+   *
+   * @param covariance    covariance function, or string
+   * @param extendedCells candidate number of cells for extended domain
+   *
+   * @return false if coarse matrix has negative eigenvalues, else true
+   */
+  template<typename Covariance>
+  bool screenEmbedding(Covariance& covariance,
+                       const Indices& extendedCells) const
+  {
+    auto coarseTraits = std::make_shared<Traits>(*traits);
+    if (!(*coarseTraits).coarsenForScreening(extendedCells))
+      return true;
+
+    Matrix coarseMatrix(coarseTraits);
+    coarseMatrix.computeTransformedMatrix(covariance);
+    return coarseMatrix.checkEigenvalues() == 0;
+  }
+
+  /**
+   * @brief Enlarge extended domain for automatic embedding
+   *
+   * This function enlarges the extended domain, one dimension at a time,
+   * and uses the smallest resulting candidate that passes screenEmbedding.
+   * If no candidate passes, the largest admissible extended domain is used.
+   * The matrix backend is reset whenever the extended domain changes, so
+   * the matrix has to be computed again if this function returns true.
+   *
+   * @param covariance covariance function, or string
+   *
+   * @return true if the extended domain has been changed, else false
+   */
+  template<typename Covariance>
+  bool growEmbedding(Covariance& covariance) const
+  {
+    Indices current = (*traits).extendedCells;
+
+    while (true) {
+      std::vector<std::pair<Index, Indices>> candidates;
+      for (unsigned int i = 0; i < dim; i++) {
+        const Index next = (*traits).nextEmbeddingCells(i, current[i]);
+        if (next != 0) {
+          Indices candidate = current;
+          candidate[i] = next;
+
+          Index size = 1;
+          for (unsigned int j = 0; j < dim; j++)
+            size *= candidate[j];
+          candidates.emplace_back(size, candidate);
+        }
+      }
+
+      if (candidates.empty()) {
+        if (current == (*traits).extendedCells)
+          return false;
+
+        // largest admissible size, has to be computed and checked as well
+        setExtendedCells(current);
+        return true;
+      }
+
+      std::sort(candidates.begin(), candidates.end());
+      for (const auto& candidate : candidates)
+        if (screenEmbedding(covariance, candidate.second)) {
+          setExtendedCells(candidate.second);
+          return true;
+        }
+
+      current = candidates.front().second;
+    }
+  }
+
+  /**
+   * @brief Change size of extended domain and update backends
+   *
+   * @param extendedCells new number of cells for extended domain
+   */
+  void setExtendedCells(const Indices& extendedCells) const
+  {
+    (*traits).setExtendedCells(extendedCells);
+    matrixBackend.update();
+    fieldBackend.update();
+
+    if ((*traits).verbose && rank == 0) {
+      std::cout << "automatic embedding, using extended cells: ";
+      for (unsigned int i = 0; i < dim; i++)
+        std::cout << extendedCells[i] << " ";
+      std::cout << std::endl;
+    }
+  }
+
+  /**
+   * @brief Smallest ratio between extended domain and original domain
+   *
+   * @return minimum over dimensions of the ratio of extensions
+   */
+  RF embeddingRatio() const
+  {
+    RF ratio = std::numeric_limits<RF>::max();
+    for (unsigned int i = 0; i < dim; i++)
+      ratio = std::min(ratio, (*traits).extendedExtensions[i] / extensions[i]);
+
+    return ratio;
+  }
+
+  /**
+   * @brief Call function with built-in covariance function of given name
+   *
+   * @param covariance name of the covariance function
+   * @param function   callable that receives the covariance function object
+   */
+  template<typename Function>
+  void visitCovariance(const std::string& covariance, Function&& function) const
+  {
+    if (covariance == "exponential")
+      function(ExponentialCovariance());
+    else if (covariance == "gaussian")
+      function(GaussianCovariance());
+    else if (covariance == "spherical")
+      function(SphericalCovariance());
+    else if (covariance == "separableExponential")
+      function(SeparableExponentialCovariance());
+    else if (covariance == "matern")
+      function(MaternCovariance(traits->config));
+    else if (covariance == "matern32")
+      function(Matern32Covariance());
+    else if (covariance == "matern52")
+      function(Matern52Covariance());
+    else if (covariance == "dampedOscillation")
+      function(DampedOscillationCovariance());
+    else if (covariance == "gammaExponential")
+      function(GammaExponentialCovariance(traits->config));
+    else if (covariance == "cauchy")
+      function(CauchyCovariance());
+    else if (covariance == "generalizedCauchy")
+      function(GeneralizedCauchyCovariance(traits->config));
+    else if (covariance == "cubic")
+      function(CubicCovariance());
+    else if (covariance == "whiteNoise")
+      function(WhiteNoiseCovariance());
+    else
+      throw std::runtime_error{ "covariance structure " + covariance +
+                                " not known" };
+  }
+
+  /**
+   * @brief Covariance function including variance and coordinate trafo
+   *
+   * Combines the configured built-in covariance function with the current
+   * variance and the geometry matrix for the current correlation length,
+   * so that matrices with different hyperparameters can be filled in the
+   * same loop over the extended domain.
+   *
+   * @return function mapping untransformed coordinates to covariance
+   */
+  std::function<RF(const std::array<RF, dim>&)> covarianceEvaluator() const
+  {
+    const std::string& anisotropy = (*traits).config.template get<std::string>(
+      "stochastic.anisotropy", "none");
+
+    std::function<RF(const std::array<RF, dim>&)> evaluator;
+    visitCovariance(covariance, [&](auto&& function) {
+      using Covariance = std::decay_t<decltype(function)>;
+      if (anisotropy == "none")
+        evaluator = geometryEvaluator<Covariance,
+                                      ScaledIdentityMatrix<RF, dim>>(function);
+      else if (anisotropy == "axiparallel")
+        evaluator =
+          geometryEvaluator<Covariance, DiagonalMatrix<RF, dim>>(function);
+      else if (anisotropy == "geometric")
+        evaluator =
+          geometryEvaluator<Covariance, GeneralMatrix<RF, dim>>(function);
+      else
+        throw std::runtime_error{ "stochastic.anisotropy must be \"none\", "
+                                  "\"axiparallel\" or \"geometric\"" };
+    });
+
+    return evaluator;
+  }
+
+  /**
+   * @brief Bind covariance function to variance and geometry matrix
+   *
+   * @tparam Covariance     prescribed covariance function
+   * @tparam GeometryMatrix transformation matrix (based on correlation lengths)
+   *
+   * @param covariance covariance function object
+   *
+   * @return function mapping untransformed coordinates to covariance
+   */
+  template<typename Covariance, typename GeometryMatrix>
+  std::function<RF(const std::array<RF, dim>&)> geometryEvaluator(
+    const Covariance& covariance) const
+  {
+    return [matrix = GeometryMatrix((*traits).hyperparameters),
+            covariance,
+            variance = variance](const std::array<RF, dim>& coord) mutable {
+      std::array<RF, dim> transCoord;
+      matrix.transform(coord, transCoord);
+      return covariance(variance, transCoord);
+    };
+  }
+
   /**
    * @brief Compute entries of covariance matrix
    *
@@ -615,7 +1335,7 @@ private:
   template<typename Covariance, typename GeometryMatrix>
   void computeMatrixEntriesWithMirroring(Covariance&& covariance) const
   {
-    GeometryMatrix matrix((*traits).config);
+    GeometryMatrix matrix((*traits).hyperparameters);
 
     std::array<RF, dim> coord;
     std::array<RF, dim> transCoord;
@@ -627,8 +1347,8 @@ private:
       for (unsigned int i = 0; i < dim; i++) {
         coord[i] =
           (indices[i] + matrixBackend.localMatrixOffset()[i]) * meshsize[i];
-        if (coord[i] > 0.5 * extensions[i] * (*traits).embeddingFactor)
-          coord[i] -= extensions[i] * (*traits).embeddingFactor;
+        if (coord[i] > 0.5 * (*traits).extendedExtensions[i])
+          coord[i] -= (*traits).extendedExtensions[i];
       }
 
       matrix.transform(coord, transCoord);
@@ -652,7 +1372,7 @@ private:
   template<typename Covariance, typename GeometryMatrix, typename Sigmoid>
   void computeMatrixEntriesWithMerge(Covariance&& covariance) const
   {
-    GeometryMatrix matrix((*traits).config);
+    GeometryMatrix matrix((*traits).hyperparameters);
     Sigmoid sigmoid;
 
     bool radial;
@@ -675,7 +1395,7 @@ private:
     const RF sigmoidStart =
       (*traits).config.template get<RF>("embedding.sigmoidStart", 1.);
     const RF sigmoidEnd = (*traits).config.template get<RF>(
-      "embedding.sigmoidEnd", (*traits).embeddingFactor - 1.);
+      "embedding.sigmoidEnd", embeddingRatio() - 1.);
     unsigned int recursions = (*traits).config.template get<unsigned int>(
       "embedding.mergeRecursions", 99);
 
@@ -709,7 +1429,7 @@ private:
     RF constValue = 0.;
     if (type == "radialPlus") {
       for (unsigned int i = 0; i < dim; i++)
-        trueCoord[i] = extensions[i] * (*traits).embeddingFactor / 2.;
+        trueCoord[i] = (*traits).extendedExtensions[i] / 2.;
 
       matrix.transform(trueCoord, transCoord);
 
@@ -733,13 +1453,12 @@ private:
         for (unsigned int i = 0; i < dim; i++)
           // flip dimension if i-th bit is set
           if (j & (1 << i))
-            mirrorCoord[i] =
-              extensions[i] * (*traits).embeddingFactor - trueCoord[i];
+            mirrorCoord[i] = (*traits).extendedExtensions[i] - trueCoord[i];
 
         RF dampening = 1.;
         const RF eps = 1e-10;
         static const RF sqrtDim = std::sqrt(RF(dim));
-        const unsigned int factor = (*traits).embeddingFactor;
+        const RF factor = embeddingRatio();
         if (radial && sqrtDim < factor / 2.) {
           RF radius = 0.;
           for (unsigned int i = 0; i < dim; i++)
@@ -791,7 +1510,7 @@ private:
   template<typename Covariance, typename GeometryMatrix, typename Sigmoid>
   void computeMatrixEntriesWithFold(Covariance&& covariance) const
   {
-    GeometryMatrix matrix((*traits).config);
+    GeometryMatrix matrix((*traits).hyperparameters);
 
 #if HAVE_GSL
     std::array<RF, dim> coord;
@@ -833,7 +1552,7 @@ private:
     RF params[3];
     params[0] = 1.;
     params[1] =
-      maxFactor * 0.5 * (*traits).embeddingFactor / std::sqrt(RF(dim));
+      maxFactor * 0.5 * embeddingRatio() / std::sqrt(RF(dim));
     params[2] = recursions;
 
     auto func = [](double x, void* params) {
@@ -859,8 +1578,8 @@ private:
       for (unsigned int i = 0; i < dim; i++) {
         coord[i] =
           (indices[i] + matrixBackend.localMatrixOffset()[i]) * meshsize[i];
-        if (coord[i] > 0.5 * extensions[i] * (*traits).embeddingFactor)
-          coord[i] -= extensions[i] * (*traits).embeddingFactor;
+        if (coord[i] > 0.5 * (*traits).extendedExtensions[i])
+          coord[i] -= (*traits).extendedExtensions[i];
       }
 
       RF norm = 0.;
@@ -919,8 +1638,8 @@ private:
       for (unsigned int i = 0; i < dim; i++) {
         coord[i] =
           (indices[i] + matrixBackend.localMatrixOffset()[i]) * meshsize[i];
-        if (coord[i] > 0.5 * extensions[i] * (*traits).embeddingFactor)
-          coord[i] -= extensions[i] * (*traits).embeddingFactor;
+        if (coord[i] > 0.5 * (*traits).extendedExtensions[i])
+          coord[i] -= (*traits).extendedExtensions[i];
       }
 
       RF norm = 0.;
@@ -936,8 +1655,7 @@ private:
       } else {
         for (unsigned int i = 0; i < dim; i++) {
           if (val > maxBorder)
-            if (0.5 * extensions[i] * (*traits).embeddingFactor -
-                  std::abs(coord[i]) <
+            if (0.5 * (*traits).extendedExtensions[i] - std::abs(coord[i]) <
                 extensions[i] / (*traits).extendedCells[i])
               maxBorder = val;
         }
@@ -980,8 +1698,8 @@ private:
       for (unsigned int i = 0; i < dim; i++) {
         coord[i] =
           (indices[i] + matrixBackend.localMatrixOffset()[i]) * meshsize[i];
-        if (coord[i] > 0.5 * extensions[i] * (*traits).embeddingFactor)
-          coord[i] -= extensions[i] * (*traits).embeddingFactor;
+        if (coord[i] > 0.5 * (*traits).extendedExtensions[i])
+          coord[i] -= (*traits).extendedExtensions[i];
       }
 
       RF norm = 0.;
@@ -1035,10 +1753,6 @@ private:
       throw std::runtime_error{
         "optimization requires untransposed DFTMatrixBackend"
       };
-    if ((*traits).commSize != 1)
-      throw std::runtime_error{
-        "optimization is only implemented for sequential runs"
-      };
 
     bool radial;
     const std::string& type =
@@ -1048,7 +1762,7 @@ private:
     else
       radial = false;
 
-    GeometryMatrix matrix((*traits).config);
+    GeometryMatrix matrix((*traits).hyperparameters);
 
     std::array<RF, dim> coord;
     std::array<RF, dim> transCoord;
@@ -1061,8 +1775,8 @@ private:
       for (unsigned int i = 0; i < dim; i++) {
         coord[i] =
           (indices[i] + matrixBackend.localMatrixOffset()[i]) * meshsize[i];
-        if (coord[i] > 0.5 * extensions[i] * (*traits).embeddingFactor)
-          coord[i] -= extensions[i] * (*traits).embeddingFactor;
+        if (coord[i] > 0.5 * (*traits).extendedExtensions[i])
+          coord[i] -= (*traits).extendedExtensions[i];
       }
 
       RF norm = 0.;
@@ -1122,12 +1836,13 @@ private:
     while (i < maxStep) {
       const bool converged = solver.step(problem, iter);
       if (converged || (problem.negatives() == 0 && breakIfPositive)) {
-        std::cout << "embeddingFactor: " << (*traits).embeddingFactor
-                  << " iterations: " << problem.optimizationStep()
-                  << " forward trans: " << problem.forwards()
-                  << " backward trans: " << problem.backwards()
-                  << " total trans: "
-                  << problem.forwards() + problem.backwards() << std::endl;
+        if (rank == 0)
+          std::cout << "embeddingFactor: " << embeddingRatio()
+                    << " iterations: " << problem.optimizationStep()
+                    << " forward trans: " << problem.forwards()
+                    << " backward trans: " << problem.backwards()
+                    << " total trans: "
+                    << problem.forwards() + problem.backwards() << std::endl;
         break;
       }
       i++;
@@ -1143,8 +1858,8 @@ private:
         for (unsigned int i = 0; i < dim; i++) {
           coord[i] =
             (indices[i] + matrixBackend.localMatrixOffset()[i]) * meshsize[i];
-          if (coord[i] > 0.5 * extensions[i] * (*traits).embeddingFactor)
-            coord[i] -= extensions[i] * (*traits).embeddingFactor;
+          if (coord[i] > 0.5 * (*traits).extendedExtensions[i])
+            coord[i] -= (*traits).extendedExtensions[i];
         }
 
         matrix.transform(coord, transCoord);
@@ -1180,12 +1895,8 @@ private:
       throw std::runtime_error{
         "optimization requires untransposed DFTMatrixBackend"
       };
-    if ((*traits).commSize != 1)
-      throw std::runtime_error{
-        "optimization is only implemented for sequential runs"
-      };
 
-    GeometryMatrix matrix((*traits).config);
+    GeometryMatrix matrix((*traits).hyperparameters);
 
     bool radial;
     const std::string& type =
@@ -1205,8 +1916,8 @@ private:
       for (unsigned int i = 0; i < dim; i++) {
         coord[i] =
           (indices[i] + matrixBackend.localMatrixOffset()[i]) * meshsize[i];
-        if (coord[i] > 0.5 * extensions[i] * (*traits).embeddingFactor)
-          coord[i] -= extensions[i] * (*traits).embeddingFactor;
+        if (coord[i] > 0.5 * (*traits).extendedExtensions[i])
+          coord[i] -= (*traits).extendedExtensions[i];
       }
 
       RF norm = 0.;
@@ -1271,15 +1982,80 @@ private:
       i++;
     }
 
-    std::cout << "embeddingFactor: " << (*traits).embeddingFactor
-              << " iterations: " << problem.optimizationStep()
-              << " forward trans: " << problem.forwards() + 1
-              << " backward trans: " << problem.backwards() + 1
-              << " total trans: "
-              << problem.forwards() + problem.backwards() + 2 << std::endl;
+    if (rank == 0)
+      std::cout << "embeddingFactor: " << embeddingRatio()
+                << " iterations: " << problem.optimizationStep()
+                << " forward trans: " << problem.forwards() + 1
+                << " backward trans: " << problem.backwards() + 1
+                << " total trans: "
+                << problem.forwards() + problem.backwards() + 2 << std::endl;
   }
 #endif // HAVE_DUNE_NONLINOPT
 
+  /**
+   * @brief Call function for each mode of field backend with its eigenvalue
+   *
+   * Visits the local entries of the field backend in order of their flat
+   * index. If the backends have the same layout, the flat index is used
+   * directly. Otherwise, the remapping of indices by the matrix backend is
+   * tabulated per dimension and applied with nested loops, avoiding the
+   * conversion between flat indices and index tuples for each entry.
+   *
+   * @param function function receiving flat index and eigenvalue
+   */
+  template<typename Function>
+  void forEachEigenvalue(Function&& function) const
+  {
+    if (sameLayout()) {
+      for (Index index = 0; index < fieldBackend.localFieldSize(); index++)
+        function(index, matrixBackend.eval(index));
+    } else {
+      const std::array<std::vector<Index>, dim> offsets =
+        matrixBackend.evalOffsets(fieldBackend.localFieldCells());
+
+      Index index = 0;
+      eigenvalueLoop<dim - 1>(offsets, 0, index, function);
+    }
+  }
+
+  /**
+   * @brief Multiply unnormalized spectrum with function of eigenvalues
+   *
+   * Scales each mode of the field backend with the given function of its
+   * eigenvalue, and with the normalization of the forward transform. The
+   * forward transforms of all field backends divide by the number of cells
+   * of the extended domain, unless they are called with normalize set to
+   * false, and then this function has to be used instead. This saves one
+   * pass over the spectrum per matrix-vector product.
+   *
+   * @param factor function mapping eigenvalues to multipliers
+   */
+  template<typename Function>
+  void multiplySpectrum(Function&& factor) const
+  {
+    const RF scale = 1. / (*traits).extendedDomainSize;
+    forEachEigenvalue([&](Index index, RF lambda) {
+      fieldBackend.mult(index, scale * factor(lambda));
+    });
+  }
+
+  /**
+   * @brief Loop nest for forEachEigenvalue, unrolled over dimensions
+   */
+  template<unsigned int currentDim, typename Function>
+  void eigenvalueLoop(const std::array<std::vector<Index>, dim>& offsets,
+                      Index offset,
+                      Index& index,
+                      Function& function) const
+  {
+    for (const Index dimOffset : offsets[currentDim])
+      if constexpr (currentDim == 0)
+        function(index++, matrixBackend.evalStored(offset + dimOffset));
+      else
+        eigenvalueLoop<currentDim - 1>(
+          offsets, offset + dimOffset, index, function);
+  }
+
   /**
    * @brief Whether matrix backend and field backend have the same local cell
    * layout
@@ -1431,6 +2207,46 @@ private:
       std::cout << count << " iterations" << std::endl;
   }
 
+  /**
+   * @brief Multiply even/odd components of extended field (DCT/DST version)
+   *
+   * Helper function for the DCT/DST field backend, which has to treat each
+   * combination of even and odd symmetry separately. The extended input has
+   * to be stored in the field backend. The components are transformed one
+   * after the other, since FFTW can't combine real-to-real transforms of
+   * different kinds and sizes in one plan, but they are added up in
+   * extended space, so that the result is restricted to the original domain
+   * in a single pass.
+   *
+   * @param[out] output resulting matrix-vector product
+   * @param      factor function mapping eigenvalues to multipliers
+   */
+  template<typename Function>
+  void multiplyComponents(std::vector<RF>& output, Function&& factor) const
+  {
+    FieldBackend<Traits> component(traits);
+    component.update();
+    component.allocate();
+    component.clearSum();
+
+    for (unsigned int type = 0; type < (1 << dim); type++) {
+      component.setType(type);
+
+      for (Index index = 0; index < component.localFieldSize(); index++)
+        component.setComponent(index, fieldBackend.get(index));
+
+      component.forwardTransform(false);
+
+      const RF scale = 1. / (*traits).extendedDomainSize;
+      for (Index index = 0; index < component.localFieldSize(); index++)
+        component.mult(index, scale * factor(matrixBackend.get(index)));
+
+      component.backwardTransform(true);
+    }
+
+    component.extendedSumToField(output);
+  }
+
   /**
    * @brief Multiply an extended random field with covariance matrix
    *
@@ -1442,6 +2258,7 @@ private:
    */
   void multiplyExtended(std::vector<RF>& input, std::vector<RF>& output) const
   {
+    waitReady();
     if (!matrixBackend.valid())
       fillTransformedMatrix(covariance);
 
@@ -1454,45 +2271,13 @@ private:
         std::is_same<MatrixBackend<Traits>, DCTMatrixBackend<Traits>>::value,
         "DCTDSTFieldBackend requires DCTMatrixBackend");
 
-      FieldBackend<Traits> component(traits);
-      component.update();
-      component.allocate();
-
-      for (unsigned int type = 0; type < (1 << dim); type++) {
-        component.setType(type);
-
-        for (Index index = 0; index < component.localFieldSize(); index++)
-          component.setComponent(index, fieldBackend.get(index));
-
-        component.forwardTransform();
-
-        for (Index index = 0; index < component.localFieldSize(); index++)
-          component.mult(index, matrixBackend.get(index));
-
-        component.backwardTransform();
-
-        component.extendedFieldToField(output, 0, type != 0);
-      }
+      multiplyComponents(output, [](RF lambda) { return lambda; });
     }
     // general version
     else {
-      fieldBackend.forwardTransform();
+      fieldBackend.forwardTransform(false);
 
-      // raw (flat) index can be used
-      if (sameLayout()) {
-        for (Index index = 0; index < fieldBackend.localFieldSize(); index++)
-          fieldBackend.mult(index, matrixBackend.eval(index));
-      }
-      // matrix and field layout differ, conversion needed
-      else {
-        Indices indices;
-        for (Index index = 0; index < fieldBackend.localFieldSize(); index++) {
-          Traits::indexToIndices(
-            index, indices, fieldBackend.localFieldCells());
-
-          fieldBackend.mult(index, matrixBackend.eval(indices));
-        }
-      }
+      multiplySpectrum([](RF lambda) { return lambda; });
 
       fieldBackend.backwardTransform();
 
@@ -1514,6 +2299,7 @@ private:
   void multiplyRootExtended(std::vector<RF>& input,
                             std::vector<RF>& output) const
   {
+    waitReady();
     if (!matrixBackend.valid())
       fillTransformedMatrix(covariance);
 
@@ -1526,45 +2312,13 @@ private:
         std::is_same<MatrixBackend<Traits>, DCTMatrixBackend<Traits>>::value,
         "DCTDSTFieldBackend requires DCTMatrixBackend");
 
-      FieldBackend<Traits> component(traits);
-      component.update();
-      component.allocate();
-
-      for (unsigned int type = 0; type < (1 << dim); type++) {
-        component.setType(type);
-
-        for (Index index = 0; index < component.localFieldSize(); index++)
-          component.setComponent(index, fieldBackend.get(index));
-
-        component.forwardTransform();
-
-        for (Index index = 0; index < component.localFieldSize(); index++)
-          component.mult(index, std::sqrt(matrixBackend.get(index)));
-
-        component.backwardTransform();
-
-        component.extendedFieldToField(output, 0, type != 0);
-      }
+      multiplyComponents(output, [](RF lambda) { return std::sqrt(lambda); });
     }
     // general version
     else {
-      fieldBackend.forwardTransform();
-
-      // raw (flat) index can be used
-      if (sameLayout()) {
-        for (Index index = 0; index < fieldBackend.localFieldSize(); index++)
-          fieldBackend.mult(index, std::sqrt(matrixBackend.eval(index)));
-      }
-      // matrix and field layout differ, conversion needed
-      else {
-        Indices indices;
-        for (Index index = 0; index < fieldBackend.localFieldSize(); index++) {
-          Traits::indexToIndices(
-            index, indices, fieldBackend.localFieldCells());
+      fieldBackend.forwardTransform(false);
 
-          fieldBackend.mult(index, std::sqrt(matrixBackend.eval(indices)));
-        }
-      }
+      multiplySpectrum([](RF lambda) { return std::sqrt(lambda); });
 
       fieldBackend.backwardTransform();
 
@@ -1587,6 +2341,7 @@ private:
   void multiplyInverseExtended(std::vector<RF>& input,
                                std::vector<RF>& output) const
   {
+    waitReady();
     if (!matrixBackend.valid())
       fillTransformedMatrix(covariance);
 
@@ -1599,45 +2354,13 @@ private:
         std::is_same<MatrixBackend<Traits>, DCTMatrixBackend<Traits>>::value,
         "DCTDSTFieldBackend requires DCTMatrixBackend");
 
-      FieldBackend<Traits> component(traits);
-      component.update();
-      component.allocate();
-
-      for (unsigned int type = 0; type < (1 << dim); type++) {
-        component.setType(type);
-
-        for (Index index = 0; index < component.localFieldSize(); index++)
-          component.setComponent(index, fieldBackend.get(index));
-
-        component.forwardTransform();
-
-        for (Index index = 0; index < component.localFieldSize(); index++)
-          component.mult(index, 1. / matrixBackend.get(index));
-
-        component.backwardTransform();
-
-        component.extendedFieldToField(output, 0, type != 0);
-      }
+      multiplyComponents(output, [](RF lambda) { return 1. / lambda; });
     }
     // general version
     else {
-      fieldBackend.forwardTransform();
+      fieldBackend.forwardTransform(false);
 
-      // raw (flat) index can be used
-      if (sameLayout()) {
-        for (Index index = 0; index < fieldBackend.localFieldSize(); index++)
-          fieldBackend.mult(index, 1. / matrixBackend.eval(index));
-      }
-      // matrix and field layout differ, conversion needed
-      else {
-        Indices indices;
-        for (Index index = 0; index < fieldBackend.localFieldSize(); index++) {
-          Traits::indexToIndices(
-            index, indices, fieldBackend.localFieldCells());
-
-          fieldBackend.mult(index, 1. / matrixBackend.eval(indices));
-        }
-      }
+      multiplySpectrum([](RF lambda) { return 1. / lambda; });
 
       fieldBackend.backwardTransform();
 
@@ -1702,14 +2425,20 @@ public:
 };
 
 /**
- * @brief Default isotropic matrix selector for 1D: DFTMatrix
+ * @brief Default isotropic matrix selector for 1D: DCTMatrix or DFTMatrix
+ *
+ * The transforms of the DCT matrix backend aren't distributed in 1D, so
+ * it is only used on a single processor, and the DFT matrix backend is
+ * used otherwise, see DispatchMatrix.
  */
 template<>
 class DefaultIsoMatrix<1>
 {
 public:
   template<typename T>
-  using Type = Matrix<T, DFTMatrixBackend>;
+  using Type = DispatchMatrix<T,
+                              Matrix<T, DCTMatrixBackend, DFTFieldBackend>,
+                              Matrix<T, DFTMatrixBackend, DFTFieldBackend>>;
 };
 
 /**
@@ -1734,4 +2463,34 @@ public:
   using Type = Matrix<T, DFTMatrixBackend>;
 };
 
+/**
+ * @brief Isotropic matrix selector producing fields in pairs
+ *
+ * Uses a complex DFT of the extended field, which is about twice the work
+ * of the real-to-complex transform of DefaultIsoMatrix, but produces two
+ * independent fields, one in the real and one in the imaginary part. This
+ * is the default in 1D, and doubles the number of fields per transform
+ * for ensembles in higher dimensions.
+ */
+template<long unsigned int dim>
+class PairedIsoMatrix
+{
+public:
+  template<typename T>
+  using Type = Matrix<T, DCTMatrixBackend, DFTFieldBackend>;
+};
+
+/**
+ * @brief Anisotropic matrix selector producing fields in pairs
+ *
+ * Counterpart of PairedIsoMatrix for general covariance functions.
+ */
+template<long unsigned int dim>
+class PairedAnisoMatrix
+{
+public:
+  template<typename T>
+  using Type = Matrix<T, DFTMatrixBackend, DFTFieldBackend>;
+};
+
 } // namespace parafields
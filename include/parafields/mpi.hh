@@ -0,0 +1,13 @@
+#pragma once
+
+/*
+ * MPI and FFTW-MPI, or their single-process replacement in serial builds
+ * (PARAFIELDS_USE_MPI=OFF in CMake, which defines PARAFIELDS_NO_MPI).
+ */
+
+#if PARAFIELDS_NO_MPI
+#include <parafields/serialmpi.hh>
+#else
+#include <fftw3-mpi.h>
+#include <mpi.h>
+#endif
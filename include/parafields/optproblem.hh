@@ -2,6 +2,11 @@
 
 #if HAVE_DUNE_NONLINOPT
 
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
 #include <dune/nonlinopt/nonlinopt.hh>
 
 #include <parafields/legacyvtk.hh>
@@ -10,6 +15,13 @@ namespace parafields {
 /**
  * @brief Wrapper class with vector arithmetics for optimization
  *
+ * Each processor stores its part of the extended domain, with the same
+ * data distribution as the DFT matrix backend. Scalar products, norms
+ * and comparisons are reduced across the communicator, so all of these
+ * operations have to be called collectively. Buffers are recycled through
+ * a pool, since the optimization methods create and destroy temporary
+ * vectors in every step.
+ *
  * @tparam Traits traits class for configuration
  */
 template<typename Traits>
@@ -20,8 +32,29 @@ public:
   using Index = typename Traits::Index;
 
 private:
-  unsigned int data_size = 0;
-  fftw_complex* data = nullptr;
+  using Complex = typename FFTEngine<Real>::complex;
+
+  /**
+   * @brief Released buffers, shared by all vectors of the same type
+   */
+  struct Pool
+  {
+    std::mutex mutex;
+    std::vector<std::pair<Index, Complex*>> buffers;
+
+    ~Pool()
+    {
+      for (auto& buffer : buffers)
+        FFTEngine<Real>::free(buffer.second);
+    }
+  };
+
+  // maximum number of released buffers kept for reuse
+  static constexpr std::size_t maxPooled = 16;
+
+  Index data_size = 0;
+  Index alloc_size = 0;
+  Complex* data = nullptr;
 
   enum
   {
@@ -43,7 +76,8 @@ public:
   /**
    * @brief Constructor
    *
-   * Creates vector wrapper from given data backend.
+   * Creates vector wrapper from given data backend, using its local part
+   * of the extended domain.
    *
    * @param backend             backend to extract data from
    * @param extendedCells_      number of cells per dimension
@@ -56,11 +90,12 @@ public:
                 Index extendedDomainSize_,
                 MPI_Comm comm_)
     : data_size(backend.localMatrixSize())
+    , alloc_size(std::max<Index>(backend.localStorageSize() / 2, data_size))
     , extendedCells(extendedCells_)
     , extendedDomainSize(extendedDomainSize_)
     , comm(comm_)
   {
-    data = FFTW<Real>::alloc_complex(data_size);
+    data = allocate(alloc_size);
 
     for (Index i = 0; i < data_size; ++i) {
       data[i][0] = backend.get(i);
@@ -75,19 +110,15 @@ public:
    */
   VectorWrapper(const VectorWrapper& other)
     : data_size(other.data_size)
+    , alloc_size(other.alloc_size)
     , extendedCells(other.extendedCells)
     , extendedDomainSize(other.extendedDomainSize)
     , comm(other.comm)
   {
     if (other.data) {
-      data = FFTW<Real>::alloc_complex(data_size);
-
-      for (Index i = 0; i < data_size; ++i) {
-        data[i][0] = other.data[i][0];
-        data[i][1] = other.data[i][1];
-      }
-    } else
-      data = nullptr;
+      data = allocate(alloc_size);
+      copy(other);
+    }
   }
 
   /**
@@ -96,24 +127,22 @@ public:
    * @param other other vector wrapper to move from
    */
   VectorWrapper(VectorWrapper&& other)
-    : data_size(std::move(other.data_size))
-    , data(std::move(other.data))
-    , extendedCells(std::move(other.extendedCells))
-    , extendedDomainSize(std::move(other.extendedDomainSize))
-    , comm(std::move(other.comm))
+    : data_size(other.data_size)
+    , alloc_size(other.alloc_size)
+    , data(other.data)
+    , extendedCells(other.extendedCells)
+    , extendedDomainSize(other.extendedDomainSize)
+    , comm(other.comm)
   {
     other.data = nullptr;
     other.data_size = 0;
+    other.alloc_size = 0;
   }
 
   /**
    * @brief Destructor
    */
-  ~VectorWrapper()
-  {
-    if (data)
-      FFTW<Real>::free(data);
-  }
+  ~VectorWrapper() { release(data, alloc_size); }
 
   /**
    * @brief Assignment operator
@@ -127,25 +156,25 @@ public:
     if (this == &other)
       return *this;
 
-    if (data_size != other.data_size) {
-      data_size = other.data_size;
-      extendedCells = other.extendedCells;
-      extendedDomainSize = other.extendedDomainSize;
-
-      if (data)
-        FFTW<Real>::free(data);
+    if (!other.data) {
+      release(data, alloc_size);
+      data = nullptr;
+      data_size = 0;
+      alloc_size = 0;
+      return *this;
+    }
 
-      if (data_size)
-        data = FFTW<Real>::alloc_complex(data_size);
-      else
-        data = nullptr;
+    if (!data || alloc_size != other.alloc_size) {
+      release(data, alloc_size);
+      data = allocate(other.alloc_size);
     }
 
-    if (other.data)
-      for (Index i = 0; i < data_size; ++i) {
-        data[i][0] = other.data[i][0];
-        data[i][1] = other.data[i][1];
-      }
+    data_size = other.data_size;
+    alloc_size = other.alloc_size;
+    extendedCells = other.extendedCells;
+    extendedDomainSize = other.extendedDomainSize;
+    comm = other.comm;
+    copy(other);
 
     return *this;
   }
@@ -159,13 +188,20 @@ public:
    */
   VectorWrapper& operator=(VectorWrapper&& other)
   {
-    data_size = std::move(other.data_size);
-    data = std::move(other.data);
-    extendedCells = std::move(other.extendedCells);
-    extendedDomainSize = std::move(other.extendedDomainSize);
-    comm = std::move(other.comm);
+    if (this == &other)
+      return *this;
+
+    release(data, alloc_size);
+
+    data_size = other.data_size;
+    alloc_size = other.alloc_size;
+    data = other.data;
+    extendedCells = other.extendedCells;
+    extendedDomainSize = other.extendedDomainSize;
+    comm = other.comm;
 
     other.data_size = 0;
+    other.alloc_size = 0;
     other.data = nullptr;
 
     return *this;
@@ -176,7 +212,7 @@ public:
    *
    * @return raw data pointer
    */
-  fftw_complex* raw() const { return data; }
+  Complex* raw() const { return data; }
 
   /**
    * @brief Scaled multiply-add
@@ -190,15 +226,8 @@ public:
   {
     if (other.data) {
       if (!data) {
-        data_size = other.data_size;
-        extendedCells = other.extendedCells;
-        extendedDomainSize = other.extendedDomainSize;
-        data = FFTW<Real>::alloc_complex(data_size);
-
-        for (Index i = 0; i < data_size; ++i) {
-          data[i][0] = alpha * other.data[i][0];
-          data[i][1] = alpha * other.data[i][1];
-        }
+        *this = other;
+        *this *= alpha;
       } else
         for (Index i = 0; i < data_size; ++i) {
           data[i][0] += alpha * other.data[i][0];
@@ -226,56 +255,21 @@ public:
    *
    * @param other other vector wrapper to add
    */
-  void operator+=(const VectorWrapper& other)
-  {
-    if (other.data) {
-      if (!data) {
-        data_size = other.data_size;
-        extendedCells = other.extendedCells;
-        extendedDomainSize = other.extendedDomainSize;
-        data = FFTW<Real>::alloc_complex(data_size);
-
-        for (Index i = 0; i < data_size; ++i) {
-          data[i][0] = other.data[i][0];
-          data[i][1] = other.data[i][1];
-        }
-      } else
-        for (Index i = 0; i < data_size; ++i) {
-          data[i][0] += other.data[i][0];
-          data[i][1] += other.data[i][1];
-        }
-    }
-  }
+  void operator+=(const VectorWrapper& other) { axpy(other, 1.); }
 
   /**
    * @brief Vector subtraction
    *
    * @param other other vector wrapper to subtract
    */
-  void operator-=(const VectorWrapper& other)
-  {
-    if (other.data) {
-      if (!data) {
-        data_size = other.data_size;
-        extendedCells = other.extendedCells;
-        extendedDomainSize = other.extendedDomainSize;
-        data = FFTW<Real>::alloc_complex(data_size);
-
-        for (Index i = 0; i < data_size; ++i) {
-          data[i][0] = -other.data[i][0];
-          data[i][1] = -other.data[i][1];
-        }
-      } else
-        for (Index i = 0; i < data_size; ++i) {
-          data[i][0] -= other.data[i][0];
-          data[i][1] -= other.data[i][1];
-        }
-    }
-  }
+  void operator-=(const VectorWrapper& other) { axpy(other, -1.); }
 
   /**
    * @brief Calculate value at given tuple of indices
    *
+   * Uses global indices, and is therefore only meaningful for
+   * sequential runs, e.g., for debug output.
+   *
    * @tparam Indices data type of indices
    * @tparam Vector  storage type with one entry
    *
@@ -310,20 +304,7 @@ public:
   void forwardTransform()
   {
     if (data) {
-      unsigned int flags = FFTW_ESTIMATE;
-
-      ptrdiff_t n[dim];
-      for (unsigned int i = 0; i < dim; i++)
-        n[i] = extendedCells[dim - 1 - i];
-
-      typename FFTW<Real>::plan plan_forward =
-        FFTW<Real>::mpi_plan_dft(dim, n, data, data, comm, FFTW_FORWARD, flags);
-
-      if (plan_forward == nullptr)
-        throw std::runtime_error{ "parafields failed to create forward plan" };
-
-      FFTW<Real>::execute(plan_forward);
-      FFTW<Real>::destroy_plan(plan_forward);
+      transform(FFTW_FORWARD);
 
       for (Index i = 0; i < data_size; ++i) {
         data[i][0] /= extendedDomainSize;
@@ -337,22 +318,8 @@ public:
    */
   void backwardTransform()
   {
-    if (data) {
-      unsigned int flags = FFTW_ESTIMATE;
-
-      ptrdiff_t n[dim];
-      for (unsigned int i = 0; i < dim; i++)
-        n[i] = extendedCells[dim - 1 - i];
-
-      typename FFTW<Real>::plan plan_backward = FFTW<Real>::mpi_plan_dft(
-        dim, n, data, data, comm, FFTW_BACKWARD, flags);
-
-      if (plan_backward == nullptr)
-        throw std::runtime_error{ "parafields failed to create backward plan" };
-
-      FFTW<Real>::execute(plan_backward);
-      FFTW<Real>::destroy_plan(plan_backward);
-    }
+    if (data)
+      transform(FFTW_BACKWARD);
   }
 
   /**
@@ -362,18 +329,20 @@ public:
    * @param threshold  threshold used for truncation
    * @param multiplier multiplier applied to data before truncation
    * @param logSumExp  apply LogSumExp transformation if true
+   *
+   * @return number of truncated entries across all processors
    */
   unsigned int makePositive(Real shift,
                             Real threshold,
                             Real multiplier = 1.,
                             bool logSumExp = false)
   {
-    unsigned int negative = 0;
+    unsigned int myNegative = 0;
 
     if (logSumExp) {
       for (Index i = 0; i < data_size; ++i) {
         if (data[i][0] < -threshold)
-          negative++;
+          myNegative++;
 
         data[i][0] =
           std::log1p(std::exp((data[i][0] - shift) * multiplier)) / multiplier;
@@ -381,12 +350,14 @@ public:
     } else {
       for (Index i = 0; i < data_size; ++i) {
         if (data[i][0] * multiplier < -threshold)
-          negative++;
+          myNegative++;
 
-        data[i][0] = std::max(data[i][0] - shift, 0.);
+        data[i][0] = std::max<Real>(data[i][0] - shift, 0.);
       }
     }
 
+    unsigned int negative;
+    MPI_Allreduce(&myNegative, &negative, 1, MPI_UNSIGNED, MPI_SUM, comm);
     return negative;
   }
 
@@ -423,7 +394,7 @@ public:
   /**
    * @brief Number of entries in vector
    *
-   * @return length of data vector
+   * @return length of local data vector
    */
   unsigned int size() const { return data_size; }
 
@@ -436,16 +407,18 @@ public:
    */
   Real operator*(const VectorWrapper& other) const
   {
-    if (data_size == 0 || other.data_size == 0)
+    if (!data || !other.data)
       return 0.;
 
     if (data_size != other.data_size)
       throw std::runtime_error{ "size mismatch" };
 
-    Real output = 0.;
+    Real myOutput = 0.;
     for (Index i = 0; i < data_size; ++i)
-      output += data[i][0] * other.data[i][0];
+      myOutput += data[i][0] * other.data[i][0];
 
+    Real output;
+    MPI_Allreduce(&myOutput, &output, 1, mpiType<Real>, MPI_SUM, comm);
     return output;
   }
 
@@ -459,34 +432,31 @@ public:
     if (!data)
       return 0.;
 
-    Real minValue = 0.;
-    for (Index i = 0; i < data_size; ++i) {
-      const Real value = data[i][0];
-      if (value < minValue)
-        minValue = value;
-    }
+    Real myMin = 0.;
+    for (Index i = 0; i < data_size; ++i)
+      myMin = std::min(myMin, data[i][0]);
 
+    Real minValue;
+    MPI_Allreduce(&myMin, &minValue, 1, mpiType<Real>, MPI_MIN, comm);
     return minValue;
   }
 
   /**
    * @brief Maximum norm
    *
-   * @return sum of absolute values
+   * @return maximum of absolute values
    */
   Real inf_norm() const
   {
     if (!data)
       return 0.;
 
-    Real maxValue = 0.;
-
-    for (Index i = 0; i < data_size; ++i) {
-      const Real absValue = std::abs(data[i][0]);
-      if (absValue > maxValue)
-        maxValue = absValue;
-    }
+    Real myMax = 0.;
+    for (Index i = 0; i < data_size; ++i)
+      myMax = std::max(myMax, std::abs(data[i][0]));
 
+    Real maxValue;
+    MPI_Allreduce(&myMax, &maxValue, 1, mpiType<Real>, MPI_MAX, comm);
     return maxValue;
   }
 
@@ -499,11 +469,19 @@ public:
    */
   bool operator==(const VectorWrapper& other) const
   {
+    if (!data || !other.data)
+      return !data && !other.data;
+
+    int myEqual = 1;
     for (Index i = 0; i < data_size; ++i)
-      if (data[i][0] != other.data[i][0])
-        return false;
+      if (data[i][0] != other.data[i][0]) {
+        myEqual = 0;
+        break;
+      }
 
-    return true;
+    int equal;
+    MPI_Allreduce(&myEqual, &equal, 1, MPI_INT, MPI_MIN, comm);
+    return equal;
   }
 
   /**
@@ -517,6 +495,108 @@ public:
   {
     return !operator==(other);
   }
+
+private:
+  /**
+   * @brief Copy data of other vector wrapper of same size
+   *
+   * @param other other vector wrapper to copy from
+   */
+  void copy(const VectorWrapper& other)
+  {
+    for (Index i = 0; i < data_size; ++i) {
+      data[i][0] = other.data[i][0];
+      data[i][1] = other.data[i][1];
+    }
+  }
+
+  /**
+   * @brief Perform in-place DFT on distributed data
+   *
+   * @param direction FFTW_FORWARD or FFTW_BACKWARD
+   */
+  void transform(int direction)
+  {
+    unsigned int flags = FFTW_ESTIMATE;
+
+    ptrdiff_t n[dim];
+    for (unsigned int i = 0; i < dim; i++)
+      n[i] = extendedCells[dim - 1 - i];
+
+    typename FFTEngine<Real>::plan plan =
+      createPlan((Real*)data, 0, flags, [&] {
+        return FFTEngine<Real>::mpi_plan_dft(
+          dim, n, data, data, comm, direction, flags);
+      });
+
+    if (plan == nullptr)
+      throw std::runtime_error{ "parafields failed to create plan" };
+
+    FFTEngine<Real>::execute(plan);
+    destroyPlan<Real>(plan);
+  }
+
+  /**
+   * @brief Global pool of released buffers
+   *
+   * @return reference to pool
+   */
+  static Pool& pool()
+  {
+    static Pool instance;
+    return instance;
+  }
+
+  /**
+   * @brief Take buffer of given size from pool, or allocate one
+   *
+   * @param size number of complex entries
+   *
+   * @return pointer to buffer
+   */
+  static Complex* allocate(Index size)
+  {
+    Pool& pool = VectorWrapper::pool();
+    {
+      std::lock_guard<std::mutex> lock(pool.mutex);
+      for (auto it = pool.buffers.begin(); it != pool.buffers.end(); ++it)
+        if (it->first == size) {
+          Complex* buffer = it->second;
+          pool.buffers.erase(it);
+          return buffer;
+        }
+    }
+
+    // ensure non-null pointer, so that all processors agree on state
+    Complex* buffer = FFTEngine<Real>::alloc_complex(std::max<Index>(size, 1));
+    if (buffer == nullptr)
+      throw std::bad_alloc{};
+
+    return buffer;
+  }
+
+  /**
+   * @brief Return buffer to pool, or free it if the pool is full
+   *
+   * @param buffer pointer to buffer, may be nullptr
+   * @param size   number of complex entries
+   */
+  static void release(Complex* buffer, Index size)
+  {
+    if (buffer == nullptr)
+      return;
+
+    Pool& pool = VectorWrapper::pool();
+    {
+      std::lock_guard<std::mutex> lock(pool.mutex);
+      if (pool.buffers.size() < maxPooled) {
+        pool.buffers.emplace_back(size, buffer);
+        return;
+      }
+    }
+
+    FFTEngine<Real>::free(buffer);
+  }
 };
 
 /**
@@ -615,18 +695,13 @@ public:
     forward++;
 
     if (config.template get<bool>("stochastic.logSumExp", false)) {
-      negative = 0;
-      Real max = std::numeric_limits<Real>::min();
-      for (unsigned int i = 0; i < localExtendedDomainSize; i++) {
-        if (current.raw()[i][0] < -threshold)
-          negative++;
-        max = std::max(max, -current.raw()[i][0]);
-      }
+      const Real max = reduceLogSumExpMax();
       if (logSumExpFactor == 0.)
         logSumExpFactor = 1. / max;
       Real sum = 0.;
       for (unsigned int i = 0; i < localExtendedDomainSize; i++)
         sum += std::exp(-logSumExpFactor * (current.raw()[i][0] - max));
+      MPI_Allreduce(MPI_IN_PLACE, &sum, 1, mpiType<Real>, MPI_SUM, comm);
 
       coneVal = max + std::log(sum) - std::log(extendedDomainSize);
     } else {
@@ -664,13 +739,7 @@ public:
     forward++;
 
     if (config.template get<bool>("stochastic.logSumExp", false)) {
-      negative = 0;
-      Real max = std::numeric_limits<Real>::min();
-      for (unsigned int i = 0; i < localExtendedDomainSize; i++) {
-        if (current.raw()[i][0] < -threshold)
-          negative++;
-        max = std::max(max, -current.raw()[i][0]);
-      }
+      const Real max = reduceLogSumExpMax();
       if (logSumExpFactor == 0.)
         logSumExpFactor = 1. / max;
       Real sum = 0.;
@@ -682,6 +751,7 @@ public:
         if (!std::isfinite(current.raw()[i][0]))
           current.raw()[i][0] = 0.;
       }
+      MPI_Allreduce(MPI_IN_PLACE, &sum, 1, mpiType<Real>, MPI_SUM, comm);
       current *= 1. / std::exp(max + std::log(sum));
 
       current.backwardTransform();
@@ -743,6 +813,31 @@ public:
   {
     iteration = iter;
   }
+
+private:
+  /**
+   * @brief Count negative modes and find largest negated mode
+   *
+   * Sets the number of modes below the negative threshold, reduced
+   * across all processors, and returns the global maximum of the
+   * negated Fourier modes in current.
+   *
+   * @return largest negated mode on all processors
+   */
+  Real reduceLogSumExpMax() const
+  {
+    negative = 0;
+    Real max = std::numeric_limits<Real>::min();
+    for (unsigned int i = 0; i < localExtendedDomainSize; i++) {
+      if (current.raw()[i][0] < -threshold)
+        negative++;
+      max = std::max(max, -current.raw()[i][0]);
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &negative, 1, MPI_UNSIGNED, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &max, 1, mpiType<Real>, MPI_MAX, comm);
+    return max;
+  }
 };
 
 /**
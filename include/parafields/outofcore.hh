@@ -0,0 +1,325 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "parafields/eigenvalues.hh"
+#include "parafields/exceptions.hh"
+#include "parafields/io.hh"
+
+#include "parafields/backends/outofcoretransform.hh"
+
+namespace parafields {
+
+/**
+ * @brief Field generation with disk-resident extended arrays
+ *
+ * Circulant embedding needs the eigenvalues and a complex field on the
+ * extended domain, which is several times larger than the original one.
+ * For fields where these arrays don't fit into the aggregate memory of the
+ * processors, this class keeps them in ScratchArray files in the directory
+ * outOfCore.directory (default: TMPDIR, or /tmp), which should be on local
+ * storage, and transforms them with OutOfCoreTransform. Each processor
+ * holds about outOfCore.memory MiB (default: 1024) of data in memory, but
+ * at least one plane of the extended domain. The part of the field on the
+ * original domain is streamed to an HDF5 file chunk by chunk, or, without
+ * HDF5 support, to a raw binary file in natural order (first dimension
+ * fastest) using MPI-IO.
+ *
+ * Only classical circulant embedding with a built-in covariance function
+ * is supported, since smooth periodization and optimization operate on the
+ * complete extended matrix, and the extended domain isn't grown
+ * automatically. The eigenvalues are computed on first use and kept on
+ * disk for subsequent fields.
+ *
+ * @tparam Traits traits class with data types and definitions
+ */
+template<typename Traits>
+class OutOfCoreGenerator
+{
+  using RF = typename Traits::RF;
+  using Indices = typename Traits::Indices;
+  using Complex = typename FFTEngine<RF>::complex;
+
+  enum
+  {
+    dim = Traits::dim
+  };
+
+  const std::shared_ptr<Traits> traits;
+  const std::function<RF(const std::array<RF, dim>&)> covariance;
+
+  std::string directory;
+  OutOfCoreTransform<Traits> transform;
+  std::uint64_t chunk;
+
+  std::unique_ptr<ScratchArray<RF>> roots;
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param traits_     traits object with parameters and communication
+   * @param covariance_ covariance function including variance and geometry
+   */
+  OutOfCoreGenerator(
+    const std::shared_ptr<Traits>& traits_,
+    const std::function<RF(const std::array<RF, dim>&)>& covariance_)
+    : traits(traits_)
+    , covariance(covariance_)
+  {
+    if (dim == 1)
+      throw std::runtime_error{ "out-of-core generation requires dim > 1" };
+
+    const std::string& periodization =
+      (*traits).config.template get<std::string>("embedding.periodization",
+                                                 "classical");
+    const std::string& optim =
+      (*traits).config.template get<std::string>("embedding.optim", "none");
+    if (periodization != "classical" || optim != "none")
+      throw std::runtime_error{
+        "out-of-core generation requires classical circulant embedding"
+      };
+
+    const char* tmpdir = std::getenv("TMPDIR");
+    directory = (*traits).config.template get<std::string>(
+      "outOfCore.directory", tmpdir ? tmpdir : "/tmp");
+
+    const double memory =
+      (*traits).config.template get<double>("outOfCore.memory", 1024.);
+    const std::uint64_t budget = std::max<std::uint64_t>(
+      1, memory * 1024. * 1024. / sizeof(Complex));
+    transform.update((*traits).comm, (*traits).extendedCells, budget);
+
+    // complex field and real roots, i.e., three values of type RF per entry
+    chunk = std::max<std::uint64_t>(
+      1, 2 * budget / 3 / transform.entriesPerPlane());
+  }
+
+  /**
+   * @brief Generate random field and write it to file
+   *
+   * @param rngBackend random number generator, seeded per processor
+   * @param fileName   base file name, extended by .stoch.h5 or .stoch.raw
+   */
+  template<typename RNG>
+  void generate(RNG& rngBackend, const std::string& fileName)
+  {
+    if (!roots)
+      computeRoots();
+
+    const std::uint64_t planeSize = transform.entriesPerPlane();
+    const std::uint64_t localPlanes = transform.localPlanes();
+
+    ScratchArray<Complex> field(directory);
+    {
+      std::vector<RF> storage(2 * chunk * planeSize);
+      Complex* data = (Complex*)storage.data();
+      std::vector<RF> lambda(chunk * planeSize);
+
+      for (std::uint64_t plane = 0; plane < localPlanes; plane += chunk) {
+        const std::uint64_t count =
+          std::min(chunk, localPlanes - plane) * planeSize;
+        roots->read(plane * planeSize, count, lambda.data());
+
+        for (std::uint64_t index = 0; index < count; index++) {
+          const RF& rand1 = rngBackend.sample();
+          const RF& rand2 = rngBackend.sample();
+          data[index][0] = lambda[index] * rand1;
+          data[index][1] = lambda[index] * rand2;
+        }
+
+        field.write(plane * planeSize, count, data);
+      }
+    }
+
+    transform.backward(field);
+
+    writeOriginalDomain(field, fileName);
+  }
+
+private:
+  /**
+   * @brief Compute square roots of eigenvalues of extended matrix
+   *
+   * Evaluates the covariance function with classical mirroring, transforms
+   * the result, and screens the eigenvalues like Matrix::checkEigenvalues,
+   * setting negative ones to zero.
+   */
+  void computeRoots()
+  {
+    const std::uint64_t planeSize = transform.entriesPerPlane();
+    const std::uint64_t localPlanes = transform.localPlanes();
+
+    std::uint64_t extendedDomainSize = 1;
+    for (unsigned int i = 0; i < dim; i++)
+      extendedDomainSize *= (*traits).extendedCells[i];
+
+    std::vector<RF> storage(2 * chunk * planeSize);
+    Complex* data = (Complex*)storage.data();
+
+    ScratchArray<Complex> matrix(directory);
+    for (std::uint64_t plane = 0; plane < localPlanes; plane += chunk) {
+      const std::uint64_t count =
+        std::min(chunk, localPlanes - plane) * planeSize;
+
+      std::array<RF, dim> coord;
+      for (std::uint64_t index = 0; index < count; index++) {
+        std::uint64_t rest = index;
+        for (unsigned int i = 0; i < dim; i++) {
+          std::uint64_t cell = rest;
+          if (i < dim - 1) {
+            cell = rest % (*traits).extendedCells[i];
+            rest /= (*traits).extendedCells[i];
+          } else
+            cell += transform.firstPlane() + plane;
+
+          coord[i] = cell * (*traits).meshsize[i];
+          if (coord[i] > 0.5 * (*traits).extendedExtensions[i])
+            coord[i] -= (*traits).extendedExtensions[i];
+        }
+
+        data[index][0] = covariance(coord);
+        data[index][1] = 0.;
+      }
+
+      matrix.write(plane * planeSize, count, data);
+    }
+
+    transform.forward(matrix);
+
+    EigenvalueScreening<RF> screening((*traits).config);
+    roots = std::make_unique<ScratchArray<RF>>(directory);
+    std::vector<RF> lambda(chunk * planeSize);
+    for (std::uint64_t plane = 0; plane < localPlanes; plane += chunk) {
+      const std::uint64_t count =
+        std::min(chunk, localPlanes - plane) * planeSize;
+      matrix.read(plane * planeSize, count, data);
+
+      for (std::uint64_t index = 0; index < count; index++) {
+        const RF value = data[index][0] / extendedDomainSize;
+        screening.add(value);
+        lambda[index] = std::sqrt(std::max(value, RF(0.)));
+      }
+
+      roots->write(plane * planeSize, count, lambda.data());
+    }
+
+    const unsigned long negative =
+      screening.reduce((*traits).comm, (*traits).verbose);
+    if (negative > 0 && !(*traits).approximate) {
+      roots.reset();
+      if ((*traits).rank == 0)
+        std::cerr << "negative eigenvalues in covariance matrix, "
+                  << "consider increasing embeddingFactor, or alternatively "
+                  << "allow generation of approximate samples" << std::endl;
+      throw NegativeEigenvalueError{
+        "negative eigenvalues in covariance matrix"
+      };
+    }
+  }
+
+  /**
+   * @brief Stream restriction of extended field to output file
+   *
+   * @param field    extended field after backward transform
+   * @param fileName base file name
+   */
+  void writeOriginalDomain(const ScratchArray<Complex>& field,
+                           const std::string& fileName) const
+  {
+    const Indices& cells = (*traits).cells;
+    const Indices& extendedCells = (*traits).extendedCells;
+    const std::uint64_t planeSize = transform.entriesPerPlane();
+
+    std::uint64_t originalPlaneSize = 1;
+    for (unsigned int i = 0; i < dim - 1; i++)
+      originalPlaneSize *= cells[i];
+
+    const std::uint64_t first = transform.firstPlane();
+    const std::uint64_t end =
+      std::min<std::uint64_t>(first + transform.localPlanes(), cells[dim - 1]);
+
+#if HAVE_HDF5
+    if ((*traits).verbose && (*traits).rank == 0)
+      std::cout << "streaming random field to file " << fileName << std::endl;
+
+    HDF5SlabWriter<RF, dim> writer(
+      cells, (*traits).comm, "/stochastic", fileName + ".stoch.h5");
+#else  // HAVE_HDF5
+    const std::string rawName = fileName + ".stoch.raw";
+    if ((*traits).verbose && (*traits).rank == 0)
+      std::cout << "streaming random field to file " << rawName << std::endl;
+
+    if ((*traits).rank == 0)
+      std::remove(rawName.c_str());
+    MPI_Barrier((*traits).comm);
+
+    MPI_File file;
+    if (MPI_File_open((*traits).comm,
+                      rawName.c_str(),
+                      MPI_MODE_WRONLY | MPI_MODE_CREATE,
+                      MPI_INFO_NULL,
+                      &file) != MPI_SUCCESS)
+      throw std::runtime_error{ "could not open " + rawName };
+#endif // HAVE_HDF5
+
+    std::vector<RF> storage(2 * chunk * planeSize);
+    Complex* data = (Complex*)storage.data();
+    std::vector<RF> values;
+
+    for (std::uint64_t plane = first; plane < end; plane += chunk) {
+      const std::uint64_t count = std::min(chunk, end - plane);
+      field.read((plane - first) * planeSize, count * planeSize, data);
+
+      values.resize(count * originalPlaneSize);
+      for (std::uint64_t index = 0; index < values.size(); index++) {
+        std::uint64_t rest = index;
+        std::uint64_t extendedIndex = 0;
+        std::uint64_t stride = 1;
+        for (unsigned int i = 0; i < dim - 1; i++) {
+          extendedIndex += (rest % cells[i]) * stride;
+          rest /= cells[i];
+          stride *= extendedCells[i];
+        }
+        extendedIndex += rest * stride;
+
+        values[index] = data[extendedIndex][0];
+      }
+
+#if HAVE_HDF5
+      Indices localCount = cells;
+      Indices localOffset;
+      std::fill(localOffset.begin(), localOffset.end(), 0);
+      localCount[dim - 1] = count;
+      localOffset[dim - 1] = plane;
+      writer.write(values, localCount, localOffset);
+#else  // HAVE_HDF5
+      MPI_File_write_at(file,
+                        plane * originalPlaneSize * sizeof(RF),
+                        values.data(),
+                        values.size(),
+                        mpiType<RF>,
+                        MPI_STATUS_IGNORE);
+#endif // HAVE_HDF5
+    }
+
+#if HAVE_HDF5
+    if ((*traits).rank == 0)
+      writeToXDMF<RF, dim>(cells, (*traits).extensions, fileName);
+#else  // HAVE_HDF5
+    MPI_File_close(&file);
+#endif // HAVE_HDF5
+  }
+};
+
+} // namespace parafields
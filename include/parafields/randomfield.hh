@@ -14,8 +14,10 @@
 #include <parafields/fieldtraits.hh>
 #include <parafields/io.hh>
 #include <parafields/legacyvtk.hh>
+#include <parafields/dispatchmatrix.hh>
 #include <parafields/matrix.hh>
 #include <parafields/mutators.hh>
+#include <parafields/registry.hh>
 #include <parafields/stochastic.hh>
 #include <parafields/trend.hh>
 
@@ -48,6 +50,8 @@ class RandomField
 {
 public:
   using Traits = RandomFieldTraits<GridTraits, IsoMatrix, AnisoMatrix>;
+  using Registry =
+    MatrixRegistry<Traits, IsoMatrix<Traits>, AnisoMatrix<Traits>>;
 
 protected:
   using StochasticPartType = StochasticPart<Traits>;
@@ -137,7 +141,7 @@ public:
                        const MPI_Comm comm = MPI_COMM_WORLD)
     : config(config_)
     , valueTransform(config)
-    , traits(new Traits(config, loadBalance, comm))
+    , traits(createTraits(config, loadBalance, comm))
     , trendPart(config, traits, fileName)
     , stochasticPart(traits, fileName)
     , cacheInvMatvec((*traits).cacheInvMatvec)
@@ -150,18 +154,7 @@ public:
       invRootMatvecValid = true;
     }
 
-    const std::string& anisotropy = (*traits).config.template get<std::string>(
-      "stochastic.anisotropy", "none");
-    const std::string& covariance =
-      (*traits).config.template get<std::string>("stochastic.covariance");
-    if (covariance != "custom-aniso" &&
-        (anisotropy == "none" || anisotropy == "axiparallel")) {
-      isoMatrix = IsoMatrixPtr(new IsoMatrix<Traits>(traits));
-      useAnisoMatrix = false;
-    } else {
-      anisoMatrix = AnisoMatrixPtr(new AnisoMatrix<Traits>(traits));
-      useAnisoMatrix = true;
-    }
+    createMatrix(loadBalance, comm);
 
     if (cacheInvMatvec)
       invMatvecPart = std::shared_ptr<StochasticPartType>(
@@ -196,7 +189,7 @@ public:
     : treeHelper(fileName)
     , config(treeHelper.get())
     , valueTransform(config)
-    , traits(new Traits(config, loadBalance, comm))
+    , traits(createTraits(config, loadBalance, comm))
     , trendPart(config, traits, fileName)
     , stochasticPart(traits, fileName)
     , cacheInvMatvec((*traits).cacheInvMatvec)
@@ -204,18 +197,7 @@ public:
     , invMatvecValid(false)
     , invRootMatvecValid(false)
   {
-    const std::string& anisotropy = (*traits).config.template get<std::string>(
-      "stochastic.anisotropy", "none");
-    const std::string& covariance =
-      (*traits).config.template get<std::string>("stochastic.covariance");
-    if (covariance != "custom-aniso" &&
-        (anisotropy == "none" || anisotropy == "axiparallel")) {
-      isoMatrix = IsoMatrixPtr(new IsoMatrix<Traits>(traits));
-      useAnisoMatrix = false;
-    } else {
-      anisoMatrix = AnisoMatrixPtr(new AnisoMatrix<Traits>(traits));
-      useAnisoMatrix = true;
-    }
+    createMatrix(loadBalance, comm);
 
     if (cacheInvMatvec)
       invMatvecPart = std::shared_ptr<StochasticPartType>(
@@ -415,6 +397,19 @@ public:
    */
   RF cellVolume() const { return (*traits).cellVolume; }
 
+  /**
+   * @brief Number of cells of the extended domain
+   *
+   * With automatic embedding, this is only final once the covariance
+   * matrix has been set up, e.g., after the first field generation.
+   *
+   * @return cells per dimension of the extended domain
+   */
+  const typename Traits::Indices& extendedCells() const
+  {
+    return (*traits).extendedCells;
+  }
+
   /**
    * @brief Number of degrees of freedom
    *
@@ -450,6 +445,87 @@ public:
           std::forward<Covariance>(covariance));
   }
 
+  /**
+   * @brief Set up covariance matrices of several fields at once
+   *
+   * This function is meant for hyperparameter sweeps, where fields with
+   * the same grid but different variance or correlation length are
+   * needed. The matrices of all given fields are filled in a single pass
+   * over the extended domain and transformed with a single batched FFT,
+   * instead of one setup per field on first use. Afterwards, samples can
+   * be drawn from each of the fields as usual. Has to be called
+   * collectively, with the same list on all processors.
+   *
+   * @param fields fields whose matrices should be set up
+   */
+  static void fillMatrices(const std::vector<RandomField*>& fields)
+  {
+    std::vector<const IsoMatrix<Traits>*> isoMatrices;
+    std::vector<const AnisoMatrix<Traits>*> anisoMatrices;
+    for (const RandomField* field : fields)
+      if (field->useAnisoMatrix)
+        anisoMatrices.push_back(field->anisoMatrix.get());
+      else
+        isoMatrices.push_back(field->isoMatrix.get());
+
+    IsoMatrix<Traits>::fillTransformedMatrices(isoMatrices);
+    AnisoMatrix<Traits>::fillTransformedMatrices(anisoMatrices);
+  }
+
+  /**
+   * @brief Start setup of covariance matrix in the background
+   *
+   * The covariance matrix is normally set up when it is first needed,
+   * e.g., on the first call of generate. This function instead starts
+   * its setup on a separate thread right away, so that it overlaps with
+   * other work of the application. All functions that need the matrix
+   * wait for the setup to complete, and waitReady can be used to wait
+   * explicitly. Has to be called collectively.
+   *
+   * @see Matrix::prepareAsync
+   */
+  void prepareAsync() const
+  {
+    if (useAnisoMatrix)
+      (*anisoMatrix).prepareAsync();
+    else
+      (*isoMatrix).prepareAsync();
+  }
+
+  /**
+   * @brief Wait for background setup of covariance matrix
+   *
+   * Returns immediately if prepareAsync hasn't been called, and rethrows
+   * exceptions raised during background setup. Has to be called
+   * collectively.
+   */
+  void waitReady() const
+  {
+    if (useAnisoMatrix)
+      (*anisoMatrix).waitReady();
+    else
+      (*isoMatrix).waitReady();
+  }
+
+  /**
+   * @brief Names of the backends of the covariance matrix
+   *
+   * Only available if the backends are selected at runtime, e.g., with
+   * AutoMatrix. Selects them if this hasn't happened yet, which includes
+   * autotuning if configured. Has to be called collectively.
+   *
+   * @return names of matrix and field backend, joined by a hyphen
+   *
+   * @see DispatchMatrix::backends
+   */
+  std::string backends() const
+  {
+    if (useAnisoMatrix)
+      return (*anisoMatrix).backends();
+    else
+      return (*isoMatrix).backends();
+  }
+
   /** @brief Dynamically add trend components
    *
    * This adds trend components to an already instantiated random field.
@@ -557,6 +633,46 @@ public:
     invRootMatvecValid = false;
   }
 
+  /**
+   * @brief Generate a field and write it to file without storing it
+   *
+   * Generate a random field sample using extended arrays on local disk,
+   * and stream the part on the original domain to the file fileName +
+   * ".stoch.h5" (with XDMF file), or fileName + ".stoch.raw" if HDF5 isn't
+   * available. Only the stochastic part is written, and the field object
+   * itself isn't modified. This is meant for fields that are too large for
+   * the in-memory circulant embedding, see OutOfCoreGenerator for the
+   * configuration options and restrictions.
+   *
+   * @param seed              seed value for random number generation
+   * @param fileName          base file name for the output
+   * @param allowNonWorldComm prevent inconsistent field generation by default
+   */
+  void generateOutOfCore(unsigned int seed,
+                         const std::string& fileName,
+                         bool allowNonWorldComm = false)
+  {
+    if (((*traits).comm != MPI_COMM_WORLD) && !allowNonWorldComm)
+      throw std::runtime_error{
+        "generation of inconsistent fields prevented, set "
+        "allowNonWorldComm = true if you really want this"
+      };
+
+#if HAVE_GSL
+    GSLRNGBackend<Traits> rngBackend(this->traits);
+#else
+    CppRNGBackend<Traits> rngBackend(this->traits);
+#endif
+
+    seed += this->traits->rank; // different seed for each processor
+    rngBackend.seed(seed);
+
+    if (useAnisoMatrix)
+      (*anisoMatrix).generateFieldOutOfCore(rngBackend, fileName);
+    else
+      (*isoMatrix).generateFieldOutOfCore(rngBackend, fileName);
+  }
+
   /**
    * @brief Generate a field without correlation structure (i.e. noise)
    *
@@ -604,6 +720,62 @@ public:
     invRootMatvecValid = false;
   }
 
+  /**
+   * @brief Prepare reduced-rank sampling with the given number of modes
+   *
+   * Selects the count modes of the circulant embedding with the largest
+   * eigenvalues, i.e., a truncated Karhunen-Loeve expansion of the field
+   * on the extended domain, see ReducedRankModes. Fields with few relevant
+   * modes can then be described by a small number of coefficients. This
+   * has to be called on all processors, and again after the covariance
+   * has been changed.
+   *
+   * @param count number of modes that should be kept
+   */
+  void setupReducedRank(unsigned int count)
+  {
+    if (useAnisoMatrix)
+      (*anisoMatrix).setupReducedRank(count);
+    else
+      (*isoMatrix).setupReducedRank(count);
+  }
+
+  /**
+   * @brief Eigenvalues of the modes used for reduced-rank sampling
+   *
+   * @return eigenvalues of the extended covariance matrix, in decreasing order
+   */
+  std::vector<RF> reducedRankEigenvalues() const
+  {
+    if (useAnisoMatrix)
+      return (*anisoMatrix).reducedRankModes().eigenvalues();
+    else
+      return (*isoMatrix).reducedRankModes().eigenvalues();
+  }
+
+  /**
+   * @brief Generate the stochastic part from reduced-rank coefficients
+   *
+   * Sums the leading coefficients.size() modes selected by
+   * setupReducedRank, weighted with the given coefficients. Standard
+   * normal coefficients produce a sample of the truncated expansion. The
+   * coefficients have to be the same on all processors, and the trend
+   * part isn't modified.
+   *
+   * @param coefficients one coefficient per mode
+   */
+  void generateFromCoefficients(const std::vector<RF>& coefficients)
+  {
+    if (useAnisoMatrix)
+      (*anisoMatrix)
+        .generateFieldFromCoefficients(coefficients, stochasticPart);
+    else
+      (*isoMatrix).generateFieldFromCoefficients(coefficients, stochasticPart);
+
+    invMatvecValid = false;
+    invRootMatvecValid = false;
+  }
+
 #if HAVE_DUNE_GRID
   /**
    * @brief Evaluate the random field in the coordinates of an element
@@ -650,6 +822,40 @@ public:
     valueTransform.apply(output);
   }
 
+  /**
+   * @brief Evaluate a reduced-rank field at given coordinates
+   *
+   * This evaluates the field that generateFromCoefficients would produce,
+   * including the current trend part, but only in a single location. The
+   * cost is proportional to the number of coefficients, so that a few
+   * point values can be obtained without generating the whole field. The
+   * location doesn't have to be on this processor.
+   *
+   * @param      coefficients one coefficient per mode
+   * @param      location     coordinates where field should be evaluated
+   * @param[out] output       field value at given position
+   */
+  void evaluateFromCoefficients(const std::vector<RF>& coefficients,
+                                const typename Traits::DomainType& location,
+                                typename Traits::RangeType& output) const
+  {
+    typename Traits::Indices cell, offset;
+    std::fill(offset.begin(), offset.end(), 0);
+    (*traits).coordsToIndices(location, cell, offset);
+    for (unsigned int i = 0; i < Traits::dim; i++)
+      cell[i] = std::min(cell[i], (*traits).cells[i] - 1);
+
+    typename Traits::RangeType trend = 0.;
+    trendPart.evaluate(location, trend);
+
+    if (useAnisoMatrix)
+      output = (*anisoMatrix).reducedRankModes().evaluate(coefficients, cell);
+    else
+      output = (*isoMatrix).reducedRankModes().evaluate(coefficients, cell);
+    output += trend;
+    valueTransform.apply(output);
+  }
+
   /**
    * @brief Evaluate the random field at all cells on this processor
    *
@@ -708,8 +914,17 @@ public:
     stochasticPart.writeToFile(fileName);
     trendPart.writeToFile(fileName);
 
+    // report current hyperparameters instead of initial ones
+    Dune::ParameterTree currentConfig(config);
+    const Dune::ParameterTree& hyperparameters = (*traits).hyperparameters;
+    if (hyperparameters.hasSub("stochastic"))
+      for (const std::string& key :
+           hyperparameters.sub("stochastic").getValueKeys())
+        currentConfig["stochastic." + key] =
+          hyperparameters["stochastic." + key];
+
     std::ofstream file(fileName + ".field", std::ofstream::trunc);
-    config.report(file);
+    currentConfig.report(file);
   }
 
   /**
@@ -879,6 +1094,7 @@ public:
    */
   void refineMatrix()
   {
+    Registry::evict(traits);
     (*traits).refine();
     if (useAnisoMatrix)
       (*anisoMatrix).update();
@@ -953,6 +1169,7 @@ public:
    */
   void coarsenMatrix()
   {
+    Registry::evict(traits);
     (*traits).coarsen();
     if (useAnisoMatrix)
       (*anisoMatrix).update();
@@ -960,6 +1177,37 @@ public:
       (*isoMatrix).update();
   }
 
+  /**
+   * @brief Change variance and / or correlation length of covariance matrix
+   *
+   * This function replaces the values of stochastic.variance and
+   * stochastic.corrLength with those contained in the given ParameterTree
+   * object, e.g., when hyperparameters are sampled in hierarchical Bayesian
+   * inversion. A pure change of variance simply rescales the eigenvalues
+   * of the covariance matrix, while a change of correlation length
+   * recomputes them without setting up the matrix from scratch. Just like
+   * refineMatrix, this method should only be called once for several
+   * fields sharing a covariance matrix. The current field values are kept,
+   * but cached matrix-vector products are discarded.
+   *
+   * @param hyperparameters ParameterTree object containing new values
+   *
+   * @see refineMatrix
+   */
+  void updateHyperparameters(const Dune::ParameterTree& hyperparameters)
+  {
+    Registry::evict(traits);
+    const bool corrLengthChanged =
+      (*traits).setHyperparameters(hyperparameters);
+    if (useAnisoMatrix)
+      (*anisoMatrix).updateHyperparameters(corrLengthChanged);
+    else
+      (*isoMatrix).updateHyperparameters(corrLengthChanged);
+
+    invMatvecValid = false;
+    invRootMatvecValid = false;
+  }
+
   /**
    * @brief Reduce spatial resolution of random field
    *
@@ -1386,6 +1634,99 @@ public:
     if (cacheInvRootMatvec)
       invRootMatvecValid = false;
   }
+
+  /**
+   * @brief Check whether covariance matrix is shared with other field
+   *
+   * This is the case for copies of a field, and for fields that obtained
+   * their matrix from the registry.
+   *
+   * @param other other random field to compare with
+   *
+   * @return true if both fields use the same matrix instance, else false
+   */
+  bool sharesMatrix(const RandomField& other) const
+  {
+    return traits == other.traits;
+  }
+
+protected:
+  /**
+   * @brief Check whether matrix should be obtained from registry
+   *
+   * Sharing has to be requested via randomField.shareMatrix, and is
+   * not available for custom covariance functions, since the matrix
+   * then depends on a user-supplied object.
+   *
+   * @param config ParameterTree object containing configuration
+   *
+   * @return true if registry should be used, else false
+   */
+  static bool useRegistry(const Dune::ParameterTree& config)
+  {
+    const std::string& covariance =
+      config.get<std::string>("stochastic.covariance", "");
+    return config.get<bool>("randomField.shareMatrix", false) &&
+           covariance != "custom-iso" && covariance != "custom-aniso";
+  }
+
+  /**
+   * @brief Create traits object, or obtain it from registry
+   *
+   * @tparam LoadBalance class used for parallel data distribution with MPI
+   *
+   * @param config      ParameterTree object containing configuration
+   * @param loadBalance instance of the load balancer
+   * @param comm        MPI communicator for parallel field generation
+   *
+   * @return pointer to traits object
+   */
+  template<typename LoadBalance>
+  static std::shared_ptr<Traits> createTraits(
+    const Dune::ParameterTree& config,
+    const LoadBalance& loadBalance,
+    const MPI_Comm comm)
+  {
+    if (useRegistry(config))
+      return Registry::acquire(config, loadBalance, comm).traits;
+    else
+      return std::make_shared<Traits>(config, loadBalance, comm);
+  }
+
+  /**
+   * @brief Create covariance matrix, or obtain it from registry
+   *
+   * @tparam LoadBalance class used for parallel data distribution with MPI
+   *
+   * @param loadBalance instance of the load balancer
+   * @param comm        MPI communicator for parallel field generation
+   */
+  template<typename LoadBalance>
+  void createMatrix(const LoadBalance& loadBalance, const MPI_Comm comm)
+  {
+    const std::string& anisotropy = (*traits).config.template get<std::string>(
+      "stochastic.anisotropy", "none");
+    const std::string& covariance =
+      (*traits).config.template get<std::string>("stochastic.covariance");
+    useAnisoMatrix = covariance == "custom-aniso" ||
+                     (anisotropy != "none" && anisotropy != "axiparallel");
+
+    if (useRegistry(config)) {
+      typename Registry::Entry& entry =
+        Registry::acquire(config, loadBalance, comm);
+
+      if (useAnisoMatrix && !entry.anisoMatrix)
+        entry.anisoMatrix = AnisoMatrixPtr(new AnisoMatrix<Traits>(traits));
+      else if (!useAnisoMatrix && !entry.isoMatrix)
+        entry.isoMatrix = IsoMatrixPtr(new IsoMatrix<Traits>(traits));
+
+      isoMatrix = entry.isoMatrix;
+      anisoMatrix = entry.anisoMatrix;
+    } else if (useAnisoMatrix)
+      anisoMatrix = AnisoMatrixPtr(new AnisoMatrix<Traits>(traits));
+    else
+      isoMatrix = IsoMatrixPtr(new IsoMatrix<Traits>(traits));
+  }
 };
 
 /**
@@ -1518,6 +1859,10 @@ public:
           config.hasKey("randomField.cgIterations"))
         subConfig["randomField.cgIterations"] =
           config["randomField.cgIterations"];
+      if (!subConfig.hasKey("randomField.shareMatrix") &&
+          config.hasKey("randomField.shareMatrix"))
+        subConfig["randomField.shareMatrix"] =
+          config["randomField.shareMatrix"];
 
       std::string subFileName = fileName;
       if (subFileName != "")
@@ -1975,11 +2320,20 @@ public:
    * method for design reasons, since several random fields can share a
    * covariance matrix, i.e., this method should only be called once, and
    * then refine should be called on all fields sharing the matrix instance.
+   * Fields within the list that share their matrix are only refined once.
    */
   void refineMatrix()
   {
-    for (const std::string& type : activeTypes)
-      list.find(type)->second->refineMatrix();
+    std::vector<std::shared_ptr<SubRandomField>> done;
+    for (const std::string& type : activeTypes) {
+      const std::shared_ptr<SubRandomField>& field = list.find(type)->second;
+      if (std::none_of(done.begin(), done.end(), [&](const auto& other) {
+            return field->sharesMatrix(*other);
+          })) {
+        field->refineMatrix();
+        done.push_back(field);
+      }
+    }
   }
 
   /**
@@ -2006,8 +2360,16 @@ public:
    */
   void coarsenMatrix()
   {
-    for (const std::string& type : activeTypes)
-      list.find(type)->second->coarsenMatrix();
+    std::vector<std::shared_ptr<SubRandomField>> done;
+    for (const std::string& type : activeTypes) {
+      const std::shared_ptr<SubRandomField>& field = list.find(type)->second;
+      if (std::none_of(done.begin(), done.end(), [&](const auto& other) {
+            return field->sharesMatrix(*other);
+          })) {
+        field->coarsenMatrix();
+        done.push_back(field);
+      }
+    }
   }
 
   /**
@@ -0,0 +1,392 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "parafields/exceptions.hh"
+
+namespace parafields {
+
+/**
+ * @brief Truncated Karhunen-Loeve expansion based on the circulant spectrum
+ *
+ * The eigenvectors of the extended circulant matrix are Fourier modes, and
+ * those of its real part are the cosine and sine of the frequencies of the
+ * extended domain, with a pair of complex conjugate frequencies k and -k
+ * sharing the eigenvalue N * mu_k, where N is the number of cells of the
+ * extended domain and mu_k the normalized eigenvalue as stored by the
+ * backends. This class collects these modes, keeps the ones with the
+ * largest eigenvalues, and represents a field as
+ *
+ *   Z(n) = sum_j xi_j * sqrt(c_j mu_j) * phi_j(2 pi k_j . n / N),
+ *
+ * where phi_j is either cosine or sine, and c_j is one for frequencies
+ * that are their own mirror image (only cosine) and two otherwise. With
+ * all modes and standard normal coefficients xi_j, this has the same
+ * distribution as circulant embedding on the extended domain.
+ *
+ * The modes are selected by each processor among its part of the spectrum
+ * first, and then merged, so that all processors store the same set of
+ * modes in the same order, i.e., by decreasing eigenvalue. The expansion
+ * is evaluated by direct summation, which costs O(k) per cell and is
+ * therefore meant for small numbers of modes or of evaluation points.
+ *
+ * @tparam Traits traits class with data types and definitions
+ */
+template<typename Traits>
+class ReducedRankModes
+{
+  using RF = typename Traits::RF;
+  using Index = typename Traits::Index;
+  using Indices = typename Traits::Indices;
+
+  enum
+  {
+    dim = Traits::dim
+  };
+
+  const std::shared_ptr<Traits> traits;
+
+  // eigenvalue, flat frequency (first dimension fastest), and whether
+  // the mode is the sine instead of the cosine of that frequency
+  std::vector<RF> modeEigenvalues;
+  std::vector<std::uint64_t> modeFrequencies;
+  std::vector<int> modeSine;
+
+  // factor sqrt(c_j mu_j) of each mode, derived from the above
+  std::vector<RF> modeScales;
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param traits_ traits object with parameters and communication
+   */
+  ReducedRankModes(const std::shared_ptr<Traits>& traits_)
+    : traits(traits_)
+  {
+  }
+
+  /**
+   * @brief Offer a frequency of the local part of the spectrum
+   *
+   * Only one frequency of each conjugate pair is kept, so this may be
+   * called for the complete spectrum or for the stored half of a
+   * Hermitian one. Frequencies with nonpositive eigenvalues are ignored.
+   *
+   * @param frequency global frequency, one per dimension
+   * @param lambda    normalized eigenvalue mu_k of the frequency
+   */
+  void addCandidate(const Indices& frequency, RF lambda)
+  {
+    if (lambda <= 0.)
+      return;
+
+    const Indices& extendedCells = (*traits).extendedCells;
+
+    // keep k if it is lexicographically not larger than -k
+    for (unsigned int i = 0; i < dim; i++) {
+      const Index mirror =
+        (extendedCells[i] - frequency[i]) % extendedCells[i];
+      if (frequency[i] < mirror)
+        break;
+      if (frequency[i] > mirror)
+        return;
+    }
+
+    const RF eigenvalue = (*traits).extendedDomainSize * lambda;
+    const std::uint64_t flat = flatFrequency(frequency);
+
+    modeEigenvalues.push_back(eigenvalue);
+    modeFrequencies.push_back(flat);
+    modeSine.push_back(0);
+
+    if (!selfConjugate(frequency)) {
+      modeEigenvalues.push_back(eigenvalue);
+      modeFrequencies.push_back(flat);
+      modeSine.push_back(1);
+    }
+  }
+
+  /**
+   * @brief Keep the given number of modes with largest eigenvalues
+   *
+   * Has to be called on all processors after all local candidates have
+   * been added. Afterwards, each processor holds the same modes. Ties are
+   * broken by frequency, so that the result doesn't depend on the data
+   * distribution.
+   *
+   * @param count number of modes that should be kept
+   */
+  void select(unsigned int count)
+  {
+    // local preselection, only the largest count modes can survive
+    std::vector<std::size_t> order = sortedOrder();
+    if (order.size() > count)
+      order.resize(count);
+    permute(order);
+
+    const int localCount = modeEigenvalues.size();
+    std::vector<int> counts((*traits).commSize), displs((*traits).commSize, 0);
+    MPI_Allgather(
+      &localCount, 1, MPI_INT, counts.data(), 1, MPI_INT, (*traits).comm);
+    for (int i = 1; i < (*traits).commSize; i++)
+      displs[i] = displs[i - 1] + counts[i - 1];
+    const int totalCount = displs.back() + counts.back();
+
+    std::vector<RF> eigenvalues(totalCount);
+    std::vector<std::uint64_t> frequencies(totalCount);
+    std::vector<int> sine(totalCount);
+    MPI_Allgatherv(modeEigenvalues.data(),
+                   localCount,
+                   mpiType<RF>,
+                   eigenvalues.data(),
+                   counts.data(),
+                   displs.data(),
+                   mpiType<RF>,
+                   (*traits).comm);
+    MPI_Allgatherv(modeFrequencies.data(),
+                   localCount,
+                   MPI_UINT64_T,
+                   frequencies.data(),
+                   counts.data(),
+                   displs.data(),
+                   MPI_UINT64_T,
+                   (*traits).comm);
+    MPI_Allgatherv(modeSine.data(),
+                   localCount,
+                   MPI_INT,
+                   sine.data(),
+                   counts.data(),
+                   displs.data(),
+                   MPI_INT,
+                   (*traits).comm);
+
+    modeEigenvalues.swap(eigenvalues);
+    modeFrequencies.swap(frequencies);
+    modeSine.swap(sine);
+
+    order = sortedOrder();
+    if (order.size() > count)
+      order.resize(count);
+    permute(order);
+
+    modeScales.resize(modeEigenvalues.size());
+    Indices frequency;
+    for (std::size_t j = 0; j < modeEigenvalues.size(); j++) {
+      unflatFrequency(modeFrequencies[j], frequency);
+      const RF factor = selfConjugate(frequency) ? 1. : 2.;
+      modeScales[j] = std::sqrt(
+        factor * modeEigenvalues[j] / (*traits).extendedDomainSize);
+    }
+  }
+
+  /**
+   * @brief Number of selected modes
+   *
+   * This may be less than requested if the spectrum doesn't contain
+   * enough modes with positive eigenvalue.
+   *
+   * @return number of modes
+   */
+  std::size_t size() const { return modeEigenvalues.size(); }
+
+  /**
+   * @brief Eigenvalues of the selected modes, in decreasing order
+   *
+   * @return eigenvalues of the extended covariance matrix
+   */
+  const std::vector<RF>& eigenvalues() const { return modeEigenvalues; }
+
+  /**
+   * @brief Evaluate the expansion in a single cell
+   *
+   * The leading coefficients.size() modes are used.
+   *
+   * @param coefficients coefficients xi_j of the modes
+   * @param cell         global indices of the cell
+   *
+   * @return value of the expansion in the cell
+   */
+  RF evaluate(const std::vector<RF>& coefficients, const Indices& cell) const
+  {
+    checkCoefficients(coefficients);
+
+    const Indices& extendedCells = (*traits).extendedCells;
+    static const RF twoPi = 2. * std::acos(-1.);
+
+    RF output = 0.;
+    Indices frequency;
+    for (std::size_t j = 0; j < coefficients.size(); j++) {
+      unflatFrequency(modeFrequencies[j], frequency);
+
+      RF phase = 0.;
+      for (unsigned int i = 0; i < dim; i++)
+        phase += RF((std::uint64_t(frequency[i]) * cell[i]) %
+                    extendedCells[i]) /
+                 extendedCells[i];
+
+      const RF value = modeSine[j] ? std::sin(twoPi * phase)
+                                   : std::cos(twoPi * phase);
+      output += coefficients[j] * modeScales[j] * value;
+    }
+
+    return output;
+  }
+
+  /**
+   * @brief Evaluate the expansion on the local part of the domain
+   *
+   * The leading coefficients.size() modes are used. Each mode is
+   * tabulated along the dimensions and then summed over the local cells,
+   * first dimension fastest.
+   *
+   * @param      coefficients coefficients xi_j of the modes
+   * @param[out] data         values on the local cells
+   */
+  void generate(const std::vector<RF>& coefficients,
+                std::vector<RF>& data) const
+  {
+    checkCoefficients(coefficients);
+
+    const Indices& localCells = (*traits).localCells;
+    const Indices& localOffset = (*traits).localOffset;
+    const Indices& extendedCells = (*traits).extendedCells;
+    static const RF twoPi = 2. * std::acos(-1.);
+
+    data.assign((*traits).localDomainSize, 0.);
+
+    const Index rows = (*traits).localDomainSize / localCells[0];
+    std::array<std::vector<std::complex<RF>>, dim> tables;
+    Indices frequency, indices;
+    for (std::size_t j = 0; j < coefficients.size(); j++) {
+      unflatFrequency(modeFrequencies[j], frequency);
+
+      for (unsigned int i = 0; i < dim; i++) {
+        tables[i].resize(localCells[i]);
+        for (Index n = 0; n < localCells[i]; n++) {
+          const std::uint64_t phase =
+            (std::uint64_t(frequency[i]) * (n + localOffset[i])) %
+            extendedCells[i];
+          tables[i][n] = std::polar(RF(1.), twoPi * phase / extendedCells[i]);
+        }
+      }
+
+      const RF weight = coefficients[j] * modeScales[j];
+      for (Index row = 0; row < rows; row++) {
+        std::complex<RF> outer = weight;
+        Index rest = row;
+        for (unsigned int i = 1; i < dim; i++) {
+          outer *= tables[i][rest % localCells[i]];
+          rest /= localCells[i];
+        }
+
+        RF* line = data.data() + row * localCells[0];
+        if (modeSine[j])
+          for (Index n = 0; n < localCells[0]; n++)
+            line[n] += (outer * tables[0][n]).imag();
+        else
+          for (Index n = 0; n < localCells[0]; n++)
+            line[n] += (outer * tables[0][n]).real();
+      }
+    }
+  }
+
+private:
+  /**
+   * @brief Check that there is a mode for each coefficient
+   *
+   * @param coefficients coefficients xi_j of the modes
+   */
+  void checkCoefficients(const std::vector<RF>& coefficients) const
+  {
+    if (coefficients.size() > modeEigenvalues.size())
+      throw std::runtime_error{
+        "more coefficients than reduced-rank modes given"
+      };
+  }
+
+  /**
+   * @brief Whether a frequency is its own mirror image
+   *
+   * @param frequency global frequency, one per dimension
+   *
+   * @return true if k equals -k modulo the extended domain, else false
+   */
+  bool selfConjugate(const Indices& frequency) const
+  {
+    for (unsigned int i = 0; i < dim; i++)
+      if ((2 * frequency[i]) % (*traits).extendedCells[i] != 0)
+        return false;
+
+    return true;
+  }
+
+  /**
+   * @brief Flat index of a frequency, first dimension fastest
+   */
+  std::uint64_t flatFrequency(const Indices& frequency) const
+  {
+    std::uint64_t output = 0;
+    for (unsigned int i = dim; i-- > 0;)
+      output = output * (*traits).extendedCells[i] + frequency[i];
+
+    return output;
+  }
+
+  /**
+   * @brief Frequency for flat index, inverse of flatFrequency
+   */
+  void unflatFrequency(std::uint64_t flat, Indices& frequency) const
+  {
+    for (unsigned int i = 0; i < dim; i++) {
+      frequency[i] = flat % (*traits).extendedCells[i];
+      flat /= (*traits).extendedCells[i];
+    }
+  }
+
+  /**
+   * @brief Order of modes by decreasing eigenvalue, then frequency
+   */
+  std::vector<std::size_t> sortedOrder() const
+  {
+    std::vector<std::size_t> order(modeEigenvalues.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+      if (modeEigenvalues[a] != modeEigenvalues[b])
+        return modeEigenvalues[a] > modeEigenvalues[b];
+      if (modeFrequencies[a] != modeFrequencies[b])
+        return modeFrequencies[a] < modeFrequencies[b];
+      return modeSine[a] < modeSine[b];
+    });
+
+    return order;
+  }
+
+  /**
+   * @brief Keep the given modes, in the given order
+   */
+  void permute(const std::vector<std::size_t>& order)
+  {
+    std::vector<RF> eigenvalues;
+    std::vector<std::uint64_t> frequencies;
+    std::vector<int> sine;
+    for (const std::size_t j : order) {
+      eigenvalues.push_back(modeEigenvalues[j]);
+      frequencies.push_back(modeFrequencies[j]);
+      sine.push_back(modeSine[j]);
+    }
+
+    modeEigenvalues.swap(eigenvalues);
+    modeFrequencies.swap(frequencies);
+    modeSine.swap(sine);
+  }
+};
+
+} // namespace parafields
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include <dune/common/parametertree.hh>
+
+namespace parafields {
+
+/**
+ * @brief Write section of configuration in canonical form
+ *
+ * @param stream stream to write to
+ * @param tree   section of configuration
+ * @param prefix name of section, including trailing dot
+ */
+inline void
+writeCanonicalSection(std::ostream& stream,
+                      const Dune::ParameterTree& tree,
+                      const std::string& prefix)
+{
+  for (const std::string& valueKey : tree.getValueKeys()) {
+    std::istringstream value(tree[valueKey]);
+    std::string token;
+    stream << prefix << valueKey << "=";
+    if (value >> token)
+      stream << token;
+    while (value >> token)
+      stream << " " << token;
+    stream << "\n";
+  }
+
+  for (const std::string& subKey : tree.getSubKeys())
+    writeCanonicalSection(stream, tree.sub(subKey), prefix + subKey + ".");
+}
+
+/**
+ * @brief Canonical representation of covariance matrix parameters
+ *
+ * Collects all configuration values that influence the covariance
+ * matrix (sections grid, embedding, stochastic, fftw and randomField),
+ * sorted by name and with normalized whitespace, so that equivalent
+ * configurations result in the same string.
+ *
+ * @param config ParameterTree object containing configuration
+ *
+ * @return string representation of relevant parameters
+ */
+inline std::string
+canonicalConfig(const Dune::ParameterTree& config)
+{
+  std::ostringstream stream;
+  for (const std::string section :
+       { "grid", "embedding", "stochastic", "fftw", "randomField" })
+    if (config.hasSub(section))
+      writeCanonicalSection(stream, config.sub(section), section + ".");
+
+  return stream.str();
+}
+
+/**
+ * @brief Process-wide registry of covariance matrices
+ *
+ * Random fields normally share their covariance matrix only through copy
+ * construction. Fields that have been constructed independently, but with
+ * identical parameters, would each set up their own matrix and repeat the
+ * computation of its eigenvalues. If the configuration key
+ * randomField.shareMatrix is set, fields instead request traits and
+ * covariance matrix from this registry, which stores one entry per
+ * distinct set of relevant parameters. These entries are shared between
+ * all fields using them, just like with copy construction, and stay alive
+ * until they have been evicted and the last field using them has been
+ * destroyed. Since the matrix is set up collectively, all processors have
+ * to construct the same fields and evict the same entries. Entries for a
+ * communicator other than MPI_COMM_WORLD are evicted automatically when
+ * it is freed.
+ *
+ * @tparam Traits      traits class with data types and definitions
+ * @tparam IsoMatrix   covariance matrix implementation using symmetries
+ * @tparam AnisoMatrix covariance matrix implementation for general covariance
+ * functions
+ */
+template<typename Traits, typename IsoMatrix, typename AnisoMatrix>
+class MatrixRegistry
+{
+public:
+  /**
+   * @brief Shared objects associated with a set of parameters
+   */
+  struct Entry
+  {
+    std::shared_ptr<Traits> traits;
+    std::shared_ptr<IsoMatrix> isoMatrix;
+    std::shared_ptr<AnisoMatrix> anisoMatrix;
+  };
+
+  /**
+   * @brief Canonical key for a given configuration
+   *
+   * The key consists of the canonical configuration, the type of load
+   * balancer, and the communicator. Precision and matrix
+   * implementation are template parameters, i.e., each combination of
+   * them has its own registry. Communicators are identified by a number
+   * attached to them as an attribute, since MPI may reuse the handle of
+   * a freed communicator for a new one.
+   *
+   * @tparam LoadBalance class used for parallel data distribution with MPI
+   *
+   * @param config      ParameterTree object containing configuration
+   * @param loadBalance instance of the load balancer
+   * @param comm        MPI communicator for parallel field generation
+   *
+   * @return string representation of relevant parameters
+   */
+  template<typename LoadBalance>
+  static std::string key(const Dune::ParameterTree& config,
+                         const LoadBalance& loadBalance,
+                         const MPI_Comm comm)
+  {
+    std::ostringstream stream;
+    stream << canonicalConfig(config);
+    stream << "loadBalance=" << typeid(LoadBalance).name() << "\n";
+    stream << "comm=" << commId(comm) << "\n";
+    return stream.str();
+  }
+
+  /**
+   * @brief Entry associated with a given configuration
+   *
+   * Returns the existing entry for the configuration, or creates a new
+   * one containing freshly constructed traits. The matrix pointers of a
+   * new entry are empty, and have to be set by the first field using it.
+   * The traits only store a reference to their configuration, so the
+   * traits of an entry own a copy of it, which keeps them valid after
+   * the field that created the entry has been destroyed.
+   *
+   * @tparam LoadBalance class used for parallel data distribution with MPI
+   *
+   * @param config      ParameterTree object containing configuration
+   * @param loadBalance instance of the load balancer
+   * @param comm        MPI communicator for parallel field generation
+   *
+   * @return reference to registry entry
+   */
+  template<typename LoadBalance>
+  static Entry& acquire(const Dune::ParameterTree& config,
+                        const LoadBalance& loadBalance,
+                        const MPI_Comm comm)
+  {
+    const std::string& entryKey = key(config, loadBalance, comm);
+    auto it = entries().find(entryKey);
+    if (it == entries().end()) {
+      const auto ownConfig =
+        std::make_shared<const Dune::ParameterTree>(config);
+      Entry entry;
+      entry.traits =
+        std::shared_ptr<Traits>(new Traits(*ownConfig, loadBalance, comm),
+                                [ownConfig](Traits* traits) { delete traits; });
+      it = entries().insert({ entryKey, entry }).first;
+    }
+
+    return it->second;
+  }
+
+  /**
+   * @brief Remove entry with given key from registry
+   *
+   * Fields that are currently using the entry keep their reference to
+   * it, but subsequently constructed fields will create a new entry.
+   *
+   * @param entryKey key as returned by the key method
+   *
+   * @return true if an entry was removed, else false
+   */
+  static bool evict(const std::string& entryKey)
+  {
+    return entries().erase(entryKey) > 0;
+  }
+
+  /**
+   * @brief Remove entry containing given traits object from registry
+   *
+   * This is used when the traits of an entry are modified, e.g., during
+   * refinement, so that the entry no longer matches its key.
+   *
+   * @param traits traits object that should no longer be handed out
+   *
+   * @return true if an entry was removed, else false
+   */
+  static bool evict(const std::shared_ptr<Traits>& traits)
+  {
+    for (auto it = entries().begin(); it != entries().end(); ++it)
+      if (it->second.traits == traits) {
+        entries().erase(it);
+        return true;
+      }
+
+    return false;
+  }
+
+  /**
+   * @brief Remove all entries from registry
+   */
+  static void clear() { entries().clear(); }
+
+  /**
+   * @brief Number of entries in registry
+   *
+   * @return number of distinct configurations currently stored
+   */
+  static std::size_t size() { return entries().size(); }
+
+private:
+  /**
+   * @brief Number identifying a communicator within this registry
+   *
+   * A new number is attached to communicators that don't have one yet.
+   * Duplicates don't inherit it, and freeing the communicator evicts
+   * its entries, see commFreedCallback.
+   *
+   * @param comm MPI communicator for parallel field generation
+   *
+   * @return number that is unique among all communicators used so far
+   */
+  static std::uintptr_t commId(MPI_Comm comm)
+  {
+    static std::uintptr_t nextId = 1;
+
+    void* value;
+    int found;
+    MPI_Comm_get_attr(comm, commKeyval(), &value, &found);
+    if (found)
+      return reinterpret_cast<std::uintptr_t>(value);
+
+    const std::uintptr_t id = nextId++;
+    MPI_Comm_set_attr(comm, commKeyval(), reinterpret_cast<void*>(id));
+    return id;
+  }
+
+  /**
+   * @brief Keyval for the communicator numbers
+   *
+   * @return keyval, created on first use
+   */
+  static int commKeyval()
+  {
+    static int keyval = [] {
+      int newKeyval;
+      MPI_Comm_create_keyval(
+        MPI_COMM_NULL_COPY_FN, &commFreedCallback, &newKeyval, nullptr);
+      return newKeyval;
+    }();
+    return keyval;
+  }
+
+  /**
+   * @brief Callback evicting entries of a communicator that is freed
+   */
+  static int commFreedCallback(MPI_Comm, int, void* value, void*)
+  {
+    std::ostringstream stream;
+    stream << "comm=" << reinterpret_cast<std::uintptr_t>(value) << "\n";
+    const std::string suffix = stream.str();
+
+    // destroyed after the loop, since matrix destructors may call MPI
+    std::vector<Entry> evicted;
+    for (auto it = entries().begin(); it != entries().end();)
+      if (it->first.size() >= suffix.size() &&
+          it->first.compare(
+            it->first.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        evicted.push_back(it->second);
+        it = entries().erase(it);
+      } else
+        ++it;
+
+    return MPI_SUCCESS;
+  }
+
+  /**
+   * @brief Storage for registry entries
+   *
+   * The entries hold covariance matrices, which have to be destroyed
+   * before MPI is finalized. An attribute is therefore attached to
+   * MPI_COMM_SELF, which clears the registry as part of MPI_Finalize.
+   *
+   * @return reference to map from keys to entries
+   */
+  static std::map<std::string, Entry>& entries()
+  {
+    static std::map<std::string, Entry> map;
+    static const bool cleanupRegistered = registerCleanup();
+    (void)cleanupRegistered;
+    return map;
+  }
+
+  /**
+   * @brief Request clearing of registry during MPI_Finalize
+   *
+   * @return true
+   */
+  static bool registerCleanup()
+  {
+    int keyval;
+    MPI_Comm_create_keyval(
+      MPI_COMM_NULL_COPY_FN, &finalizeCallback, &keyval, nullptr);
+    MPI_Comm_set_attr(MPI_COMM_SELF, keyval, nullptr);
+    return true;
+  }
+
+  /**
+   * @brief Callback clearing the registry, called by MPI_Finalize
+   */
+  static int finalizeCallback(MPI_Comm, int, void*, void*)
+  {
+    clear();
+    return MPI_SUCCESS;
+  }
+};
+
+} // namespace parafields
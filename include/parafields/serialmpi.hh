@@ -0,0 +1,847 @@
+#pragma once
+
+#ifdef MPI_VERSION
+#error "serial build of parafields can't be combined with MPI headers"
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/*
+ * Replacement of the MPI and FFTW-MPI functions used by parafields for
+ * builds without MPI, see PARAFIELDS_USE_MPI in CMakeLists.txt. There is
+ * exactly one process, so collective operations reduce to copying the
+ * local contribution, messages can only be sent to the process itself,
+ * and the FFTW-MPI planners are mapped onto the sequential (optionally
+ * threaded) planners with the same data layout, if FFTW is available.
+ * Datatypes are represented by their size in bytes, which is all that is
+ * needed for copying.
+ */
+
+// types and constants
+
+using MPI_Comm = int;
+using MPI_Datatype = std::size_t;
+using MPI_Op = int;
+using MPI_Request = int;
+using MPI_Info = int;
+using MPI_Offset = long long;
+using MPI_File = std::FILE*;
+
+struct MPI_Status
+{
+  int MPI_SOURCE;
+  int MPI_TAG;
+  int MPI_ERROR;
+  std::size_t bytes;
+};
+
+using MPI_Comm_copy_attr_function =
+  int(MPI_Comm, int, void*, void*, void*, int*);
+using MPI_Comm_delete_attr_function = int(MPI_Comm, int, void*, void*);
+
+constexpr int MPI_SUCCESS = 0;
+constexpr int MPI_ERR_OTHER = 1;
+
+constexpr MPI_Comm MPI_COMM_NULL = 0;
+constexpr MPI_Comm MPI_COMM_WORLD = 1;
+constexpr MPI_Comm MPI_COMM_SELF = 2;
+
+constexpr int MPI_IDENT = 0;
+constexpr int MPI_CONGRUENT = 1;
+
+constexpr MPI_Datatype MPI_BYTE = 1;
+constexpr MPI_Datatype MPI_INT = sizeof(int);
+constexpr MPI_Datatype MPI_UNSIGNED = sizeof(unsigned int);
+constexpr MPI_Datatype MPI_UNSIGNED_LONG = sizeof(unsigned long);
+constexpr MPI_Datatype MPI_UINT64_T = sizeof(std::uint64_t);
+constexpr MPI_Datatype MPI_FLOAT = sizeof(float);
+constexpr MPI_Datatype MPI_DOUBLE = sizeof(double);
+constexpr MPI_Datatype MPI_LONG_DOUBLE = sizeof(long double);
+
+constexpr MPI_Op MPI_SUM = 0;
+constexpr MPI_Op MPI_MIN = 1;
+constexpr MPI_Op MPI_MAX = 2;
+constexpr MPI_Op MPI_LOR = 3;
+
+constexpr MPI_Request MPI_REQUEST_NULL = 0;
+constexpr MPI_Info MPI_INFO_NULL = 0;
+
+constexpr int MPI_THREAD_SINGLE = 0;
+constexpr int MPI_THREAD_FUNNELED = 1;
+constexpr int MPI_THREAD_SERIALIZED = 2;
+constexpr int MPI_THREAD_MULTIPLE = 3;
+
+constexpr int MPI_MODE_RDONLY = 2;
+constexpr int MPI_MODE_WRONLY = 4;
+constexpr int MPI_MODE_CREATE = 1;
+
+inline void* const MPI_IN_PLACE = reinterpret_cast<void*>(1);
+inline MPI_Status* const MPI_STATUS_IGNORE = nullptr;
+inline MPI_Status* const MPI_STATUSES_IGNORE = nullptr;
+inline MPI_Comm_copy_attr_function* const MPI_COMM_NULL_COPY_FN = nullptr;
+
+namespace parafields {
+namespace serial {
+
+/**
+ * @brief Message that has been sent, but not yet received
+ */
+struct Message
+{
+  int tag;
+  std::vector<char> data;
+};
+
+/**
+ * @brief Messages the process has sent to itself, in order
+ */
+inline std::deque<Message>&
+mailbox()
+{
+  static std::deque<Message> messages;
+  return messages;
+}
+
+/**
+ * @brief Value attached to a communicator with a keyval
+ */
+struct Attribute
+{
+  MPI_Comm comm;
+  int keyval;
+  void* value;
+};
+
+/**
+ * @brief Delete callbacks of the created keyvals, indexed by keyval
+ */
+inline std::vector<MPI_Comm_delete_attr_function*>&
+keyvals()
+{
+  static std::vector<MPI_Comm_delete_attr_function*> callbacks;
+  return callbacks;
+}
+
+/**
+ * @brief Attributes of all communicators, in the order they were set
+ */
+inline std::vector<Attribute>&
+attributes()
+{
+  static std::vector<Attribute> list;
+  return list;
+}
+
+/**
+ * @brief Remove attribute and call the delete callback of its keyval
+ *
+ * The attribute is removed first, since the callback may modify the
+ * attributes itself, e.g., by freeing other communicators.
+ */
+inline void
+deleteAttribute(std::vector<Attribute>::iterator it)
+{
+  const Attribute attribute = *it;
+  attributes().erase(it);
+  MPI_Comm_delete_attr_function* callback = keyvals()[attribute.keyval];
+  if (callback != nullptr)
+    callback(attribute.comm, attribute.keyval, attribute.value, nullptr);
+}
+
+/**
+ * @brief Delete all attributes of a communicator, most recent first
+ */
+inline void
+deleteAttributes(MPI_Comm comm)
+{
+  while (true) {
+    std::vector<Attribute>& list = attributes();
+    const auto it = std::find_if(
+      list.rbegin(), list.rend(), [&](const Attribute& attribute) {
+        return attribute.comm == comm;
+      });
+    if (it == list.rend())
+      return;
+
+    deleteAttribute(std::next(it).base());
+  }
+}
+
+/**
+ * @brief Attribute of communicator with given keyval, if any
+ */
+inline std::vector<Attribute>::iterator
+findAttribute(MPI_Comm comm, int keyval)
+{
+  std::vector<Attribute>& list = attributes();
+  return std::find_if(
+    list.begin(), list.end(), [&](const Attribute& attribute) {
+      return attribute.comm == comm && attribute.keyval == keyval;
+    });
+}
+
+/**
+ * @brief Copy local contribution, unless it is already in place
+ */
+inline void
+copy(const void* in, void* out, std::size_t bytes)
+{
+  if (in != MPI_IN_PLACE && in != out && bytes > 0)
+    std::memmove(out, in, bytes);
+}
+
+} // namespace serial
+} // namespace parafields
+
+// environment and communicators
+
+inline int
+MPI_Init(int*, char***)
+{
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Init_thread(int*, char***, int, int* provided)
+{
+  *provided = MPI_THREAD_MULTIPLE;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Finalize()
+{
+  // like MPI, delete attributes of MPI_COMM_SELF first
+  parafields::serial::deleteAttributes(MPI_COMM_SELF);
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Query_thread(int* provided)
+{
+  *provided = MPI_THREAD_MULTIPLE;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Comm_rank(MPI_Comm, int* rank)
+{
+  *rank = 0;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Comm_size(MPI_Comm, int* size)
+{
+  *size = 1;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Comm_dup(MPI_Comm, MPI_Comm* newComm)
+{
+  static MPI_Comm next = MPI_COMM_SELF + 1;
+  *newComm = next++;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Comm_free(MPI_Comm* comm)
+{
+  parafields::serial::deleteAttributes(*comm);
+  *comm = MPI_COMM_NULL;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Comm_compare(MPI_Comm comm1, MPI_Comm comm2, int* result)
+{
+  *result = (comm1 == comm2) ? MPI_IDENT : MPI_CONGRUENT;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Comm_c2f(MPI_Comm comm)
+{
+  return comm;
+}
+
+inline int
+MPI_Comm_create_keyval(MPI_Comm_copy_attr_function*,
+                       MPI_Comm_delete_attr_function* deleteFunction,
+                       int* keyval,
+                       void*)
+{
+  *keyval = parafields::serial::keyvals().size();
+  parafields::serial::keyvals().push_back(deleteFunction);
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Comm_set_attr(MPI_Comm comm, int keyval, void* value)
+{
+  const auto it = parafields::serial::findAttribute(comm, keyval);
+  if (it != parafields::serial::attributes().end())
+    parafields::serial::deleteAttribute(it);
+
+  parafields::serial::attributes().push_back({ comm, keyval, value });
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Comm_get_attr(MPI_Comm comm, int keyval, void* value, int* flag)
+{
+  const auto it = parafields::serial::findAttribute(comm, keyval);
+  *flag = (it != parafields::serial::attributes().end());
+  if (*flag)
+    *static_cast<void**>(value) = it->value;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Type_contiguous(int count, MPI_Datatype oldType, MPI_Datatype* newType)
+{
+  *newType = count * oldType;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Type_commit(MPI_Datatype*)
+{
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Type_free(MPI_Datatype* type)
+{
+  *type = 0;
+  return MPI_SUCCESS;
+}
+
+// collective operations
+
+inline int
+MPI_Barrier(MPI_Comm)
+{
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Bcast(void*, int, MPI_Datatype, int, MPI_Comm)
+{
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Allreduce(const void* in,
+              void* out,
+              int count,
+              MPI_Datatype type,
+              MPI_Op,
+              MPI_Comm)
+{
+  parafields::serial::copy(in, out, count * type);
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Reduce(const void* in,
+           void* out,
+           int count,
+           MPI_Datatype type,
+           MPI_Op,
+           int,
+           MPI_Comm)
+{
+  parafields::serial::copy(in, out, count * type);
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Exscan(const void*, void*, int, MPI_Datatype, MPI_Op, MPI_Comm)
+{
+  // result is undefined on first process
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Allgather(const void* in,
+              int inCount,
+              MPI_Datatype inType,
+              void* out,
+              int,
+              MPI_Datatype,
+              MPI_Comm)
+{
+  parafields::serial::copy(in, out, inCount * inType);
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Allgatherv(const void* in,
+               int inCount,
+               MPI_Datatype inType,
+               void* out,
+               const int*,
+               const int* displs,
+               MPI_Datatype outType,
+               MPI_Comm)
+{
+  parafields::serial::copy(
+    in, static_cast<char*>(out) + displs[0] * outType, inCount * inType);
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Alltoallv(const void* in,
+              const int* inCounts,
+              const int* inDispls,
+              MPI_Datatype inType,
+              void* out,
+              const int*,
+              const int* outDispls,
+              MPI_Datatype outType,
+              MPI_Comm)
+{
+  parafields::serial::copy(static_cast<const char*>(in) + inDispls[0] * inType,
+                           static_cast<char*>(out) + outDispls[0] * outType,
+                           inCounts[0] * inType);
+  return MPI_SUCCESS;
+}
+
+// point-to-point communication
+
+inline int
+MPI_Isend(const void* buffer,
+          int count,
+          MPI_Datatype type,
+          int,
+          int tag,
+          MPI_Comm,
+          MPI_Request* request)
+{
+  const char* bytes = static_cast<const char*>(buffer);
+  parafields::serial::mailbox().push_back(
+    { tag, std::vector<char>(bytes, bytes + count * type) });
+  *request = MPI_REQUEST_NULL;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Recv(void* buffer,
+         int count,
+         MPI_Datatype type,
+         int,
+         int tag,
+         MPI_Comm,
+         MPI_Status* status)
+{
+  auto& mailbox = parafields::serial::mailbox();
+  for (auto it = mailbox.begin(); it != mailbox.end(); ++it)
+    if (it->tag == tag) {
+      const std::size_t bytes = std::min(it->data.size(), count * type);
+      std::memcpy(buffer, it->data.data(), bytes);
+      if (status != MPI_STATUS_IGNORE)
+        *status = { 0, tag, MPI_SUCCESS, bytes };
+      mailbox.erase(it);
+      return MPI_SUCCESS;
+    }
+
+  throw std::runtime_error{ "receive without matching send in serial build" };
+}
+
+inline int
+MPI_Wait(MPI_Request* request, MPI_Status*)
+{
+  *request = MPI_REQUEST_NULL;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Waitall(int count, MPI_Request* requests, MPI_Status*)
+{
+  for (int i = 0; i < count; i++)
+    requests[i] = MPI_REQUEST_NULL;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_Get_count(const MPI_Status* status, MPI_Datatype type, int* count)
+{
+  *count = status->bytes / type;
+  return MPI_SUCCESS;
+}
+
+// file access
+
+inline int
+MPI_File_open(MPI_Comm, const char* name, int mode, MPI_Info, MPI_File* file)
+{
+  *file = std::fopen(name, (mode & MPI_MODE_RDONLY) ? "rb" : "wb");
+  return (*file != nullptr) ? MPI_SUCCESS : MPI_ERR_OTHER;
+}
+
+inline int
+MPI_File_close(MPI_File* file)
+{
+  const int result = std::fclose(*file);
+  *file = nullptr;
+  return (result == 0) ? MPI_SUCCESS : MPI_ERR_OTHER;
+}
+
+inline int
+MPI_File_read_at_all(MPI_File file,
+                     MPI_Offset offset,
+                     void* buffer,
+                     int count,
+                     MPI_Datatype type,
+                     MPI_Status* status)
+{
+  std::size_t bytes = 0;
+  if (std::fseek(file, offset, SEEK_SET) == 0)
+    bytes = std::fread(buffer, 1, count * type, file);
+  if (status != MPI_STATUS_IGNORE)
+    *status = { 0, 0, MPI_SUCCESS, bytes };
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_File_write_at(MPI_File file,
+                  MPI_Offset offset,
+                  const void* buffer,
+                  int count,
+                  MPI_Datatype type,
+                  MPI_Status*)
+{
+  if (std::fseek(file, offset, SEEK_SET) != 0 ||
+      std::fwrite(buffer, 1, count * type, file) != count * type)
+    return MPI_ERR_OTHER;
+  return MPI_SUCCESS;
+}
+
+inline int
+MPI_File_write_at_all(MPI_File file,
+                      MPI_Offset offset,
+                      const void* buffer,
+                      int count,
+                      MPI_Datatype type,
+                      MPI_Status* status)
+{
+  return MPI_File_write_at(file, offset, buffer, count, type, status);
+}
+
+// FFTW-MPI, mapped onto sequential FFTW
+
+constexpr ptrdiff_t FFTW_MPI_DEFAULT_BLOCK = 0;
+constexpr unsigned int FFTW_MPI_TRANSPOSED_IN = 1U << 29;
+constexpr unsigned int FFTW_MPI_TRANSPOSED_OUT = 1U << 30;
+
+#if HAVE_FFTW3_FLOAT || HAVE_FFTW3_DOUBLE
+#include <fftw3.h>
+
+namespace parafields {
+namespace serial {
+
+/**
+ * @brief Convert extents to the integer type of the sequential planners
+ */
+inline std::vector<int>
+extents(int rank, const ptrdiff_t* n)
+{
+  return std::vector<int>(n, n + rank);
+}
+
+/**
+ * @brief Extents of the padded real array of FFTW-MPI r2c transforms
+ */
+inline std::vector<int>
+paddedExtents(int rank, const ptrdiff_t* n)
+{
+  std::vector<int> padded(n, n + rank);
+  padded[rank - 1] = 2 * (n[rank - 1] / 2 + 1);
+  return padded;
+}
+
+/**
+ * @brief Extents of the complex array of r2c and c2r transforms
+ */
+inline std::vector<int>
+halfExtents(int rank, const ptrdiff_t* n)
+{
+  std::vector<int> half(n, n + rank);
+  half[rank - 1] = n[rank - 1] / 2 + 1;
+  return half;
+}
+
+/**
+ * @brief Transposed layouts only save communication and aren't available
+ */
+inline bool
+transposedLayout(unsigned int flags)
+{
+  return flags & (FFTW_MPI_TRANSPOSED_IN | FFTW_MPI_TRANSPOSED_OUT);
+}
+
+/**
+ * @brief Number of local entries, i.e., all of them
+ */
+inline ptrdiff_t
+localSize(int rank, const ptrdiff_t* n, ptrdiff_t howmany)
+{
+  ptrdiff_t size = howmany;
+  for (int i = 0; i < rank; i++)
+    size *= n[i];
+  return size;
+}
+
+} // namespace serial
+} // namespace parafields
+
+/**
+ * @brief Define the FFTW-MPI functions used by parafields for one precision
+ *
+ * @param X name mangling macro of FFTW, e.g., FFTW_MANGLE_DOUBLE
+ * @param R real data type of the precision
+ */
+#define PARAFIELDS_SERIAL_FFTW(X, R)                                           \
+  inline void X(mpi_init)() {}                                                 \
+                                                                               \
+  inline void X(mpi_broadcast_wisdom)(MPI_Comm) {}                             \
+                                                                               \
+  inline void X(mpi_gather_wisdom)(MPI_Comm) {}                                \
+                                                                               \
+  inline ptrdiff_t X(mpi_local_size)(int rank,                                 \
+                                     const ptrdiff_t* n,                       \
+                                     MPI_Comm,                                 \
+                                     ptrdiff_t* localN0,                       \
+                                     ptrdiff_t* local0Start)                   \
+  {                                                                            \
+    *localN0 = n[0];                                                           \
+    *local0Start = 0;                                                          \
+    return parafields::serial::localSize(rank, n, 1);                          \
+  }                                                                            \
+                                                                               \
+  inline ptrdiff_t X(mpi_local_size_1d)(ptrdiff_t n0,                          \
+                                        MPI_Comm,                              \
+                                        int,                                   \
+                                        unsigned int,                          \
+                                        ptrdiff_t* localNi,                    \
+                                        ptrdiff_t* localIStart,                \
+                                        ptrdiff_t* localNo,                    \
+                                        ptrdiff_t* localOStart)                \
+  {                                                                            \
+    *localNi = *localNo = n0;                                                  \
+    *localIStart = *localOStart = 0;                                           \
+    return n0;                                                                 \
+  }                                                                            \
+                                                                               \
+  inline ptrdiff_t X(mpi_local_size_many_transposed)(int rank,                 \
+                                                     const ptrdiff_t* n,       \
+                                                     ptrdiff_t howmany,        \
+                                                     ptrdiff_t,                \
+                                                     ptrdiff_t,                \
+                                                     MPI_Comm,                 \
+                                                     ptrdiff_t* localN0,       \
+                                                     ptrdiff_t* local0Start,   \
+                                                     ptrdiff_t* localN1,       \
+                                                     ptrdiff_t* local1Start)   \
+  {                                                                            \
+    *localN0 = n[0];                                                           \
+    *local0Start = 0;                                                          \
+    *localN1 = (rank > 1) ? n[1] : n[0];                                       \
+    *local1Start = 0;                                                          \
+    return parafields::serial::localSize(rank, n, howmany);                    \
+  }                                                                            \
+                                                                               \
+  inline ptrdiff_t X(mpi_local_size_transposed)(int rank,                      \
+                                                const ptrdiff_t* n,            \
+                                                MPI_Comm comm,                 \
+                                                ptrdiff_t* localN0,            \
+                                                ptrdiff_t* local0Start,        \
+                                                ptrdiff_t* localN1,            \
+                                                ptrdiff_t* local1Start)        \
+  {                                                                            \
+    return X(mpi_local_size_many_transposed)(                                  \
+      rank, n, 1, 0, 0, comm, localN0, local0Start, localN1, local1Start);     \
+  }                                                                            \
+                                                                               \
+  inline X(plan) X(mpi_plan_many_dft)(int rank,                                \
+                                      const ptrdiff_t* n,                      \
+                                      ptrdiff_t howmany,                       \
+                                      ptrdiff_t,                               \
+                                      ptrdiff_t,                               \
+                                      X(complex) * in,                         \
+                                      X(complex) * out,                        \
+                                      MPI_Comm,                                \
+                                      int sign,                                \
+                                      unsigned int flags)                      \
+  {                                                                            \
+    if (parafields::serial::transposedLayout(flags))                           \
+      return nullptr;                                                          \
+    const std::vector<int> dims = parafields::serial::extents(rank, n);        \
+    return X(plan_many_dft)(rank,                                              \
+                            dims.data(),                                       \
+                            howmany,                                           \
+                            in,                                                \
+                            nullptr,                                           \
+                            howmany,                                           \
+                            1,                                                 \
+                            out,                                               \
+                            nullptr,                                           \
+                            howmany,                                           \
+                            1,                                                 \
+                            sign,                                              \
+                            flags);                                            \
+  }                                                                            \
+                                                                               \
+  inline X(plan) X(mpi_plan_dft)(int rank,                                     \
+                                 const ptrdiff_t* n,                           \
+                                 X(complex) * in,                              \
+                                 X(complex) * out,                             \
+                                 MPI_Comm comm,                                \
+                                 int sign,                                     \
+                                 unsigned int flags)                           \
+  {                                                                            \
+    return X(mpi_plan_many_dft)(rank, n, 1, 0, 0, in, out, comm, sign, flags); \
+  }                                                                            \
+                                                                               \
+  inline X(plan) X(mpi_plan_many_dft_r2c)(int rank,                            \
+                                          const ptrdiff_t* n,                  \
+                                          ptrdiff_t howmany,                   \
+                                          ptrdiff_t,                           \
+                                          ptrdiff_t,                           \
+                                          R* in,                               \
+                                          X(complex) * out,                    \
+                                          MPI_Comm,                            \
+                                          unsigned int flags)                  \
+  {                                                                            \
+    if (parafields::serial::transposedLayout(flags))                           \
+      return nullptr;                                                          \
+    const std::vector<int> dims = parafields::serial::extents(rank, n);        \
+    const std::vector<int> padded =                                            \
+      parafields::serial::paddedExtents(rank, n);                              \
+    const std::vector<int> half = parafields::serial::halfExtents(rank, n);    \
+    return X(plan_many_dft_r2c)(rank,                                          \
+                                dims.data(),                                   \
+                                howmany,                                       \
+                                in,                                            \
+                                padded.data(),                                 \
+                                howmany,                                       \
+                                1,                                             \
+                                out,                                           \
+                                half.data(),                                   \
+                                howmany,                                       \
+                                1,                                             \
+                                flags);                                        \
+  }                                                                            \
+                                                                               \
+  inline X(plan) X(mpi_plan_dft_r2c)(int rank,                                 \
+                                     const ptrdiff_t* n,                       \
+                                     R* in,                                    \
+                                     X(complex) * out,                         \
+                                     MPI_Comm comm,                            \
+                                     unsigned int flags)                       \
+  {                                                                            \
+    return X(mpi_plan_many_dft_r2c)(rank, n, 1, 0, 0, in, out, comm, flags);   \
+  }                                                                            \
+                                                                               \
+  inline X(plan) X(mpi_plan_dft_c2r)(int rank,                                 \
+                                     const ptrdiff_t* n,                       \
+                                     X(complex) * in,                          \
+                                     R* out,                                   \
+                                     MPI_Comm,                                 \
+                                     unsigned int flags)                       \
+  {                                                                            \
+    if (parafields::serial::transposedLayout(flags))                           \
+      return nullptr;                                                          \
+    const std::vector<int> dims = parafields::serial::extents(rank, n);        \
+    const std::vector<int> padded =                                            \
+      parafields::serial::paddedExtents(rank, n);                              \
+    const std::vector<int> half = parafields::serial::halfExtents(rank, n);    \
+    return X(plan_many_dft_c2r)(rank,                                          \
+                                dims.data(),                                   \
+                                1,                                             \
+                                in,                                            \
+                                half.data(),                                   \
+                                1,                                             \
+                                0,                                             \
+                                out,                                           \
+                                padded.data(),                                 \
+                                1,                                             \
+                                0,                                             \
+                                flags);                                        \
+  }                                                                            \
+                                                                               \
+  inline X(plan) X(mpi_plan_many_r2r)(int rank,                                \
+                                      const ptrdiff_t* n,                      \
+                                      ptrdiff_t howmany,                       \
+                                      ptrdiff_t,                               \
+                                      ptrdiff_t,                               \
+                                      R* in,                                   \
+                                      R* out,                                  \
+                                      MPI_Comm,                                \
+                                      const X(r2r_kind) * kinds,               \
+                                      unsigned int flags)                      \
+  {                                                                            \
+    if (parafields::serial::transposedLayout(flags))                           \
+      return nullptr;                                                          \
+    const std::vector<int> dims = parafields::serial::extents(rank, n);        \
+    return X(plan_many_r2r)(rank,                                              \
+                            dims.data(),                                       \
+                            howmany,                                           \
+                            in,                                                \
+                            nullptr,                                           \
+                            howmany,                                           \
+                            1,                                                 \
+                            out,                                               \
+                            nullptr,                                           \
+                            howmany,                                           \
+                            1,                                                 \
+                            kinds,                                             \
+                            flags);                                            \
+  }                                                                            \
+                                                                               \
+  inline X(plan) X(mpi_plan_r2r)(int rank,                                     \
+                                 const ptrdiff_t* n,                           \
+                                 R* in,                                        \
+                                 R* out,                                       \
+                                 MPI_Comm comm,                                \
+                                 const X(r2r_kind) * kinds,                    \
+                                 unsigned int flags)                           \
+  {                                                                            \
+    return X(mpi_plan_many_r2r)(                                               \
+      rank, n, 1, 0, 0, in, out, comm, kinds, flags);                          \
+  }                                                                            \
+                                                                               \
+  inline X(plan) X(mpi_plan_many_transpose)(ptrdiff_t n0,                      \
+                                            ptrdiff_t n1,                      \
+                                            ptrdiff_t howmany,                 \
+                                            ptrdiff_t,                         \
+                                            ptrdiff_t,                         \
+                                            R* in,                             \
+                                            R* out,                            \
+                                            MPI_Comm,                          \
+                                            unsigned int flags)                \
+  {                                                                            \
+    /* rank zero transform with strides, i.e., a plain transpose */            \
+    const X(iodim64) dims[3] = { { n0, n1 * howmany, howmany },                \
+                                 { n1, howmany, n0 * howmany },                \
+                                 { howmany, 1, 1 } };                          \
+    return X(plan_guru64_r2r)(0, nullptr, 3, dims, in, out, nullptr, flags);   \
+  }
+
+PARAFIELDS_SERIAL_FFTW(FFTW_MANGLE_FLOAT, float)
+PARAFIELDS_SERIAL_FFTW(FFTW_MANGLE_DOUBLE, double)
+PARAFIELDS_SERIAL_FFTW(FFTW_MANGLE_LONG_DOUBLE, long double)
+
+#undef PARAFIELDS_SERIAL_FFTW
+#endif // HAVE_FFTW3_FLOAT || HAVE_FFTW3_DOUBLE
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "parafields/registry.hh"
+
+namespace parafields {
+
+/**
+ * @brief On-disk cache for transformed covariance matrices
+ *
+ * For a fixed configuration, the eigenvalues of the extended covariance
+ * matrix are the same in every program run. If the configuration key
+ * cache.directory is set, the transformed matrix is written to a file in
+ * that directory after it has been computed, and subsequent runs read it
+ * instead of evaluating the covariance function and transforming it. The
+ * file name contains a hash of the canonical configuration, the current
+ * hyperparameters, the current number of cells and refinement level, the
+ * matrix backend, the precision and the number of processors. The file
+ * itself consists of a header (format version, precision, dimension,
+ * number of processors, transposition flag, extended domain, canonical
+ * key), a table of local array sizes, and the local arrays in rank order,
+ * written and read with MPI-IO. All of this is validated before any data
+ * is used, and files that don't match are silently ignored. Custom
+ * covariance functions are never cached, since the matrix then depends on
+ * a user-supplied object.
+ *
+ * @tparam Traits traits class with data types and definitions
+ */
+template<typename Traits>
+class SpectrumCache
+{
+  using RF = typename Traits::RF;
+  using Index = typename Traits::Index;
+  using Indices = typename Traits::Indices;
+
+  enum
+  {
+    dim = Traits::dim
+  };
+
+  static constexpr std::uint32_t formatVersion = 1;
+
+  /**
+   * @brief Fixed-size part of the file header
+   */
+  struct Header
+  {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t precision;
+    std::uint32_t dim;
+    std::uint32_t commSize;
+    std::uint32_t transposed;
+    std::uint32_t keyLength;
+    std::uint64_t extendedCells[Traits::dim];
+  };
+
+  const std::shared_ptr<Traits> traits;
+
+  std::string key;
+  std::string fileName;
+
+  MPI_File file;
+  bool fileOpen;
+  MPI_Offset dataStart;
+  std::vector<std::uint64_t> localSizes;
+
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param traits_     traits object with parameters and communication
+   * @param backendName name identifying the matrix backend
+   */
+  SpectrumCache(const std::shared_ptr<Traits>& traits_,
+                const std::string& backendName)
+    : traits(traits_)
+    , fileOpen(false)
+  {
+    const std::string& directory =
+      (*traits).config.template get<std::string>("cache.directory", "");
+    if (directory == "" || (*traits).covariance == "custom-iso" ||
+        (*traits).covariance == "custom-aniso")
+      return;
+
+    std::ostringstream stream;
+    stream << canonicalConfig((*traits).config);
+    writeCanonicalSection(stream, (*traits).hyperparameters, "current.");
+    // refinement changes the resolution, but not the configuration
+    stream << "cells=";
+    for (unsigned int i = 0; i < dim; i++)
+      stream << (*traits).cells[i] << (i + 1 < dim ? " " : "\n");
+    stream << "level=" << (*traits).level << "\n";
+    stream << "backend=" << backendName << "\n";
+    stream << "precision=" << sizeof(RF) << "\n";
+    stream << "commSize=" << (*traits).commSize << "\n";
+    key = stream.str();
+
+    fileName = directory + "/spectrum-" + hash(key) + ".bin";
+  }
+
+  /**
+   * @brief Destructor, closes file if still open
+   */
+  ~SpectrumCache()
+  {
+    if (fileOpen)
+      MPI_File_close(&file);
+  }
+
+  /**
+   * @brief Check whether caching has been requested
+   *
+   * @return true if a cache directory has been set, else false
+   */
+  bool enabled() const { return fileName != ""; }
+
+  /**
+   * @brief Name of the cache file for the current configuration
+   *
+   * @return file name, or empty string if caching is disabled
+   */
+  const std::string& name() const { return fileName; }
+
+  /**
+   * @brief Open cache file and validate its header
+   *
+   * Has to be called collectively. The extended domain is part of the
+   * header, since it may differ from the configured one when automatic
+   * embedding is used. The file stays open for a subsequent call of
+   * readData if validation was successful.
+   *
+   * @param[out] extendedCells extended domain the matrix was computed for
+   *
+   * @return true if a matching cache file was found, else false
+   */
+  bool readHeader(Indices& extendedCells)
+  {
+    if (!enabled())
+      return false;
+
+    if (MPI_File_open((*traits).comm,
+                      fileName.c_str(),
+                      MPI_MODE_RDONLY,
+                      MPI_INFO_NULL,
+                      &file) != MPI_SUCCESS)
+      return false;
+    fileOpen = true;
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    MPI_File_read_at_all(
+      file, 0, &header, sizeof(Header), MPI_BYTE, MPI_STATUS_IGNORE);
+
+    bool valid = std::strncmp(header.magic, "PFSPEC", 8) == 0 &&
+                 header.version == formatVersion &&
+                 header.precision == sizeof(RF) && header.dim == dim &&
+                 header.commSize == (std::uint32_t)(*traits).commSize &&
+                 header.transposed == (*traits).transposed &&
+                 header.keyLength == key.size();
+
+    if (valid) {
+      std::string fileKey(key.size(), ' ');
+      MPI_File_read_at_all(file,
+                           sizeof(Header),
+                           &fileKey[0],
+                           key.size(),
+                           MPI_BYTE,
+                           MPI_STATUS_IGNORE);
+      valid = (fileKey == key);
+    }
+
+    if (valid) {
+      localSizes.resize((*traits).commSize);
+      MPI_File_read_at_all(file,
+                           sizeof(Header) + key.size(),
+                           localSizes.data(),
+                           localSizes.size() * sizeof(std::uint64_t),
+                           MPI_BYTE,
+                           MPI_STATUS_IGNORE);
+
+      dataStart = sizeof(Header) + key.size() +
+                  localSizes.size() * sizeof(std::uint64_t);
+      for (int i = 0; i < (*traits).rank; i++)
+        dataStart += localSizes[i] * sizeof(RF);
+
+      for (unsigned int i = 0; i < dim; i++)
+        extendedCells[i] = header.extendedCells[i];
+    }
+
+    if (!valid) {
+      MPI_File_close(&file);
+      fileOpen = false;
+    }
+
+    return valid;
+  }
+
+  /**
+   * @brief Close cache file without reading the matrix
+   *
+   * Has to be called collectively after a successful call of readHeader,
+   * if the matrix isn't needed after all.
+   */
+  void close()
+  {
+    if (fileOpen) {
+      MPI_File_close(&file);
+      fileOpen = false;
+    }
+  }
+
+  /**
+   * @brief Read local part of the matrix from cache file
+   *
+   * Has to be called collectively after a successful call of readHeader,
+   * and closes the file. Fails if the local array size doesn't match the
+   * stored one on any of the processors, or if the file is truncated.
+   *
+   * @param[out] data      local array that should be filled
+   * @param      localSize number of local values
+   *
+   * @return true if the data was read, else false
+   */
+  bool readData(RF* data, Index localSize)
+  {
+    if (!fileOpen)
+      return false;
+
+    const int myValid = (localSizes[(*traits).rank] == localSize);
+    int valid;
+    MPI_Allreduce(&myValid, &valid, 1, MPI_INT, MPI_MIN, (*traits).comm);
+
+    if (valid) {
+      MPI_Status status;
+      MPI_File_read_at_all(
+        file, dataStart, data, localSize, mpiType<RF>, &status);
+
+      int count;
+      MPI_Get_count(&status, mpiType<RF>, &count);
+      const int myComplete = (count == (int)localSize);
+      MPI_Allreduce(
+        &myComplete, &valid, 1, MPI_INT, MPI_MIN, (*traits).comm);
+    }
+
+    MPI_File_close(&file);
+    fileOpen = false;
+
+    return valid;
+  }
+
+  /**
+   * @brief Write matrix to cache file
+   *
+   * Has to be called collectively. The data is written to a temporary
+   * file first, which is then renamed, so that concurrent runs never
+   * see incomplete cache files. Failure to write is not an error, since
+   * the cache is optional.
+   *
+   * @param extendedCells extended domain the matrix was computed for
+   * @param data          local array that should be stored
+   * @param localSize     number of local values
+   *
+   * @return true if the file was written, else false
+   */
+  bool write(const Indices& extendedCells, const RF* data, Index localSize)
+  {
+    if (!enabled())
+      return false;
+
+    std::uint64_t suffix = 0;
+    if ((*traits).rank == 0)
+      suffix = std::random_device{}();
+    MPI_Bcast(&suffix, 1, MPI_UINT64_T, 0, (*traits).comm);
+    const std::string tmpName = fileName + "." + std::to_string(suffix);
+
+    MPI_File out;
+    if (MPI_File_open((*traits).comm,
+                      tmpName.c_str(),
+                      MPI_MODE_WRONLY | MPI_MODE_CREATE,
+                      MPI_INFO_NULL,
+                      &out) != MPI_SUCCESS)
+      return false;
+
+    if ((*traits).rank == 0) {
+      Header header;
+      std::memset(&header, 0, sizeof(Header));
+      std::strncpy(header.magic, "PFSPEC", 8);
+      header.version = formatVersion;
+      header.precision = sizeof(RF);
+      header.dim = dim;
+      header.commSize = (*traits).commSize;
+      header.transposed = (*traits).transposed;
+      header.keyLength = key.size();
+      for (unsigned int i = 0; i < dim; i++)
+        header.extendedCells[i] = extendedCells[i];
+
+      MPI_File_write_at(
+        out, 0, &header, sizeof(Header), MPI_BYTE, MPI_STATUS_IGNORE);
+      MPI_File_write_at(out,
+                        sizeof(Header),
+                        key.data(),
+                        key.size(),
+                        MPI_BYTE,
+                        MPI_STATUS_IGNORE);
+    }
+
+    const std::uint64_t mySize = localSize;
+    std::uint64_t before = 0;
+    MPI_Exscan(&mySize, &before, 1, MPI_UINT64_T, MPI_SUM, (*traits).comm);
+    if ((*traits).rank == 0)
+      before = 0;
+
+    const MPI_Offset tableStart = sizeof(Header) + key.size();
+    MPI_File_write_at(out,
+                      tableStart + (*traits).rank * sizeof(std::uint64_t),
+                      &mySize,
+                      sizeof(std::uint64_t),
+                      MPI_BYTE,
+                      MPI_STATUS_IGNORE);
+
+    const MPI_Offset offset = tableStart +
+                              (*traits).commSize * sizeof(std::uint64_t) +
+                              before * sizeof(RF);
+    MPI_File_write_at_all(
+      out, offset, data, localSize, mpiType<RF>, MPI_STATUS_IGNORE);
+    MPI_File_close(&out);
+
+    int success = 1;
+    if ((*traits).rank == 0)
+      success = (std::rename(tmpName.c_str(), fileName.c_str()) == 0);
+    MPI_Bcast(&success, 1, MPI_INT, 0, (*traits).comm);
+
+    return success;
+  }
+
+private:
+  /**
+   * @brief 64-bit FNV-1a hash of given string
+   *
+   * @param string string that should be hashed
+   *
+   * @return hash as hexadecimal string
+   */
+  static std::string hash(const std::string& string)
+  {
+    std::uint64_t value = 14695981039346656037ull;
+    for (const char c : string) {
+      value ^= (unsigned char)c;
+      value *= 1099511628211ull;
+    }
+
+    std::ostringstream stream;
+    stream << std::hex << std::setw(16) << std::setfill('0') << value;
+    return stream.str();
+  }
+};
+
+} // namespace parafields
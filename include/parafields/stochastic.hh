@@ -36,6 +36,12 @@ class StochasticPart
 
   friend typename Traits::IsoMatrixType;
   friend typename Traits::AnisoMatrixType;
+  template<typename,
+           template<typename>
+           class,
+           template<typename>
+           class>
+  friend class Matrix;
 
   std::shared_ptr<Traits> traits;
 
@@ -1,6 +1,13 @@
 #include <catch2/catch.hpp>
 #include <parafields/randomfield.hh>
 
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
 #include <limits>
 
 #include "traits.hh"
@@ -55,3 +62,1111 @@ TEMPLATE_TEST_CASE("Default 3D field generation", "[seq]", float, double)
   Field field(config);
   field.generate();
 }
+
+TEMPLATE_TEST_CASE("Automatic embedding 2D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "64 32";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.1";
+  config["embedding.factor"] = "auto";
+
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  typename Field::Traits::Indices expected;
+  SECTION("Minimal embedding suffices")
+  {
+    config["stochastic.covariance"] = "exponential";
+    expected = { 126, 64 };
+  }
+  SECTION("Embedding has to be grown")
+  {
+    config["stochastic.covariance"] = "matern32";
+    expected = { 128, 72 };
+  }
+
+  // Approximate samples aren't allowed, so negative eigenvalues would throw
+  Field field(config);
+  REQUIRE_NOTHROW(field.generate());
+
+  // Even sizes with small prime factors, at least minimal embedding
+  const typename Field::Traits::Indices cells = { 64, 32 };
+  for (unsigned int i = 0; i < 2; i++) {
+    const unsigned int extendedCells = field.extendedCells()[i];
+    REQUIRE(extendedCells == expected[i]);
+    REQUIRE(extendedCells % 2 == 0);
+    REQUIRE(Field::Traits::isSmooth(extendedCells / 2));
+    REQUIRE(extendedCells >= 2 * cells[i] - 2);
+  }
+
+  // Minimal embedding is smaller than the default factor of two
+  if (config["stochastic.covariance"] == "exponential")
+    REQUIRE(expected[0] * expected[1] < 4 * cells[0] * cells[1]);
+}
+
+TEMPLATE_TEST_CASE("Automatic embedding limit 2D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "64 32";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.5";
+  config["stochastic.covariance"] = "gaussian";
+  config["embedding.factor"] = "auto";
+  config["embedding.autoMaxFactor"] = "2.5";
+  config["embedding.approximate"] = "true";
+
+  // Largest admissible extended domain is used even if it isn't enough
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  Field field(config);
+  field.generate(42u);
+  REQUIRE(field.extendedCells()[0] == 160);
+  REQUIRE(field.extendedCells()[1] == 80);
+
+  const TestType norm = field.twoNorm();
+  REQUIRE(std::isfinite(norm));
+  REQUIRE(norm > 0.);
+}
+
+TEMPLATE_TEST_CASE("Per-axis embedding 2D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "32 16";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = GENERATE("exponential", "spherical");
+
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  SECTION("Per-axis embedding factors")
+  {
+    config["embedding.factor"] = "3 2";
+    Field field(config);
+    field.generate(42u);
+    REQUIRE(field.extendedCells()[0] == 96);
+    REQUIRE(field.extendedCells()[1] == 32);
+  }
+  SECTION("Explicit extended domain")
+  {
+    config["embedding.extendedCells"] = "80 36";
+    Field field(config);
+    field.generate(42u);
+    REQUIRE(field.extendedCells()[0] == 80);
+    REQUIRE(field.extendedCells()[1] == 36);
+  }
+  SECTION("Odd extended domain")
+  {
+    // Symmetric embedding requires even sizes, which are used instead
+    Dune::ParameterTree evenConfig = config;
+    evenConfig["embedding.extendedCells"] = "80 36";
+    config["embedding.extendedCells"] = "79 35";
+    Field field1(config);
+    Field field2(evenConfig);
+    REQUIRE(field1.extendedCells() == field2.extendedCells());
+
+    field1.generate(42u);
+    field2.generate(42u);
+    REQUIRE(field1 == field2);
+  }
+  SECTION("Equivalent to uniform factor")
+  {
+    // Same extended domain, given in three different ways
+    Dune::ParameterTree factorConfig = config;
+    factorConfig["embedding.factor"] = "2 2";
+    Dune::ParameterTree cellsConfig = config;
+    cellsConfig["embedding.extendedCells"] = "64 32";
+
+    Field field1(config);
+    Field field2(factorConfig);
+    Field field3(cellsConfig);
+    REQUIRE(field2.extendedCells() == field1.extendedCells());
+    REQUIRE(field3.extendedCells() == field1.extendedCells());
+
+    field1.generate(42u);
+    field2.generate(42u);
+    field3.generate(42u);
+    REQUIRE(field1 == field2);
+    REQUIRE(field1 == field3);
+
+    field1.timesMatrix();
+    field2.timesMatrix();
+    field3.timesMatrix();
+    REQUIRE(field1 == field2);
+    REQUIRE(field1 == field3);
+  }
+}
+
+TEMPLATE_TEST_CASE("Shared matrix 2D field generation", "[seq]", float, double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "16 16";
+  config["grid.extensions"] = "1 1";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = "exponential";
+  config["randomField.shareMatrix"] = "true";
+
+  // Instantiate independent fields with identical parameters
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  Field::Registry::clear();
+  Field field1(config);
+  config["stochastic.variance"] = " 1 ";
+  Field field2(config);
+  REQUIRE(field1.sharesMatrix(field2));
+  REQUIRE(Field::Registry::size() == 1);
+
+  // Different parameters lead to a separate matrix
+  config["stochastic.corrLength"] = "0.1";
+  Field field3(config);
+  REQUIRE(!field1.sharesMatrix(field3));
+  REQUIRE(Field::Registry::size() == 2);
+
+  field1.generate();
+  field2.generate();
+  field3.generate();
+
+  // Evicted entries stay valid for fields using them
+  Field::Registry::clear();
+  REQUIRE(Field::Registry::size() == 0);
+  field1.generate();
+  Field field4(config);
+  REQUIRE(!field3.sharesMatrix(field4));
+  REQUIRE(Field::Registry::size() == 1);
+
+  // Entries are evicted when their communicator is freed
+  MPI_Comm comm;
+  MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+  {
+    Field field5(config, "", parafields::DefaultLoadBalance<2>(), comm);
+    REQUIRE(!field4.sharesMatrix(field5));
+    REQUIRE(Field::Registry::size() == 2);
+  }
+  MPI_Comm_free(&comm);
+  REQUIRE(Field::Registry::size() == 1);
+}
+
+TEMPLATE_TEST_CASE("Cached spectrum 2D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  const std::filesystem::path directory =
+    std::filesystem::temp_directory_path() / "parafields-spectrum-cache";
+  if (rank == 0) {
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "32 16";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = "exponential";
+  config["cache.directory"] = directory.string();
+
+  SECTION("Fixed embedding factor") {}
+  SECTION("Automatic embedding")
+  {
+    config["embedding.factor"] = "auto";
+  }
+
+  // First field computes and stores the spectrum, second one reads it
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  Field field1(config);
+  field1.generate(42u);
+  Field field2(config);
+  field2.generate(42u);
+  REQUIRE(field1 == field2);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  auto entries = std::filesystem::directory_iterator(directory);
+  REQUIRE(std::distance(begin(entries), end(entries)) == 1);
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // Refined matrix must not use the spectrum of the coarse one
+  Dune::ParameterTree fineConfig = config;
+  fineConfig["grid.cells"] = "64 32";
+  fineConfig["cache.directory"] = "";
+  Field field3(fineConfig);
+  field3.generate(42u);
+  field1.refineMatrix();
+  field1.refine();
+  field1.generate(42u);
+  REQUIRE(field1.extendedCells() == field3.extendedCells());
+  REQUIRE(field1 == field3);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  entries = std::filesystem::directory_iterator(directory);
+  REQUIRE(std::distance(begin(entries), end(entries)) == 2);
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0)
+    std::filesystem::remove_all(directory);
+}
+
+TEMPLATE_TEST_CASE("FFTW wisdom 2D field generation", "[seq]", float, double)
+{
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  const std::filesystem::path directory =
+    std::filesystem::temp_directory_path() / "parafields-fftw-wisdom";
+  if (rank == 0) {
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "32 16";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = "exponential";
+  config["fftw.measure"] = "true";
+  config["fftw.useWisdom"] = "true";
+  config["fftw.wisdomDirectory"] = directory.string();
+
+  // Measured plans must not change the result, and all fields write to
+  // the same file, which is only rewritten if needed
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  {
+    Dune::ParameterTree estimateConfig = config;
+    estimateConfig["fftw.measure"] = "false";
+    estimateConfig["fftw.useWisdom"] = "false";
+    Field reference(estimateConfig);
+    reference.generate(42u);
+
+    Field field1(config);
+    field1.generate(42u);
+    Field field2(config);
+    field2.generate(42u);
+    REQUIRE(field1 == field2);
+
+    const TestType norm = reference.twoNorm();
+    field1 -= reference;
+    REQUIRE(field1.twoNorm() <=
+            1000 * std::numeric_limits<TestType>::epsilon() * norm);
+  }
+
+  // engines without wisdom, e.g., the native one, don't write files
+  using Engine = parafields::FFTEngine<TestType>;
+  const int files = Engine::export_wisdom_to_string().empty() ? 0 : 1;
+  MPI_Barrier(MPI_COMM_WORLD);
+  auto entries = std::filesystem::directory_iterator(directory);
+  REQUIRE(std::distance(begin(entries), end(entries)) == files);
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0)
+    std::filesystem::remove_all(directory);
+}
+
+TEMPLATE_TEST_CASE("Hyperparameter update 2D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "32 16";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = GENERATE("exponential", "spherical");
+
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  Field field1(config);
+  field1.generate(42u);
+
+  Dune::ParameterTree hyperparameters;
+  SECTION("Variance")
+  {
+    hyperparameters["stochastic.variance"] = "4";
+  }
+  SECTION("Correlation length")
+  {
+    hyperparameters["stochastic.corrLength"] = "0.1";
+  }
+  SECTION("Variance and correlation length")
+  {
+    hyperparameters["stochastic.variance"] = "0.25";
+    hyperparameters["stochastic.corrLength"] = "0.02";
+  }
+
+  // Updated field has to match field constructed with new parameters
+  field1.updateHyperparameters(hyperparameters);
+  field1.generate(42u);
+  for (const std::string key :
+       { "stochastic.variance", "stochastic.corrLength" })
+    if (hyperparameters.hasKey(key))
+      config[key] = hyperparameters[key];
+  Field field2(config);
+  field2.generate(42u);
+
+  // Rescaled eigenvalues only agree up to rounding
+  const TestType norm = field2.twoNorm();
+  field1 -= field2;
+  REQUIRE(field1.twoNorm() <=
+          100 * std::numeric_limits<TestType>::epsilon() * norm);
+}
+
+TEMPLATE_TEST_CASE("Batched matrix setup 2D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "32 16";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.covariance"] = GENERATE("exponential", "spherical");
+  const std::string anisotropy = GENERATE("none", "axiparallel");
+  config["stochastic.anisotropy"] = anisotropy;
+
+  // Sweep over variance and correlation length
+  const std::vector<std::pair<std::string, std::string>> sweep = {
+    { "1", "0.05" }, { "4", "0.05" }, { "1", "0.1" }, { "0.25", "0.02" }
+  };
+  auto setParameters = [&](std::size_t i) {
+    config["stochastic.variance"] = sweep[i].first;
+    if (anisotropy == "none")
+      config["stochastic.corrLength"] = sweep[i].second;
+    else
+      config["stochastic.corrLength"] = sweep[i].second + " 0.05";
+  };
+
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  std::vector<std::unique_ptr<Field>> fields;
+  std::vector<Field*> pointers;
+  for (std::size_t i = 0; i < sweep.size(); i++) {
+    setParameters(i);
+    fields.push_back(std::make_unique<Field>(config));
+    pointers.push_back(fields.back().get());
+  }
+  pointers.push_back(pointers.front());
+
+  // Batched setup has to match individual setup of each field
+  Field::fillMatrices(pointers);
+  for (std::size_t i = 0; i < sweep.size(); i++) {
+    setParameters(i);
+    Field reference(config);
+    reference.generate(42u);
+    fields[i]->generate(42u);
+    *fields[i] -= reference;
+    REQUIRE(fields[i]->infNorm() <=
+            std::sqrt(std::numeric_limits<TestType>::epsilon()) *
+              reference.infNorm());
+  }
+}
+
+TEMPLATE_TEST_CASE("Asynchronous matrix setup 2D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "32 16";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = GENERATE("exponential", "spherical");
+
+  SECTION("Fixed embedding factor") {}
+  SECTION("Automatic embedding")
+  {
+    config["embedding.factor"] = "auto";
+  }
+
+  // Matrix set up in the background has to match lazily computed one, and
+  // other fields mustn't plan before the background setup is complete
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  Field field1(config);
+  field1.prepareAsync();
+  field1.generate(42u);
+  Field field2(config);
+  field2.generate(42u);
+  REQUIRE(field1 == field2);
+
+  // Explicit wait, and repeated calls are harmless
+  Field field3(config);
+  field3.prepareAsync();
+  field3.prepareAsync();
+  field3.waitReady();
+  field3.waitReady();
+  field3.generate(42u);
+  REQUIRE(field3 == field2);
+}
+
+template<typename Traits>
+using DCTDSTMatrix = parafields::Matrix<Traits,
+                                        parafields::DCTMatrixBackend,
+                                        parafields::DCTDSTFieldBackend>;
+
+TEMPLATE_TEST_CASE("DCT/DST field backend 3D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "8 8 8";
+  config["grid.extensions"] = "1 1 1";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = GENERATE("exponential", "spherical");
+  config["fftw.transposed"] = GENERATE("true", "false");
+
+  // Sum of even/odd components has to be reset between fields
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 3>,
+                                        DCTDSTMatrix,
+                                        DCTDSTMatrix>;
+  Field field1(config);
+  field1.generate(42u);
+  Field field2(config);
+  field2.generate(7u);
+  field2.generate(42u);
+  REQUIRE(field1 == field2);
+}
+
+TEMPLATE_TEST_CASE("Paired sampling 3D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "8 8 8";
+  config["grid.extensions"] = "1 1 1";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = GENERATE("exponential", "gaussian");
+
+  // Second field of each pair is returned by the next call
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 3>,
+                                        parafields::PairedIsoMatrix<3>::Type,
+                                        parafields::PairedAnisoMatrix<3>::Type>;
+  Field field1(config);
+  Field field2(config);
+  field1.generate(42u);
+  field2.generate(42u);
+  REQUIRE(field1 == field2);
+  field1.generate(7u);
+  REQUIRE(field1 != field2);
+  field2.generate(7u);
+  REQUIRE(field1 == field2);
+}
+
+template<typename Traits>
+using R2CMatrix = parafields::Matrix<Traits,
+                                     parafields::R2CMatrixBackend,
+                                     parafields::R2CFieldBackend>;
+
+TEMPLATE_TEST_CASE("Transposed R2C backends 2D matrix multiplication",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "32 16";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = GENERATE("exponential", "gaussian");
+
+  // Products in transposed frequency space have to match untransposed ones
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>,
+                                        R2CMatrix,
+                                        R2CMatrix>;
+  config["fftw.transposed"] = "true";
+  Field field1(config);
+  config["fftw.transposed"] = "false";
+  Field field2(config);
+
+  field1.generate(42u);
+  field2.generate(42u);
+  field1.generateUncorrelated(42u);
+  field2.generateUncorrelated(42u);
+  field1.timesMatrix();
+  field2.timesMatrix();
+  field1.timesMatrixRoot();
+  field2.timesMatrixRoot();
+
+  const TestType norm = field2.twoNorm();
+  field1 -= field2;
+  REQUIRE(field1.twoNorm() <=
+          100 * std::numeric_limits<TestType>::epsilon() * norm);
+}
+
+template<typename Traits>
+using DFTMatrix = parafields::Matrix<Traits, parafields::DFTMatrixBackend>;
+
+template<typename Traits>
+using DCTMatrix1D = parafields::
+  Matrix<Traits, parafields::DCTMatrixBackend, parafields::DFTFieldBackend>;
+
+TEMPLATE_TEST_CASE("DCT matrix backend 1D matrix multiplication",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "48";
+  config["grid.extensions"] = "1";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = GENERATE("exponential", "gaussian");
+
+  // Products with the DCT matrix have to match the full DFT matrix, and
+  // so do generated fields, which use the mirrored matrix of finalize
+  using GT = GridTraits<TestType, TestType, 1>;
+  using Field1 = parafields::RandomField<GT, DCTMatrix1D, DFTMatrix>;
+  using Field2 = parafields::RandomField<GT, DFTMatrix, DFTMatrix>;
+  Field1 field1(config);
+  Field2 field2(config);
+
+  SECTION("Multiplication")
+  {
+    field1.generateUncorrelated(42u);
+    field2.generateUncorrelated(42u);
+    field1.timesMatrix();
+    field2.timesMatrix();
+  }
+  SECTION("Generation")
+  {
+    field1.generate(42u);
+    field2.generate(42u);
+  }
+
+  TestType diff = 0., norm = 0.;
+  for (unsigned int i = 0; i < 48; i++) {
+    const typename GT::Domain location = (i + 0.5) / 48.;
+    typename GT::Scalar value1, value2;
+    field1.evaluate(location, value1);
+    field2.evaluate(location, value2);
+    diff += (value1 - value2) * (value1 - value2);
+    norm += value2 * value2;
+  }
+  REQUIRE(std::sqrt(diff) <=
+          1000 * std::numeric_limits<TestType>::epsilon() * std::sqrt(norm));
+}
+
+template<typename Traits>
+using FourStepMatrix = parafields::Matrix<Traits,
+                                          parafields::FourStepMatrixBackend,
+                                          parafields::FourStepFieldBackend>;
+
+TEMPLATE_TEST_CASE("Four-step backends 1D matrix multiplication",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "48";
+  config["grid.extensions"] = "1";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = GENERATE("exponential", "gaussian");
+
+  // Forcing the factorization exercises the twiddle factors and the data
+  // exchange on a single processor
+  config["fftw.forceFourStep"] = GENERATE("false", "true");
+
+  // Products with four-step transforms have to match FFTW-MPI ones
+  using GT = GridTraits<TestType, TestType, 1>;
+  using Field1 =
+    parafields::RandomField<GT, FourStepMatrix, FourStepMatrix>;
+  using Field2 = parafields::RandomField<GT, DFTMatrix, DFTMatrix>;
+  Field1 field1(config);
+  Field2 field2(config);
+
+  field1.generateUncorrelated(42u);
+  field2.generateUncorrelated(42u);
+  field1.timesMatrix();
+  field2.timesMatrix();
+
+  TestType diff = 0., norm = 0.;
+  for (unsigned int i = 0; i < 48; i++) {
+    const typename GT::Domain location = (i + 0.5) / 48.;
+    typename GT::Scalar value1, value2;
+    field1.evaluate(location, value1);
+    field2.evaluate(location, value2);
+    diff += (value1 - value2) * (value1 - value2);
+    norm += value2 * value2;
+  }
+  REQUIRE(std::sqrt(diff) <=
+          1000 * std::numeric_limits<TestType>::epsilon() * std::sqrt(norm));
+}
+
+TEMPLATE_TEST_CASE("Pruned transforms 3D matrix multiplication",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "16 16 8";
+  config["grid.extensions"] = "1 1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = GENERATE("exponential", "gaussian");
+  config["fftw.transposed"] = GENERATE("true", "false");
+
+  // Pruned transforms have to match full transforms on the original domain
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 3>>;
+  config["fftw.pruned"] = "true";
+  Field field1(config);
+  config["fftw.pruned"] = "false";
+  Field field2(config);
+
+  field1.generate(42u);
+  field2.generate(42u);
+  field1.timesMatrix();
+  field2.timesMatrix();
+  field1.timesMatrixRoot();
+  field2.timesMatrixRoot();
+
+  const TestType norm = field2.twoNorm();
+  field1 -= field2;
+  REQUIRE(field1.twoNorm() <=
+          100 * std::numeric_limits<TestType>::epsilon() * norm);
+}
+
+TEMPLATE_TEST_CASE("Spectral truncation 3D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "16 16 8";
+  config["grid.extensions"] = "1 1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.2";
+  config["stochastic.covariance"] = "gaussian";
+  config["embedding.approximate"] = "true";
+  config["embedding.truncate"] = "true";
+  config["embedding.threshold"] = "1e-6";
+  config["fftw.transposed"] = GENERATE("true", "false");
+
+  // Band-limited pruned transforms have to match full transforms
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 3>>;
+  config["fftw.pruned"] = "true";
+  Field field1(config);
+  config["fftw.pruned"] = "false";
+  Field field2(config);
+
+  field1.generate(42u);
+  field2.generate(42u);
+
+  const TestType norm = field2.twoNorm();
+  REQUIRE(norm > 0.);
+  field1 -= field2;
+  REQUIRE(field1.twoNorm() <=
+          100 * std::numeric_limits<TestType>::epsilon() * norm);
+}
+
+TEMPLATE_TEST_CASE("Reduced-rank 2D field generation", "[seq]", float, double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "16 8";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.1";
+  config["stochastic.covariance"] = "gaussian";
+  config["embedding.approximate"] = "true";
+
+  // Half spectrum of R2C backend has to give the same modes as full one
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  using DFTField = parafields::RandomField<GridTraits<TestType, TestType, 2>,
+                                           DFTMatrix,
+                                           DFTMatrix>;
+  Field field1(config);
+  DFTField field2(config);
+
+  const unsigned int count = 12;
+  field1.setupReducedRank(count);
+  field2.setupReducedRank(count);
+  const std::vector<TestType> eigenvalues1 = field1.reducedRankEigenvalues();
+  const std::vector<TestType> eigenvalues2 = field2.reducedRankEigenvalues();
+  REQUIRE(eigenvalues1.size() == count);
+  REQUIRE(eigenvalues2.size() == count);
+  for (unsigned int j = 0; j < count; j++) {
+    if (j > 0)
+      REQUIRE(eigenvalues1[j] <= eigenvalues1[j - 1]);
+    REQUIRE(std::abs(eigenvalues1[j] - eigenvalues2[j]) <=
+            100 * std::numeric_limits<TestType>::epsilon() * eigenvalues1[0]);
+  }
+
+  // Point evaluation has to match the generated field
+  std::vector<TestType> coefficients(count);
+  for (unsigned int j = 0; j < count; j++)
+    coefficients[j] = std::sin(1.7 * j + 0.3);
+  field1.generateFromCoefficients(coefficients);
+  for (unsigned int i = 0; i < 8; i++) {
+    typename GridTraits<TestType, TestType, 2>::Domain location;
+    location[0] = (2 * i + 0.5) / 16.;
+    location[1] = (7.5 - i) / 16.;
+    typename GridTraits<TestType, TestType, 2>::Scalar value1, value2;
+    field1.evaluate(location, value1);
+    field1.evaluateFromCoefficients(coefficients, location, value2);
+    REQUIRE(std::abs(value1[0] - value2[0]) <=
+            1000 * std::numeric_limits<TestType>::epsilon());
+  }
+
+  coefficients.push_back(1.);
+  REQUIRE_THROWS(field1.generateFromCoefficients(coefficients));
+
+  // With all modes, the expansion has to reproduce the covariance function
+  Field field3(config);
+  field3.setupReducedRank(100000);
+  const unsigned int modes = field3.reducedRankEigenvalues().size();
+  REQUIRE(modes == 32 * 16);
+
+  typename GridTraits<TestType, TestType, 2>::Domain location1, location2;
+  location1[0] = 3.5 / 16.;
+  location1[1] = 2.5 / 16.;
+  location2[0] = 5.5 / 16.;
+  location2[1] = 3.5 / 16.;
+  TestType variance = 0., covariance = 0.;
+  for (unsigned int j = 0; j < modes; j++) {
+    std::vector<TestType> unit(j + 1, 0.);
+    unit[j] = 1.;
+    typename GridTraits<TestType, TestType, 2>::Scalar value1, value2;
+    field3.evaluateFromCoefficients(unit, location1, value1);
+    field3.evaluateFromCoefficients(unit, location2, value2);
+    variance += value1[0] * value1[0];
+    covariance += value1[0] * value2[0];
+  }
+  const TestType h2 = (4. + 1.) / (16. * 16.) / (0.1 * 0.1);
+  const TestType tolerance =
+    std::sqrt(std::numeric_limits<TestType>::epsilon());
+  REQUIRE(std::abs(variance - 1.) <= tolerance);
+  REQUIRE(std::abs(covariance - std::exp(-h2)) <= tolerance);
+}
+
+TEMPLATE_TEST_CASE("Native FFT engine 2D transforms", "[seq]", float, double)
+{
+  using Engine = parafields::NativeFFT<TestType>;
+  using Complex = std::complex<long double>;
+  const long double pi = std::acos(-1.L);
+
+  // Mixed-radix lengths, including a prime factor without special case
+  const ptrdiff_t n[2] = { 6, 14 };
+  const ptrdiff_t half = n[1] / 2 + 1;
+  std::vector<TestType> values(n[0] * n[1]);
+  for (std::size_t i = 0; i < values.size(); i++)
+    values[i] = std::sin(0.3 * i * i) + 0.1 * i;
+
+  // Padded in-place r2c transform, as in the R2C backends
+  typename Engine::complex* data = Engine::alloc_complex(n[0] * half);
+  TestType* real = (TestType*)data;
+  for (ptrdiff_t i = 0; i < n[0]; i++)
+    for (ptrdiff_t j = 0; j < n[1]; j++)
+      real[i * 2 * half + j] = values[i * n[1] + j];
+
+  typename Engine::plan plan = Engine::mpi_plan_dft_r2c(
+    2, n, real, data, MPI_COMM_SELF, FFTW_ESTIMATE);
+  Engine::execute(plan);
+  Engine::destroy_plan(plan);
+
+  long double diff = 0., norm = 0.;
+  for (ptrdiff_t k0 = 0; k0 < n[0]; k0++)
+    for (ptrdiff_t k1 = 0; k1 < half; k1++) {
+      Complex sum = 0.;
+      for (ptrdiff_t j0 = 0; j0 < n[0]; j0++)
+        for (ptrdiff_t j1 = 0; j1 < n[1]; j1++)
+          sum += (long double)values[j0 * n[1] + j1] *
+                 std::polar(1.L,
+                            -2 * pi * (k0 * j0 / (long double)n[0] +
+                                       k1 * j1 / (long double)n[1]));
+      const Complex value(data[k0 * half + k1][0], data[k0 * half + k1][1]);
+      diff += std::norm(value - sum);
+      norm += std::norm(sum);
+    }
+  REQUIRE(std::sqrt(diff) <=
+          100 * std::numeric_limits<TestType>::epsilon() * std::sqrt(norm));
+
+  // Backward transform recovers the input, up to the usual scaling
+  plan = Engine::mpi_plan_dft_c2r(2, n, data, real, MPI_COMM_SELF, 0);
+  Engine::execute(plan);
+  Engine::destroy_plan(plan);
+
+  diff = 0.;
+  norm = 0.;
+  for (ptrdiff_t i = 0; i < n[0]; i++)
+    for (ptrdiff_t j = 0; j < n[1]; j++) {
+      const long double value = values[i * n[1] + j];
+      diff += std::pow(real[i * 2 * half + j] / (n[0] * n[1]) - value, 2);
+      norm += value * value;
+    }
+  REQUIRE(std::sqrt(diff) <=
+          100 * std::numeric_limits<TestType>::epsilon() * std::sqrt(norm));
+
+  Engine::free(data);
+}
+
+TEMPLATE_TEST_CASE("Out-of-core 2D field generation", "[seq]", float, double)
+{
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  const std::filesystem::path directory =
+    std::filesystem::temp_directory_path() / "parafields-out-of-core";
+  if (rank == 0) {
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "32 16";
+  config["grid.extensions"] = "1 0.5";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = "exponential";
+  config["outOfCore.directory"] = directory.string();
+
+  const auto read = [&](const std::string& fileName) {
+    std::vector<TestType> values(32 * 16);
+#if HAVE_HDF5
+    parafields::readParallelFromHDF5<TestType, 2>(values,
+                                                  { 32, 16 },
+                                                  { 0, 0 },
+                                                  MPI_COMM_WORLD,
+                                                  "/stochastic",
+                                                  fileName + ".stoch.h5");
+#else
+    std::ifstream file(fileName + ".stoch.raw", std::ios::binary);
+    file.read((char*)values.data(), values.size() * sizeof(TestType));
+    REQUIRE(file.good());
+#endif
+    return values;
+  };
+
+  // Chunked passes over the disk-resident arrays don't change the result
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>>;
+  Field field1(config);
+  field1.generateOutOfCore(42u, (directory / "whole").string());
+  config["outOfCore.memory"] = "0.001";
+  Field field2(config);
+  field2.generateOutOfCore(42u, (directory / "chunked").string());
+
+  const std::vector<TestType> whole = read((directory / "whole").string());
+  const std::vector<TestType> chunked = read((directory / "chunked").string());
+  TestType diff = 0., norm = 0.;
+  for (std::size_t i = 0; i < whole.size(); i++) {
+    diff += std::pow(whole[i] - chunked[i], 2);
+    norm += whole[i] * whole[i];
+  }
+  REQUIRE(norm > 0.);
+  REQUIRE(std::sqrt(diff) <=
+          1000 * std::numeric_limits<TestType>::epsilon() * std::sqrt(norm));
+
+  // In-memory generation with the full DFT in natural order draws the
+  // same random numbers for the same frequencies, and has to agree
+  using GT = GridTraits<TestType, TestType, 2>;
+  using InMemoryField =
+    parafields::RandomField<GT,
+                            parafields::PairedIsoMatrix<2>::Type,
+                            parafields::PairedAnisoMatrix<2>::Type>;
+  config["fftw.transposed"] = "false";
+  InMemoryField field3(config);
+  field3.generate(42u);
+
+  diff = 0.;
+  for (unsigned int j = 0; j < 16; j++)
+    for (unsigned int i = 0; i < 32; i++) {
+      typename GT::Domain location;
+      location[0] = (i + 0.5) / 32.;
+      location[1] = (j + 0.5) / 32.;
+      typename GT::Scalar value;
+      field3.evaluate(location, value);
+      diff += std::pow(whole[i + 32 * j] - value[0], 2);
+    }
+  REQUIRE(std::sqrt(diff) <=
+          1000 * std::numeric_limits<TestType>::epsilon() * std::sqrt(norm));
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0)
+    std::filesystem::remove_all(directory);
+}
+
+TEMPLATE_TEST_CASE("Runtime backend selection 3D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration
+  Dune::ParameterTree config;
+  config["grid.cells"] = "8 8 8";
+  config["grid.extensions"] = "1 1 1";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.05";
+  config["stochastic.covariance"] = GENERATE("exponential", "spherical");
+
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 3>,
+                                        parafields::AutoMatrix<3>::Type,
+                                        parafields::AutoMatrix<3>::Type>;
+
+  SECTION("Fixed choice matches compile-time choice")
+  {
+    using FixedField =
+      parafields::RandomField<GridTraits<TestType, TestType, 3>,
+                              DCTDSTMatrix,
+                              DCTDSTMatrix>;
+    FixedField field1(config);
+    field1.generate(42u);
+    config["randomField.backends"] = "dct-dctdst";
+    Field field2(config);
+    field2.generate(42u);
+
+    for (unsigned int i = 0; i < 8; i++) {
+      typename GridTraits<TestType, TestType, 3>::Domain location;
+      location[0] = (i + 0.5) / 8.;
+      location[1] = (7.5 - i) / 8.;
+      location[2] = 0.5 / 8.;
+      typename GridTraits<TestType, TestType, 3>::Scalar value1, value2;
+      field1.evaluate(location, value1);
+      field2.evaluate(location, value2);
+      REQUIRE(value1 == value2);
+    }
+  }
+  SECTION("Autotuning matches fixed choice")
+  {
+    config["randomField.backends"] = "autotune";
+    Field field1(config);
+    field1.generate(42u);
+    const std::string choice = field1.backends();
+    REQUIRE((choice == "dct-r2c" || choice == "r2c-r2c" ||
+             choice == "dft-dft" || choice == "dct-dctdst"));
+
+    config["randomField.backends"] = choice;
+    Field field2(config);
+    field2.generate(42u);
+    REQUIRE(field2.backends() == choice);
+    REQUIRE(field1 == field2);
+  }
+}
+
+#if HAVE_DUNE_NONLINOPT
+TEMPLATE_TEST_CASE("Optimized embedding 2D field generation",
+                   "[seq]",
+                   float,
+                   double)
+{
+  // Define the configuration, with a correlation length that is too large
+  // for the default embedding to be positive definite
+  Dune::ParameterTree config;
+  config["grid.cells"] = "16 16";
+  config["grid.extensions"] = "1 1";
+  config["stochastic.variance"] = "1";
+  config["stochastic.corrLength"] = "0.5";
+  config["stochastic.covariance"] = "gaussian";
+  config["stochastic.sigmoidCombine"] = "radial";
+  config["embedding.threshold"] = "1e-6";
+  config["embedding.projShift"] = "1e-3";
+  config["embedding.optim"] = GENERATE("coneopt", "dualopt");
+  config["embedding.optimAbsTol"] = "1e-6";
+  config["embedding.optimMaxStep"] = "1000";
+  config["embedding.useCG"] = "false";
+  config["embedding.useGMRES"] = "false";
+  config["fftw.transposed"] = "false";
+
+  // Optimization has to remove the negative eigenvalues, so that exact
+  // samples can be generated
+  using Field = parafields::RandomField<GridTraits<TestType, TestType, 2>,
+                                        DFTMatrix,
+                                        DFTMatrix>;
+  Field field1(config);
+  REQUIRE_NOTHROW(field1.generate(42u));
+  REQUIRE(field1.twoNorm() > 0.);
+
+  // The optimized embedding has to match the one on a single processor
+  Field field2(config, "", parafields::DefaultLoadBalance<2>(), MPI_COMM_SELF);
+  const unsigned int count = 32 * 32;
+  field1.setupReducedRank(count);
+  field2.setupReducedRank(count);
+  const std::vector<TestType> eigenvalues1 = field1.reducedRankEigenvalues();
+  const std::vector<TestType> eigenvalues2 = field2.reducedRankEigenvalues();
+  REQUIRE(eigenvalues1.size() == count);
+  REQUIRE(eigenvalues2.size() == count);
+  REQUIRE(eigenvalues1.back() >= -1e-6);
+  for (unsigned int j = 0; j < count; j++)
+    REQUIRE(std::abs(eigenvalues1[j] - eigenvalues2[j]) <=
+            std::sqrt(std::numeric_limits<TestType>::epsilon()) *
+              eigenvalues1[0]);
+}
+#endif // HAVE_DUNE_NONLINOPT
+
+TEST_CASE("Strided copy bandwidth", "[.benchmark]")
+{
+  // Compaction of a 3D DCT array with odd boundaries in the first two
+  // dimensions, as performed before each DST transform
+  using Indices = std::array<unsigned int, 3>;
+  using Copy = parafields::StridedCopy<unsigned int, Indices, 3>;
+  const Indices cells = { 257, 257, 129 };
+  const Indices compact = { 255, 255, 129 };
+  const unsigned int offset = 1 + cells[0];
+
+  std::vector<double> source(cells[0] * cells[1] * cells[2]);
+  for (std::size_t i = 0; i < source.size(); i++)
+    source[i] = i;
+  std::vector<double> target(compact[0] * compact[1] * compact[2]);
+
+  // Strided copy has to match naive element-wise copy
+  Copy::copy(compact, source.data(), cells, offset, target.data(), compact, 0);
+  std::size_t mismatches = 0;
+  for (unsigned int k = 0; k < compact[2]; k++)
+    for (unsigned int j = 0; j < compact[1]; j++)
+      for (unsigned int i = 0; i < compact[0]; i++)
+        if (target[i + compact[0] * (j + compact[1] * k)] !=
+            source[offset + i + cells[0] * (j + cells[1] * k)])
+          mismatches++;
+  REQUIRE(mismatches == 0);
+
+  const int repetitions = 20;
+  auto measure = [&](auto&& function) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++)
+      function();
+    const std::chrono::duration<double> time =
+      std::chrono::steady_clock::now() - start;
+    return repetitions * target.size() * sizeof(double) / time.count() / 1e9;
+  };
+
+  const double strided = measure([&]() {
+    Copy::copy(
+      compact, source.data(), cells, offset, target.data(), compact, 0);
+  });
+  const double contiguous = measure([&]() {
+    std::memcpy(
+      target.data(), source.data(), target.size() * sizeof(double));
+  });
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank == 0)
+    std::cout << "strided copy: " << strided << " GB/s, memcpy: " << contiguous
+              << " GB/s, ratio: " << strided / contiguous << std::endl;
+}
@@ -3,12 +3,14 @@
 
 #define CATCH_CONFIG_RUNNER
 #include "catch2/catch.hpp"
-#include <mpi.h>
+#include <parafields/mpi.hh>
 
 int
 main(int argc, char* argv[])
 {
-  MPI_Init(&argc, &argv);
+  // background setup of covariance matrices requires MPI_THREAD_MULTIPLE
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
   int result = Catch::Session().run(argc, argv);
   MPI_Finalize();
   return result;
@@ -0,0 +1,146 @@
+// Offline creation of FFTW wisdom for parafields
+//
+// Usage: mpirun -n <procs> parafields-wisdom <config.ini> [float|double]
+//
+// Creates a random field for the given configuration with patient FFTW
+// planning, generates a field and multiplies it with the covariance
+// matrix, so that every transform of a production run with the same
+// configuration and number of processors has been planned. The resulting
+// wisdom is stored in fftw.wisdomDirectory, and production runs pick it
+// up if fftw.useWisdom is set. The default backends of RandomField are
+// planned, unless randomField.backends is given, which requires runtime
+// selection of the backends. If it is "autotune", the choice of backends
+// is stored as well.
+
+#include <parafields/randomfield.hh>
+
+#include <dune/common/fvector.hh>
+#include <dune/common/parametertreeparser.hh>
+
+#include <parafields/mpi.hh>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Types for coordinates and range values
+ */
+template<typename RF, unsigned int dimension>
+class GridTraits
+{
+public:
+  enum
+  {
+    dim = dimension
+  };
+
+  using RangeField = RF;
+  using Scalar = Dune::FieldVector<RF, 1>;
+  using DomainField = RF;
+  using Domain = Dune::FieldVector<RF, dim>;
+};
+
+/**
+ * @brief Plan all transforms of given random field type
+ *
+ * @param config configuration, including patient planning and wisdom
+ */
+template<typename Field>
+void
+planField(const Dune::ParameterTree& config)
+{
+  Field field(config);
+  field.generate();
+  field.timesMatrix();
+}
+
+/**
+ * @brief Plan all transforms for given configuration
+ *
+ * The backends have to be the same as in the production run, since they
+ * determine the transforms, e.g., whether the transposed layout is used.
+ *
+ * @param config configuration, including patient planning and wisdom
+ */
+template<typename RF, unsigned int dim>
+void
+plan(const Dune::ParameterTree& config)
+{
+  if (config.hasKey("randomField.backends"))
+    planField<parafields::RandomField<
+      GridTraits<RF, dim>,
+      parafields::AutoMatrix<dim>::template Type,
+      parafields::AutoMatrix<dim>::template Type>>(config);
+  else
+    planField<parafields::RandomField<GridTraits<RF, dim>>>(config);
+}
+
+/**
+ * @brief Dispatch based on dimension of configured grid
+ *
+ * @param config configuration, including patient planning and wisdom
+ */
+template<typename RF>
+void
+plan(const Dune::ParameterTree& config)
+{
+  const auto& cells = config.get<std::vector<unsigned int>>("grid.cells");
+  if (cells.size() == 1)
+    plan<RF, 1>(config);
+  else if (cells.size() == 2)
+    plan<RF, 2>(config);
+  else if (cells.size() == 3)
+    plan<RF, 3>(config);
+  else
+    throw std::runtime_error{ "grid.cells must have one to three entries" };
+}
+
+int
+main(int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  if (argc < 2 || argc > 3) {
+    if (rank == 0)
+      std::cerr << "usage: " << argv[0] << " <config.ini> [float|double]"
+                << std::endl;
+    MPI_Finalize();
+    return 1;
+  }
+
+  Dune::ParameterTree config;
+  Dune::ParameterTreeParser::readINITree(argv[1], config);
+  config["fftw.useWisdom"] = "true";
+  config["fftw.patient"] = "true";
+
+  const std::string precision = (argc == 3) ? argv[2] : "double";
+  int result = 0;
+  try {
+    if (precision == "double") {
+#if HAVE_FFTW3_DOUBLE
+      plan<double>(config);
+#else
+      throw std::runtime_error{ "FFTW not available in double precision" };
+#endif // HAVE_FFTW3_DOUBLE
+    } else if (precision == "float") {
+#if HAVE_FFTW3_FLOAT
+      plan<float>(config);
+#else
+      throw std::runtime_error{ "FFTW not available in single precision" };
+#endif // HAVE_FFTW3_FLOAT
+    } else
+      throw std::runtime_error{ "unknown precision: " + precision };
+  } catch (const std::exception& e) {
+    if (rank == 0)
+      std::cerr << "parafields-wisdom: " << e.what() << std::endl;
+    result = 1;
+  }
+
+  MPI_Finalize();
+  return result;
+}